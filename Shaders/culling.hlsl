@@ -0,0 +1,76 @@
+
+// Frustum culling and draw compaction. Each thread tests one object's world
+// bounds and appends a draw command for it when it is visible; the scene pass
+// consumes the commands with ExecuteIndirect. Must stay in sync with
+// Source/GpuCulling.h, whose CullAndCompact is the CPU reference of CSMain.
+
+cbuffer CullConstants : register(b0)
+{
+	float4 planes[6];		// Inward facing (normal, distance).
+	uint objectCount;
+	uint maxCommands;
+};
+
+struct CullObject
+{
+	uint2 material;			// GPU virtual addresses of the material constants
+	uint2 instance;			// and of the object's instance data.
+	uint indexCount;
+	uint startIndex;
+	int baseVertex;
+	uint padding;
+	float3 center;
+	float3 extents;
+};
+
+StructuredBuffer<CullObject> g_objects : register(t0);
+RWByteAddressBuffer g_commands : register(u0);		// 40 bytes per command: root CBV, root SRV, then D3D12_DRAW_INDEXED_ARGUMENTS.
+RWByteAddressBuffer g_commandCount : register(u1);
+
+static const uint CommandStride = 40;
+
+// precise keeps the compiler from fusing or reordering, so the result matches the C++ reference bit for bit.
+bool IsVisible(float3 center, float3 extents)
+{
+	[unroll]
+	for (uint p = 0; p < 6; p++)
+	{
+		const float4 plane = planes[p];
+		precise float distance = ((plane.x * center.x + plane.y * center.y) + plane.z * center.z) + plane.w;
+		precise float radius = (abs(plane.x) * extents.x + abs(plane.y) * extents.y) + abs(plane.z) * extents.z;
+		if (distance + radius < 0.0f)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+[numthreads(64, 1, 1)]
+void CSMain(uint3 dispatchThreadId : SV_DispatchThreadID)
+{
+	const uint objectIndex = dispatchThreadId.x;
+	if (objectIndex >= objectCount)
+	{
+		return;
+	}
+
+	const CullObject object = g_objects[objectIndex];
+	if (!IsVisible(object.center, object.extents))
+	{
+		return;
+	}
+
+	// The count keeps growing past the capacity; ExecuteIndirect clamps it to its MaxCommandCount.
+	uint slot;
+	g_commandCount.InterlockedAdd(0, 1, slot);
+	if (slot >= maxCommands)
+	{
+		return;
+	}
+
+	const uint address = slot * CommandStride;
+	g_commands.Store4(address, uint4(object.material, object.instance));
+	g_commands.Store4(address + 16, uint4(object.indexCount, 1, object.startIndex, asuint(object.baseVertex)));
+	g_commands.Store2(address + 32, uint2(0, 0));
+}
@@ -1,12 +1,25 @@
 
-cbuffer SceneConstantBuffer : register(b0)
+// Shared by every instance of a draw; draws are grouped by material.
+cbuffer MaterialConstantBuffer : register(b0)
 {
-	float4x4 mWorldViewProj;
-	float4x4 mWorld;
 	float4 materialColor;
 	float3 cameraPos;
+	uint textureIndex;
 };
 
+struct InstanceData
+{
+	float4x4 mWorldViewProj;
+	float4x4 mWorld;
+	float3 positionScale;	// Decodes the mesh's quantized positions: position * positionScale + positionOffset.
+	float lodFade;		// Share of pixels drawn during a LOD crossfade; negative for the LOD fading out.
+	float3 positionOffset;
+	float padding;
+};
+
+// The draw's instances, starting at its first one, indexed by SV_InstanceID.
+StructuredBuffer<InstanceData> g_instances : register(t0);
+
 //cbuffer PSConstants : register(b1)
 //{
 //	float4 materialColor;
@@ -17,16 +30,18 @@ cbuffer SceneConstantBuffer : register(b0)
 //	float3 cameraPos;
 //};
 
-Texture2D g_texture : register(t0);
+// Every SRV in the bindless heap; draws select theirs by index.
+Texture2D g_textures[] : register(t0, space1);
 SamplerState g_sampler : register(s0);
 
 
+// PackedVertex, see Source/VertexPacking.h.
 struct VSInput
 {
-	float3 position : POSITION;
-	float2 texCoord : TEXCOORD;
-	float3 normal : NORMAL;
-	float4 color : COLOR;
+	float4 position : POSITION;		// UNORM16 across the mesh's bounds.
+	float2 texCoord : TEXCOORD;		// Half floats.
+	float2 normal : NORMAL;			// SNORM16 octahedral.
+	float4 color : COLOR;			// UNORM8.
 };
 
 struct PSInput
@@ -36,18 +51,33 @@ struct PSInput
 	float3 worldPos : TEXCOORD1;
 	float3 normal : NORMAL;
 	float4 color : COLOR;
+	nointerpolation float lodFade : LODFADE;
 };
 
 
-PSInput VSMain(VSInput input)
+// Unfolds the lower half of the octahedron; matches DecodeOctahedral in Source/VertexPacking.cpp.
+float3 DecodeOctahedral(float2 encoded)
+{
+	float3 normal = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+	const float t = saturate(-normal.z);
+	normal.xy += t * (1.0f - 2.0f * step(0.0f, normal.xy));
+	return normalize(normal);
+}
+
+PSInput VSMain(VSInput input, uint instanceId : SV_InstanceID)
 {
 	PSInput result;
 
-	result.position = mul(mWorldViewProj, float4(input.position.xyz, 1.0f));
+	const float4x4 mWorldViewProj = g_instances[instanceId].mWorldViewProj;
+	const float4x4 mWorld = g_instances[instanceId].mWorld;
+	const float3 position = input.position.xyz * g_instances[instanceId].positionScale + g_instances[instanceId].positionOffset;
+
+	result.position = mul(mWorldViewProj, float4(position, 1.0f));
 	result.texCoord = input.texCoord;
-	result.worldPos = mul(mWorld, float4(input.position.xyz, 1.0f)).xyz;
-	result.normal = mul((float3x3)mWorld, input.normal);
+	result.worldPos = mul(mWorld, float4(position, 1.0f)).xyz;
+	result.normal = mul((float3x3)mWorld, DecodeOctahedral(input.normal));
 	result.color = input.color;
+	result.lodFade = g_instances[instanceId].lodFade;
 
 	return result;
 }
@@ -141,8 +171,27 @@ float3 DirectionalLight(float3 albedoColor, float3 specularColor, float roughnes
 	return light;
 }
 
+// 4x4 ordered dither thresholds in (0, 1).
+static const float DitherThresholds[16] =
+{
+	0.5f / 16, 8.5f / 16, 2.5f / 16, 10.5f / 16,
+	12.5f / 16, 4.5f / 16, 14.5f / 16, 6.5f / 16,
+	3.5f / 16, 11.5f / 16, 1.5f / 16, 9.5f / 16,
+	15.5f / 16, 7.5f / 16, 13.5f / 16, 5.5f / 16,
+};
+
 float4 PSMain(PSInput input) : SV_TARGET
 {
+	// During a LOD crossfade the incoming LOD keeps the pixels whose threshold is
+	// below the fade and the outgoing one keeps the rest, so together they cover
+	// every pixel once.
+	if (input.lodFade < 1.0f)
+	{
+		const uint2 pixel = uint2(input.position.xy) & 3;
+		const float threshold = DitherThresholds[pixel.y * 4 + pixel.x];
+		clip(input.lodFade >= 0.0f ? input.lodFade - threshold : threshold + input.lodFade);
+	}
+
 	float g_fMaterialRoughness = 0.4f;
 	float g_fMaterialMetallic = 0.0f;
 	float3 albedoColor = materialColor.rgb; //input.color.rgb;
@@ -161,6 +210,7 @@ float4 PSMain(PSInput input) : SV_TARGET
 	albedoColor = lerp(albedoColor, float3(0.1f, 0.1f, 0.1f), checkboard);
 	albedoColor = sin((input.texCoord.x * 30 + sin(input.texCoord.y * 40)) * 3);
 	albedoColor = sin((input.texCoord.x + distance(input.texCoord, float2(0.5f, 0.5f)) * 30) * 4);
+	albedoColor *= g_textures[textureIndex].Sample(g_sampler, input.texCoord).rgb;
 
 	const float roughness = max(0.08f, g_fMaterialRoughness);
 	const float3 specularColor = lerp(0.04f, albedoColor, g_fMaterialMetallic);
@@ -173,6 +223,6 @@ float4 PSMain(PSInput input) : SV_TARGET
 	float3 outColor = light;
 
 	//return float4(input.texCoord, 0.0f, 1.0f);
-	//return g_texture.Sample(g_sampler, input.texCoord);
+	//return g_textures[textureIndex].Sample(g_sampler, input.texCoord);
 	return float4(outColor, alpha);
 }
\ No newline at end of file
@@ -0,0 +1,53 @@
+#include "stdafx.h"
+#include "BindlessDescriptorHeap.h"
+#include "DXHelper.h"
+
+BindlessDescriptorHeap::BindlessDescriptorHeap(ID3D12Device* pDevice, UINT capacity) :
+	m_device(pDevice),
+	m_allocator(capacity)
+{
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+	heapDesc.NumDescriptors = capacity;
+	heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	ThrowIfFailed(m_device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&m_heap)));
+
+	m_cpuStart = m_heap->GetCPUDescriptorHandleForHeapStart();
+	m_descriptorSize = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+}
+
+BindlessHandle BindlessDescriptorHeap::CreateShaderResourceView(ID3D12Resource* pResource, const D3D12_SHADER_RESOURCE_VIEW_DESC* pDesc)
+{
+	const BindlessHandle handle = AllocateSlot();
+	m_device->CreateShaderResourceView(pResource, pDesc, GetCpuHandle(handle));
+	return handle;
+}
+
+BindlessHandle BindlessDescriptorHeap::CreateUnorderedAccessView(ID3D12Resource* pResource, const D3D12_UNORDERED_ACCESS_VIEW_DESC* pDesc)
+{
+	const BindlessHandle handle = AllocateSlot();
+	m_device->CreateUnorderedAccessView(pResource, nullptr, pDesc, GetCpuHandle(handle));
+	return handle;
+}
+
+BindlessHandle BindlessDescriptorHeap::CreateConstantBufferView(const D3D12_CONSTANT_BUFFER_VIEW_DESC& desc)
+{
+	const BindlessHandle handle = AllocateSlot();
+	m_device->CreateConstantBufferView(&desc, GetCpuHandle(handle));
+	return handle;
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE BindlessDescriptorHeap::GetCpuHandle(BindlessHandle handle) const
+{
+	return CD3DX12_CPU_DESCRIPTOR_HANDLE(m_cpuStart, handle.index, m_descriptorSize);
+}
+
+BindlessHandle BindlessDescriptorHeap::AllocateSlot()
+{
+	const BindlessHandle handle = m_allocator.Allocate();
+	if (handle.IsNull())
+	{
+		ThrowIfFailed(E_OUTOFMEMORY);
+	}
+	return handle;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "DescriptorSlotAllocator.h"
+
+using Microsoft::WRL::ComPtr;
+
+// One shader-visible CBV/SRV/UAV heap for the whole renderer. Views are written
+// into slots handed out by a lock-free allocator, and shaders index the heap
+// through an unbounded descriptor table bound once per command list. Freed
+// slots are only reused once the frame that last referenced them has retired.
+class BindlessDescriptorHeap
+{
+public:
+    static const UINT DefaultCapacity = 65536;
+
+    BindlessDescriptorHeap(ID3D12Device* pDevice, UINT capacity = DefaultCapacity);
+
+    BindlessHandle CreateShaderResourceView(ID3D12Resource* pResource, const D3D12_SHADER_RESOURCE_VIEW_DESC* pDesc = nullptr);
+    BindlessHandle CreateUnorderedAccessView(ID3D12Resource* pResource, const D3D12_UNORDERED_ACCESS_VIEW_DESC* pDesc);
+    BindlessHandle CreateConstantBufferView(const D3D12_CONSTANT_BUFFER_VIEW_DESC& desc);
+
+    // The slot is recycled once fenceValue has completed on the GPU.
+    void Free(BindlessHandle handle, UINT64 fenceValue) { m_allocator.FreeDeferred(handle, fenceValue); }
+    void Reclaim(UINT64 completedFenceValue) { m_allocator.Reclaim(completedFenceValue); }
+
+    ID3D12DescriptorHeap* GetHeap() const { return m_heap.Get(); }
+    D3D12_GPU_DESCRIPTOR_HANDLE GetGpuTableStart() const { return m_heap->GetGPUDescriptorHandleForHeapStart(); }
+    D3D12_CPU_DESCRIPTOR_HANDLE GetCpuHandle(BindlessHandle handle) const;
+    UINT GetAllocatedCount() const { return m_allocator.GetAllocatedCount(); }
+
+private:
+    BindlessHandle AllocateSlot();
+
+    ComPtr<ID3D12Device> m_device;
+    ComPtr<ID3D12DescriptorHeap> m_heap;
+    D3D12_CPU_DESCRIPTOR_HANDLE m_cpuStart;
+    UINT m_descriptorSize;
+    DescriptorSlotAllocator m_allocator;
+};
@@ -0,0 +1,270 @@
+#include "stdafx.h"
+#include "CopyUploader.h"
+#include "DXHelper.h"
+
+namespace
+{
+	// Copies within a buffer have no placement requirement, but keeping sources
+	// aligned avoids straddling cache lines on the CPU side.
+	const UINT64 RingAlignment = 16;
+}
+
+CopyUploader::CopyUploader(ID3D12Device* pDevice, UINT64 ringSize) :
+	m_device(pDevice),
+	m_fenceEvent(nullptr),
+	m_nextFenceValue(1),
+	m_lastSubmittedFenceValue(0),
+	m_pRingCpuAddress(nullptr),
+	m_ringAllocator(ringSize),
+	m_recording(false),
+	m_pendingCopies(0),
+	m_stats{}
+{
+	D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+	queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+	queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+	ThrowIfFailed(m_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_copyQueue)));
+
+	ThrowIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&m_currentAllocator)));
+	ThrowIfFailed(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY, m_currentAllocator.Get(), nullptr, IID_PPV_ARGS(&m_commandList)));
+	ThrowIfFailed(m_commandList->Close());
+	m_availableAllocators.push_back(m_currentAllocator);
+	m_currentAllocator.Reset();
+
+	ThrowIfFailed(m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
+	m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+	if (m_fenceEvent == nullptr)
+	{
+		ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+	}
+
+	ThrowIfFailed(m_device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(ringSize),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&m_ring)));
+
+	CD3DX12_RANGE readRange(0, 0);
+	ThrowIfFailed(m_ring->Map(0, &readRange, reinterpret_cast<void**>(&m_pRingCpuAddress)));
+}
+
+CopyUploader::~CopyUploader()
+{
+	WaitForIdle();
+	m_ring->Unmap(0, nullptr);
+	CloseHandle(m_fenceEvent);
+}
+
+ComPtr<ID3D12Resource> CopyUploader::CreateBuffer(const void* pData, UINT64 size)
+{
+	ComPtr<ID3D12Resource> buffer = CreateBuffer(size);
+	UploadBuffer(buffer.Get(), 0, pData, size);
+	return buffer;
+}
+
+ComPtr<ID3D12Resource> CopyUploader::CreateBuffer(UINT64 size)
+{
+	ComPtr<ID3D12Resource> buffer;
+	ThrowIfFailed(m_device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(size),
+		D3D12_RESOURCE_STATE_COMMON,
+		nullptr,
+		IID_PPV_ARGS(&buffer)));
+	return buffer;
+}
+
+ComPtr<ID3D12Resource> CopyUploader::CreateTexture2D(DXGI_FORMAT format, UINT width, UINT height, const void* pData, UINT rowPitch)
+{
+	const CD3DX12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Tex2D(format, width, height, 1, 1);
+
+	ComPtr<ID3D12Resource> texture;
+	ThrowIfFailed(m_device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&desc,
+		D3D12_RESOURCE_STATE_COMMON,
+		nullptr,
+		IID_PPV_ARGS(&texture)));
+
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+	UINT rowCount;
+	UINT64 rowSize;
+	UINT64 totalSize;
+	m_device->GetCopyableFootprints(&desc, 0, 1, 0, &footprint, &rowCount, &rowSize, &totalSize);
+
+	// Unlike buffers, a subresource is not split across several copies.
+	if (totalSize > m_ringAllocator.GetMaxAllocationSize())
+	{
+		ThrowIfFailed(E_INVALIDARG);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	footprint.Offset = AllocateRing(totalSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+	// The ring rows are padded to D3D12_TEXTURE_DATA_PITCH_ALIGNMENT.
+	const UINT8* pSource = static_cast<const UINT8*>(pData);
+	for (UINT row = 0; row < rowCount; row++)
+	{
+		memcpy(m_pRingCpuAddress + footprint.Offset + row * footprint.Footprint.RowPitch, pSource + row * rowPitch, static_cast<size_t>(rowSize));
+	}
+
+	BeginCommandList();
+	const CD3DX12_TEXTURE_COPY_LOCATION destination(texture.Get(), 0);
+	const CD3DX12_TEXTURE_COPY_LOCATION source(m_ring.Get(), footprint);
+	m_commandList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+	m_pendingCopies++;
+
+	m_stats.bytesUploaded += rowSize * rowCount;
+	m_stats.copyCount++;
+
+	return texture;
+}
+
+void CopyUploader::UploadBuffer(ID3D12Resource* pDestination, UINT64 destinationOffset, const void* pData, UINT64 size)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const UINT8* pSource = static_cast<const UINT8*>(pData);
+	while (size > 0)
+	{
+		const UINT64 chunkSize = std::min(size, m_ringAllocator.GetMaxAllocationSize());
+		const UINT64 ringOffset = AllocateRing(chunkSize, RingAlignment);
+
+		memcpy(m_pRingCpuAddress + ringOffset, pSource, static_cast<size_t>(chunkSize));
+
+		BeginCommandList();
+		m_commandList->CopyBufferRegion(pDestination, destinationOffset, m_ring.Get(), ringOffset, chunkSize);
+		m_pendingCopies++;
+
+		m_stats.bytesUploaded += chunkSize;
+		m_stats.copyCount++;
+
+		pSource += chunkSize;
+		destinationOffset += chunkSize;
+		size -= chunkSize;
+	}
+}
+
+UINT64 CopyUploader::Flush()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return FlushLocked();
+}
+
+void CopyUploader::QueueWait(ID3D12CommandQueue* pQueue)
+{
+	const UINT64 fenceValue = Flush();
+	if (fenceValue > 0 && !IsComplete(fenceValue))
+	{
+		ThrowIfFailed(pQueue->Wait(m_fence.Get(), fenceValue));
+	}
+}
+
+void CopyUploader::WaitForIdle()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	WaitForFenceValue(FlushLocked());
+	RetireSubmissions();
+}
+
+CopyUploader::Stats CopyUploader::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+// Returns the physical offset of size contiguous bytes in the ring, waiting for
+// the copy queue to release space if the ring is full.
+UINT64 CopyUploader::AllocateRing(UINT64 size, UINT64 alignment)
+{
+	for (;;)
+	{
+		RetireSubmissions();
+
+		const UINT64 offset = m_ringAllocator.Allocate(size, alignment);
+		if (offset != UploadRingAllocator::NoSpace)
+		{
+			return offset;
+		}
+
+		// Out of space: whatever is queued must be submitted before its space can come back.
+		if (m_pendingCopies > 0)
+		{
+			FlushLocked();
+		}
+		m_stats.ringStallCount++;
+		WaitForFenceValue(m_ringAllocator.GetOldestFenceValue());
+	}
+}
+
+void CopyUploader::BeginCommandList()
+{
+	if (m_recording)
+	{
+		return;
+	}
+
+	if (m_availableAllocators.empty())
+	{
+		ThrowIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&m_currentAllocator)));
+	}
+	else
+	{
+		m_currentAllocator = m_availableAllocators.front();
+		m_availableAllocators.pop_front();
+		ThrowIfFailed(m_currentAllocator->Reset());
+	}
+
+	ThrowIfFailed(m_commandList->Reset(m_currentAllocator.Get(), nullptr));
+	m_recording = true;
+}
+
+UINT64 CopyUploader::FlushLocked()
+{
+	if (!m_recording)
+	{
+		return m_lastSubmittedFenceValue;
+	}
+
+	ThrowIfFailed(m_commandList->Close());
+	ID3D12CommandList* ppCommandLists[] = { m_commandList.Get() };
+	m_copyQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+
+	const UINT64 fenceValue = m_nextFenceValue++;
+	ThrowIfFailed(m_copyQueue->Signal(m_fence.Get(), fenceValue));
+
+	m_ringAllocator.Submit(fenceValue);
+	m_submissions.push_back({ fenceValue, m_currentAllocator });
+	m_currentAllocator.Reset();
+	m_recording = false;
+	m_pendingCopies = 0;
+	m_lastSubmittedFenceValue = fenceValue;
+	m_stats.submitCount++;
+
+	return fenceValue;
+}
+
+void CopyUploader::RetireSubmissions()
+{
+	const UINT64 completedValue = m_fence->GetCompletedValue();
+	m_ringAllocator.RetireSubmissions(completedValue);
+	while (!m_submissions.empty() && m_submissions.front().fenceValue <= completedValue)
+	{
+		m_availableAllocators.push_back(m_submissions.front().allocator);
+		m_submissions.pop_front();
+	}
+}
+
+void CopyUploader::WaitForFenceValue(UINT64 fenceValue)
+{
+	if (m_fence->GetCompletedValue() < fenceValue)
+	{
+		ThrowIfFailed(m_fence->SetEventOnCompletion(fenceValue, m_fenceEvent));
+		WaitForSingleObjectEx(m_fenceEvent, INFINITE, FALSE);
+	}
+}
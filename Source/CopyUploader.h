@@ -0,0 +1,95 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+
+#include "UploadRingAllocator.h"
+
+using Microsoft::WRL::ComPtr;
+
+// Uploads static data into DEFAULT heap resources on a dedicated copy queue.
+// Source data is staged in a persistently mapped upload ring; copies are
+// batched into one command list until Flush, which submits them and signals
+// the copy fence. Ring space and command allocators are reclaimed as that
+// fence completes. Consumers make their queue wait on the fence (QueueWait)
+// instead of blocking the CPU. Destinations are created in the COMMON
+// state: the copy queue promotes them to COPY_DEST and they decay back once
+// the copy completes, so the direct queue can read them without barriers.
+// Thread-safe.
+class CopyUploader
+{
+public:
+    static const UINT64 DefaultRingSize = 16 * 1024 * 1024;
+
+    struct Stats
+    {
+        UINT64 bytesUploaded;
+        UINT64 copyCount;
+        UINT64 submitCount;
+        UINT64 ringStallCount;      // Times the CPU had to wait for the copy queue to free ring space.
+    };
+
+    CopyUploader(ID3D12Device* pDevice, UINT64 ringSize = DefaultRingSize);
+    ~CopyUploader();
+
+    // Create a buffer in the default heap and queue the upload of its contents.
+    ComPtr<ID3D12Resource> CreateBuffer(const void* pData, UINT64 size);
+
+    // Create a buffer in the default heap, to be filled with UploadBuffer.
+    ComPtr<ID3D12Resource> CreateBuffer(UINT64 size);
+
+    // Create a single-mip 2D texture in the default heap and queue the upload of its texels.
+    ComPtr<ID3D12Resource> CreateTexture2D(DXGI_FORMAT format, UINT width, UINT height, const void* pData, UINT rowPitch);
+
+    // Queue a copy into an existing buffer, which must stay alive until the copy completes.
+    // Data larger than the ring is split into several copies.
+    void UploadBuffer(ID3D12Resource* pDestination, UINT64 destinationOffset, const void* pData, UINT64 size);
+
+    // Submit everything queued since the last flush. Returns the fence value that
+    // signals completion, or the last submitted one if nothing was queued.
+    UINT64 Flush();
+
+    // Flush, then make pQueue wait on the GPU for all submitted copies.
+    void QueueWait(ID3D12CommandQueue* pQueue);
+
+    // Flush and block until the copy queue is idle.
+    void WaitForIdle();
+
+    bool IsComplete(UINT64 fenceValue) const { return m_fence->GetCompletedValue() >= fenceValue; }
+    Stats GetStats() const;
+
+private:
+    struct Submission
+    {
+        UINT64 fenceValue;
+        ComPtr<ID3D12CommandAllocator> allocator;
+    };
+
+    UINT64 AllocateRing(UINT64 size, UINT64 alignment);
+    void BeginCommandList();
+    UINT64 FlushLocked();
+    void RetireSubmissions();
+    void WaitForFenceValue(UINT64 fenceValue);
+
+    ComPtr<ID3D12Device> m_device;
+    ComPtr<ID3D12CommandQueue> m_copyQueue;
+    ComPtr<ID3D12GraphicsCommandList> m_commandList;
+    ComPtr<ID3D12CommandAllocator> m_currentAllocator;
+    std::deque<ComPtr<ID3D12CommandAllocator>> m_availableAllocators;
+
+    ComPtr<ID3D12Fence> m_fence;
+    HANDLE m_fenceEvent;
+    UINT64 m_nextFenceValue;
+    UINT64 m_lastSubmittedFenceValue;
+
+    // Ring of upload memory, laid out by m_ringAllocator.
+    ComPtr<ID3D12Resource> m_ring;
+    UINT8* m_pRingCpuAddress;
+    UploadRingAllocator m_ringAllocator;
+    std::deque<Submission> m_submissions;
+
+    bool m_recording;
+    UINT m_pendingCopies;
+    Stats m_stats;
+    mutable std::mutex m_mutex;
+};
@@ -0,0 +1,310 @@
+#include "stdafx.h"
+#include "D3D12RenderGraphBackend.h"
+#include "DXHelper.h"
+
+#include <cassert>
+
+namespace
+{
+	bool IsSameResourceDesc(const D3D12_RESOURCE_DESC& a, const D3D12_RESOURCE_DESC& b)
+	{
+		return a.Dimension == b.Dimension && a.Alignment == b.Alignment && a.Width == b.Width && a.Height == b.Height &&
+			a.DepthOrArraySize == b.DepthOrArraySize && a.MipLevels == b.MipLevels && a.Format == b.Format &&
+			a.SampleDesc.Count == b.SampleDesc.Count && a.SampleDesc.Quality == b.SampleDesc.Quality &&
+			a.Layout == b.Layout && a.Flags == b.Flags;
+	}
+}
+
+D3D12RenderGraphBackend::D3D12RenderGraphBackend() :
+	m_pDevice(nullptr),
+	m_mixedResourceHeaps(false),
+	m_pCommandList(nullptr),
+	m_heapSizes{},
+	m_transientHeapSize(0),
+	m_layoutChangeCount(0)
+{
+}
+
+void D3D12RenderGraphBackend::Initialize(ID3D12Device* pDevice, const std::function<void(IUnknown*)>& deferRelease)
+{
+	m_pDevice = pDevice;
+	m_deferRelease = deferRelease;
+
+	D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+	ThrowIfFailed(m_pDevice->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options)));
+	m_mixedResourceHeaps = options.ResourceHeapTier >= D3D12_RESOURCE_HEAP_TIER_2;
+}
+
+RenderGraphResource D3D12RenderGraphBackend::CreateTransientResource(RenderGraph& graph, const char* name, const D3D12_RESOURCE_DESC& desc, const D3D12_CLEAR_VALUE* pClearValue)
+{
+	UINT heapGroup = HeapGroupOtherTextures;
+	if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+	{
+		heapGroup = HeapGroupBuffers;
+	}
+	else if (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+	{
+		heapGroup = HeapGroupTargetTextures;
+	}
+	if (m_mixedResourceHeaps)
+	{
+		heapGroup = 0;
+	}
+
+	const D3D12_RESOURCE_ALLOCATION_INFO info = GetAllocationInfo(desc);
+	const RenderGraphResource resource = graph.CreateTransientResource(name, info.SizeInBytes, info.Alignment, heapGroup);
+
+	TransientDesc transient = {};
+	transient.resource = resource;
+	transient.desc = desc;
+	transient.hasClearValue = pClearValue != nullptr;
+	if (pClearValue)
+	{
+		transient.clearValue = *pClearValue;
+	}
+	transient.alignment = info.Alignment;
+	transient.heapGroup = heapGroup;
+	m_pendingTransients.push_back(transient);
+
+	return resource;
+}
+
+// Layouts rarely change between frames, so the placed resources of the previous
+// frame are reused as long as every description, offset and state matches.
+void D3D12RenderGraphBackend::PrepareTransientResources(const RenderGraph& graph)
+{
+	// Transients only used by culled passes take no memory.
+	std::vector<TransientDesc> transients;
+	transients.reserve(m_pendingTransients.size());
+	for (TransientDesc& transient : m_pendingTransients)
+	{
+		if (graph.IsTransientAllocated(transient.resource))
+		{
+			transient.heapOffset = graph.GetTransientHeapOffset(transient.resource);
+			transient.initialState = ToResourceStates(graph.GetInitialState(transient.resource));
+			transients.push_back(transient);
+		}
+		else
+		{
+			SetResource(transient.resource, nullptr);
+		}
+	}
+	m_pendingTransients.clear();
+
+	UINT64 heapSizes[HeapGroupCount] = {};
+	for (uint32_t group = 0; group < graph.GetTransientHeapGroupCount(); group++)
+	{
+		heapSizes[group] = graph.GetTransientHeapSize(group);
+	}
+
+	bool layoutChanged = transients.size() != m_transients.size();
+	for (UINT group = 0; group < HeapGroupCount; group++)
+	{
+		layoutChanged |= heapSizes[group] != m_heapSizes[group];
+	}
+	for (size_t i = 0; !layoutChanged && i < transients.size(); i++)
+	{
+		layoutChanged = !IsSameTransient(transients[i], m_transients[i]);
+	}
+
+	if (layoutChanged)
+	{
+		ReleaseTransientResources();
+		m_layoutChangeCount++;
+		m_transientHeapSize = 0;
+
+		for (UINT group = 0; group < HeapGroupCount; group++)
+		{
+			m_heapSizes[group] = heapSizes[group];
+			if (heapSizes[group] == 0)
+			{
+				continue;
+			}
+
+			UINT64 alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+			for (const TransientDesc& transient : transients)
+			{
+				if (transient.heapGroup == group)
+				{
+					alignment = std::max(alignment, transient.alignment);
+				}
+			}
+
+			static const D3D12_HEAP_FLAGS groupFlags[HeapGroupCount] =
+			{
+				D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS,
+				D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES,
+				D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES,
+			};
+
+			D3D12_HEAP_DESC heapDesc = {};
+			heapDesc.SizeInBytes = heapSizes[group];
+			heapDesc.Properties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+			heapDesc.Alignment = alignment;
+			heapDesc.Flags = m_mixedResourceHeaps ? D3D12_HEAP_FLAG_ALLOW_ALL_BUFFERS_AND_TEXTURES : groupFlags[group];
+			ThrowIfFailed(m_pDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(&m_heaps[group])));
+
+			m_transientHeapSize += heapSizes[group];
+		}
+
+		m_transients = transients;
+		m_transientResources.resize(m_transients.size());
+		for (size_t i = 0; i < m_transients.size(); i++)
+		{
+			const TransientDesc& transient = m_transients[i];
+			ThrowIfFailed(m_pDevice->CreatePlacedResource(
+				m_heaps[transient.heapGroup].Get(),
+				transient.heapOffset,
+				&transient.desc,
+				transient.initialState,
+				transient.hasClearValue ? &transient.clearValue : nullptr,
+				IID_PPV_ARGS(&m_transientResources[i])));
+		}
+	}
+
+	for (size_t i = 0; i < m_transients.size(); i++)
+	{
+		SetResource(m_transients[i].resource, m_transientResources[i].Get());
+	}
+}
+
+void D3D12RenderGraphBackend::SetResource(RenderGraphResource resource, ID3D12Resource* pResource)
+{
+	if (resource >= m_resources.size())
+	{
+		m_resources.resize(resource + 1, nullptr);
+	}
+	m_resources[resource] = pResource;
+}
+
+void D3D12RenderGraphBackend::ResourceBarriers(const RenderGraphBarrier* pBarriers, uint32_t count)
+{
+	m_barriers.clear();
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const RenderGraphBarrier& barrier = pBarriers[i];
+		ID3D12Resource* pResource = m_resources[barrier.resource];
+
+		switch (barrier.type)
+		{
+		case ERenderGraphBarrierType::UnorderedAccess:
+			m_barriers.push_back(CD3DX12_RESOURCE_BARRIER::UAV(pResource));
+			break;
+		case ERenderGraphBarrierType::Aliasing:
+			// A null "before" resource covers whichever resources used the memory earlier.
+			m_barriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(nullptr, pResource));
+			break;
+		default:
+			m_barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(pResource, ToResourceStates(barrier.before), ToResourceStates(barrier.after)));
+			break;
+		}
+	}
+
+	// One call per batch.
+	m_pCommandList->ResourceBarrier(static_cast<UINT>(m_barriers.size()), m_barriers.data());
+
+	// Render targets and depth buffers that just became active in shared memory
+	// must be cleared, discarded or copied to before anything else touches them.
+	// Discarding covers passes that only clear part of them or draw over them.
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const RenderGraphBarrier& barrier = pBarriers[i];
+		ID3D12Resource* pResource = m_resources[barrier.resource];
+		if (barrier.type != ERenderGraphBarrierType::Aliasing ||
+			!(pResource->GetDesc().Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)))
+		{
+			continue;
+		}
+
+		if (barrier.after == ERenderGraphState::RenderTarget || barrier.after == ERenderGraphState::DepthWrite)
+		{
+			m_pCommandList->DiscardResource(pResource, nullptr);
+		}
+		else
+		{
+			assert(barrier.after == ERenderGraphState::CopyDest && "Aliased render targets and depth buffers must be first written as a target or a copy destination.");
+		}
+	}
+}
+
+D3D12_RESOURCE_ALLOCATION_INFO D3D12RenderGraphBackend::GetAllocationInfo(const D3D12_RESOURCE_DESC& desc)
+{
+	for (const AllocationInfoCacheEntry& entry : m_allocationInfoCache)
+	{
+		if (IsSameResourceDesc(entry.desc, desc))
+		{
+			return entry.info;
+		}
+	}
+
+	const AllocationInfoCacheEntry entry = { desc, m_pDevice->GetResourceAllocationInfo(0, 1, &desc) };
+	m_allocationInfoCache.push_back(entry);
+	return entry.info;
+}
+
+bool D3D12RenderGraphBackend::IsSameTransient(const TransientDesc& a, const TransientDesc& b)
+{
+	if (a.resource != b.resource || !IsSameResourceDesc(a.desc, b.desc) || a.heapGroup != b.heapGroup ||
+		a.heapOffset != b.heapOffset || a.initialState != b.initialState || a.hasClearValue != b.hasClearValue)
+	{
+		return false;
+	}
+
+	return !a.hasClearValue || memcmp(&a.clearValue, &b.clearValue, sizeof(D3D12_CLEAR_VALUE)) == 0;
+}
+
+void D3D12RenderGraphBackend::ReleaseTransientResources()
+{
+	// Earlier frames may still be using the old layout on the GPU.
+	for (ComPtr<ID3D12Resource>& resource : m_transientResources)
+	{
+		if (resource)
+		{
+			m_deferRelease(resource.Get());
+		}
+		resource.Reset();
+	}
+	for (ComPtr<ID3D12Heap>& heap : m_heaps)
+	{
+		if (heap)
+		{
+			m_deferRelease(heap.Get());
+		}
+		heap.Reset();
+	}
+	m_transients.clear();
+}
+
+D3D12_RESOURCE_STATES D3D12RenderGraphBackend::ToResourceStates(ERenderGraphState state)
+{
+	struct StateMapping
+	{
+		ERenderGraphState state;
+		D3D12_RESOURCE_STATES resourceStates;
+	};
+
+	static const StateMapping mappings[] =
+	{
+		{ ERenderGraphState::RenderTarget, D3D12_RESOURCE_STATE_RENDER_TARGET },
+		{ ERenderGraphState::DepthWrite, D3D12_RESOURCE_STATE_DEPTH_WRITE },
+		{ ERenderGraphState::DepthRead, D3D12_RESOURCE_STATE_DEPTH_READ },
+		{ ERenderGraphState::UnorderedAccess, D3D12_RESOURCE_STATE_UNORDERED_ACCESS },
+		{ ERenderGraphState::ShaderResource, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE },
+		{ ERenderGraphState::CopySource, D3D12_RESOURCE_STATE_COPY_SOURCE },
+		{ ERenderGraphState::CopyDest, D3D12_RESOURCE_STATE_COPY_DEST },
+		{ ERenderGraphState::IndirectArgument, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT },
+		{ ERenderGraphState::VertexBuffer, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER },
+		{ ERenderGraphState::IndexBuffer, D3D12_RESOURCE_STATE_INDEX_BUFFER },
+	};
+
+	D3D12_RESOURCE_STATES resourceStates = D3D12_RESOURCE_STATE_COMMON;
+	for (const StateMapping& mapping : mappings)
+	{
+		if ((state & mapping.state) == mapping.state)
+		{
+			resourceStates |= mapping.resourceStates;
+		}
+	}
+	return resourceStates;
+}
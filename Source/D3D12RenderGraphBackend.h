@@ -0,0 +1,85 @@
+#pragma once
+
+#include "RenderGraph.h"
+
+using Microsoft::WRL::ComPtr;
+
+// Translates render graph barriers into D3D12 resource barriers on the current command list,
+// and backs transient resources with placed resources in heaps laid out by the graph.
+class D3D12RenderGraphBackend : public IRenderGraphBackend
+{
+public:
+    D3D12RenderGraphBackend();
+
+    // deferRelease must keep an object alive until the GPU is done with the frame
+    // being recorded; it receives the heaps and resources of an outdated layout.
+    void Initialize(ID3D12Device* pDevice, const std::function<void(IUnknown*)>& deferRelease);
+
+    // Declare a transient texture or buffer for this frame's graph. The physical
+    // resource is available through GetResource once the graph starts executing.
+    RenderGraphResource CreateTransientResource(RenderGraph& graph, const char* name, const D3D12_RESOURCE_DESC& desc, const D3D12_CLEAR_VALUE* pClearValue = nullptr);
+
+    void SetCommandList(ID3D12GraphicsCommandList* pCommandList) { m_pCommandList = pCommandList; }
+    ID3D12GraphicsCommandList* GetCommandList() const { return m_pCommandList; }
+
+    void SetResource(RenderGraphResource resource, ID3D12Resource* pResource);
+    ID3D12Resource* GetResource(RenderGraphResource resource) const { return m_resources[resource]; }
+
+    void PrepareTransientResources(const RenderGraph& graph) override;
+    void ResourceBarriers(const RenderGraphBarrier* pBarriers, uint32_t count) override;
+
+    UINT64 GetTransientHeapSize() const { return m_transientHeapSize; }
+    UINT GetTransientLayoutChangeCount() const { return m_layoutChangeCount; }
+
+    static D3D12_RESOURCE_STATES ToResourceStates(ERenderGraphState state);
+
+private:
+    // Resource heap tier 1 cannot mix buffers, RT/DS textures and other textures in one heap.
+    enum EHeapGroup
+    {
+        HeapGroupBuffers,
+        HeapGroupTargetTextures,
+        HeapGroupOtherTextures,
+        HeapGroupCount
+    };
+
+    struct TransientDesc
+    {
+        RenderGraphResource resource;
+        D3D12_RESOURCE_DESC desc;
+        D3D12_CLEAR_VALUE clearValue;
+        bool hasClearValue;
+        UINT64 alignment;
+        UINT heapGroup;
+        UINT64 heapOffset;
+        D3D12_RESOURCE_STATES initialState;
+    };
+
+    struct AllocationInfoCacheEntry
+    {
+        D3D12_RESOURCE_DESC desc;
+        D3D12_RESOURCE_ALLOCATION_INFO info;
+    };
+
+    D3D12_RESOURCE_ALLOCATION_INFO GetAllocationInfo(const D3D12_RESOURCE_DESC& desc);
+    static bool IsSameTransient(const TransientDesc& a, const TransientDesc& b);
+    void ReleaseTransientResources();
+
+    ID3D12Device* m_pDevice;
+    std::function<void(IUnknown*)> m_deferRelease;
+    bool m_mixedResourceHeaps;
+    ID3D12GraphicsCommandList* m_pCommandList;
+
+    // Descriptions declared for the frame being built, and the layout currently backed by m_heaps.
+    std::vector<TransientDesc> m_pendingTransients;
+    std::vector<TransientDesc> m_transients;
+    std::vector<ComPtr<ID3D12Resource>> m_transientResources;
+    ComPtr<ID3D12Heap> m_heaps[HeapGroupCount];
+    UINT64 m_heapSizes[HeapGroupCount];
+    UINT64 m_transientHeapSize;
+    UINT m_layoutChangeCount;
+    std::vector<AllocationInfoCacheEntry> m_allocationInfoCache;
+
+    std::vector<ID3D12Resource*> m_resources;
+    std::vector<D3D12_RESOURCE_BARRIER> m_barriers;
+};
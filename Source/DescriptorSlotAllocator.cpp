@@ -0,0 +1,116 @@
+#include "DescriptorSlotAllocator.h"
+
+#include <cassert>
+
+DescriptorSlotAllocator::DescriptorSlotAllocator(uint32_t capacity) :
+	m_capacity(capacity),
+	m_next(new std::atomic<uint32_t>[capacity]),
+	m_generations(new std::atomic<uint32_t>[capacity]),
+	m_retireFenceValues(new uint64_t[capacity]),
+	m_freeHead(PackHead(capacity > 0 ? 0 : EndOfList, 0)),
+	m_deferredHead(EndOfList),
+	m_allocatedCount(0)
+{
+	assert(capacity < EndOfList);
+
+	for (uint32_t i = 0; i < capacity; i++)
+	{
+		m_next[i].store(i + 1 < capacity ? i + 1 : EndOfList, std::memory_order_relaxed);
+		m_generations[i].store(1, std::memory_order_relaxed);
+		m_retireFenceValues[i] = 0;
+	}
+}
+
+BindlessHandle DescriptorSlotAllocator::Allocate()
+{
+	uint64_t head = m_freeHead.load(std::memory_order_acquire);
+	for (;;)
+	{
+		const uint32_t index = HeadIndex(head);
+		if (index == EndOfList)
+		{
+			return NullBindlessHandle;
+		}
+
+		// next may be stale if another thread popped this slot in the meantime, but
+		// then the tag has moved on and the exchange fails.
+		const uint32_t next = m_next[index].load(std::memory_order_relaxed);
+		if (m_freeHead.compare_exchange_weak(head, PackHead(next, HeadTag(head) + 1), std::memory_order_acquire, std::memory_order_acquire))
+		{
+			m_allocatedCount.fetch_add(1, std::memory_order_relaxed);
+			return { index, m_generations[index].load(std::memory_order_relaxed) };
+		}
+	}
+}
+
+void DescriptorSlotAllocator::Free(BindlessHandle handle)
+{
+	Release(handle);
+	PushFree(handle.index);
+}
+
+void DescriptorSlotAllocator::FreeDeferred(BindlessHandle handle, uint64_t fenceValue)
+{
+	Release(handle);
+	m_retireFenceValues[handle.index] = fenceValue;
+
+	uint32_t head = m_deferredHead.load(std::memory_order_relaxed);
+	do
+	{
+		m_next[handle.index].store(head, std::memory_order_relaxed);
+	} while (!m_deferredHead.compare_exchange_weak(head, handle.index, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void DescriptorSlotAllocator::Reclaim(uint64_t completedFenceValue)
+{
+	// Take the whole deferred stack at once; the consumer never pops single
+	// entries, so the deferred stack needs no tag.
+	uint32_t index = m_deferredHead.exchange(EndOfList, std::memory_order_acquire);
+	while (index != EndOfList)
+	{
+		m_pendingReclaim.push_back(index);
+		index = m_next[index].load(std::memory_order_relaxed);
+	}
+
+	size_t kept = 0;
+	for (size_t i = 0; i < m_pendingReclaim.size(); i++)
+	{
+		const uint32_t slot = m_pendingReclaim[i];
+		if (m_retireFenceValues[slot] <= completedFenceValue)
+		{
+			PushFree(slot);
+		}
+		else
+		{
+			m_pendingReclaim[kept++] = slot;
+		}
+	}
+	m_pendingReclaim.resize(kept);
+}
+
+bool DescriptorSlotAllocator::IsValid(BindlessHandle handle) const
+{
+	return handle.index < m_capacity && m_generations[handle.index].load(std::memory_order_relaxed) == handle.generation;
+}
+
+// Invalidate outstanding copies of the handle.
+void DescriptorSlotAllocator::Release(BindlessHandle handle)
+{
+	assert(IsValid(handle) && "Slot freed twice or with a stale handle.");
+
+	m_generations[handle.index].fetch_add(1, std::memory_order_relaxed);
+	m_allocatedCount.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void DescriptorSlotAllocator::PushFree(uint32_t index)
+{
+	uint64_t head = m_freeHead.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		m_next[index].store(HeadIndex(head), std::memory_order_relaxed);
+		if (m_freeHead.compare_exchange_weak(head, PackHead(index, HeadTag(head)), std::memory_order_release, std::memory_order_relaxed))
+		{
+			return;
+		}
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Reference to a slot. The generation changes every time the slot is freed, so
+// handles kept past a free can be detected instead of silently aliasing the
+// slot's next owner. Shaders only ever see the index.
+struct BindlessHandle
+{
+    uint32_t index;
+    uint32_t generation;
+
+    bool IsNull() const { return index == UINT32_MAX; }
+};
+
+static const BindlessHandle NullBindlessHandle = { UINT32_MAX, 0 };
+
+// Fixed-capacity slot allocator with a lock-free free list. Allocate, Free and
+// FreeDeferred may be called from any thread. The free list is a Treiber stack
+// whose head carries a tag that changes on every pop, which rules out ABA.
+// Slots freed with FreeDeferred go to a second lock-free stack and only return
+// to the free list once Reclaim sees their fence value complete; Reclaim must
+// only be called from one thread at a time.
+class DescriptorSlotAllocator
+{
+public:
+    explicit DescriptorSlotAllocator(uint32_t capacity);
+
+    DescriptorSlotAllocator(const DescriptorSlotAllocator&) = delete;
+    DescriptorSlotAllocator& operator=(const DescriptorSlotAllocator&) = delete;
+
+    // Returns NullBindlessHandle when every slot is in use.
+    BindlessHandle Allocate();
+
+    // Return a slot that the GPU can no longer be referencing.
+    void Free(BindlessHandle handle);
+
+    // Return a slot once fenceValue has completed.
+    void FreeDeferred(BindlessHandle handle, uint64_t fenceValue);
+    void Reclaim(uint64_t completedFenceValue);
+
+    bool IsValid(BindlessHandle handle) const;
+    uint32_t GetCapacity() const { return m_capacity; }
+    uint32_t GetAllocatedCount() const { return m_allocatedCount.load(std::memory_order_relaxed); }
+
+private:
+    static const uint32_t EndOfList = UINT32_MAX;
+
+    static uint64_t PackHead(uint32_t index, uint32_t tag) { return (static_cast<uint64_t>(tag) << 32) | index; }
+    static uint32_t HeadIndex(uint64_t head) { return static_cast<uint32_t>(head); }
+    static uint32_t HeadTag(uint64_t head) { return static_cast<uint32_t>(head >> 32); }
+
+    void Release(BindlessHandle handle);
+    void PushFree(uint32_t index);
+
+    uint32_t m_capacity;
+    std::unique_ptr<std::atomic<uint32_t>[]> m_next;
+    std::unique_ptr<std::atomic<uint32_t>[]> m_generations;
+    std::unique_ptr<uint64_t[]> m_retireFenceValues;
+
+    std::atomic<uint64_t> m_freeHead;
+    std::atomic<uint32_t> m_deferredHead;
+    std::atomic<uint32_t> m_allocatedCount;
+
+    // Deferred slots whose fence had not completed at the last Reclaim. Owned by the reclaiming thread.
+    std::vector<uint32_t> m_pendingReclaim;
+};
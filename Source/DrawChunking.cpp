@@ -0,0 +1,38 @@
+#include "DrawChunking.h"
+#include "RadixSort.h"
+
+#include <algorithm>
+
+void DrawChunking::Split(uint32_t drawCount, uint32_t minDrawsPerChunk, uint32_t maxChunks)
+{
+	m_drawCount = drawCount;
+	m_chunkCount = std::min(std::max((drawCount + minDrawsPerChunk - 1) / minDrawsPerChunk, 1u), maxChunks);
+	m_chunkSize = m_chunkCount > 0 ? (drawCount + m_chunkCount - 1) / m_chunkCount : 0;
+}
+
+uint32_t DrawChunking::GetFirstDraw(uint32_t chunkIndex) const
+{
+	return std::min(chunkIndex * m_chunkSize, m_drawCount);
+}
+
+uint32_t DrawChunking::GetLastDraw(uint32_t chunkIndex) const
+{
+	return std::min(GetFirstDraw(chunkIndex) + m_chunkSize, m_drawCount);
+}
+
+uint32_t BuildDrawRuns(RadixSorter& sorter, uint64_t* pKeys, uint32_t* pEntries, uint32_t count, uint32_t stateShift,
+	uint32_t instancesPerChunk, DrawRun* pRuns, JobSystem* pJobSystem)
+{
+	sorter.Sort(pKeys, pEntries, count, pJobSystem);
+
+	uint32_t runCount = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (i % instancesPerChunk == 0 || (pKeys[i] >> stateShift) != (pKeys[i - 1] >> stateShift))
+		{
+			pRuns[runCount++] = { i, 0 };
+		}
+		pRuns[runCount - 1].count++;
+	}
+	return runCount;
+}
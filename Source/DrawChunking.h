@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+
+class JobSystem;
+class RadixSorter;
+
+// Split of a sorted draw list into contiguous chunks, one command list each, so
+// that submitting the lists in chunk order keeps the draws in order. Kept apart
+// from the device so that recording can be driven against a mock command list.
+class DrawChunking
+{
+public:
+    DrawChunking() : m_drawCount(0), m_chunkCount(0), m_chunkSize(0) {}
+
+    // Uses as many chunks as there are groups of minDrawsPerChunk draws, at
+    // least one and at most maxChunks. maxChunks of 0 records nothing.
+    void Split(uint32_t drawCount, uint32_t minDrawsPerChunk, uint32_t maxChunks);
+
+    uint32_t GetChunkCount() const { return m_chunkCount; }
+    uint32_t GetFirstDraw(uint32_t chunkIndex) const;
+    uint32_t GetLastDraw(uint32_t chunkIndex) const;
+
+private:
+    uint32_t m_drawCount;
+    uint32_t m_chunkCount;
+    uint32_t m_chunkSize;
+};
+
+// Sorted draw entries [first, first + count), drawn as one instance each by a single draw.
+struct DrawRun
+{
+    uint32_t first;
+    uint32_t count;
+};
+
+// Sort the draw entries by key, and split them into runs whose keys agree above
+// the low stateShift bits. Instance data is written in chunks of
+// instancesPerChunk entries, each to an upload page of its own, so runs also
+// split at chunk boundaries. pRuns must have room for count runs; returns the
+// number written. pJobSystem may be null to sort on the calling thread.
+uint32_t BuildDrawRuns(RadixSorter& sorter, uint64_t* pKeys, uint32_t* pEntries, uint32_t count, uint32_t stateShift,
+    uint32_t instancesPerChunk, DrawRun* pRuns, JobSystem* pJobSystem = nullptr);
+
+// One instanced draw of the sorted draw list. Addresses are GPU virtual addresses.
+struct DrawItem
+{
+    uint64_t sortKey;       // Of the first instance.
+    uint64_t material;
+    uint64_t instances;
+    uint32_t instanceCount;
+    uint32_t indexCount;
+    uint32_t startIndex;
+    int32_t baseVertex;
+};
+
+// State set while recording a chunk, against what setting everything per draw would cost.
+struct DrawRecordingStats
+{
+    uint32_t drawCount;
+    uint32_t materialSets;
+};
+
+// Record draws [firstDraw, lastDraw) into a command list that already has the
+// shared scene state. The draws are sorted by state, so only what differs from
+// the previous draw is set. CommandList is ID3D12GraphicsCommandList, or a mock
+// with the same methods.
+template <typename CommandList>
+void RecordDrawItems(CommandList* pCommandList, const DrawItem* pDrawItems, uint32_t firstDraw, uint32_t lastDraw, DrawRecordingStats& stats)
+{
+    uint64_t material = 0;
+    stats = {};
+    for (uint32_t i = firstDraw; i < lastDraw; i++)
+    {
+        const DrawItem& draw = pDrawItems[i];
+        if (draw.material != material)
+        {
+            pCommandList->SetGraphicsRootConstantBufferView(0, draw.material);
+            material = draw.material;
+            stats.materialSets++;
+        }
+        pCommandList->SetGraphicsRootShaderResourceView(2, draw.instances);
+        pCommandList->DrawIndexedInstanced(draw.indexCount, draw.instanceCount, draw.startIndex, draw.baseVertex, 0);
+    }
+    stats.drawCount = lastDraw - firstDraw;
+}
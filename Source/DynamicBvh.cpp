@@ -0,0 +1,729 @@
+#include "DynamicBvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+	// Traversal stack that only touches the heap for unusually deep trees.
+	class TraversalStack
+	{
+	public:
+		TraversalStack() : m_count(0) {}
+
+		bool IsEmpty() const { return m_count == 0; }
+
+		void Push(uint32_t value)
+		{
+			if (m_count < FixedSize)
+			{
+				m_fixed[m_count] = value;
+			}
+			else
+			{
+				m_overflow.push_back(value);
+			}
+			m_count++;
+		}
+
+		uint32_t Pop()
+		{
+			m_count--;
+			if (m_count < FixedSize)
+			{
+				return m_fixed[m_count];
+			}
+
+			const uint32_t value = m_overflow.back();
+			m_overflow.pop_back();
+			return value;
+		}
+
+	private:
+		static const uint32_t FixedSize = 128;
+
+		uint32_t m_fixed[FixedSize];
+		std::vector<uint32_t> m_overflow;
+		uint32_t m_count;
+	};
+
+	// Frustum queries mark subtrees that are entirely inside so their leaves are taken without tests.
+	const uint32_t InsideFlag = 0x80000000u;
+
+	// Refits mark nodes whose children have been refitted already.
+	const uint32_t ChildrenDoneFlag = 0x80000000u;
+
+	inline BvhBounds Union(const BvhBounds& a, const BvhBounds& b)
+	{
+		return
+		{
+			std::min(a.minX, b.minX), std::min(a.minY, b.minY), std::min(a.minZ, b.minZ),
+			std::max(a.maxX, b.maxX), std::max(a.maxY, b.maxY), std::max(a.maxZ, b.maxZ),
+		};
+	}
+
+	inline float Area(const BvhBounds& b)
+	{
+		const float dx = b.maxX - b.minX;
+		const float dy = b.maxY - b.minY;
+		const float dz = b.maxZ - b.minZ;
+		return 2.0f * (dx * dy + dy * dz + dz * dx);
+	}
+
+	inline bool Contains(const BvhBounds& outer, const BvhBounds& inner)
+	{
+		return outer.minX <= inner.minX && outer.minY <= inner.minY && outer.minZ <= inner.minZ &&
+			outer.maxX >= inner.maxX && outer.maxY >= inner.maxY && outer.maxZ >= inner.maxZ;
+	}
+
+	inline bool Equal(const BvhBounds& a, const BvhBounds& b)
+	{
+		return a.minX == b.minX && a.minY == b.minY && a.minZ == b.minZ && a.maxX == b.maxX && a.maxY == b.maxY && a.maxZ == b.maxZ;
+	}
+
+	// Distance along the ray at which it enters the box, or infinity if it misses.
+	inline float RayEntry(const BvhBounds& b, const float origin[3], const float inverseDirection[3])
+	{
+		const float x0 = (b.minX - origin[0]) * inverseDirection[0];
+		const float x1 = (b.maxX - origin[0]) * inverseDirection[0];
+		const float y0 = (b.minY - origin[1]) * inverseDirection[1];
+		const float y1 = (b.maxY - origin[1]) * inverseDirection[1];
+		const float z0 = (b.minZ - origin[2]) * inverseDirection[2];
+		const float z1 = (b.maxZ - origin[2]) * inverseDirection[2];
+
+		const float entry = std::max(std::max(std::min(x0, x1), std::min(y0, y1)), std::max(std::min(z0, z1), 0.0f));
+		const float exit = std::min(std::min(std::max(x0, x1), std::max(y0, y1)), std::max(z0, z1));
+		return entry <= exit ? entry : std::numeric_limits<float>::infinity();
+	}
+}
+
+DynamicBvh::DynamicBvh(float margin, float degradationThreshold) :
+	m_root(NullNode),
+	m_freeNode(NullNode),
+	m_proxyCount(0),
+	m_margin(margin),
+	m_degradationThreshold(degradationThreshold)
+{
+}
+
+uint32_t DynamicBvh::Insert(const BvhBounds& bounds, uint32_t userData)
+{
+	const uint32_t leaf = AllocateNode();
+	Node& node = m_nodes[leaf];
+	node.bounds = { bounds.minX - m_margin, bounds.minY - m_margin, bounds.minZ - m_margin, bounds.maxX + m_margin, bounds.maxY + m_margin, bounds.maxZ + m_margin };
+	node.userData = userData;
+	node.buildArea = Area(node.bounds);
+
+	InsertLeaf(leaf);
+	m_proxyCount++;
+	return leaf;
+}
+
+void DynamicBvh::Remove(uint32_t proxy)
+{
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	m_proxyCount--;
+}
+
+bool DynamicBvh::Move(uint32_t proxy, const BvhBounds& bounds)
+{
+	Node& node = m_nodes[proxy];
+	if (Contains(node.bounds, bounds))
+	{
+		return false;
+	}
+
+	node.bounds = { bounds.minX - m_margin, bounds.minY - m_margin, bounds.minZ - m_margin, bounds.maxX + m_margin, bounds.maxY + m_margin, bounds.maxZ + m_margin };
+
+	// Mark up to the first ancestor that is already marked, so each node is refitted once however many leaves under it moved.
+	for (uint32_t ancestor = node.parent; ancestor != NullNode && !m_nodes[ancestor].needsRefit; ancestor = m_nodes[ancestor].parent)
+	{
+		m_nodes[ancestor].needsRefit = true;
+	}
+	return true;
+}
+
+uint32_t DynamicBvh::Update()
+{
+	RefitMarked();
+
+	if (m_degradedNodes.empty())
+	{
+		return 0;
+	}
+
+	// Rebuild from the top down: rebuilding an ancestor also fixes its descendants,
+	// whose nodes are then either freed or fresh.
+	m_rebuildOrder.clear();
+	std::sort(m_degradedNodes.begin(), m_degradedNodes.end());
+	m_degradedNodes.erase(std::unique(m_degradedNodes.begin(), m_degradedNodes.end()), m_degradedNodes.end());
+	for (uint32_t node : m_degradedNodes)
+	{
+		// Nodes freed since they were recorded look like leaves.
+		if (m_nodes[node].IsLeaf())
+		{
+			continue;
+		}
+
+		uint32_t depth = 0;
+		for (uint32_t ancestor = m_nodes[node].parent; ancestor != NullNode; ancestor = m_nodes[ancestor].parent)
+		{
+			depth++;
+		}
+		m_rebuildOrder.push_back(std::make_pair(depth, node));
+	}
+	m_degradedNodes.clear();
+	std::sort(m_rebuildOrder.begin(), m_rebuildOrder.end());
+
+	uint32_t rebuiltLeafCount = 0;
+	for (const auto& entry : m_rebuildOrder)
+	{
+		const Node& node = m_nodes[entry.second];
+		if (!node.IsLeaf() && Area(node.bounds) > m_degradationThreshold * node.buildArea)
+		{
+			RebuildSubtree(entry.second);
+			rebuiltLeafCount += static_cast<uint32_t>(m_buildItems.size());
+		}
+	}
+	return rebuiltLeafCount;
+}
+
+void DynamicBvh::Rebuild()
+{
+	RefitMarked();
+	m_degradedNodes.clear();
+	if (m_root != NullNode)
+	{
+		RebuildSubtree(m_root);
+	}
+}
+
+void DynamicBvh::QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& results) const
+{
+	if (m_root == NullNode)
+	{
+		return;
+	}
+
+	TraversalStack stack;
+	stack.Push(m_root);
+	while (!stack.IsEmpty())
+	{
+		const uint32_t entry = stack.Pop();
+		const Node& node = m_nodes[entry & ~InsideFlag];
+
+		bool inside = (entry & InsideFlag) != 0;
+		if (!inside)
+		{
+			const float cx = 0.5f * (node.bounds.minX + node.bounds.maxX);
+			const float cy = 0.5f * (node.bounds.minY + node.bounds.maxY);
+			const float cz = 0.5f * (node.bounds.minZ + node.bounds.maxZ);
+			const float ex = 0.5f * (node.bounds.maxX - node.bounds.minX);
+			const float ey = 0.5f * (node.bounds.maxY - node.bounds.minY);
+			const float ez = 0.5f * (node.bounds.maxZ - node.bounds.minZ);
+
+			bool outside = false;
+			inside = true;
+			for (int p = 0; p < 6 && !outside; p++)
+			{
+				const float distance = frustum.normalX[p] * cx + frustum.normalY[p] * cy + frustum.normalZ[p] * cz + frustum.distance[p];
+				const float radius = std::fabs(frustum.normalX[p]) * ex + std::fabs(frustum.normalY[p]) * ey + std::fabs(frustum.normalZ[p]) * ez;
+				outside = distance + radius < 0.0f;
+				inside = inside && distance - radius >= 0.0f;
+			}
+			if (outside)
+			{
+				continue;
+			}
+		}
+
+		if (node.IsLeaf())
+		{
+			results.push_back(node.userData);
+		}
+		else
+		{
+			const uint32_t flag = inside ? InsideFlag : 0;
+			stack.Push(node.child[0] | flag);
+			stack.Push(node.child[1] | flag);
+		}
+	}
+}
+
+void DynamicBvh::QuerySphere(float centerX, float centerY, float centerZ, float radius, std::vector<uint32_t>& results) const
+{
+	if (m_root == NullNode)
+	{
+		return;
+	}
+
+	const float radiusSquared = radius * radius;
+
+	TraversalStack stack;
+	stack.Push(m_root);
+	while (!stack.IsEmpty())
+	{
+		const Node& node = m_nodes[stack.Pop()];
+
+		// Squared distance from the center to the closest point of the box.
+		const float dx = centerX - std::min(std::max(centerX, node.bounds.minX), node.bounds.maxX);
+		const float dy = centerY - std::min(std::max(centerY, node.bounds.minY), node.bounds.maxY);
+		const float dz = centerZ - std::min(std::max(centerZ, node.bounds.minZ), node.bounds.maxZ);
+		if (dx * dx + dy * dy + dz * dz > radiusSquared)
+		{
+			continue;
+		}
+
+		if (node.IsLeaf())
+		{
+			results.push_back(node.userData);
+		}
+		else
+		{
+			stack.Push(node.child[0]);
+			stack.Push(node.child[1]);
+		}
+	}
+}
+
+uint32_t DynamicBvh::RayCast(const float origin[3], const float direction[3], float maxDistance, float* pDistance) const
+{
+	const float inverseDirection[3] = { 1.0f / direction[0], 1.0f / direction[1], 1.0f / direction[2] };
+
+	uint32_t hit = NullProxy;
+	float closest = maxDistance;
+
+	TraversalStack stack;
+	if (m_root != NullNode && RayEntry(m_nodes[m_root].bounds, origin, inverseDirection) <= closest)
+	{
+		stack.Push(m_root);
+	}
+
+	while (!stack.IsEmpty())
+	{
+		const Node& node = m_nodes[stack.Pop()];
+		if (node.IsLeaf())
+		{
+			// Re-test: closest may have shrunk since the leaf was pushed.
+			const float entry = RayEntry(node.bounds, origin, inverseDirection);
+			if (entry <= closest)
+			{
+				closest = entry;
+				hit = node.userData;
+			}
+			continue;
+		}
+
+		// Visit the nearer child first so the farther one is more likely to be skipped.
+		float entry0 = RayEntry(m_nodes[node.child[0]].bounds, origin, inverseDirection);
+		float entry1 = RayEntry(m_nodes[node.child[1]].bounds, origin, inverseDirection);
+		uint32_t nearChild = node.child[0];
+		uint32_t farChild = node.child[1];
+		if (entry1 < entry0)
+		{
+			std::swap(entry0, entry1);
+			std::swap(nearChild, farChild);
+		}
+		if (entry1 <= closest)
+		{
+			stack.Push(farChild);
+		}
+		if (entry0 <= closest)
+		{
+			stack.Push(nearChild);
+		}
+	}
+
+	if (pDistance)
+	{
+		*pDistance = closest;
+	}
+	return hit;
+}
+
+uint32_t DynamicBvh::GetHeight() const
+{
+	if (m_root == NullNode)
+	{
+		return 0;
+	}
+
+	uint32_t height = 0;
+	std::vector<std::pair<uint32_t, uint32_t>> stack(1, std::make_pair(m_root, 1u));
+	while (!stack.empty())
+	{
+		const auto entry = stack.back();
+		stack.pop_back();
+		height = std::max(height, entry.second);
+
+		const Node& node = m_nodes[entry.first];
+		if (!node.IsLeaf())
+		{
+			stack.push_back(std::make_pair(node.child[0], entry.second + 1));
+			stack.push_back(std::make_pair(node.child[1], entry.second + 1));
+		}
+	}
+	return height;
+}
+
+float DynamicBvh::GetCost() const
+{
+	if (m_root == NullNode || m_nodes[m_root].IsLeaf())
+	{
+		return 0.0f;
+	}
+
+	float internalArea = 0.0f;
+	TraversalStack stack;
+	stack.Push(m_root);
+	while (!stack.IsEmpty())
+	{
+		const Node& node = m_nodes[stack.Pop()];
+		if (!node.IsLeaf())
+		{
+			internalArea += Area(node.bounds);
+			stack.Push(node.child[0]);
+			stack.Push(node.child[1]);
+		}
+	}
+	return internalArea / Area(m_nodes[m_root].bounds);
+}
+
+uint32_t DynamicBvh::AllocateNode()
+{
+	uint32_t index = m_freeNode;
+	if (index != NullNode)
+	{
+		m_freeNode = m_nodes[index].parent;
+	}
+	else
+	{
+		index = static_cast<uint32_t>(m_nodes.size());
+		m_nodes.push_back(Node());
+	}
+
+	Node& node = m_nodes[index];
+	node.parent = NullNode;
+	node.child[0] = NullNode;
+	node.child[1] = NullNode;
+	node.userData = NullProxy;
+	node.buildArea = 0.0f;
+	node.needsRefit = false;
+	return index;
+}
+
+// Free nodes look like leaves, so stale entries in m_degradedNodes are skipped.
+void DynamicBvh::FreeNode(uint32_t node)
+{
+	m_nodes[node].child[0] = NullNode;
+	m_nodes[node].child[1] = NullNode;
+	m_nodes[node].parent = m_freeNode;
+	m_freeNode = node;
+}
+
+// Walk down to the sibling that minimizes the surface area heuristic: the area
+// of the new parent plus the growth the insertion causes in every ancestor.
+void DynamicBvh::InsertLeaf(uint32_t leaf)
+{
+	if (m_root == NullNode)
+	{
+		m_root = leaf;
+		m_nodes[leaf].parent = NullNode;
+		return;
+	}
+
+	const BvhBounds leafBounds = m_nodes[leaf].bounds;
+	uint32_t sibling = m_root;
+	while (!m_nodes[sibling].IsLeaf())
+	{
+		const Node& node = m_nodes[sibling];
+		const float area = Area(node.bounds);
+		const float combinedArea = Area(Union(node.bounds, leafBounds));
+
+		// Making this node the sibling costs a new parent enclosing both.
+		const float siblingCost = 2.0f * combinedArea;
+
+		// Descending grows this node regardless of which child is picked.
+		const float inheritedCost = 2.0f * (combinedArea - area);
+
+		float childCost[2];
+		for (int c = 0; c < 2; c++)
+		{
+			const Node& child = m_nodes[node.child[c]];
+			const float grownArea = Area(Union(child.bounds, leafBounds));
+			childCost[c] = (child.IsLeaf() ? grownArea : grownArea - Area(child.bounds)) + inheritedCost;
+		}
+
+		if (siblingCost < childCost[0] && siblingCost < childCost[1])
+		{
+			break;
+		}
+		sibling = childCost[0] <= childCost[1] ? node.child[0] : node.child[1];
+	}
+
+	const uint32_t oldParent = m_nodes[sibling].parent;
+	const uint32_t newParent = AllocateNode();
+	Node& parent = m_nodes[newParent];
+	parent.parent = oldParent;
+	parent.child[0] = sibling;
+	parent.child[1] = leaf;
+	parent.bounds = Union(m_nodes[sibling].bounds, leafBounds);
+	parent.buildArea = Area(parent.bounds);
+	parent.needsRefit = m_nodes[sibling].needsRefit;   // Marked nodes only ever have marked ancestors.
+
+	if (oldParent == NullNode)
+	{
+		m_root = newParent;
+	}
+	else
+	{
+		Node& grandParent = m_nodes[oldParent];
+		grandParent.child[grandParent.child[0] == sibling ? 0 : 1] = newParent;
+	}
+	m_nodes[sibling].parent = newParent;
+	m_nodes[leaf].parent = newParent;
+
+	RefitAncestors(oldParent);
+}
+
+// The leaf's sibling takes the place of their parent.
+void DynamicBvh::RemoveLeaf(uint32_t leaf)
+{
+	if (leaf == m_root)
+	{
+		m_root = NullNode;
+		return;
+	}
+
+	const uint32_t parent = m_nodes[leaf].parent;
+	const uint32_t grandParent = m_nodes[parent].parent;
+	const uint32_t sibling = m_nodes[parent].child[m_nodes[parent].child[0] == leaf ? 1 : 0];
+
+	m_nodes[sibling].parent = grandParent;
+	if (grandParent == NullNode)
+	{
+		m_root = sibling;
+	}
+	else
+	{
+		Node& node = m_nodes[grandParent];
+		node.child[node.child[0] == parent ? 0 : 1] = sibling;
+	}
+	FreeNode(parent);
+
+	RefitAncestors(grandParent);
+}
+
+// Recompute bounds from node up to the root, stopping at the first node that is
+// unchanged since nothing above it can change either.
+void DynamicBvh::RefitAncestors(uint32_t node)
+{
+	while (node != NullNode)
+	{
+		Node& current = m_nodes[node];
+		const BvhBounds bounds = Union(m_nodes[current.child[0]].bounds, m_nodes[current.child[1]].bounds);
+		if (Equal(bounds, current.bounds))
+		{
+			return;
+		}
+
+		current.bounds = bounds;
+		CheckDegradation(node);
+		node = current.parent;
+	}
+}
+
+// Post-order walk over the marked nodes only; unmarked subtrees are up to date.
+void DynamicBvh::RefitMarked()
+{
+	if (m_root == NullNode || !m_nodes[m_root].needsRefit)
+	{
+		return;
+	}
+
+	m_traversalStack.assign(1, m_root);
+	while (!m_traversalStack.empty())
+	{
+		const uint32_t entry = m_traversalStack.back();
+		Node& node = m_nodes[entry & ~ChildrenDoneFlag];
+
+		if ((entry & ChildrenDoneFlag) == 0)
+		{
+			m_traversalStack.back() |= ChildrenDoneFlag;
+			for (uint32_t child : node.child)
+			{
+				if (m_nodes[child].needsRefit)
+				{
+					m_traversalStack.push_back(child);
+				}
+			}
+			continue;
+		}
+
+		m_traversalStack.pop_back();
+		node.bounds = Union(m_nodes[node.child[0]].bounds, m_nodes[node.child[1]].bounds);
+		node.needsRefit = false;
+		CheckDegradation(entry & ~ChildrenDoneFlag);
+	}
+}
+
+void DynamicBvh::CheckDegradation(uint32_t node)
+{
+	if (Area(m_nodes[node].bounds) > m_degradationThreshold * m_nodes[node].buildArea)
+	{
+		m_degradedNodes.push_back(node);
+	}
+}
+
+void DynamicBvh::RebuildSubtree(uint32_t root)
+{
+	const uint32_t parent = m_nodes[root].parent;
+
+	// Gather the leaves into a contiguous array, which the build partitions in
+	// place, and recycle the internal nodes.
+	m_buildItems.clear();
+	m_traversalStack.assign(1, root);
+	while (!m_traversalStack.empty())
+	{
+		const uint32_t node = m_traversalStack.back();
+		m_traversalStack.pop_back();
+		if (m_nodes[node].IsLeaf())
+		{
+			const BvhBounds& bounds = m_nodes[node].bounds;
+			m_buildItems.push_back({ bounds, { bounds.minX + bounds.maxX, bounds.minY + bounds.maxY, bounds.minZ + bounds.maxZ }, node });
+		}
+		else
+		{
+			m_traversalStack.push_back(m_nodes[node].child[0]);
+			m_traversalStack.push_back(m_nodes[node].child[1]);
+			FreeNode(node);
+		}
+	}
+
+	const uint32_t newRoot = BuildRange(m_buildItems.data(), static_cast<uint32_t>(m_buildItems.size()), parent);
+	if (parent == NullNode)
+	{
+		m_root = newRoot;
+	}
+	else
+	{
+		Node& node = m_nodes[parent];
+		node.child[node.child[0] == root ? 0 : 1] = newRoot;
+	}
+}
+
+// Top-down build: split along the longest centroid axis where the binned
+// surface area heuristic is lowest.
+uint32_t DynamicBvh::BuildRange(BuildItem* pItems, uint32_t count, uint32_t parent)
+{
+	if (count == 1)
+	{
+		m_nodes[pItems[0].leaf].parent = parent;
+		return pItems[0].leaf;
+	}
+
+	float centroidMin[3] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+	float centroidMax[3] = { -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+	for (uint32_t i = 0; i < count; i++)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float centroid = pItems[i].centroid[axis];
+			centroidMin[axis] = std::min(centroidMin[axis], centroid);
+			centroidMax[axis] = std::max(centroidMax[axis], centroid);
+		}
+	}
+
+	int axis = 0;
+	for (int a = 1; a < 3; a++)
+	{
+		if (centroidMax[a] - centroidMin[a] > centroidMax[axis] - centroidMin[axis])
+		{
+			axis = a;
+		}
+	}
+
+	uint32_t splitCount = count / 2;
+	const float extent = centroidMax[axis] - centroidMin[axis];
+	if (extent > 0.0f)
+	{
+		const float binScale = BinCount / extent;
+		const float binOrigin = centroidMin[axis];
+		auto GetBin = [&](const BuildItem& item)
+		{
+			const uint32_t bin = static_cast<uint32_t>((item.centroid[axis] - binOrigin) * binScale);
+			return std::min(bin, BinCount - 1);
+		};
+
+		uint32_t binCounts[BinCount] = {};
+		BvhBounds binBounds[BinCount];
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const uint32_t bin = GetBin(pItems[i]);
+			binBounds[bin] = binCounts[bin] == 0 ? pItems[i].bounds : Union(binBounds[bin], pItems[i].bounds);
+			binCounts[bin]++;
+		}
+
+		// Area of everything right of each split, then sweep from the left.
+		float rightCost[BinCount];
+		uint32_t rightCount = 0;
+		BvhBounds rightBounds = {};
+		for (uint32_t bin = BinCount - 1; bin > 0; bin--)
+		{
+			if (binCounts[bin] > 0)
+			{
+				rightBounds = rightCount == 0 ? binBounds[bin] : Union(rightBounds, binBounds[bin]);
+				rightCount += binCounts[bin];
+			}
+			rightCost[bin] = rightCount > 0 ? Area(rightBounds) * rightCount : 0.0f;
+		}
+
+		float bestCost = std::numeric_limits<float>::infinity();
+		uint32_t bestSplit = BinCount;
+		uint32_t leftCount = 0;
+		BvhBounds leftBounds = {};
+		for (uint32_t bin = 0; bin + 1 < BinCount; bin++)
+		{
+			if (binCounts[bin] > 0)
+			{
+				leftBounds = leftCount == 0 ? binBounds[bin] : Union(leftBounds, binBounds[bin]);
+				leftCount += binCounts[bin];
+			}
+			if (leftCount > 0 && leftCount < count)
+			{
+				const float cost = Area(leftBounds) * leftCount + rightCost[bin + 1];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestSplit = bin;
+				}
+			}
+		}
+
+		if (bestSplit < BinCount)
+		{
+			BuildItem* pMiddle = std::partition(pItems, pItems + count, [&](const BuildItem& item) { return GetBin(item) <= bestSplit; });
+			splitCount = static_cast<uint32_t>(pMiddle - pItems);
+		}
+	}
+
+	// Identical centroids cannot be separated by position; split them evenly.
+	if (splitCount == 0 || splitCount == count)
+	{
+		splitCount = count / 2;
+	}
+
+	const uint32_t node = AllocateNode();
+	m_nodes[node].parent = parent;
+	const uint32_t child0 = BuildRange(pItems, splitCount, node);
+	const uint32_t child1 = BuildRange(pItems + splitCount, count - splitCount, node);
+
+	Node& current = m_nodes[node];
+	current.child[0] = child0;
+	current.child[1] = child1;
+	current.bounds = Union(m_nodes[child0].bounds, m_nodes[child1].bounds);
+	current.buildArea = Area(current.bounds);
+	return node;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "FrustumCulling.h"
+
+struct BvhBounds
+{
+    float minX, minY, minZ;
+    float maxX, maxY, maxZ;
+};
+
+// Bounding volume hierarchy over moving objects. Each object is a leaf ("proxy")
+// whose box is enlarged by a margin, so small moves do not touch the tree at
+// all. Moves that leave the enlarged box only mark the leaf's ancestors; Update
+// refits every marked node once, bottom up, which is cheap but lets the tree
+// degrade over time. Update then rebuilds, with a binned SAH build, only the
+// subtrees whose area grew past degradationThreshold times their area when they
+// were built, so a frame without degradation does no tree-wide work.
+//
+// Not thread-safe; const queries may run concurrently with each other.
+class DynamicBvh
+{
+public:
+    static const uint32_t NullProxy = UINT32_MAX;
+
+    explicit DynamicBvh(float margin = 0.1f, float degradationThreshold = 2.0f);
+
+    uint32_t Insert(const BvhBounds& bounds, uint32_t userData);
+    void Remove(uint32_t proxy);
+
+    // Returns false if the enlarged box still contains bounds. Otherwise the
+    // proxy's ancestors are out of date until the next Update.
+    bool Move(uint32_t proxy, const BvhBounds& bounds);
+
+    // Refit after moves and rebuild degraded subtrees. Call before querying.
+    // Returns the number of leaves whose subtrees were rebuilt.
+    uint32_t Update();
+    void Rebuild();
+
+    // Append the userData of every proxy whose enlarged box passes the query.
+    void QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& results) const;
+    void QuerySphere(float centerX, float centerY, float centerZ, float radius, std::vector<uint32_t>& results) const;
+
+    // The userData of the nearest proxy whose box the ray enters within
+    // maxDistance, or NullProxy.
+    // direction need not be normalized; distances are in units of its length.
+    uint32_t RayCast(const float origin[3], const float direction[3], float maxDistance, float* pDistance) const;
+
+    uint32_t GetUserData(uint32_t proxy) const { return m_nodes[proxy].userData; }
+    const BvhBounds& GetBounds(uint32_t proxy) const { return m_nodes[proxy].bounds; }
+    uint32_t GetProxyCount() const { return m_proxyCount; }
+    uint32_t GetHeight() const;
+
+    // Sum of the internal node areas relative to the root's: the expected number
+    // of nodes a random ray visits. Lower is better.
+    float GetCost() const;
+
+private:
+    static const uint32_t NullNode = UINT32_MAX;
+    static const uint32_t BinCount = 16;
+
+    struct Node
+    {
+        BvhBounds bounds;
+        uint32_t parent;        // Next free node while the node is unused.
+        uint32_t child[2];      // NullNode for leaves.
+        uint32_t userData;
+        float buildArea;        // Surface area when the node was created or last rebuilt.
+        bool needsRefit;
+
+        bool IsLeaf() const { return child[0] == NullNode; }
+    };
+
+    struct BuildItem
+    {
+        BvhBounds bounds;
+        float centroid[3];
+        uint32_t leaf;
+    };
+
+    uint32_t AllocateNode();
+    void FreeNode(uint32_t node);
+    void InsertLeaf(uint32_t leaf);
+    void RemoveLeaf(uint32_t leaf);
+    void RefitAncestors(uint32_t node);
+    void RefitMarked();
+    void CheckDegradation(uint32_t node);
+    void RebuildSubtree(uint32_t node);
+    uint32_t BuildRange(BuildItem* pItems, uint32_t count, uint32_t parent);
+
+    std::vector<Node> m_nodes;
+    uint32_t m_root;
+    uint32_t m_freeNode;
+    uint32_t m_proxyCount;
+    float m_margin;
+    float m_degradationThreshold;
+
+    std::vector<uint32_t> m_degradedNodes;      // May hold duplicates and nodes freed since.
+
+    // Scratch for rebuilds.
+    std::vector<std::pair<uint32_t, uint32_t>> m_rebuildOrder;
+    std::vector<BuildItem> m_buildItems;
+    std::vector<uint32_t> m_traversalStack;
+};
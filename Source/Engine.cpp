@@ -3,22 +3,58 @@
 #include "DXHelper.h"
 #include "App.h"
 
-Engine::Engine(UINT width, UINT height) :
+Engine::Engine(UINT width, UINT height, UINT frameCount) :
 	m_width(width),
 	m_height(height),
-	m_frameIndex(0),
-	m_pCbvDataBegin(nullptr),
+	m_minimized(false),
+	m_frameCount(std::min(std::max(frameCount, 1u), static_cast<UINT>(MaxFrameCount))),
+	m_frameRing(m_frameCount),
+	m_backBufferIndex(0),
+	m_pCurrentFrameResource(nullptr),
+	m_jobSystem(new JobSystem()),
+	m_recordingJobCount(0),
+	m_recordingStats{},
 	m_viewport(0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height)),
 	m_scissorRect(0, 0, static_cast<LONG>(width), static_cast<LONG>(height)),
+	m_pDepthStencilViewResource(nullptr),
+	m_whiteTextureHandle(NullBindlessHandle),
+	m_checkerTextureHandle(NullBindlessHandle),
+	m_cubeObject(NullSceneObjectHandle),
+	m_lodEnabled(true),
+	m_lodSettings{ 1.0f, 0.25f, 8 },
+	m_lodFrame(0),
+	m_meshletCulling(false),
+	m_occlusionCulling(true),
+	m_vertexShader{},
+	m_pixelShader{},
+	m_cullShader{},
+	m_vertexShaderReloadId(UINT_MAX),
+	m_pixelShaderReloadId(UINT_MAX),
+	m_cullShaderReloadId(UINT_MAX),
+	m_cullConstants{},
+	m_cullObjects(0),
+	m_gpuCulling(true),
+	m_gpuCullingActive(false),
+	m_shaderReloadSaveTime(0),
+	m_shaderReloadCompileMilliseconds(0.0),
 	m_rtvDescriptorSize(0),
-	m_fenceValues{},
-	m_constantBufferData{}
+	m_benchmarkScene(false),
+	m_statsFrameCount(0),
+	m_statsStartTime{},
+	m_statsUpdateMilliseconds(0.0),
+	m_statsRecordMilliseconds(0.0),
+	m_statsTriangleCount(0),
+	m_statsOccludedCount(0),
+	m_statsMeshletCull{},
+	m_fenceValue(0)
 {
 	WCHAR assetsPath[512];
 	GetAssetsPath(assetsPath, _countof(assetsPath));
 	m_assetsPath = assetsPath;
 
 	m_aspectRatio = static_cast<float>(width) / static_cast<float>(height);
+
+	m_recordingJobCount = std::min(m_jobSystem->GetWorkerCount(), static_cast<UINT>(MaxRecordingJobs));
 }
 
 void Engine::OnInit()
@@ -59,6 +95,20 @@ void Engine::LoadPipeline()
 		IID_PPV_ARGS(&m_device)
 	));
 
+	// Pipeline blobs persisted by the last run are only valid on the same GPU.
+	{
+		UINT64 adapterId = 0;
+		if (hardwareAdapter)
+		{
+			DXGI_ADAPTER_DESC1 adapterDesc;
+			ThrowIfFailed(hardwareAdapter->GetDesc1(&adapterDesc));
+			adapterId = (static_cast<UINT64>(adapterDesc.VendorId) << 48) ^ (static_cast<UINT64>(adapterDesc.DeviceId) << 32) ^
+				(static_cast<UINT64>(adapterDesc.Revision) << 24) ^ adapterDesc.SubSysId;
+		}
+
+		m_pipelineStateCache.reset(new PipelineStateCache(m_device.Get(), GetAssetFullPath(L"PipelineCache.bin"), adapterId));
+	}
+
 	// Describe and create the command queue.
 	D3D12_COMMAND_QUEUE_DESC queueDesc = {};
 	queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
@@ -68,7 +118,7 @@ void Engine::LoadPipeline()
 
 	// Describe and create the swap chain.
 	DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
-	swapChainDesc.BufferCount = FrameCount;
+	swapChainDesc.BufferCount = BackBufferCount;
 	swapChainDesc.Width = m_width;
 	swapChainDesc.Height = m_height;
 	swapChainDesc.Format =  DXGI_FORMAT_R16G16B16A16_FLOAT;
@@ -90,25 +140,19 @@ void Engine::LoadPipeline()
 	ThrowIfFailed(factory->MakeWindowAssociation(App::GetHwnd(), DXGI_MWA_NO_ALT_ENTER));
 
 	ThrowIfFailed(swapChain.As(&m_swapChain));
-	m_frameIndex = m_swapChain->GetCurrentBackBufferIndex();
+	m_backBufferIndex = m_swapChain->GetCurrentBackBufferIndex();
 
 	// Create descriptor heaps.
 	{
 		// Describe and create a render target view (RTV) descriptor heap.
 		D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
-		rtvHeapDesc.NumDescriptors = FrameCount;
+		rtvHeapDesc.NumDescriptors = BackBufferCount;
 		rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
 		rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
 		ThrowIfFailed(m_device->CreateDescriptorHeap(&rtvHeapDesc, IID_PPV_ARGS(&m_rtvHeap)));
 
-		// Describe and create a constant buffer view (CBV) descriptor heap.
-		// Flags indicate that this descriptor heap can be bound to the pipeline 
-		// and that descriptors contained in it can be referenced by a root table.
-		/*D3D12_DESCRIPTOR_HEAP_DESC cbvHeapDesc = {};
-		cbvHeapDesc.NumDescriptors = 1;
-		cbvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-		cbvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-		ThrowIfFailed(m_device->CreateDescriptorHeap(&cbvHeapDesc, IID_PPV_ARGS(&m_cbvHeap)));*/
+		// The shader-visible CBV/SRV/UAV heap is shared by everything and bound once per command list.
+		m_descriptorHeap.reset(new BindlessDescriptorHeap(m_device.Get()));
 
 		// Create the descriptor heap for the depth-stencil view.
 		D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc = {};
@@ -118,27 +162,31 @@ void Engine::LoadPipeline()
 		ThrowIfFailed(m_device->CreateDescriptorHeap(&dsvHeapDesc, IID_PPV_ARGS(&m_dsvHeap)));
 	}
 
-	// Create frame resources.
-	{
-		// Create a RTV and a command allocator for each frame.
-		CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart());
-		m_rtvDescriptorSize = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+	// Create a RTV for each back buffer.
+	m_rtvDescriptorSize = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+	CreateRenderTargetViews();
 
-		for (UINT n = 0; n < FrameCount; n++)
+	// Create the ring of frame resources and the upload allocator for per-frame constants.
+	{
+		for (UINT n = 0; n < m_frameCount; n++)
 		{
-			ThrowIfFailed(m_swapChain->GetBuffer(n, IID_PPV_ARGS(&m_renderTargets[n])));
-			m_device->CreateRenderTargetView(m_renderTargets[n].Get(), nullptr, rtvHandle);
-			rtvHandle.Offset(1, m_rtvDescriptorSize);
-
-			ThrowIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_commandAllocators[n])));
+			m_frameResources.emplace_back(new FrameResource(m_device.Get(), m_recordingJobCount));
 		}
+
+		m_pCurrentFrameResource = m_frameResources[m_frameRing.GetFrameIndex()].get();
+
+		m_uploadAllocator.reset(new UploadAllocator(m_device.Get()));
+		m_copyUploader.reset(new CopyUploader(m_device.Get()));
 	}
+
+	// Placed heaps for the render graph's transient resources. Outdated layouts are released once their frames retire.
+	m_renderGraphBackend.Initialize(m_device.Get(), [this](IUnknown* pObject) { DeferRelease(pObject); });
 }
 
 // Load the sample assets.
 void Engine::LoadAssets()
 {
-	// Create a root signature consisting of a descriptor table with a single CBV.
+	// Create a root signature consisting of the material CBV, an unbounded SRV table over the bindless heap and the instance buffer SRV.
 	{
 		D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData = {};
 
@@ -150,12 +198,14 @@ void Engine::LoadAssets()
 			featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
 		}
 
-		//CD3DX12_DESCRIPTOR_RANGE1 ranges[1];
-		//ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC);
+		// Slots are rewritten while the heap stays bound, so descriptors and data are volatile.
+		CD3DX12_DESCRIPTOR_RANGE1 ranges[1];
+		ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, UINT_MAX, 0, 1, D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE | D3D12_DESCRIPTOR_RANGE_FLAG_DATA_VOLATILE, 0);
 
-		CD3DX12_ROOT_PARAMETER1 rootParameters[1];
+		CD3DX12_ROOT_PARAMETER1 rootParameters[3];
 		rootParameters[0].InitAsConstantBufferView(0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC, D3D12_SHADER_VISIBILITY_ALL);
-		//rootParameters[0].InitAsDescriptorTable(1, &ranges[0], D3D12_SHADER_VISIBILITY_ALL); // D3D12_SHADER_VISIBILITY_VERTEX
+		rootParameters[1].InitAsDescriptorTable(_countof(ranges), ranges, D3D12_SHADER_VISIBILITY_PIXEL);
+		rootParameters[2].InitAsShaderResourceView(0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC, D3D12_SHADER_VISIBILITY_VERTEX);
 
 		D3D12_STATIC_SAMPLER_DESC sampler = {};
 		sampler.Filter = D3D12_FILTER_ANISOTROPIC;
@@ -186,54 +236,118 @@ void Engine::LoadAssets()
 		ComPtr<ID3DBlob> error;
 		ThrowIfFailed(D3DX12SerializeVersionedRootSignature(&rootSignatureDesc, featureData.HighestVersion, &signature, &error));
 		ThrowIfFailed(m_device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&m_rootSignature)));
+		m_pipelineStateCache->RegisterRootSignature(m_rootSignature.Get(), signature->GetBufferPointer(), signature->GetBufferSize());
+
+		// The cull pass takes its constants inline and addresses its buffers directly, so it needs no descriptors.
+		CD3DX12_ROOT_PARAMETER1 cullRootParameters[4];
+		cullRootParameters[0].InitAsConstants(sizeof(GpuCullConstants) / sizeof(UINT32), 0);
+		cullRootParameters[1].InitAsShaderResourceView(0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC);
+		cullRootParameters[2].InitAsUnorderedAccessView(0);
+		cullRootParameters[3].InitAsUnorderedAccessView(1);
+
+		CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC cullRootSignatureDesc;
+		cullRootSignatureDesc.Init_1_1(_countof(cullRootParameters), cullRootParameters);
+
+		ThrowIfFailed(D3DX12SerializeVersionedRootSignature(&cullRootSignatureDesc, featureData.HighestVersion, &signature, &error));
+		ThrowIfFailed(m_device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&m_cullRootSignature)));
+		m_pipelineStateCache->RegisterRootSignature(m_cullRootSignature.Get(), signature->GetBufferPointer(), signature->GetBufferSize());
 	}
 
-	// Create the pipeline state, which includes compiling and loading shaders.
+	// Watch the shader sources in the project tree, where they are edited, rather than the copies
+	// next to the executable. Without a project tree (a shipped build) there is nothing to watch.
 	{
-		ComPtr<ID3DBlob> vertexShader = CompileShader(GetAssetFullPath(L"shaders.hlsl"), nullptr, "VSMain", "vs_5_0");
-		ComPtr<ID3DBlob> pixelShader = CompileShader(GetAssetFullPath(L"shaders.hlsl"), nullptr, "PSMain", "ps_5_0");
+		std::wstring shaderDirectory = m_assetsPath;
+		for (UINT level = 0; level < 4; level++)
+		{
+			const std::wstring sourcePath = shaderDirectory + L"Shaders\\shaders.hlsl";
+			if (GetFileAttributesW(sourcePath.c_str()) != INVALID_FILE_ATTRIBUTES)
+			{
+				m_shaderHotReloader.reset(new ShaderHotReloader());
+				m_vertexShaderReloadId = m_shaderHotReloader->AddShader(sourcePath, nullptr, "VSMain", "vs_5_1");
+				m_pixelShaderReloadId = m_shaderHotReloader->AddShader(sourcePath, nullptr, "PSMain", "ps_5_1");
+				m_cullShaderReloadId = m_shaderHotReloader->AddShader(shaderDirectory + L"Shaders\\culling.hlsl", nullptr, "CSMain", "cs_5_1");
+				break;
+			}
+
+			const size_t slash = shaderDirectory.find_last_of(L'\\', shaderDirectory.size() - 2);
+			if (slash == std::wstring::npos)
+			{
+				break;
+			}
+			shaderDirectory.resize(slash + 1);
+		}
+	}
 
-		// Define the vertex input layout.
-		D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
+	// Create the pipeline state, which includes compiling and loading shaders. The
+	// hot reloader compiles with FXC, so while it runs the bundle, which may hold
+	// DXC's DXIL, is skipped: every stage of a pipeline must be in the same format.
+	{
+		if (!m_shaderHotReloader)
 		{
-			{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-			{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-			{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-			{ "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
-		};
+			m_shaderBundle.Open(GetAssetFullPath(L"shaders.bundle"));
+		}
 
-		// Describe and create the graphics pipeline state object (PSO).
-		D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
-		psoDesc.InputLayout = { inputElementDescs, _countof(inputElementDescs) };
-		psoDesc.pRootSignature = m_rootSignature.Get();
-		psoDesc.VS = CD3DX12_SHADER_BYTECODE(vertexShader.Get());
-		psoDesc.PS = CD3DX12_SHADER_BYTECODE(pixelShader.Get());
-		psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
-		psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
-		psoDesc.DepthStencilState.DepthEnable = TRUE;
-		psoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
-		psoDesc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL;
-		psoDesc.DepthStencilState.StencilEnable = FALSE;
-		psoDesc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
-		psoDesc.SampleMask = UINT_MAX;
-		psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-		psoDesc.NumRenderTargets = 1;
-		psoDesc.RTVFormats[0] = DXGI_FORMAT_R16G16B16A16_FLOAT;
-		psoDesc.SampleDesc.Count = 1;
-		ThrowIfFailed(m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_pipelineState)));
-	}
-
-	// Create the command list.
-	ThrowIfFailed(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_commandAllocators[m_frameIndex].Get(), m_pipelineState.Get(), IID_PPV_ARGS(&m_commandList)));
+		m_vertexShader = LoadShader(L"shaders.hlsl", nullptr, "VSMain", "vs_5_1");
+		m_pixelShader = LoadShader(L"shaders.hlsl", nullptr, "PSMain", "ps_5_1");
+		m_cullShader = LoadShader(L"culling.hlsl", nullptr, "CSMain", "cs_5_1");
+
+		if (!CreatePipelineState() || !CreateCullPipelineState())
+		{
+			ThrowIfFailed(E_FAIL);
+		}
+		m_pipelineStateCache->ReportStats("startup");
+	}
+
+	// Create the command signature and the buffers the cull pass fills for ExecuteIndirect.
+	{
+		// Each command rebinds the material constants and the instance data, then draws.
+		D3D12_INDIRECT_ARGUMENT_DESC arguments[3] = {};
+		arguments[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT_BUFFER_VIEW;
+		arguments[0].ConstantBufferView.RootParameterIndex = 0;
+		arguments[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_SHADER_RESOURCE_VIEW;
+		arguments[1].ShaderResourceView.RootParameterIndex = 2;
+		arguments[2].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+		D3D12_COMMAND_SIGNATURE_DESC commandSignatureDesc = {};
+		commandSignatureDesc.ByteStride = sizeof(GpuDrawCommand);
+		commandSignatureDesc.NumArgumentDescs = _countof(arguments);
+		commandSignatureDesc.pArgumentDescs = arguments;
+		ThrowIfFailed(m_device->CreateCommandSignature(&commandSignatureDesc, m_rootSignature.Get(), IID_PPV_ARGS(&m_commandSignature)));
+
+		// Both buffers rest in the indirect argument state between frames.
+		const CD3DX12_HEAP_PROPERTIES defaultHeapProperties(D3D12_HEAP_TYPE_DEFAULT);
+		const CD3DX12_RESOURCE_DESC commandBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(MaxGpuDrawCommands * sizeof(GpuDrawCommand), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+		const CD3DX12_RESOURCE_DESC countBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(sizeof(UINT32), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+		ThrowIfFailed(m_device->CreateCommittedResource(&defaultHeapProperties, D3D12_HEAP_FLAG_NONE, &commandBufferDesc,
+			D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, nullptr, IID_PPV_ARGS(&m_drawCommandBuffer)));
+		ThrowIfFailed(m_device->CreateCommittedResource(&defaultHeapProperties, D3D12_HEAP_FLAG_NONE, &countBufferDesc,
+			D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, nullptr, IID_PPV_ARGS(&m_drawCountBuffer)));
+	}
+
+	// Create the command lists: one that opens the frame, one per recording job and one that closes the frame.
+	ThrowIfFailed(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_pCurrentFrameResource->GetCommandAllocator(), m_pipelineState.Get(), IID_PPV_ARGS(&m_commandList)));
+	ThrowIfFailed(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_pCurrentFrameResource->GetCommandAllocator(), m_pipelineState.Get(), IID_PPV_ARGS(&m_endCommandList)));
+
+	for (UINT i = 0; i < m_recordingJobCount; i++)
+	{
+		ThrowIfFailed(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_pCurrentFrameResource->GetWorkerCommandAllocator(i), m_pipelineState.Get(), IID_PPV_ARGS(&m_workerCommandLists[i])));
+		ThrowIfFailed(m_workerCommandLists[i]->Close());
+	}
 
 	// Command lists are created in the recording state, but there is nothing
-	// to record yet. The main loop expects it to be closed, so close it now.
+	// to record yet. The main loop expects them to be closed, so close them now.
 	ThrowIfFailed(m_commandList->Close());
+	ThrowIfFailed(m_endCommandList->Close());
 
-	// Create the vertex buffer.
+	CookMeshSources();
+
+	LARGE_INTEGER uploadStart;
+	QueryPerformanceCounter(&uploadStart);
+
+	// Create the vertex and index buffers shared by every mesh: a cube, then a sphere at decreasing levels of detail,
+	// then the meshes cooked into meshes.mesh.
 	{
-		// Define the geometry for a triangle.
-		Vertex vertices[] =
+		const Vertex cubeVertices[] =
 		{
 			// Front Face
 			{ { -1.0f, -1.0f, -1.0f }, { 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f }, { 0.0f, 0.0f, 1.0f, 1.0f } },
@@ -272,36 +386,7 @@ void Engine::LoadAssets()
 			{ { 1.0f, -1.0f,  1.0f }, { 1.0f, 1.0f }, { 1.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 1.0f, 1.0f } },
 		};
 
-		const UINT vertexBufferSize = sizeof(vertices);
-
-		// Note: using upload heaps to transfer static data like vert buffers is not 
-		// recommended. Every time the GPU needs it, the upload heap will be marshalled 
-		// over. Please read up on Default Heap usage. An upload heap is used here for 
-		// code simplicity and because there are very few verts to actually transfer.
-		ThrowIfFailed(m_device->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-			D3D12_HEAP_FLAG_NONE,
-			&CD3DX12_RESOURCE_DESC::Buffer(vertexBufferSize),
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS(&m_vertexBuffer)));
-
-		// Copy the triangle data to the vertex buffer.
-		UINT8* pVertexDataBegin;
-		CD3DX12_RANGE readRange(0, 0);        // We do not intend to read from this resource on the CPU.
-		ThrowIfFailed(m_vertexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pVertexDataBegin)));
-		memcpy(pVertexDataBegin, vertices, sizeof(vertices));
-		m_vertexBuffer->Unmap(0, nullptr);
-
-		// Initialize the vertex buffer view.
-		m_vertexBufferView.BufferLocation = m_vertexBuffer->GetGPUVirtualAddress();
-		m_vertexBufferView.StrideInBytes = sizeof(Vertex);
-		m_vertexBufferView.SizeInBytes = vertexBufferSize;
-	}
-
-	// Create the index buffer.
-	{
-		const WORD indices[] =
+		const WORD cubeIndices[] =
 		{
 			// Front Face
 			0,  1,  2,
@@ -328,80 +413,216 @@ void Engine::LoadAssets()
 			20, 22, 23
 		};
 
-		const UINT indexBufferSize = sizeof(indices);
+		std::vector<Vertex> vertices(std::begin(cubeVertices), std::end(cubeVertices));
+		std::vector<WORD> indices(std::begin(cubeIndices), std::end(cubeIndices));
+		m_meshes.push_back({ { { _countof(cubeIndices), 0, 0 } }, { { 0.0f }, 1 }, { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f } });
 
-		ThrowIfFailed(m_device->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-			D3D12_HEAP_FLAG_NONE,
-			&CD3DX12_RESOURCE_DESC::Buffer(indexBufferSize),
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS(&m_indexBuffer)));
+		// Unit UV spheres with half as many stacks as slices. Their flat facets sit at
+		// most 1 - cos(pi / slices) * cos(pi / (2 * stacks)) inside the sphere.
+		const float pi = g_XMPi.f[0];
+		Mesh sphere = { {}, {}, { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f } };
+		for (UINT slices = 64; slices >= 8; slices /= 2)
+		{
+			const UINT stacks = slices / 2;
+			const UINT firstVertex = static_cast<UINT>(vertices.size());
+			const UINT firstIndex = static_cast<UINT>(indices.size());
+			sphere.lods[sphere.lodChain.lodCount] = { stacks * slices * 6, static_cast<UINT>(indices.size()), static_cast<INT>(vertices.size()) };
+			sphere.lodChain.geometricErrors[sphere.lodChain.lodCount] = 1.0f - cosf(pi / slices) * cosf(pi / (2 * stacks));
+			sphere.lodChain.lodCount++;
+
+			for (UINT stack = 0; stack <= stacks; stack++)
+			{
+				const float polar = pi * stack / stacks;
+				for (UINT slice = 0; slice <= slices; slice++)
+				{
+					const float azimuth = 2.0f * pi * slice / slices;
+					const XMFLOAT3 normal(sinf(polar) * cosf(azimuth), cosf(polar), sinf(polar) * sinf(azimuth));
+					vertices.push_back({ normal, { static_cast<float>(slice) / slices, static_cast<float>(stack) / stacks }, normal, { 1.0f, 1.0f, 1.0f, 1.0f } });
+				}
+			}
+
+			for (UINT stack = 0; stack < stacks; stack++)
+			{
+				for (UINT slice = 0; slice < slices; slice++)
+				{
+					const WORD top = static_cast<WORD>(stack * (slices + 1) + slice);
+					const WORD bottom = static_cast<WORD>(top + slices + 1);
+					indices.insert(indices.end(), { top, static_cast<WORD>(top + 1), bottom, static_cast<WORD>(top + 1), static_cast<WORD>(bottom + 1), bottom });
+				}
+			}
+
+			// Row by row, the finer LODs miss the vertex cache on every new row. Reorder the triangles
+			// for it, split them into meshlets and then reorder the vertices for fetch locality; spheres
+			// are convex, so overdraw is moot.
+			std::vector<UINT32> lodIndices(indices.begin() + firstIndex, indices.end());
+			std::vector<Vertex> lodVertices(vertices.size() - firstVertex);
+			std::vector<Meshlet> lodMeshlets;
+			OptimizeVertexCache(lodIndices.data(), lodIndices.data(), static_cast<UINT32>(lodIndices.size()), static_cast<UINT32>(lodVertices.size()));
+			BuildMeshlets(lodIndices.data(), static_cast<UINT32>(lodIndices.size()), &vertices[firstVertex].position.x, sizeof(Vertex), static_cast<UINT32>(lodVertices.size()), lodMeshlets);
+			MeshLod& sphereLod = sphere.lods[sphere.lodChain.lodCount - 1];
+			sphereLod.firstMeshlet = static_cast<UINT>(m_meshlets.size());
+			sphereLod.meshletCount = static_cast<UINT>(lodMeshlets.size());
+			m_meshlets.insert(m_meshlets.end(), lodMeshlets.begin(), lodMeshlets.end());
+			OptimizeVertexFetch(lodVertices.data(), lodIndices.data(), static_cast<UINT32>(lodIndices.size()), &vertices[firstVertex], static_cast<UINT32>(lodVertices.size()), sizeof(Vertex));
+			std::copy(lodVertices.begin(), lodVertices.end(), vertices.begin() + firstVertex);
+			for (size_t i = 0; i < lodIndices.size(); i++)
+			{
+				indices[firstIndex + i] = static_cast<WORD>(lodIndices[i]);
+			}
+		}
+		m_meshes.push_back(sphere);
+
+		// Cooked vertices and indices go straight from the mapped file to the upload ring. The file is
+		// skipped if it lacks the packed layout or would overflow the buffers or the draw key's mesh field.
+		static_assert(sizeof(Vertex) == 48, "Vertex must match EMeshVertexLayout::PositionTexCoordNormalColor");
+		MeshFile meshFile;
+		UINT32 meshStream = UINT32_MAX;
+		if (meshFile.Open(GetAssetFullPath(L"meshes.mesh")))
+		{
+			meshStream = meshFile.FindStream(EMeshVertexLayout::Packed, sizeof(PackedVertex));
+			const UINT64 vertexBytes = (vertices.size() + meshFile.GetVertexCount()) * sizeof(PackedVertex);
+			const UINT64 indexBytes = (indices.size() + meshFile.GetIndexCount()) * static_cast<UINT64>(meshFile.GetIndexSize());
+			if (meshStream == UINT32_MAX || m_meshes.size() + meshFile.GetMeshCount() > 0x10000 / MaxLodCount || vertexBytes > UINT_MAX || indexBytes > UINT_MAX)
+			{
+				OutputDebugStringA("MeshFile: meshes.mesh has no packed vertex stream or does not fit, skipped\n");
+				meshFile.Close();
+			}
+		}
 
-		UINT8* pIndexDataBegin;
-		CD3DX12_RANGE readRange(0, 0);
-		ThrowIfFailed(m_indexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pIndexDataBegin)));
-		memcpy(pIndexDataBegin, indices, sizeof(indices));
-		m_indexBuffer->Unmap(0, nullptr);
+		const UINT builtInVertexCount = static_cast<UINT>(vertices.size());
+		const UINT builtInIndexCount = static_cast<UINT>(indices.size());
+		const UINT cookedVertexCount = meshFile.IsOpen() ? meshFile.GetVertexCount() : 0;
+		const UINT cookedIndexCount = meshFile.IsOpen() ? meshFile.GetIndexCount() : 0;
+		for (UINT i = 0; meshFile.IsOpen() && i < meshFile.GetMeshCount(); i++)
+		{
+			// LODs past MaxLodCount are the coarsest and are dropped.
+			const MeshFileMesh& cookedMesh = meshFile.GetMesh(i);
+			Mesh mesh = {};
+			mesh.lodChain.lodCount = std::min(cookedMesh.lodCount, MaxLodCount);
+			for (UINT lod = 0; lod < mesh.lodChain.lodCount; lod++)
+			{
+				const MeshFileLod& cookedLod = meshFile.GetLod(cookedMesh.firstLod + lod);
+				mesh.lods[lod] = { cookedLod.indexCount, builtInIndexCount + cookedLod.startIndex, static_cast<INT>(builtInVertexCount) + cookedLod.baseVertex,
+					static_cast<UINT>(m_meshlets.size()), cookedLod.meshletCount };
+				m_meshlets.insert(m_meshlets.end(), meshFile.GetMeshlets() + cookedLod.firstMeshlet, meshFile.GetMeshlets() + cookedLod.firstMeshlet + cookedLod.meshletCount);
+				mesh.lodChain.geometricErrors[lod] = cookedLod.geometricError;
+			}
+			mesh.boundsCenter = { cookedMesh.boundsCenter[0], cookedMesh.boundsCenter[1], cookedMesh.boundsCenter[2] };
+			mesh.boundsExtents = { cookedMesh.boundsExtents[0], cookedMesh.boundsExtents[1], cookedMesh.boundsExtents[2] };
+			m_meshes.push_back(mesh);
+		}
 
-		m_indexBufferView.BufferLocation = m_indexBuffer->GetGPUVirtualAddress();
-		m_indexBufferView.Format = DXGI_FORMAT_R16_UINT;
-		m_indexBufferView.SizeInBytes = indexBufferSize;
-	}
+		// The GPU reads packed vertices, with positions quantized across each mesh's bounds. The cooked
+		// ones come packed; the built-in ones are packed here, and their floats kept for occluders.
+		for (Mesh& mesh : m_meshes)
+		{
+			mesh.positionQuantization = GetPositionQuantization(&mesh.boundsCenter.x, &mesh.boundsExtents.x);
+		}
+		std::vector<PackedVertex> packedVertices(builtInVertexCount);
+		const UINT builtInFirstVertices[BuiltInMeshCount + 1] = { 0, static_cast<UINT>(_countof(cubeVertices)), builtInVertexCount };
+		for (UINT i = 0; i < BuiltInMeshCount; i++)
+		{
+			const UINT first = builtInFirstVertices[i];
+			PackVertices(&packedVertices[first], &vertices[first], sizeof(Vertex), builtInFirstVertices[i + 1] - first, m_meshes[i].positionQuantization);
+		}
 
-	// Create the constant buffer.
-	{
-		const UINT constantBufferSize = sizeof(SceneConstantBuffer) * 2; // * FrameCount
+		const UINT vertexBufferSize = (builtInVertexCount + cookedVertexCount) * sizeof(PackedVertex);
+
+		// The copy queue fills a default heap buffer; the direct queue waits for it before drawing.
+		m_vertexBuffer = m_copyUploader->CreateBuffer(vertexBufferSize);
+		m_copyUploader->UploadBuffer(m_vertexBuffer.Get(), 0, packedVertices.data(), builtInVertexCount * sizeof(PackedVertex));
+		if (cookedVertexCount > 0)
+		{
+			m_copyUploader->UploadBuffer(m_vertexBuffer.Get(), builtInVertexCount * sizeof(PackedVertex), meshFile.GetStreamData(meshStream), cookedVertexCount * sizeof(PackedVertex));
+		}
+
+		// Initialize the vertex buffer view.
+		m_vertexBufferView.BufferLocation = m_vertexBuffer->GetGPUVirtualAddress();
+		m_vertexBufferView.StrideInBytes = sizeof(PackedVertex);
+		m_vertexBufferView.SizeInBytes = vertexBufferSize;
+
+		char message[256];
+		const UINT vertexCount = builtInVertexCount + cookedVertexCount;
+		sprintf_s(message, "Vertices: %u, %.2f MB packed instead of %.2f MB as floats, %.0f%% less to store and fetch\n", vertexCount,
+			vertexCount * sizeof(PackedVertex) / (1024.0 * 1024.0), vertexCount * sizeof(Vertex) / (1024.0 * 1024.0), 100.0 * (1.0 - static_cast<double>(sizeof(PackedVertex)) / sizeof(Vertex)));
+		OutputDebugStringA(message);
+
+		// The built-in indices are widened when the cooked ones are 32-bit.
+		const UINT indexSize = meshFile.IsOpen() ? meshFile.GetIndexSize() : sizeof(WORD);
+		std::vector<UINT32> wideIndices;
+		const void* pBuiltInIndices = indices.data();
+		if (indexSize == sizeof(UINT32))
+		{
+			wideIndices.assign(indices.begin(), indices.end());
+			pBuiltInIndices = wideIndices.data();
+		}
 
-		ThrowIfFailed(m_device->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-			D3D12_HEAP_FLAG_NONE,
-			&CD3DX12_RESOURCE_DESC::Buffer(constantBufferSize),
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS(&m_constantBuffer)));
+		const UINT indexBufferSize = (builtInIndexCount + cookedIndexCount) * indexSize;
 
-		// Describe and create a constant buffer view.
-		//D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
-		//cbvDesc.BufferLocation = m_constantBuffer->GetGPUVirtualAddress();
-		//cbvDesc.SizeInBytes = (sizeof(SceneConstantBuffer) + 255) & ~255; // CB size is required to be 256-byte aligned.
-		//m_device->CreateConstantBufferView(&cbvDesc, m_cbvHeap->GetCPUDescriptorHandleForHeapStart());
+		m_indexBuffer = m_copyUploader->CreateBuffer(indexBufferSize);
+		m_copyUploader->UploadBuffer(m_indexBuffer.Get(), 0, pBuiltInIndices, builtInIndexCount * indexSize);
+		if (cookedIndexCount > 0)
+		{
+			m_copyUploader->UploadBuffer(m_indexBuffer.Get(), builtInIndexCount * indexSize, meshFile.GetIndexData(), cookedIndexCount * indexSize);
+		}
 
-		// Map and initialize the constant buffer. We don't unmap this until the
-		// app closes. Keeping things mapped for the lifetime of the resource is okay.
-		CD3DX12_RANGE readRange(0, 0);
-		ThrowIfFailed(m_constantBuffer->Map(0, &readRange, reinterpret_cast<void**>(&m_pCbvDataBegin)));
-		memcpy(m_pCbvDataBegin, &m_constantBufferData, constantBufferSize);
+		m_indexBufferView.BufferLocation = m_indexBuffer->GetGPUVirtualAddress();
+		m_indexBufferView.Format = indexSize == sizeof(UINT32) ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
+		m_indexBufferView.SizeInBytes = indexBufferSize;
+
+		// Kept for occluder rasterization.
+		m_vertices = std::move(vertices);
+		m_indices = std::move(indices);
 	}
 
-	// Create the depth stencil view.
+	// Create the textures and their views in the bindless heap.
 	{
-		D3D12_DEPTH_STENCIL_VIEW_DESC depthStencilDesc = {};
-		depthStencilDesc.Format = DXGI_FORMAT_D32_FLOAT;
-		depthStencilDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
-		depthStencilDesc.Flags = D3D12_DSV_FLAG_NONE;
+		const UINT32 white = 0xffffffff;
+		m_whiteTexture = m_copyUploader->CreateTexture2D(DXGI_FORMAT_R8G8B8A8_UNORM, 1, 1, &white, sizeof(white));
+		m_whiteTextureHandle = m_descriptorHeap->CreateShaderResourceView(m_whiteTexture.Get());
 
-		D3D12_CLEAR_VALUE depthOptimizedClearValue = {};
-		depthOptimizedClearValue.Format = DXGI_FORMAT_D32_FLOAT;
-		depthOptimizedClearValue.DepthStencil.Depth = 1.0f;
-		depthOptimizedClearValue.DepthStencil.Stencil = 0;
-
-		ThrowIfFailed(m_device->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-			D3D12_HEAP_FLAG_NONE,
-			&CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_D32_FLOAT, m_width, m_height, 1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL),
-			D3D12_RESOURCE_STATE_DEPTH_WRITE,
-			&depthOptimizedClearValue,
-			IID_PPV_ARGS(&m_depthStencil)
-		));
+		const UINT checkerSize = 64;
+		std::vector<UINT32> checker(checkerSize * checkerSize);
+		for (UINT y = 0; y < checkerSize; y++)
+		{
+			for (UINT x = 0; x < checkerSize; x++)
+			{
+				checker[y * checkerSize + x] = ((x / 8 + y / 8) & 1) ? 0xffffffff : 0xffb0b0b0;
+			}
+		}
+		m_checkerTexture = m_copyUploader->CreateTexture2D(DXGI_FORMAT_R8G8B8A8_UNORM, checkerSize, checkerSize, checker.data(), checkerSize * sizeof(UINT32));
+		m_checkerTextureHandle = m_descriptorHeap->CreateShaderResourceView(m_checkerTexture.Get());
+	}
 
-		m_device->CreateDepthStencilView(m_depthStencil.Get(), &depthStencilDesc, m_dsvHeap->GetCPUDescriptorHandleForHeapStart());
+	// Build the scene: a spinning cube carrying a smaller one, standing on a flattened cube as the ground.
+	{
+		const UINT orangeMaterial = static_cast<UINT>(m_materials.size());
+		m_materials.push_back({ XMFLOAT4(1.0f, 0.4f, 0.0f, 1.0f), m_whiteTextureHandle.index });
+		const UINT groundMaterial = static_cast<UINT>(m_materials.size());
+		m_materials.push_back({ XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f), m_checkerTextureHandle.index });
+
+		const Mesh& cube = m_meshes[CubeMesh];
+		m_cubeObject = m_scene.Create({ { 0.0f, 0.5f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.5f, 0.5f, 0.5f }, cube.boundsCenter, cube.boundsExtents, CubeMesh, orangeMaterial });
+		m_scene.Create({ { 2.0f, 0.5f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.3f, 0.3f, 0.3f }, cube.boundsCenter, cube.boundsExtents, CubeMesh, groundMaterial }, m_cubeObject);
+		m_scene.Create({ { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 40.0f, 0.01f, 40.0f }, cube.boundsCenter, cube.boundsExtents, CubeMesh, groundMaterial });
+
+		// Cooked meshes stand in a row behind the cube, each scaled to fit a unit box.
+		const UINT cookedMeshCount = static_cast<UINT>(m_meshes.size()) - BuiltInMeshCount;
+		for (UINT i = 0; i < cookedMeshCount; i++)
+		{
+			const Mesh& mesh = m_meshes[BuiltInMeshCount + i];
+			const float extent = std::max(std::max(mesh.boundsExtents.x, mesh.boundsExtents.y), mesh.boundsExtents.z);
+			const float scale = extent > 0.0f ? 0.5f / extent : 1.0f;
+			const float x = 1.5f * i - 0.75f * (cookedMeshCount - 1);
+			m_scene.Create({ { x - scale * mesh.boundsCenter.x, 0.5f - scale * mesh.boundsCenter.y, 3.0f - scale * mesh.boundsCenter.z }, { 0.0f, 0.0f, 0.0f, 1.0f },
+				{ scale, scale, scale }, mesh.boundsCenter, mesh.boundsExtents, BuiltInMeshCount + i, orangeMaterial });
+		}
 	}
 
 	// Create synchronization objects and wait until assets have been uploaded to the GPU.
 	{
-		ThrowIfFailed(m_device->CreateFence(m_fenceValues[m_frameIndex], D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
-		m_fenceValues[m_frameIndex]++;
+		ThrowIfFailed(m_device->CreateFence(m_fenceValue, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
+		m_fenceValue++;
 
 		m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
 		if (m_fenceEvent == nullptr)
@@ -409,8 +630,25 @@ void Engine::LoadAssets()
 			ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
 		}
 
+		m_copyUploader->QueueWait(m_commandQueue.Get());
 		WaitForGpu();
 	}
+
+	// Report the startup upload throughput (from staging the first byte to the direct queue seeing it).
+	{
+		LARGE_INTEGER uploadEnd, frequency;
+		QueryPerformanceCounter(&uploadEnd);
+		QueryPerformanceFrequency(&frequency);
+
+		const CopyUploader::Stats stats = m_copyUploader->GetStats();
+		const double seconds = static_cast<double>(uploadEnd.QuadPart - uploadStart.QuadPart) / static_cast<double>(frequency.QuadPart);
+		const double megabytes = static_cast<double>(stats.bytesUploaded) / (1024.0 * 1024.0);
+
+		char message[256];
+		sprintf_s(message, "CopyUploader: %.3f MB in %llu copies, %llu submits, %llu ring stalls, %.1f MB/s\n",
+			megabytes, stats.copyCount, stats.submitCount, stats.ringStallCount, seconds > 0.0 ? megabytes / seconds : 0.0);
+		OutputDebugStringA(message);
+	}
 }
 
 float roll = 0;
@@ -454,9 +692,25 @@ float NormalizePitch(float fPitch)
 	return fPitch;
 }
 
+double MillisecondsSince(const LARGE_INTEGER& start)
+{
+	LARGE_INTEGER now, frequency;
+	QueryPerformanceCounter(&now);
+	QueryPerformanceFrequency(&frequency);
+	return static_cast<double>(now.QuadPart - start.QuadPart) * 1000.0 / static_cast<double>(frequency.QuadPart);
+}
+
 // Update frame-based values.
 void Engine::OnUpdate()
 {
+	if (m_minimized)
+	{
+		return;
+	}
+
+	LARGE_INTEGER updateStart;
+	QueryPerformanceCounter(&updateStart);
+
 	const float pi = g_XMPi.f[0];
 	const float translationSpeed = 0.01f;
 	const float offsetBounds = 1.25f;
@@ -531,44 +785,307 @@ void Engine::OnUpdate()
 	}
 
 	XMMATRIX mView = XMMatrixLookAtLH(camPos, camPos + forward, up);
-	XMMATRIX mProj = XMMatrixPerspectiveFovLH(pi / 3, m_aspectRatio, 0.1f, 100.0f);
+	const float nearPlane = 0.1f;
+	const float farPlane = 100.0f;
+	const float fovY = pi / 3;
+	XMMATRIX mProj = XMMatrixPerspectiveFovLH(fovY, m_aspectRatio, nearPlane, farPlane);
 	mViewProj = mView * mProj;
 
-	XMMATRIX mWorld =
-		XMMatrixTranslation(0.0f, 1.0f, 0.0f) *
-		XMMatrixScaling(0.5f, 0.5f, 0.5f) *
-		XMMatrixRotationRollPitchYaw(0.0f, roll, 0.0f);
+	// Spin the cube about the vertical axis.
+	m_scene.SetRotation(m_cubeObject, { 0.0f, sinf(roll * 0.5f), 0.0f, cosf(roll * 0.5f) });
+
+	m_scene.UpdateWorld(m_jobSystem.get(), MinObjectsPerUpdateJob);
+	UpdateSceneBvh();
+	const UINT objectCount = m_scene.GetObjectCount();
+
+	// Only objects whose world bounds intersect the view frustum are drawn.
+	static_assert(sizeof(SceneMatrix) == sizeof(XMFLOAT4X4), "SceneMatrix must match XMFLOAT4X4.");
+	SceneMatrix viewProj;
+	XMStoreFloat4x4(reinterpret_cast<XMFLOAT4X4*>(&viewProj), mViewProj);
+	Frustum frustum;
+	ExtractFrustum(viewProj, frustum);
+
+	// On the GPU path every object is uploaded and the cull pass picks the visible ones.
+	m_gpuCullingActive = m_gpuCulling && objectCount <= MaxGpuDrawCommands;
+
+	UINT visibleCount = 0;
+	if (m_gpuCullingActive)
+	{
+		m_visibleObjects.resize(objectCount);
+		std::iota(m_visibleObjects.begin(), m_visibleObjects.end(), 0u);
+		visibleCount = objectCount;
+	}
+	else if (objectCount >= MinObjectsForBvhCulling)
+	{
+		m_visibleObjects.clear();
+		m_sceneBvh.QueryFrustum(frustum, m_visibleObjects);
+		visibleCount = static_cast<UINT>(m_visibleObjects.size());
+		for (UINT v = 0; v < visibleCount; v++)
+		{
+			m_visibleObjects[v] = m_scene.GetSlotDenseIndex(m_visibleObjects[v]);
+		}
+	}
+	else
+	{
+		m_visibleObjects.resize(objectCount);
+		visibleCount = CullBoxes(frustum, m_scene.GetWorldBounds(), 0, objectCount, m_visibleObjects.data(), GetBestCullingPath());
+	}
+
+	// Then drop what the occluders hide.
+	if (!m_gpuCullingActive && m_occlusionCulling && !m_occluders.empty())
+	{
+		const SceneMatrix* pWorldMatrices = m_scene.GetWorldMatrices();
+		m_occlusionBuffer.Begin(viewProj);
+		for (SceneObjectHandle occluder : m_occluders)
+		{
+			const UINT i = m_scene.GetDenseIndex(occluder);
+			const MeshLod& mesh = m_meshes[m_scene.GetMeshes()[i]].lods[0];
+			m_occlusionBuffer.AddOccluder(&m_vertices[mesh.baseVertex].position.x, sizeof(Vertex), &m_indices[mesh.startIndex], mesh.indexCount, pWorldMatrices[i]);
+		}
+		m_occlusionBuffer.Rasterize(m_jobSystem.get());
+
+		const UINT unoccludedCount = m_occlusionBuffer.CullBoxes(m_scene.GetWorldBounds(), m_visibleObjects.data(), visibleCount, m_jobSystem.get());
+		m_statsOccludedCount += visibleCount - unoccludedCount;
+		visibleCount = unoccludedCount;
+	}
 
-	XMStoreFloat4x4(&m_constantBufferData.mWorldViewProj, mWorld * mViewProj);
-	XMStoreFloat4x4(&m_constantBufferData.mWorld, mWorld);
-	XMStoreFloat3(&m_constantBufferData.cameraPos, camPos);
-	m_constantBufferData.materialColor = XMFLOAT4(1.0f, 0.4f, 0.0f, 1.0f);
-	memcpy(m_pCbvDataBegin, &m_constantBufferData, sizeof(m_constantBufferData));
+	// Constants shared by every instance with the same material.
+	MaterialConstantBuffer materialConstants = {};
+	XMStoreFloat3(&materialConstants.cameraPos, camPos);
+	m_materialConstants.resize(m_materials.size());
+	for (size_t m = 0; m < m_materials.size(); m++)
+	{
+		materialConstants.materialColor = m_materials[m].color;
+		materialConstants.textureIndex = m_materials[m].textureIndex;
+		m_materialConstants[m] = m_uploadAllocator->AllocateConstants(materialConstants);
+	}
 
+	XMFLOAT3 eye, viewDirection;
+	XMStoreFloat3(&eye, camPos);
+	XMStoreFloat3(&viewDirection, forward);
 
-	mWorld =
-		XMMatrixTranslation(0.0f, 0.0f, 0.0f) *
-		XMMatrixScaling(40.0f, 0.01f, 40.0f) *
-		XMMatrixRotationRollPitchYaw(0.0f, 0.0f, 0.0f);
+	// Pixels covered by one world unit at distance 1 from the eye.
+	const float pixelsPerUnit = static_cast<float>(m_height) / (2.0f * tanf(fovY / 2));
+	SelectLods(visibleCount, eye, pixelsPerUnit, nearPlane);
+
+	// Past the capacity of the GPU command buffer, objects switch LOD without drawing the one fading out.
+	UINT entryCount = visibleCount + static_cast<UINT>(m_fadingObjects.size());
+	if (m_gpuCullingActive && entryCount > MaxGpuDrawCommands)
+	{
+		entryCount = MaxGpuDrawCommands;
+	}
+
+	const SceneMatrix* pWorldMatrices = m_scene.GetWorldMatrices();
+	const UINT* pMeshes = m_scene.GetMeshes();
+	const UINT* pMaterials = m_scene.GetMaterials();
+	const auto WriteInstance = [this, pWorldMatrices, pMeshes](InstanceData& instance, UINT i, float lodFade)
+	{
+		const XMMATRIX mWorld = XMLoadFloat4x4(reinterpret_cast<const XMFLOAT4X4*>(&pWorldMatrices[i]));
+		XMStoreFloat4x4(&instance.mWorldViewProj, mWorld * mViewProj);
+		XMStoreFloat4x4(&instance.mWorld, mWorld);
+		const PositionQuantization& quantization = m_meshes[pMeshes[i]].positionQuantization;
+		instance.positionScale = XMFLOAT3(quantization.scale);
+		instance.lodFade = lodFade;
+		instance.positionOffset = XMFLOAT3(quantization.offset);
+	};
+
+	// Instance data is written in chunks that fit an upload page, so it never needs a dedicated page.
+	const UINT instancesPerChunk = static_cast<UINT>(UploadAllocator::DefaultPageSize / sizeof(InstanceData));
+
+	m_drawItems.clear();
+	if (m_gpuCullingActive)
+	{
+		const UploadAllocator::Allocation cullObjects = m_uploadAllocator->Allocate(entryCount * sizeof(GpuCullObject), 16);
+		GpuCullObject* pCullObjects = static_cast<GpuCullObject*>(cullObjects.pCpuAddress);
+		m_cullObjects = cullObjects.gpuAddress;
+		SetCullConstants(frustum, entryCount, MaxGpuDrawCommands, m_cullConstants);
+
+		// One single-instance command per draw entry, in entry order.
+		const SceneBoundsView worldBounds = m_scene.GetWorldBounds();
+		for (UINT first = 0; first < entryCount; first += instancesPerChunk)
+		{
+			const UINT count = std::min(instancesPerChunk, entryCount - first);
+			const UploadAllocator::Allocation chunk = m_uploadAllocator->Allocate(count * sizeof(InstanceData), 16);
+			InstanceData* pInstances = static_cast<InstanceData*>(chunk.pCpuAddress);
+
+			for (UINT c = 0; c < count; c++)
+			{
+				const UINT entry = first + c;
+				UINT i, lod;
+				float lodFade;
+				GetDrawEntry(entry, visibleCount, i, lod, lodFade);
+
+				const MeshLod& mesh = m_meshes[pMeshes[i]].lods[lod];
+				WriteInstance(pInstances[c], i, lodFade);
+				pCullObjects[entry] =
+				{
+					m_materialConstants[pMaterials[i]], chunk.gpuAddress + c * sizeof(InstanceData),
+					mesh.indexCount, mesh.startIndex, mesh.baseVertex, 0,
+					worldBounds.centerX[i], worldBounds.centerY[i], worldBounds.centerZ[i],
+					worldBounds.extentX[i], worldBounds.extentY[i], worldBounds.extentZ[i],
+				};
+				m_statsTriangleCount += mesh.indexCount / 3;
+			}
+		}
+	}
+	else
+	{
+		// Sort the draw entries by their keys; each run of equal state becomes one instanced draw.
+		// Everything is drawn with the one scene pipeline state for now.
+		const float depthScale = static_cast<float>((1u << DrawSortKeyDepthBits) - 1) / farPlane;
+		const SceneBoundsView worldBounds = m_scene.GetWorldBounds();
+
+		m_drawKeys.resize(entryCount);
+		m_drawObjects.resize(entryCount);
+		m_jobSystem->ParallelFor(entryCount, MinObjectsPerUpdateJob, [&](UINT begin, UINT end)
+		{
+			for (UINT entry = begin; entry < end; entry++)
+			{
+				UINT i, lod;
+				float lodFade;
+				GetDrawEntry(entry, visibleCount, i, lod, lodFade);
+
+				const float depth = (worldBounds.centerX[i] - eye.x) * viewDirection.x + (worldBounds.centerY[i] - eye.y) * viewDirection.y + (worldBounds.centerZ[i] - eye.z) * viewDirection.z;
+				const UINT depthBucket = static_cast<UINT>(std::min(std::max(depth * depthScale, 0.0f), static_cast<float>((1u << DrawSortKeyDepthBits) - 1)));
+				m_drawKeys[entry] = MakeDrawSortKey(EDrawPass::Opaque, 0, pMaterials[i], pMeshes[i] * MaxLodCount + lod, depthBucket);
+				m_drawObjects[entry] = entry;
+			}
+		});
+		m_drawRuns.resize(entryCount);
+		const UINT runCount = BuildDrawRuns(m_drawSorter, m_drawKeys.data(), m_drawObjects.data(), entryCount, DrawSortKeyDepthBits,
+			instancesPerChunk, m_drawRuns.data(), m_jobSystem.get());
+
+		UploadAllocator::Allocation chunk = {};
+		for (UINT r = 0; r < runCount; r++)
+		{
+			const DrawRun& run = m_drawRuns[r];
+			if (run.first % instancesPerChunk == 0)
+			{
+				const UINT count = std::min(instancesPerChunk, entryCount - run.first);
+				chunk = m_uploadAllocator->Allocate(count * sizeof(InstanceData), 16);
+			}
+
+			InstanceData* pInstances = static_cast<InstanceData*>(chunk.pCpuAddress);
+			UINT i = 0, lod = 0;
+			for (UINT v = run.first; v < run.first + run.count; v++)
+			{
+				float lodFade;
+				GetDrawEntry(m_drawObjects[v], visibleCount, i, lod, lodFade);
+				WriteInstance(pInstances[v % instancesPerChunk], i, lodFade);
+			}
+
+			// The run shares its mesh LOD and material, so i and lod of its last entry stand for all of them.
+			const MeshLod& mesh = m_meshes[pMeshes[i]].lods[lod];
+			const D3D12_GPU_VIRTUAL_ADDRESS material = m_materialConstants[pMaterials[i]];
+			const D3D12_GPU_VIRTUAL_ADDRESS instances = chunk.gpuAddress + (run.first % instancesPerChunk) * sizeof(InstanceData);
+			if (!m_meshletCulling || mesh.meshletCount == 0)
+			{
+				m_drawItems.push_back({ m_drawKeys[run.first], material, instances, run.count, mesh.indexCount, mesh.startIndex, mesh.baseVertex });
+				continue;
+			}
+
+			// An object drawn by meshlets has draws of its own.
+			for (UINT v = run.first; v < run.first + run.count; v++)
+			{
+				UINT object, objectLod;
+				float lodFade;
+				GetDrawEntry(m_drawObjects[v], visibleCount, object, objectLod, lodFade);
+				MeshletCullView view;
+				GetMeshletCullView(frustum, pWorldMatrices[object], &eye.x, view);
+				m_meshletRanges.resize(std::max(m_meshletRanges.size(), static_cast<size_t>(mesh.meshletCount)));
+				const UINT rangeCount = CullMeshlets(view, &m_meshlets[mesh.firstMeshlet], mesh.meshletCount, m_meshletRanges.data(), m_statsMeshletCull);
+				for (UINT range = 0; range < rangeCount; range++)
+				{
+					m_drawItems.push_back({ m_drawKeys[v], material, instances + (v - run.first) * sizeof(InstanceData), 1,
+						m_meshletRanges[range].indexCount, mesh.startIndex + m_meshletRanges[range].startIndex, mesh.baseVertex });
+				}
+			}
+		}
+
+		for (const DrawItem& draw : m_drawItems)
+		{
+			m_statsTriangleCount += static_cast<UINT64>(draw.indexCount / 3) * draw.instanceCount;
+		}
+	}
 
-	XMStoreFloat4x4(&m_constantBufferData.mWorldViewProj, mWorld * mViewProj);
-	XMStoreFloat4x4(&m_constantBufferData.mWorld, mWorld);
-	m_constantBufferData.materialColor = XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f);
-	memcpy(m_pCbvDataBegin + sizeof(SceneConstantBuffer), &m_constantBufferData, sizeof(m_constantBufferData));
+	m_statsUpdateMilliseconds += MillisecondsSince(updateStart);
 }
 
 void Engine::OnResize(HWND hWnd)
 {
 	RECT windowRect;
 	GetClientRect(hWnd, &windowRect);
-	m_width = windowRect.right - windowRect.left;
-	m_height = windowRect.bottom - windowRect.top;
+	const UINT width = windowRect.right - windowRect.left;
+	const UINT height = windowRect.bottom - windowRect.top;
+
+	// A minimized window has an empty client area. Keep the current buffers and
+	// skip frames until it is restored.
+	m_minimized = width == 0 || height == 0;
+	if (m_minimized || (width == m_width && height == m_height))
+	{
+		return;
+	}
+
+	m_width = width;
+	m_height = height;
 	m_aspectRatio = static_cast<float>(m_width) / static_cast<float>(m_height);
+	m_viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(m_width), static_cast<float>(m_height));
+	m_scissorRect = CD3DX12_RECT(0, 0, static_cast<LONG>(m_width), static_cast<LONG>(m_height));
+
+	if (!m_swapChain)
+	{
+		return;
+	}
+
+	// The back buffers, and the transient depth buffer sized from m_width and
+	// m_height, must follow the client area. Nothing may reference the old back
+	// buffers when they are resized.
+	WaitForGpu();
+	for (UINT n = 0; n < BackBufferCount; n++)
+	{
+		m_renderTargets[n].Reset();
+	}
+
+	DXGI_SWAP_CHAIN_DESC1 swapChainDesc;
+	ThrowIfFailed(m_swapChain->GetDesc1(&swapChainDesc));
+	ThrowIfFailed(m_swapChain->ResizeBuffers(BackBufferCount, m_width, m_height, swapChainDesc.Format, swapChainDesc.Flags));
+	m_backBufferIndex = m_swapChain->GetCurrentBackBufferIndex();
+	CreateRenderTargetViews();
 }
 
-void Engine::OnKeyDown(UINT8 key)
+void Engine::CreateRenderTargetViews()
 {
+	CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart());
+	for (UINT n = 0; n < BackBufferCount; n++)
+	{
+		ThrowIfFailed(m_swapChain->GetBuffer(n, IID_PPV_ARGS(&m_renderTargets[n])));
+		m_device->CreateRenderTargetView(m_renderTargets[n].Get(), nullptr, rtvHandle);
+		rtvHandle.Offset(1, m_rtvDescriptorSize);
+	}
+}
 
+void Engine::OnKeyDown(UINT8 key)
+{
+	if (key == 'G')
+	{
+		m_gpuCulling = !m_gpuCulling;
+	}
+	else if (key == 'B')
+	{
+		CreateBenchmarkScene();
+	}
+	else if (key == 'L')
+	{
+		m_lodEnabled = !m_lodEnabled;
+	}
+	else if (key == 'O')
+	{
+		m_occlusionCulling = !m_occlusionCulling;
+	}
+	else if (key == 'M')
+	{
+		m_meshletCulling = !m_meshletCulling;
+	}
 }
 
 void Engine::OnKeyUp(UINT8 key)
@@ -594,16 +1111,49 @@ void Engine::OnMouseButtonUp(EMouseButton button)
 // Render the scene.
 void Engine::OnRender()
 {
+	if (m_minimized)
+	{
+		return;
+	}
+
+	// Pick up recompiled shaders before anything is recorded with the current pipeline state.
+	ApplyShaderReloads();
+
 	// Record all the commands we need to render the scene into the command list.
+	LARGE_INTEGER recordStart;
+	QueryPerformanceCounter(&recordStart);
 	PopulateCommandList();
+	m_statsRecordMilliseconds += MillisecondsSince(recordStart);
+
+	// Anything uploaded since the last frame is submitted now; the GPU waits for it, the CPU does not.
+	m_copyUploader->QueueWait(m_commandQueue.Get());
 
-	// Execute the command list.
-	ID3D12CommandList* ppCommandLists[] = { m_commandList.Get() };
-	m_commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+	// Execute the command lists in recording order with a single submission.
+	ID3D12CommandList* ppCommandLists[MaxRecordingJobs + 2];
+	UINT commandListCount = 0;
+	ppCommandLists[commandListCount++] = m_commandList.Get();
+	for (UINT i = 0; i < m_drawChunks.GetChunkCount(); i++)
+	{
+		ppCommandLists[commandListCount++] = m_workerCommandLists[i].Get();
+	}
+	ppCommandLists[commandListCount++] = m_endCommandList.Get();
+	m_commandQueue->ExecuteCommandLists(commandListCount, ppCommandLists);
 
 	// Present the frame.
 	ThrowIfFailed(m_swapChain->Present(1, 0));
 
+	if (m_shaderReloadSaveTime != 0)
+	{
+		// FILETIME ticks are 100 ns.
+		const double turnaroundMilliseconds = static_cast<double>(ShaderHotReloader::GetCurrentFileTime() - m_shaderReloadSaveTime) / 10000.0;
+
+		char message[256];
+		sprintf_s(message, "ShaderHotReloader: save to present %.1f ms (compile %.1f ms)\n", turnaroundMilliseconds, m_shaderReloadCompileMilliseconds);
+		OutputDebugStringA(message);
+		m_shaderReloadSaveTime = 0;
+	}
+
+	ReportFrameStats();
 	MoveToNextFrame();
 }
 
@@ -613,77 +1163,648 @@ void Engine::OnDestroy()
    // cleaned up by the destructor.
 	WaitForGpu();
 
+	m_pipelineStateCache->Save();
+
 	CloseHandle(m_fenceEvent);
 }
 
 void Engine::PopulateCommandList()
 {
-	ThrowIfFailed(m_commandAllocators[m_frameIndex]->Reset());
-	ThrowIfFailed(m_commandList->Reset(m_commandAllocators[m_frameIndex].Get(), m_pipelineState.Get()));
-	m_commandList->SetGraphicsRootSignature(m_rootSignature.Get());
+	// Describe the frame. Barriers are derived from the declared accesses.
+	m_renderGraph.Reset();
+
+	const RenderGraphResource backBuffer = m_renderGraph.ImportResource("BackBuffer", ERenderGraphState::Present, ERenderGraphState::Present);
+	m_renderGraphBackend.SetResource(backBuffer, m_renderTargets[m_backBufferIndex].Get());
+
+	// The depth buffer only lives within the frame, so the graph may alias its memory with other transients.
+	D3D12_CLEAR_VALUE depthOptimizedClearValue = {};
+	depthOptimizedClearValue.Format = DXGI_FORMAT_D32_FLOAT;
+	depthOptimizedClearValue.DepthStencil.Depth = 1.0f;
+	depthOptimizedClearValue.DepthStencil.Stencil = 0;
+
+	const RenderGraphResource depthBuffer = m_renderGraphBackend.CreateTransientResource(m_renderGraph, "DepthBuffer",
+		CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_D32_FLOAT, m_width, m_height, 1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL),
+		&depthOptimizedClearValue);
+
+	// With GPU culling the draws come from the cull pass: reset the count, cull, then draw indirectly.
+	RenderGraphResource drawCommands = InvalidRenderGraphResource;
+	RenderGraphResource drawCount = InvalidRenderGraphResource;
+	if (m_gpuCullingActive)
+	{
+		drawCommands = m_renderGraph.ImportResource("DrawCommands", ERenderGraphState::IndirectArgument, ERenderGraphState::IndirectArgument);
+		m_renderGraphBackend.SetResource(drawCommands, m_drawCommandBuffer.Get());
+		drawCount = m_renderGraph.ImportResource("DrawCount", ERenderGraphState::IndirectArgument, ERenderGraphState::IndirectArgument);
+		m_renderGraphBackend.SetResource(drawCount, m_drawCountBuffer.Get());
+
+		m_renderGraph.AddPass("ResetDrawCount",
+			[&](RenderGraphBuilder& builder)
+			{
+				builder.Write(drawCount, ERenderGraphState::CopyDest);
+			},
+			[this]
+			{
+				const UploadAllocator::Allocation zero = m_uploadAllocator->Allocate(sizeof(UINT32), sizeof(UINT32));
+				*static_cast<UINT32*>(zero.pCpuAddress) = 0;
+				m_renderGraphBackend.GetCommandList()->CopyBufferRegion(m_drawCountBuffer.Get(), 0, zero.pResource, zero.offset, sizeof(UINT32));
+			});
+
+		m_renderGraph.AddPass("Cull",
+			[&](RenderGraphBuilder& builder)
+			{
+				builder.Write(drawCommands, ERenderGraphState::UnorderedAccess);
+				builder.Write(drawCount, ERenderGraphState::UnorderedAccess);
+			},
+			[this] { RecordCullPass(); });
+	}
+
+	m_renderGraph.AddPass("Scene",
+		[&](RenderGraphBuilder& builder)
+		{
+			builder.Write(backBuffer, ERenderGraphState::RenderTarget);
+			builder.Write(depthBuffer, ERenderGraphState::DepthWrite);
+			if (drawCommands != InvalidRenderGraphResource)
+			{
+				builder.Read(drawCommands, ERenderGraphState::IndirectArgument);
+				builder.Read(drawCount, ERenderGraphState::IndirectArgument);
+			}
+		},
+		[this, depthBuffer] { RecordScenePass(depthBuffer); });
+
+	m_renderGraph.Compile();
+
+	// The allocator was reset when this frame resource was recycled in MoveToNextFrame.
+	ThrowIfFailed(m_commandList->Reset(m_pCurrentFrameResource->GetCommandAllocator(), m_pipelineState.Get()));
+	m_renderGraphBackend.SetCommandList(m_commandList.Get());
+
+	m_renderGraph.Execute(m_renderGraphBackend);
+
+	// Whatever the graph recorded last (at least the final transitions) closes the frame.
+	ThrowIfFailed(m_renderGraphBackend.GetCommandList()->Close());
+}
 
-	//ID3D12DescriptorHeap* ppHeaps[] = { m_cbvHeap.Get() };
-	//m_commandList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
+// Test every object's world bounds against the frustum and append the draws of
+// the visible ones to m_drawCommandBuffer, counting them in m_drawCountBuffer.
+void Engine::RecordCullPass()
+{
+	ID3D12GraphicsCommandList* pCommandList = m_renderGraphBackend.GetCommandList();
+	pCommandList->SetComputeRootSignature(m_cullRootSignature.Get());
+	pCommandList->SetPipelineState(m_cullPipelineState.Get());
+	pCommandList->SetComputeRoot32BitConstants(0, sizeof(GpuCullConstants) / sizeof(UINT32), &m_cullConstants, 0);
+	pCommandList->SetComputeRootShaderResourceView(1, m_cullObjects);
+	pCommandList->SetComputeRootUnorderedAccessView(2, m_drawCommandBuffer->GetGPUVirtualAddress());
+	pCommandList->SetComputeRootUnorderedAccessView(3, m_drawCountBuffer->GetGPUVirtualAddress());
+
+	// Matches numthreads in culling.hlsl.
+	const UINT threadGroupSize = 64;
+	pCommandList->Dispatch((m_cullConstants.objectCount + threadGroupSize - 1) / threadGroupSize, 1, 1);
+}
+
+// Clears and draws the scene. The draws are recorded by jobs into their own command
+// lists, so the graph continues on m_endCommandList, which is submitted after them.
+// With GPU culling a single ExecuteIndirect replaces the jobs.
+void Engine::RecordScenePass(RenderGraphResource depthBuffer)
+{
+	// DSVs are consumed when recorded, so the view is simply rewritten whenever the
+	// transient depth buffer got a new placed resource.
+	ID3D12Resource* pDepthStencil = m_renderGraphBackend.GetResource(depthBuffer);
+	if (pDepthStencil != m_pDepthStencilViewResource)
+	{
+		D3D12_DEPTH_STENCIL_VIEW_DESC depthStencilDesc = {};
+		depthStencilDesc.Format = DXGI_FORMAT_D32_FLOAT;
+		depthStencilDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
+		depthStencilDesc.Flags = D3D12_DSV_FLAG_NONE;
 
-	//m_commandList->SetGraphicsRootDescriptorTable(0, m_cbvHeap->GetGPUDescriptorHandleForHeapStart());
-	m_commandList->RSSetViewports(1, &m_viewport);
-	m_commandList->RSSetScissorRects(1, &m_scissorRect);
+		m_device->CreateDepthStencilView(pDepthStencil, &depthStencilDesc, m_dsvHeap->GetCPUDescriptorHandleForHeapStart());
+		m_pDepthStencilViewResource = pDepthStencil;
+	}
 
-	m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[m_frameIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
+	// Only split into as many chunks as are worth recording in parallel.
+	const UINT drawCount = static_cast<UINT>(m_drawItems.size());
+	m_drawChunks.Split(drawCount, MinDrawsPerJob, m_gpuCullingActive ? 0 : m_recordingJobCount);
 
-	CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), m_frameIndex, m_rtvDescriptorSize);
-	CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle(m_dsvHeap->GetCPUDescriptorHandleForHeapStart());
-	m_commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
+	JobCounter recording;
+	for (UINT i = 0; i < m_drawChunks.GetChunkCount(); i++)
+	{
+		m_jobSystem->Run(recording, [this, i] { RecordDrawChunk(i); });
+	}
 
+	// While the jobs record draws, clear on the list that opens the frame.
+	CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), m_backBufferIndex, m_rtvDescriptorSize);
 	const float clearColor[] = { 0.4f, 0.6f, 0.9f, 1.0f };
 	m_commandList->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
 	m_commandList->ClearDepthStencilView(m_dsvHeap->GetCPUDescriptorHandleForHeapStart(), D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
-	m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	m_commandList->IASetVertexBuffers(0, 1, &m_vertexBufferView);
-	m_commandList->IASetIndexBuffer(&m_indexBufferView);
-	
+	// The GPU never draws more commands than there are objects, whatever the count says.
+	if (m_gpuCullingActive)
+	{
+		m_commandList->SetPipelineState(m_pipelineState.Get());
+		SetSceneState(m_commandList.Get());
+		m_commandList->ExecuteIndirect(m_commandSignature.Get(), m_cullConstants.objectCount, m_drawCommandBuffer.Get(), 0, m_drawCountBuffer.Get(), 0);
+	}
 
-	m_commandList->SetGraphicsRootConstantBufferView(0, m_constantBuffer->GetGPUVirtualAddress());
-	m_commandList->DrawIndexedInstanced(36, 1, 0, 0, 0);
+	ThrowIfFailed(m_commandList->Close());
 
-	m_commandList->SetGraphicsRootConstantBufferView(0, m_constantBuffer->GetGPUVirtualAddress() + sizeof(SceneConstantBuffer));
-	m_commandList->DrawIndexedInstanced(36, 1, 0, 0, 0);
+	m_jobSystem->Wait(recording);
 
+	// The main allocator is free again now that m_commandList is closed.
+	ThrowIfFailed(m_endCommandList->Reset(m_pCurrentFrameResource->GetCommandAllocator(), m_pipelineState.Get()));
+	m_renderGraphBackend.SetCommandList(m_endCommandList.Get());
+}
 
-	m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[m_frameIndex].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+// Bind everything the scene draws share but the pipeline state, which lists get
+// when they are reset. Each worker list starts with default state otherwise, so
+// the full setup is repeated on every list that draws.
+void Engine::SetSceneState(ID3D12GraphicsCommandList* pCommandList)
+{
+	pCommandList->SetGraphicsRootSignature(m_rootSignature.Get());
 
-	ThrowIfFailed(m_commandList->Close());
+	ID3D12DescriptorHeap* ppHeaps[] = { m_descriptorHeap->GetHeap() };
+	pCommandList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
+	pCommandList->SetGraphicsRootDescriptorTable(1, m_descriptorHeap->GetGpuTableStart());
+
+	pCommandList->RSSetViewports(1, &m_viewport);
+	pCommandList->RSSetScissorRects(1, &m_scissorRect);
+
+	CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), m_backBufferIndex, m_rtvDescriptorSize);
+	CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle(m_dsvHeap->GetCPUDescriptorHandleForHeapStart());
+	pCommandList->OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
+
+	pCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	pCommandList->IASetVertexBuffers(0, 1, &m_vertexBufferView);
+	pCommandList->IASetIndexBuffer(&m_indexBufferView);
+}
+
+// Record one contiguous chunk of the draw list. Chunks map 1:1 to command lists
+// so submission order is preserved regardless of which worker runs the job.
+void Engine::RecordDrawChunk(UINT chunkIndex)
+{
+	ID3D12GraphicsCommandList* pCommandList = m_workerCommandLists[chunkIndex].Get();
+	ThrowIfFailed(pCommandList->Reset(m_pCurrentFrameResource->GetWorkerCommandAllocator(chunkIndex), m_pipelineState.Get()));
+	SetSceneState(pCommandList);
+	RecordDrawItems(pCommandList, m_drawItems.data(), m_drawChunks.GetFirstDraw(chunkIndex), m_drawChunks.GetLastDraw(chunkIndex), m_recordingStats[chunkIndex]);
+	ThrowIfFailed(pCommandList->Close());
 }
 
 // Wait for pending GPU work to complete.
 void Engine::WaitForGpu()
 {
-	ThrowIfFailed(m_commandQueue->Signal(m_fence.Get(), m_fenceValues[m_frameIndex]));
+	ThrowIfFailed(m_commandQueue->Signal(m_fence.Get(), m_fenceValue));
+	WaitForFenceValue(m_fenceValue);
 
-	ThrowIfFailed(m_fence->SetEventOnCompletion(m_fenceValues[m_frameIndex], m_fenceEvent));
-	WaitForSingleObjectEx(m_fenceEvent, INFINITE, FALSE);
+	m_fenceValue++;
+}
 
-	m_fenceValues[m_frameIndex]++;
+// Block the CPU until the GPU has passed the given fence value.
+void Engine::WaitForFenceValue(UINT64 fenceValue)
+{
+	if (m_fence->GetCompletedValue() < fenceValue)
+	{
+		ThrowIfFailed(m_fence->SetEventOnCompletion(fenceValue, m_fenceEvent));
+		WaitForSingleObjectEx(m_fenceEvent, INFINITE, FALSE);
+	}
 }
 
 // Prepare to render the next frame.
 void Engine::MoveToNextFrame()
 {
-	const UINT64 currentFenceValue = m_fenceValues[m_frameIndex];
-	ThrowIfFailed(m_commandQueue->Signal(m_fence.Get(), currentFenceValue));
+	// Tag the frame we just submitted so its slot is not reused before the GPU retires it.
+	m_uploadAllocator->FinishFrame(m_fenceValue);
+	ThrowIfFailed(m_commandQueue->Signal(m_fence.Get(), m_fenceValue));
+	const UINT64 slotFenceValue = m_frameRing.Advance(m_fenceValue);
+	m_fenceValue++;
+
+	// This is where the CPU stalls once it is m_frameCount frames ahead.
+	m_pCurrentFrameResource = m_frameResources[m_frameRing.GetFrameIndex()].get();
+	WaitForFenceValue(slotFenceValue);
+	m_pCurrentFrameResource->Recycle();
+	const UINT64 completedFenceValue = m_fence->GetCompletedValue();
+	m_uploadAllocator->RetirePages(completedFenceValue);
+	m_descriptorHeap->Reclaim(completedFenceValue);
+
+	m_backBufferIndex = m_swapChain->GetCurrentBackBufferIndex();
+}
+
+// Pick the LOD of each visible object: the coarsest whose geometric error,
+// scaled by the object's world scale, projects to at most maxPixelError pixels
+// at the near side of its bounding sphere. Objects in a crossfade are listed in
+// m_fadingObjects, so their old LOD can be drawn with them.
+void Engine::SelectLods(UINT visibleCount, const XMFLOAT3& eye, float pixelsPerUnit, float nearPlane)
+{
+	m_visibleLods.resize(visibleCount);
+	m_visibleLodFades.resize(visibleCount);
+	m_fadingObjects.clear();
+	if (!m_lodEnabled)
+	{
+		std::fill(m_visibleLods.begin(), m_visibleLods.end(), static_cast<UINT8>(0));
+		std::fill(m_visibleLodFades.begin(), m_visibleLodFades.end(), 1.0f);
+		return;
+	}
 
-	m_frameIndex = m_swapChain->GetCurrentBackBufferIndex();
+	m_lodStates.resize(m_scene.GetSlotCount(), LodState());
+	m_lodFrame++;
 
-	if (m_fence->GetCompletedValue() < m_fenceValues[m_frameIndex])
+	const SceneBoundsView bounds = m_scene.GetWorldBounds();
+	const SceneMatrix* pWorldMatrices = m_scene.GetWorldMatrices();
+	const UINT* pMeshes = m_scene.GetMeshes();
+	m_jobSystem->ParallelFor(visibleCount, MinObjectsPerUpdateJob, [&](UINT begin, UINT end)
 	{
-		ThrowIfFailed(m_fence->SetEventOnCompletion(m_fenceValues[m_frameIndex], m_fenceEvent));
-		WaitForSingleObjectEx(m_fenceEvent, INFINITE, FALSE);
+		for (UINT v = begin; v < end; v++)
+		{
+			const UINT i = m_visibleObjects[v];
+			const float (&m)[4][4] = pWorldMatrices[i].m;
+			const float scaleSquared = std::max(std::max(
+				m[0][0] * m[0][0] + m[0][1] * m[0][1] + m[0][2] * m[0][2],
+				m[1][0] * m[1][0] + m[1][1] * m[1][1] + m[1][2] * m[1][2]),
+				m[2][0] * m[2][0] + m[2][1] * m[2][1] + m[2][2] * m[2][2]);
+
+			const float dx = bounds.centerX[i] - eye.x;
+			const float dy = bounds.centerY[i] - eye.y;
+			const float dz = bounds.centerZ[i] - eye.z;
+			const float radius = sqrtf(bounds.extentX[i] * bounds.extentX[i] + bounds.extentY[i] * bounds.extentY[i] + bounds.extentZ[i] * bounds.extentZ[i]);
+			const float distance = std::max(sqrtf(dx * dx + dy * dy + dz * dz) - radius, nearPlane);
+
+			LodState& state = m_lodStates[m_scene.GetHandle(i).index];
+			const UINT lod = SelectLod(m_meshes[pMeshes[i]].lodChain, sqrtf(scaleSquared) * pixelsPerUnit / distance, state.lod, m_lodSettings);
+			m_visibleLodFades[v] = UpdateLodState(state, lod, m_lodFrame, m_lodSettings);
+			m_visibleLods[v] = state.lod;
+		}
+	});
+
+	for (UINT v = 0; v < visibleCount; v++)
+	{
+		if (m_visibleLodFades[v] < 1.0f)
+		{
+			m_fadingObjects.push_back(v);
+		}
+	}
+}
+
+// Draw entries below visibleCount are the visible objects at their selected LOD;
+// the others draw the LOD a crossfading object is fading out.
+void Engine::GetDrawEntry(UINT entry, UINT visibleCount, UINT& denseIndex, UINT& lod, float& lodFade) const
+{
+	if (entry < visibleCount)
+	{
+		denseIndex = m_visibleObjects[entry];
+		lod = m_visibleLods[entry];
+		lodFade = m_visibleLodFades[entry];
+	}
+	else
+	{
+		const UINT v = m_fadingObjects[entry - visibleCount];
+		denseIndex = m_visibleObjects[v];
+		lod = m_lodStates[m_scene.GetHandle(denseIndex).index].fadingLod;
+		lodFade = -m_visibleLodFades[v];
+	}
+}
+
+// Bring the BVH in line with the scene's world bounds. Objects that stayed
+// within their proxy's margin cost one containment test. A slot's proxy is
+// reused by whatever object takes the slot next; nothing destroys scene
+// objects yet, so proxies are never removed.
+void Engine::UpdateSceneBvh()
+{
+	const SceneBoundsView bounds = m_scene.GetWorldBounds();
+	const uint8_t* pWorldChanged = m_scene.GetWorldChanged();
+	m_sceneProxies.resize(m_scene.GetSlotCount(), DynamicBvh::NullProxy);
+
+	// New objects always start out changed, so only moved objects need visiting.
+	for (UINT i = 0; i < bounds.count; i++)
+	{
+		if (!pWorldChanged[i])
+		{
+			continue;
+		}
+
+		const BvhBounds box =
+		{
+			bounds.centerX[i] - bounds.extentX[i], bounds.centerY[i] - bounds.extentY[i], bounds.centerZ[i] - bounds.extentZ[i],
+			bounds.centerX[i] + bounds.extentX[i], bounds.centerY[i] + bounds.extentY[i], bounds.centerZ[i] + bounds.extentZ[i],
+		};
+
+		const UINT slot = m_scene.GetHandle(i).index;
+		if (m_sceneProxies[slot] == DynamicBvh::NullProxy)
+		{
+			m_sceneProxies[slot] = m_sceneBvh.Insert(box, slot);
+		}
+		else
+		{
+			m_sceneBvh.Move(m_sceneProxies[slot], box);
+		}
+	}
+
+	m_sceneBvh.Update();
+}
+
+// Add a grid of small spheres in two alternating materials to measure CPU costs at scale.
+// Only the first press adds them; from then on frame timings are reported.
+void Engine::CreateBenchmarkScene()
+{
+	if (m_benchmarkScene)
+	{
+		return;
+	}
+
+	const Mesh& sphere = m_meshes[SphereMesh];
+
+	const UINT side = static_cast<UINT>(ceilf(sqrtf(static_cast<float>(BenchmarkObjectCount))));
+	const float spacing = 0.4f;
+	m_scene.Reserve(m_scene.GetObjectCount() + BenchmarkObjectCount);
+	for (UINT n = 0; n < BenchmarkObjectCount; n++)
+	{
+		const float x = (static_cast<float>(n % side) - 0.5f * side) * spacing;
+		const float z = (static_cast<float>(n / side) - 0.5f * side) * spacing;
+		m_scene.Create({ { x, 0.1f, z }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.1f, 0.1f, 0.1f }, sphere.boundsCenter, sphere.boundsExtents, SphereMesh, n % 2 });
+	}
+
+	// Staggered walls across the grid, which hide the spheres behind them.
+	const Mesh& cube = m_meshes[CubeMesh];
+	for (UINT w = 0; w < BenchmarkWallCount; w++)
+	{
+		const float x = (w % 2 == 0) ? -3.0f : 3.0f;
+		const float z = 2.0f + 5.0f * w;
+		m_occluders.push_back(m_scene.Create({ { x, 0.6f, z }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 4.0f, 0.6f, 0.1f }, cube.boundsCenter, cube.boundsExtents, CubeMesh, 0 }));
 	}
 
-	m_fenceValues[m_frameIndex] = currentFenceValue + 1;
+	m_benchmarkScene = true;
+	m_statsFrameCount = 0;
+	m_statsUpdateMilliseconds = 0.0;
+	m_statsRecordMilliseconds = 0.0;
+	m_statsTriangleCount = 0;
+	m_statsOccludedCount = 0;
+	m_statsMeshletCull = {};
+	QueryPerformanceCounter(&m_statsStartTime);
 }
 
+// Print the average CPU update and recording times of the last second.
+void Engine::ReportFrameStats()
+{
+	if (!m_benchmarkScene)
+	{
+		return;
+	}
+
+	m_statsFrameCount++;
+	const double elapsedMilliseconds = MillisecondsSince(m_statsStartTime);
+	if (elapsedMilliseconds < 1000.0)
+	{
+		return;
+	}
+
+	// With GPU culling the draws are only known to the GPU.
+	char draws[64];
+	if (m_gpuCullingActive)
+	{
+		sprintf_s(draws, "GPU culled");
+	}
+	else
+	{
+		UINT instanceCount = 0;
+		for (const DrawItem& draw : m_drawItems)
+		{
+			instanceCount += draw.instanceCount;
+		}
+
+		UINT materialSets = 0;
+		for (UINT i = 0; i < m_drawChunks.GetChunkCount(); i++)
+		{
+			materialSets += m_recordingStats[i].materialSets;
+		}
+		sprintf_s(draws, "%u instances in %u draws, %u material sets", instanceCount, static_cast<UINT>(m_drawItems.size()), materialSets);
+	}
+
+	// Meshlets are only culled on the CPU path.
+	char meshlets[96];
+	if (m_meshletCulling && !m_gpuCullingActive)
+	{
+		sprintf_s(meshlets, "%.0f outside and %.0f back facing in meshlets", static_cast<double>(m_statsMeshletCull.outsideTriangleCount) / m_statsFrameCount,
+			static_cast<double>(m_statsMeshletCull.backFacingTriangleCount) / m_statsFrameCount);
+	}
+	else
+	{
+		sprintf_s(meshlets, "meshlets off");
+	}
+
+	char message[384];
+	sprintf_s(message, "Frame: %u objects, %.0f occluded, %s, %.0f triangles (LOD %s, %s), update %.2f ms, record %.2f ms, %.1f fps\n", m_scene.GetObjectCount(),
+		static_cast<double>(m_statsOccludedCount) / m_statsFrameCount, draws, static_cast<double>(m_statsTriangleCount) / m_statsFrameCount, m_lodEnabled ? "on" : "off",
+		meshlets, m_statsUpdateMilliseconds / m_statsFrameCount, m_statsRecordMilliseconds / m_statsFrameCount, m_statsFrameCount * 1000.0 / elapsedMilliseconds);
+	OutputDebugStringA(message);
+
+	m_statsFrameCount = 0;
+	m_statsUpdateMilliseconds = 0.0;
+	m_statsRecordMilliseconds = 0.0;
+	m_statsTriangleCount = 0;
+	m_statsOccludedCount = 0;
+	m_statsMeshletCull = {};
+	QueryPerformanceCounter(&m_statsStartTime);
+}
+
+// Describe and create the graphics pipeline state object (PSO) for the current
+// shaders. Returns false, keeping the current one, if the device rejects it.
+bool Engine::CreatePipelineState()
+{
+	// Define the vertex input layout, that of PackedVertex.
+	D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+	};
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
+	psoDesc.InputLayout = { inputElementDescs, _countof(inputElementDescs) };
+	psoDesc.pRootSignature = m_rootSignature.Get();
+	psoDesc.VS = m_vertexShader;
+	psoDesc.PS = m_pixelShader;
+	psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+	psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+	psoDesc.DepthStencilState.DepthEnable = TRUE;
+	psoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
+	psoDesc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL;
+	psoDesc.DepthStencilState.StencilEnable = FALSE;
+	psoDesc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
+	psoDesc.SampleMask = UINT_MAX;
+	psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+	psoDesc.NumRenderTargets = 1;
+	psoDesc.RTVFormats[0] = DXGI_FORMAT_R16G16B16A16_FLOAT;
+	psoDesc.SampleDesc.Count = 1;
+	ID3D12PipelineState* pPipelineState = m_pipelineStateCache->GetGraphicsPipelineState(psoDesc);
+	if (pPipelineState == nullptr)
+	{
+		return false;
+	}
+	m_pipelineState = pPipelineState;
+	return true;
+}
+
+// Describe and create the compute pipeline state of the cull pass.
+bool Engine::CreateCullPipelineState()
+{
+	D3D12_COMPUTE_PIPELINE_STATE_DESC psoDesc = {};
+	psoDesc.pRootSignature = m_cullRootSignature.Get();
+	psoDesc.CS = m_cullShader;
+	ID3D12PipelineState* pPipelineState = m_pipelineStateCache->GetComputePipelineState(psoDesc);
+	if (pPipelineState == nullptr)
+	{
+		return false;
+	}
+	m_cullPipelineState = pPipelineState;
+	return true;
+}
+
+// Swap in shaders the hot reloader recompiled since the last frame. Only the
+// pipeline state changes; the GPU keeps using the previous one for frames in
+// flight, which the pipeline state cache keeps alive, so nothing waits. If the
+// device rejects the new pipeline state, the shaders and the state stay as they were.
+void Engine::ApplyShaderReloads()
+{
+	std::vector<ShaderHotReloader::Result> results;
+	if (!m_shaderHotReloader || !m_shaderHotReloader->TakeResults(results))
+	{
+		return;
+	}
+
+	const D3D12_SHADER_BYTECODE previousVertexShader = m_vertexShader;
+	const D3D12_SHADER_BYTECODE previousPixelShader = m_pixelShader;
+	const D3D12_SHADER_BYTECODE previousCullShader = m_cullShader;
+	const ComPtr<ID3DBlob> previousReloadedVertexShader = m_reloadedVertexShader;
+	const ComPtr<ID3DBlob> previousReloadedPixelShader = m_reloadedPixelShader;
+	const ComPtr<ID3DBlob> previousReloadedCullShader = m_reloadedCullShader;
+
+	ULONGLONG saveTime = 0;
+	double compileMilliseconds = 0.0;
+	bool graphicsChanged = false;
+	bool cullChanged = false;
+	for (const ShaderHotReloader::Result& result : results)
+	{
+		if (result.shaderId == m_vertexShaderReloadId)
+		{
+			m_reloadedVertexShader = result.bytecode;
+			m_vertexShader = CD3DX12_SHADER_BYTECODE(m_reloadedVertexShader.Get());
+			graphicsChanged = true;
+		}
+		else if (result.shaderId == m_pixelShaderReloadId)
+		{
+			m_reloadedPixelShader = result.bytecode;
+			m_pixelShader = CD3DX12_SHADER_BYTECODE(m_reloadedPixelShader.Get());
+			graphicsChanged = true;
+		}
+		else if (result.shaderId == m_cullShaderReloadId)
+		{
+			m_reloadedCullShader = result.bytecode;
+			m_cullShader = CD3DX12_SHADER_BYTECODE(m_reloadedCullShader.Get());
+			cullChanged = true;
+		}
+		saveTime = std::max(saveTime, result.saveTime);
+		compileMilliseconds += result.compileMilliseconds;
+	}
+
+	if (graphicsChanged && !CreatePipelineState())
+	{
+		OutputDebugStringA("ShaderHotReloader: pipeline state rejected, keeping the previous shaders\n");
+		m_vertexShader = previousVertexShader;
+		m_pixelShader = previousPixelShader;
+		m_reloadedVertexShader = previousReloadedVertexShader;
+		m_reloadedPixelShader = previousReloadedPixelShader;
+	}
+	if (cullChanged && !CreateCullPipelineState())
+	{
+		OutputDebugStringA("ShaderHotReloader: cull pipeline state rejected, keeping the previous shader\n");
+		m_cullShader = previousCullShader;
+		m_reloadedCullShader = previousReloadedCullShader;
+	}
+
+	m_shaderReloadSaveTime = saveTime;
+	m_shaderReloadCompileMilliseconds = compileMilliseconds;
+}
+
+// Release an object once the GPU has finished the frame currently being recorded.
+void Engine::DeferRelease(IUnknown* pObject)
+{
+	m_pCurrentFrameResource->DeferRelease(pObject);
+}
+
+// Bytecode from the offline bundle when the source still matches what was built,
+// otherwise compiled now.
+D3D12_SHADER_BYTECODE Engine::LoadShader(LPCWSTR sourceName, const D3D_SHADER_MACRO* pDefines, const char* entryPoint, const char* target)
+{
+	const std::wstring sourcePath = GetAssetFullPath(sourceName);
+
+	D3D12_SHADER_BYTECODE bytecode = {};
+	if (m_shaderBundle.Find(ShaderBundle::ComputeKey(sourcePath, pDefines, entryPoint, target), &bytecode))
+	{
+		return bytecode;
+	}
+
+	char message[256];
+	sprintf_s(message, "ShaderBundle: %s (%s) not in bundle, compiling at runtime\n", entryPoint, target);
+	OutputDebugStringA(message);
+
+	ComPtr<ID3DBlob> blob = CompileShader(sourcePath, pDefines, entryPoint, target);
+	m_compiledShaders.push_back(blob);
+	return CD3DX12_SHADER_BYTECODE(blob.Get());
+}
+
+static void OutputMessage(const char* message)
+{
+	OutputDebugStringA(message);
+	fputs(message, stdout);
+}
+
+// Import the OBJ and glTF files in the Meshes directory next to the executable into
+// meshes.mesh, which LoadAssets then maps. Nothing is imported while it is up to date.
+// Messages go to the debugger and to stdout, which "-import" attaches to its console.
+bool Engine::CookMeshSources()
+{
+	std::vector<std::wstring> sourcePaths;
+	WIN32_FIND_DATAW findData;
+	const HANDLE find = FindFirstFileW(GetAssetFullPath(L"Meshes\\*").c_str(), &findData);
+	if (find != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			const wchar_t* pExtension = wcsrchr(findData.cFileName, L'.');
+			if (pExtension && (_wcsicmp(pExtension, L".obj") == 0 || _wcsicmp(pExtension, L".gltf") == 0 || _wcsicmp(pExtension, L".glb") == 0))
+			{
+				sourcePaths.push_back(GetAssetFullPath(L"Meshes\\") + findData.cFileName);
+			}
+		} while (FindNextFileW(find, &findData));
+		FindClose(find);
+	}
+	if (sourcePaths.empty())
+	{
+		return true;
+	}
+
+	// Sorted, so that the mesh order and the cache key do not depend on the file system.
+	std::sort(sourcePaths.begin(), sourcePaths.end());
+
+	MeshImporter importer(m_jobSystem.get());
+	char message[512];
+	const bool cooked = importer.Cook(sourcePaths, GetAssetFullPath(L"meshes.mesh"));
+	if (cooked)
+	{
+		const MeshImporter::Stats& stats = importer.GetStats();
+		sprintf_s(message, "MeshImporter: %u meshes, %u vertices, %llu triangles in %u meshlets %s in %.1f ms\n", stats.meshCount, stats.vertexCount,
+			stats.triangleCount, stats.meshletCount, stats.cacheHit ? "already cooked" : "cooked", stats.seconds * 1000.0);
+		if (!stats.cacheHit)
+		{
+			OutputMessage(message);
+			sprintf_s(message, "MeshImporter: %.2f million triangles/s on %u workers\n", stats.triangleCount / stats.seconds * 1e-6, m_jobSystem->GetWorkerCount());
+			OutputMessage(message);
+			sprintf_s(message, "MeshImporter: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f in a %u-entry FIFO cache\n", stats.cacheBefore.acmr, stats.cacheAfter.acmr,
+				stats.cacheBefore.atvr, stats.cacheAfter.atvr, VertexCacheSize);
+		}
+	}
+	else
+	{
+		sprintf_s(message, "MeshImporter: %s\n", importer.GetError().c_str());
+	}
+	OutputMessage(message);
+	return cooked;
+}
 
 std::wstring Engine::GetAssetFullPath(LPCWSTR assetName)
 {
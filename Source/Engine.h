@@ -1,5 +1,29 @@
 #pragma once
 
+#include "FrameResource.h"
+#include "FrameRing.h"
+#include "UploadAllocator.h"
+#include "CopyUploader.h"
+#include "BindlessDescriptorHeap.h"
+#include "PipelineStateCache.h"
+#include "ShaderBundle.h"
+#include "ShaderHotReloader.h"
+#include "JobSystem.h"
+#include "DrawChunking.h"
+#include "SceneStore.h"
+#include "FrustumCulling.h"
+#include "DynamicBvh.h"
+#include "GpuCulling.h"
+#include "RadixSort.h"
+#include "LodSelection.h"
+#include "MeshFile.h"
+#include "MeshImporter.h"
+#include "MeshOptimizer.h"
+#include "Meshlets.h"
+#include "VertexPacking.h"
+#include "OcclusionCulling.h"
+#include "D3D12RenderGraphBackend.h"
+
 using namespace DirectX;
 
 using Microsoft::WRL::ComPtr;
@@ -16,7 +40,9 @@ enum class EMouseButton
 class Engine
 {
 public:
-    Engine(UINT width, UINT height);
+    static const UINT MaxFrameCount = 4;
+
+    Engine(UINT width, UINT height, UINT frameCount = 2);
 
     void OnInit();
     void OnResize(HWND hWnd);
@@ -40,15 +66,43 @@ public:
 
     std::wstring GetAssetFullPath(LPCWSTR assetName);
 
+    // Needs no window or device, so that "-import" can cook and exit.
+    bool CookMeshSources();
+
 private:
-    static const UINT FrameCount = 2;
+    static const UINT BackBufferCount = 2;
+
+    // Draw recording is split into contiguous chunks, each recorded by a job into its own command list.
+    static const UINT MaxRecordingJobs = 8;
+    static const UINT MinDrawsPerJob = 64;
+
+    // Scene transforms are updated in parallel in ranges of at least this many objects.
+    static const UINT MinObjectsPerUpdateJob = 4096;
+
+    // Below this many objects the linear SIMD culling pass beats walking the BVH.
+    static const UINT MinObjectsForBvhCulling = 65536;
+
+    // Capacity of the GPU culling buffers. Larger scenes are culled and drawn by the CPU instead.
+    static const UINT MaxGpuDrawCommands = 65536;
+
+    // Spheres added by the benchmark scene (B).
+    static const UINT BenchmarkObjectCount = 100000;
+    static const UINT BenchmarkWallCount = 8;
+
+    // Meshes created by LoadAssets, by index into m_meshes. Those loaded from
+    // meshes.mesh, if any, follow the built-in ones.
+    static const UINT CubeMesh = 0;
+    static const UINT SphereMesh = 1;
+    static const UINT BuiltInMeshCount = 2;
 
     UINT m_width;
     UINT m_height;
+    bool m_minimized;                           // Client area is empty; no frames are rendered.
     float m_aspectRatio;
 
     std::wstring m_assetsPath;
 
+    // As built and cooked, and as occluders read them; the GPU gets PackedVertex.
     struct Vertex
     {
         XMFLOAT3 position;
@@ -57,50 +111,231 @@ private:
         XMFLOAT4 color;
     };
 
-    struct SceneConstantBuffer
+    struct MaterialConstantBuffer
     {
-        XMFLOAT4X4 mWorldViewProj;
-        XMFLOAT4X4 mWorld;
         XMFLOAT4 materialColor;
         XMFLOAT3 cameraPos;
-        float padding01;
+        UINT textureIndex;      // Slot of the albedo texture in the bindless heap.
+
+        float padding[56];
+    };
+
+    // Element of the per-draw instance buffer the vertex shader indexes with SV_InstanceID.
+    struct InstanceData
+    {
+        XMFLOAT4X4 mWorldViewProj;
+        XMFLOAT4X4 mWorld;
+        XMFLOAT3 positionScale; // The mesh's PositionQuantization, which decodes its packed positions.
+        float lodFade;          // Share of pixels drawn during a LOD crossfade; negative for the LOD fading out.
+        XMFLOAT3 positionOffset;
+        float padding;
+    };
 
-        float padding[24];
+    // Draw sort key, most significant field first: pass (4 bits), pipeline state (12),
+    // material (16), mesh (16), depth bucket (16). Sorting by it groups draws that
+    // need the same state, and objects that share everything above the depth
+    // bucket are instanced together, front to back.
+    enum class EDrawPass : UINT
+    {
+        Opaque,
+    };
+
+    static const UINT DrawSortKeyDepthBits = 16;
+
+    static UINT64 MakeDrawSortKey(EDrawPass pass, UINT pipelineState, UINT material, UINT mesh, UINT depthBucket)
+    {
+        return (static_cast<UINT64>(pass) << 60) | (static_cast<UINT64>(pipelineState & 0xfff) << 48) |
+            (static_cast<UINT64>(material & 0xffff) << 32) | (static_cast<UINT64>(mesh & 0xffff) << 16) | (depthBucket & 0xffff);
+    }
+
+    // Instances of one mesh with one material, drawn with a single call.
+    // Range of the shared vertex and index buffers, split into m_meshlets[firstMeshlet, firstMeshlet + meshletCount).
+    struct MeshLod
+    {
+        UINT indexCount;
+        UINT startIndex;
+        INT baseVertex;
+        UINT firstMeshlet;
+        UINT meshletCount;      // 0 if the LOD is only drawn whole.
+    };
+
+    // Referenced by scene objects. Draw keys identify a mesh's LODs as mesh * MaxLodCount + lod.
+    struct Mesh
+    {
+        MeshLod lods[MaxLodCount];      // Finest first.
+        LodChain lodChain;
+        SceneFloat3 boundsCenter;
+        SceneFloat3 boundsExtents;
+        PositionQuantization positionQuantization;     // Of its packed vertices, derived from its bounds.
+    };
+
+    struct Material
+    {
+        XMFLOAT4 color;
+        UINT textureIndex;
     };
 
     CD3DX12_VIEWPORT m_viewport;
     CD3DX12_RECT m_scissorRect;
     ComPtr<IDXGISwapChain3> m_swapChain;
     ComPtr<ID3D12Device> m_device;
-    ComPtr<ID3D12Resource> m_renderTargets[FrameCount];
-    ComPtr<ID3D12Resource> m_depthStencil;
-    ComPtr<ID3D12CommandAllocator> m_commandAllocators[FrameCount];
+    ComPtr<ID3D12Resource> m_renderTargets[BackBufferCount];
     ComPtr<ID3D12CommandQueue> m_commandQueue;
     ComPtr<ID3D12RootSignature> m_rootSignature;
     ComPtr<ID3D12DescriptorHeap> m_rtvHeap;
     ComPtr<ID3D12DescriptorHeap> m_dsvHeap;
-    ComPtr<ID3D12DescriptorHeap> m_cbvHeap;
     ComPtr<ID3D12PipelineState> m_pipelineState;
+    std::unique_ptr<PipelineStateCache> m_pipelineStateCache;
+
+    // GPU culling: a compute pass compacts the visible objects' draws into
+    // m_drawCommandBuffer and the scene pass issues them with one ExecuteIndirect.
+    ComPtr<ID3D12RootSignature> m_cullRootSignature;
+    ComPtr<ID3D12PipelineState> m_cullPipelineState;
+    ComPtr<ID3D12CommandSignature> m_commandSignature;
+    ComPtr<ID3D12Resource> m_drawCommandBuffer;
+    ComPtr<ID3D12Resource> m_drawCountBuffer;
+    GpuCullConstants m_cullConstants;
+    D3D12_GPU_VIRTUAL_ADDRESS m_cullObjects;    // This frame's GpuCullObject array in upload memory.
+    bool m_gpuCulling;                          // Toggled with G.
+    bool m_gpuCullingActive;                    // Whether this frame is culled on the GPU.
+
+    // Precompiled bytecode; shaders missing from it are compiled at startup and kept alive here.
+    ShaderBundle m_shaderBundle;
+    std::vector<ComPtr<ID3DBlob>> m_compiledShaders;
+    D3D12_SHADER_BYTECODE m_vertexShader;
+    D3D12_SHADER_BYTECODE m_pixelShader;
+    D3D12_SHADER_BYTECODE m_cullShader;
+
+    // Edits to the shader sources are recompiled in the background and swapped in between frames.
+    // While it runs, the shaders are compiled at startup too, with the same compiler.
+    std::unique_ptr<ShaderHotReloader> m_shaderHotReloader;
+    UINT m_vertexShaderReloadId;
+    UINT m_pixelShaderReloadId;
+    UINT m_cullShaderReloadId;
+    ComPtr<ID3DBlob> m_reloadedVertexShader;
+    ComPtr<ID3DBlob> m_reloadedPixelShader;
+    ComPtr<ID3DBlob> m_reloadedCullShader;
+    ULONGLONG m_shaderReloadSaveTime;   // Non-zero while a reload waits for its first present.
+    double m_shaderReloadCompileMilliseconds;
     ComPtr<ID3D12GraphicsCommandList> m_commandList;
+    ComPtr<ID3D12GraphicsCommandList> m_endCommandList;
+
+    RenderGraph m_renderGraph;
+    D3D12RenderGraphBackend m_renderGraphBackend;
+    ID3D12Resource* m_pDepthStencilViewResource;   // Transient depth buffer the DSV currently describes.
     UINT m_rtvDescriptorSize;
 
     ComPtr<ID3D12Resource> m_vertexBuffer;
     D3D12_VERTEX_BUFFER_VIEW m_vertexBufferView;
     ComPtr<ID3D12Resource> m_indexBuffer;
     D3D12_INDEX_BUFFER_VIEW m_indexBufferView;
-    ComPtr<ID3D12Resource> m_constantBuffer;
-    SceneConstantBuffer m_constantBufferData;
-    UINT8* m_pCbvDataBegin;
 
-    UINT m_frameIndex;
+    // Per-draw constants are sub-allocated from fence-retired upload pages every frame.
+    std::unique_ptr<UploadAllocator> m_uploadAllocator;
+
+    // Static geometry is copied into default heap buffers on the copy queue.
+    std::unique_ptr<CopyUploader> m_copyUploader;
+
+    // Every shader resource lives in one shader-visible heap, indexed from the shaders.
+    std::unique_ptr<BindlessDescriptorHeap> m_descriptorHeap;
+    ComPtr<ID3D12Resource> m_whiteTexture;
+    ComPtr<ID3D12Resource> m_checkerTexture;
+    BindlessHandle m_whiteTextureHandle;
+    BindlessHandle m_checkerTextureHandle;
+    std::vector<DrawItem> m_drawItems;
+    std::vector<UINT64> m_drawKeys;     // Sort key per draw entry.
+    std::vector<UINT> m_drawObjects;    // Draw entry per key, sorted along with m_drawKeys.
+    RadixSorter m_drawSorter;
+    std::vector<DrawRun> m_drawRuns;    // Runs of m_drawKeys, one instanced draw each.
+    std::vector<D3D12_GPU_VIRTUAL_ADDRESS> m_materialConstants;     // This frame's constants per material.
+
+    SceneStore m_scene;
+    std::vector<Mesh> m_meshes;
+    std::vector<Material> m_materials;
+    SceneObjectHandle m_cubeObject;
+    std::vector<UINT> m_visibleObjects;     // Dense scene indices that passed culling this frame.
+
+    // Level of detail, selected per visible object from its projected geometric
+    // error. Every visible object is one draw entry; objects in a crossfade get a
+    // second entry, visibleCount + n for the n-th one in m_fadingObjects, for the
+    // LOD fading out.
+    bool m_lodEnabled;                      // Toggled with L.
+    LodSettings m_lodSettings;
+    UINT m_lodFrame;
+    std::vector<LodState> m_lodStates;      // Per handle slot.
+    std::vector<UINT8> m_visibleLods;       // Per visible object.
+    std::vector<float> m_visibleLodFades;
+    std::vector<UINT> m_fadingObjects;      // Visible indices of objects in a crossfade.
+
+    // Meshlet culling: on the CPU path, the meshlets of an object's LOD that are
+    // outside the frustum or face away from the eye are skipped, and the rest are
+    // drawn as one non-instanced draw per run of consecutive meshlets. Off by
+    // default: it splits instanced draws, which costs more than it saves on
+    // small or distant objects.
+    bool m_meshletCulling;                  // Toggled with M.
+    std::vector<Meshlet> m_meshlets;        // Of every mesh LOD, startIndex relative to the LOD's.
+    std::vector<MeshletIndexRange> m_meshletRanges;     // Cull scratch.
+
+    // CPU occlusion culling: the occluders' finest LODs are rasterized into
+    // m_occlusionBuffer from CPU copies of the built-in geometry, and objects
+    // hidden behind them are dropped after frustum culling. GPU culling skips it.
+    bool m_occlusionCulling;                // Toggled with O.
+    OcclusionBuffer m_occlusionBuffer;
+    std::vector<SceneObjectHandle> m_occluders;
+    std::vector<Vertex> m_vertices;
+    std::vector<WORD> m_indices;
+
+    // CPU frame timings, reported once a second while the benchmark scene is loaded.
+    bool m_benchmarkScene;
+    UINT m_statsFrameCount;
+    LARGE_INTEGER m_statsStartTime;
+    double m_statsUpdateMilliseconds;
+    double m_statsRecordMilliseconds;
+    UINT64 m_statsTriangleCount;        // Submitted to the cull pass when culling on the GPU.
+    UINT64 m_statsOccludedCount;
+    MeshletCullStats m_statsMeshletCull;
+
+    // Spatial index over the scene's world bounds, one proxy per object keyed by handle slot.
+    DynamicBvh m_sceneBvh;
+    std::vector<UINT> m_sceneProxies;
+
+    // Ring of per-frame resources, sized at startup independently of BackBufferCount.
+    UINT m_frameCount;
+    FrameRing m_frameRing;
+    UINT m_backBufferIndex;
+    std::vector<std::unique_ptr<FrameResource>> m_frameResources;
+    FrameResource* m_pCurrentFrameResource;
+
+    std::unique_ptr<JobSystem> m_jobSystem;
+    UINT m_recordingJobCount;
+    DrawChunking m_drawChunks;
+    ComPtr<ID3D12GraphicsCommandList> m_workerCommandLists[MaxRecordingJobs];
+    DrawRecordingStats m_recordingStats[MaxRecordingJobs];
+
     HANDLE m_fenceEvent;
     ComPtr<ID3D12Fence> m_fence;
-    UINT64 m_fenceValues[FrameCount];
+    UINT64 m_fenceValue;
 
     void LoadPipeline();
+    void CreateRenderTargetViews();
     void LoadAssets();
+    bool CreatePipelineState();
+    bool CreateCullPipelineState();
+    void ApplyShaderReloads();
+    void UpdateSceneBvh();
+    void SelectLods(UINT visibleCount, const XMFLOAT3& eye, float pixelsPerUnit, float nearPlane);
+    void GetDrawEntry(UINT entry, UINT visibleCount, UINT& denseIndex, UINT& lod, float& lodFade) const;
+    void CreateBenchmarkScene();
+    void ReportFrameStats();
     void PopulateCommandList();
+    void RecordCullPass();
+    void RecordScenePass(RenderGraphResource depthBuffer);
+    void SetSceneState(ID3D12GraphicsCommandList* pCommandList);
+    void RecordDrawChunk(UINT chunkIndex);
     void MoveToNextFrame();
     void WaitForGpu();
+    void WaitForFenceValue(UINT64 fenceValue);
+    void DeferRelease(IUnknown* pObject);
+    D3D12_SHADER_BYTECODE LoadShader(LPCWSTR sourceName, const D3D_SHADER_MACRO* pDefines, const char* entryPoint, const char* target);
     void GetHardwareAdapter(_In_ IDXGIFactory2* pFactory, _Outptr_result_maybenull_ IDXGIAdapter1** ppAdapter);
 };
\ No newline at end of file
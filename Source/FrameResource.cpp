@@ -0,0 +1,35 @@
+#include "stdafx.h"
+#include "FrameResource.h"
+#include "DXHelper.h"
+
+FrameResource::FrameResource(ID3D12Device* pDevice, UINT workerCount)
+{
+	ThrowIfFailed(pDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_commandAllocator)));
+
+	// Allocators are not free-threaded, so every recording job gets its own.
+	m_workerCommandAllocators.resize(workerCount);
+	for (UINT i = 0; i < workerCount; i++)
+	{
+		ThrowIfFailed(pDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_workerCommandAllocators[i])));
+	}
+}
+
+void FrameResource::Recycle()
+{
+	// The GPU is done with everything that was queued for release on this slot.
+	m_deferredReleases.clear();
+
+	ThrowIfFailed(m_commandAllocator->Reset());
+	for (auto& allocator : m_workerCommandAllocators)
+	{
+		ThrowIfFailed(allocator->Reset());
+	}
+}
+
+void FrameResource::DeferRelease(IUnknown* pObject)
+{
+	if (pObject)
+	{
+		m_deferredReleases.emplace_back(pObject);
+	}
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+using Microsoft::WRL::ComPtr;
+
+// Per-frame state for one frame in flight. The engine keeps a ring of
+// these whose depth is independent of the swap chain buffer count; FrameRing
+// decides when a slot may be touched again.
+class FrameResource
+{
+public:
+    FrameResource(ID3D12Device* pDevice, UINT workerCount);
+
+    // Called once the slot's fence has retired, before recording into it again.
+    void Recycle();
+
+    // Keeps a resource alive until the GPU has finished with this frame.
+    void DeferRelease(IUnknown* pObject);
+
+    ID3D12CommandAllocator* GetCommandAllocator() const { return m_commandAllocator.Get(); }
+    ID3D12CommandAllocator* GetWorkerCommandAllocator(UINT workerIndex) const { return m_workerCommandAllocators[workerIndex].Get(); }
+
+private:
+    ComPtr<ID3D12CommandAllocator> m_commandAllocator;
+    std::vector<ComPtr<ID3D12CommandAllocator>> m_workerCommandAllocators;
+
+    std::vector<ComPtr<IUnknown>> m_deferredReleases;
+};
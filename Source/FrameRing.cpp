@@ -0,0 +1,17 @@
+#include "FrameRing.h"
+
+#include <cassert>
+
+FrameRing::FrameRing(uint32_t frameCount) :
+	m_fenceValues(frameCount, 0),
+	m_frameIndex(0)
+{
+	assert(frameCount > 0);
+}
+
+uint64_t FrameRing::Advance(uint64_t submittedFenceValue)
+{
+	m_fenceValues[m_frameIndex] = submittedFenceValue;
+	m_frameIndex = (m_frameIndex + 1) % static_cast<uint32_t>(m_fenceValues.size());
+	return m_fenceValues[m_frameIndex];
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Slot bookkeeping of the ring of per-frame resources, kept apart from the
+// device so that it can be driven by a simulated fence. Each slot remembers the
+// fence value of the last frame recorded into it, and the CPU may only record
+// into a slot again once the GPU has passed that value.
+class FrameRing
+{
+public:
+    explicit FrameRing(uint32_t frameCount);
+
+    uint32_t GetFrameCount() const { return static_cast<uint32_t>(m_fenceValues.size()); }
+    uint32_t GetFrameIndex() const { return m_frameIndex; }
+    uint64_t GetFenceValue(uint32_t frameIndex) const { return m_fenceValues[frameIndex]; }
+
+    // Tags the current slot with the fence value its frame was submitted with and
+    // moves on to the next slot. Returns the fence value the GPU must reach before
+    // the next slot is recorded into, 0 if it was never used.
+    uint64_t Advance(uint64_t submittedFenceValue);
+
+private:
+    std::vector<uint64_t> m_fenceValues;
+    uint32_t m_frameIndex;
+};
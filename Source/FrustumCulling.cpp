@@ -0,0 +1,316 @@
+#include "FrustumCulling.h"
+
+#include <cmath>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define FRUSTUM_CULLING_X64 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define FRUSTUM_CULLING_AVX2_FUNCTION
+#else
+#define FRUSTUM_CULLING_AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+	// Signed distance of the box center plus the box's projected radius. The box
+	// is outside if that is negative for any plane. Shared by every path so the
+	// operation order, and therefore the rounding, is identical.
+	inline bool IsBoxVisible(const Frustum& frustum, float cx, float cy, float cz, float ex, float ey, float ez)
+	{
+		for (int p = 0; p < 6; p++)
+		{
+			const float distance = ((frustum.normalX[p] * cx + frustum.normalY[p] * cy) + frustum.normalZ[p] * cz) + frustum.distance[p];
+			const float radius = (std::fabs(frustum.normalX[p]) * ex + std::fabs(frustum.normalY[p]) * ey) + std::fabs(frustum.normalZ[p]) * ez;
+			if (distance + radius < 0.0f)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	inline bool IsSphereVisible(const Frustum& frustum, float cx, float cy, float cz, float r)
+	{
+		for (int p = 0; p < 6; p++)
+		{
+			const float distance = ((frustum.normalX[p] * cx + frustum.normalY[p] * cy) + frustum.normalZ[p] * cz) + frustum.distance[p];
+			if (distance + r < 0.0f)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	uint32_t CullBoxesScalar(const Frustum& frustum, const SceneBoundsView& bounds, uint32_t begin, uint32_t end, uint32_t* pVisible)
+	{
+		uint32_t visibleCount = 0;
+		for (uint32_t i = begin; i < end; i++)
+		{
+			if (IsBoxVisible(frustum, bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i], bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]))
+			{
+				pVisible[visibleCount++] = i;
+			}
+		}
+		return visibleCount;
+	}
+
+	uint32_t CullSpheresScalar(const Frustum& frustum, const float* pCenterX, const float* pCenterY, const float* pCenterZ, const float* pRadius,
+		uint32_t begin, uint32_t end, uint32_t* pVisible)
+	{
+		uint32_t visibleCount = 0;
+		for (uint32_t i = begin; i < end; i++)
+		{
+			if (IsSphereVisible(frustum, pCenterX[i], pCenterY[i], pCenterZ[i], pRadius[i]))
+			{
+				pVisible[visibleCount++] = i;
+			}
+		}
+		return visibleCount;
+	}
+
+#if FRUSTUM_CULLING_X64
+	// Append first + each set bit of mask, lowest first.
+	inline uint32_t AppendVisible(uint32_t mask, uint32_t first, uint32_t* pVisible)
+	{
+		uint32_t visibleCount = 0;
+		while (mask != 0)
+		{
+#if defined(_MSC_VER)
+			unsigned long bit;
+			_BitScanForward(&bit, mask);
+#else
+			const uint32_t bit = static_cast<uint32_t>(__builtin_ctz(mask));
+#endif
+			pVisible[visibleCount++] = first + bit;
+			mask &= mask - 1;
+		}
+		return visibleCount;
+	}
+
+	uint32_t CullBoxesSSE(const Frustum& frustum, const SceneBoundsView& bounds, uint32_t begin, uint32_t end, uint32_t* pVisible)
+	{
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		const __m128 zero = _mm_setzero_ps();
+
+		uint32_t visibleCount = 0;
+		uint32_t i = begin;
+		for (; i + 4 <= end; i += 4)
+		{
+			const __m128 cx = _mm_loadu_ps(bounds.centerX + i);
+			const __m128 cy = _mm_loadu_ps(bounds.centerY + i);
+			const __m128 cz = _mm_loadu_ps(bounds.centerZ + i);
+			const __m128 ex = _mm_loadu_ps(bounds.extentX + i);
+			const __m128 ey = _mm_loadu_ps(bounds.extentY + i);
+			const __m128 ez = _mm_loadu_ps(bounds.extentZ + i);
+
+			__m128 outside = zero;
+			for (int p = 0; p < 6; p++)
+			{
+				const __m128 nx = _mm_set1_ps(frustum.normalX[p]);
+				const __m128 ny = _mm_set1_ps(frustum.normalY[p]);
+				const __m128 nz = _mm_set1_ps(frustum.normalZ[p]);
+				const __m128 d = _mm_set1_ps(frustum.distance[p]);
+
+				const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)), _mm_mul_ps(nz, cz)), d);
+				const __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, nx), ex), _mm_mul_ps(_mm_andnot_ps(signMask, ny), ey)), _mm_mul_ps(_mm_andnot_ps(signMask, nz), ez));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+			}
+
+			const uint32_t visibleMask = ~static_cast<uint32_t>(_mm_movemask_ps(outside)) & 0xf;
+			visibleCount += AppendVisible(visibleMask, i, pVisible + visibleCount);
+		}
+
+		return visibleCount + CullBoxesScalar(frustum, bounds, i, end, pVisible + visibleCount);
+	}
+
+	uint32_t CullSpheresSSE(const Frustum& frustum, const float* pCenterX, const float* pCenterY, const float* pCenterZ, const float* pRadius,
+		uint32_t begin, uint32_t end, uint32_t* pVisible)
+	{
+		const __m128 zero = _mm_setzero_ps();
+
+		uint32_t visibleCount = 0;
+		uint32_t i = begin;
+		for (; i + 4 <= end; i += 4)
+		{
+			const __m128 cx = _mm_loadu_ps(pCenterX + i);
+			const __m128 cy = _mm_loadu_ps(pCenterY + i);
+			const __m128 cz = _mm_loadu_ps(pCenterZ + i);
+			const __m128 r = _mm_loadu_ps(pRadius + i);
+
+			__m128 outside = zero;
+			for (int p = 0; p < 6; p++)
+			{
+				const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(frustum.normalX[p]), cx), _mm_mul_ps(_mm_set1_ps(frustum.normalY[p]), cy)),
+					_mm_mul_ps(_mm_set1_ps(frustum.normalZ[p]), cz)), _mm_set1_ps(frustum.distance[p]));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, r), zero));
+			}
+
+			const uint32_t visibleMask = ~static_cast<uint32_t>(_mm_movemask_ps(outside)) & 0xf;
+			visibleCount += AppendVisible(visibleMask, i, pVisible + visibleCount);
+		}
+
+		return visibleCount + CullSpheresScalar(frustum, pCenterX, pCenterY, pCenterZ, pRadius, i, end, pVisible + visibleCount);
+	}
+
+	// Separate multiplies and adds, not FMA: fused results would round differently from the other paths.
+	FRUSTUM_CULLING_AVX2_FUNCTION
+	uint32_t CullBoxesAVX2(const Frustum& frustum, const SceneBoundsView& bounds, uint32_t begin, uint32_t end, uint32_t* pVisible)
+	{
+		const __m256 signMask = _mm256_set1_ps(-0.0f);
+		const __m256 zero = _mm256_setzero_ps();
+
+		uint32_t visibleCount = 0;
+		uint32_t i = begin;
+		for (; i + 8 <= end; i += 8)
+		{
+			const __m256 cx = _mm256_loadu_ps(bounds.centerX + i);
+			const __m256 cy = _mm256_loadu_ps(bounds.centerY + i);
+			const __m256 cz = _mm256_loadu_ps(bounds.centerZ + i);
+			const __m256 ex = _mm256_loadu_ps(bounds.extentX + i);
+			const __m256 ey = _mm256_loadu_ps(bounds.extentY + i);
+			const __m256 ez = _mm256_loadu_ps(bounds.extentZ + i);
+
+			__m256 outside = zero;
+			for (int p = 0; p < 6; p++)
+			{
+				const __m256 nx = _mm256_set1_ps(frustum.normalX[p]);
+				const __m256 ny = _mm256_set1_ps(frustum.normalY[p]);
+				const __m256 nz = _mm256_set1_ps(frustum.normalZ[p]);
+				const __m256 d = _mm256_set1_ps(frustum.distance[p]);
+
+				const __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, cx), _mm256_mul_ps(ny, cy)), _mm256_mul_ps(nz, cz)), d);
+				const __m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_andnot_ps(signMask, nx), ex), _mm256_mul_ps(_mm256_andnot_ps(signMask, ny), ey)), _mm256_mul_ps(_mm256_andnot_ps(signMask, nz), ez));
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_LT_OQ));
+			}
+
+			const uint32_t visibleMask = ~static_cast<uint32_t>(_mm256_movemask_ps(outside)) & 0xff;
+			visibleCount += AppendVisible(visibleMask, i, pVisible + visibleCount);
+		}
+
+		return visibleCount + CullBoxesSSE(frustum, bounds, i, end, pVisible + visibleCount);
+	}
+
+	FRUSTUM_CULLING_AVX2_FUNCTION
+	uint32_t CullSpheresAVX2(const Frustum& frustum, const float* pCenterX, const float* pCenterY, const float* pCenterZ, const float* pRadius,
+		uint32_t begin, uint32_t end, uint32_t* pVisible)
+	{
+		const __m256 zero = _mm256_setzero_ps();
+
+		uint32_t visibleCount = 0;
+		uint32_t i = begin;
+		for (; i + 8 <= end; i += 8)
+		{
+			const __m256 cx = _mm256_loadu_ps(pCenterX + i);
+			const __m256 cy = _mm256_loadu_ps(pCenterY + i);
+			const __m256 cz = _mm256_loadu_ps(pCenterZ + i);
+			const __m256 r = _mm256_loadu_ps(pRadius + i);
+
+			__m256 outside = zero;
+			for (int p = 0; p < 6; p++)
+			{
+				const __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(frustum.normalX[p]), cx), _mm256_mul_ps(_mm256_set1_ps(frustum.normalY[p]), cy)),
+					_mm256_mul_ps(_mm256_set1_ps(frustum.normalZ[p]), cz)), _mm256_set1_ps(frustum.distance[p]));
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, r), zero, _CMP_LT_OQ));
+			}
+
+			const uint32_t visibleMask = ~static_cast<uint32_t>(_mm256_movemask_ps(outside)) & 0xff;
+			visibleCount += AppendVisible(visibleMask, i, pVisible + visibleCount);
+		}
+
+		return visibleCount + CullSpheresSSE(frustum, pCenterX, pCenterY, pCenterZ, pRadius, i, end, pVisible + visibleCount);
+	}
+
+	bool IsAVX2Supported()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+		{
+			return false;
+		}
+
+		// The CPU must have AVX and OSXSAVE, and the OS must save the YMM registers.
+		__cpuid(info, 1);
+		const bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+
+		__cpuidex(info, 7, 0);
+		return osSavesYmm && (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") != 0;
+#endif
+	}
+#endif
+}
+
+// Planes are combinations of the clip matrix columns: -w <= x <= w, -w <= y <= w, 0 <= z <= w.
+void ExtractFrustum(const SceneMatrix& viewProj, Frustum& frustum)
+{
+	const float (&m)[4][4] = viewProj.m;
+	const float planes[6][4] =
+	{
+		{ m[0][3] + m[0][0], m[1][3] + m[1][0], m[2][3] + m[2][0], m[3][3] + m[3][0] },     // Left
+		{ m[0][3] - m[0][0], m[1][3] - m[1][0], m[2][3] - m[2][0], m[3][3] - m[3][0] },     // Right
+		{ m[0][3] + m[0][1], m[1][3] + m[1][1], m[2][3] + m[2][1], m[3][3] + m[3][1] },     // Bottom
+		{ m[0][3] - m[0][1], m[1][3] - m[1][1], m[2][3] - m[2][1], m[3][3] - m[3][1] },     // Top
+		{ m[0][2], m[1][2], m[2][2], m[3][2] },                                             // Near
+		{ m[0][3] - m[0][2], m[1][3] - m[1][2], m[2][3] - m[2][2], m[3][3] - m[3][2] },     // Far
+	};
+
+	// Normalized so distances are in world units, which sphere radii need.
+	for (int p = 0; p < 6; p++)
+	{
+		const float length = std::sqrt(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+		const float scale = length > 0.0f ? 1.0f / length : 0.0f;
+		frustum.normalX[p] = planes[p][0] * scale;
+		frustum.normalY[p] = planes[p][1] * scale;
+		frustum.normalZ[p] = planes[p][2] * scale;
+		frustum.distance[p] = planes[p][3] * scale;
+	}
+}
+
+ECullingPath GetBestCullingPath()
+{
+#if FRUSTUM_CULLING_X64
+	static const ECullingPath path = IsAVX2Supported() ? ECullingPath::AVX2 : ECullingPath::SSE;
+	return path;
+#else
+	return ECullingPath::Scalar;
+#endif
+}
+
+uint32_t CullBoxes(const Frustum& frustum, const SceneBoundsView& bounds, uint32_t begin, uint32_t end, uint32_t* pVisible, ECullingPath path)
+{
+	switch (path)
+	{
+#if FRUSTUM_CULLING_X64
+	case ECullingPath::AVX2:
+		return CullBoxesAVX2(frustum, bounds, begin, end, pVisible);
+	case ECullingPath::SSE:
+		return CullBoxesSSE(frustum, bounds, begin, end, pVisible);
+#endif
+	default:
+		return CullBoxesScalar(frustum, bounds, begin, end, pVisible);
+	}
+}
+
+uint32_t CullSpheres(const Frustum& frustum, const float* pCenterX, const float* pCenterY, const float* pCenterZ, const float* pRadius,
+	uint32_t begin, uint32_t end, uint32_t* pVisible, ECullingPath path)
+{
+	switch (path)
+	{
+#if FRUSTUM_CULLING_X64
+	case ECullingPath::AVX2:
+		return CullSpheresAVX2(frustum, pCenterX, pCenterY, pCenterZ, pRadius, begin, end, pVisible);
+	case ECullingPath::SSE:
+		return CullSpheresSSE(frustum, pCenterX, pCenterY, pCenterZ, pRadius, begin, end, pVisible);
+#endif
+	default:
+		return CullSpheresScalar(frustum, pCenterX, pCenterY, pCenterZ, pRadius, begin, end, pVisible);
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+#include "SceneStore.h"
+
+// The six clip planes of a view-projection matrix, normalized and facing inward,
+// stored as structure of arrays so each plane can be broadcast to SIMD lanes.
+struct Frustum
+{
+    float normalX[6];
+    float normalY[6];
+    float normalZ[6];
+    float distance[6];
+};
+
+enum class ECullingPath
+{
+    Scalar,
+    SSE,        // 4 objects per iteration.
+    AVX2,       // 8 objects per iteration.
+};
+
+// viewProj uses the DirectX conventions: row vectors and clip space depth in [0, 1].
+void ExtractFrustum(const SceneMatrix& viewProj, Frustum& frustum);
+
+// Widest path this CPU and operating system support.
+ECullingPath GetBestCullingPath();
+
+// Write the indices in [begin, end) of the boxes or spheres that intersect the
+// frustum to pVisible, in increasing order, and return how many there are.
+// Every path performs the same float operations in the same order, so they
+// agree bit for bit with the scalar path. An object is culled when it lies
+// entirely behind one plane; objects near corners may be kept.
+uint32_t CullBoxes(const Frustum& frustum, const SceneBoundsView& bounds, uint32_t begin, uint32_t end, uint32_t* pVisible, ECullingPath path);
+uint32_t CullSpheres(const Frustum& frustum, const float* pCenterX, const float* pCenterY, const float* pCenterZ, const float* pRadius,
+    uint32_t begin, uint32_t end, uint32_t* pVisible, ECullingPath path);
@@ -0,0 +1,82 @@
+#include "GpuCulling.h"
+
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+	// D3D flushes float32 denormals to sign-preserved zero on the inputs and outputs of arithmetic.
+	inline float FlushDenormal(float value)
+	{
+		return std::fabs(value) < FLT_MIN ? std::copysign(0.0f, value) : value;
+	}
+
+	inline float Mul(float a, float b)
+	{
+		return FlushDenormal(FlushDenormal(a) * FlushDenormal(b));
+	}
+
+	inline float Add(float a, float b)
+	{
+		return FlushDenormal(FlushDenormal(a) + FlushDenormal(b));
+	}
+
+	// Same test as IsBoxVisible in FrustumCulling.cpp and the precise math in culling.hlsl.
+	inline bool IsObjectVisible(const GpuCullConstants& constants, const GpuCullObject& object)
+	{
+		for (int p = 0; p < 6; p++)
+		{
+			const float* pPlane = constants.planes[p];
+			const float distance = Add(Add(Add(Mul(pPlane[0], object.centerX), Mul(pPlane[1], object.centerY)), Mul(pPlane[2], object.centerZ)), pPlane[3]);
+			const float radius = Add(Add(Mul(std::fabs(pPlane[0]), object.extentX), Mul(std::fabs(pPlane[1]), object.extentY)), Mul(std::fabs(pPlane[2]), object.extentZ));
+			if (Add(distance, radius) < 0.0f)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+void SetCullConstants(const Frustum& frustum, uint32_t objectCount, uint32_t maxCommands, GpuCullConstants& constants)
+{
+	for (int p = 0; p < 6; p++)
+	{
+		constants.planes[p][0] = frustum.normalX[p];
+		constants.planes[p][1] = frustum.normalY[p];
+		constants.planes[p][2] = frustum.normalZ[p];
+		constants.planes[p][3] = frustum.distance[p];
+	}
+	constants.objectCount = objectCount;
+	constants.maxCommands = maxCommands;
+}
+
+uint32_t CullAndCompact(const GpuCullConstants& constants, const GpuCullObject* pObjects, GpuDrawCommand* pCommands)
+{
+	uint32_t commandCount = 0;
+	for (uint32_t i = 0; i < constants.objectCount; i++)
+	{
+		const GpuCullObject& object = pObjects[i];
+		if (!IsObjectVisible(constants, object))
+		{
+			continue;
+		}
+
+		const uint32_t slot = commandCount++;
+		if (slot >= constants.maxCommands)
+		{
+			continue;
+		}
+
+		GpuDrawCommand& command = pCommands[slot];
+		command.material = object.material;
+		command.instance = object.instance;
+		command.indexCountPerInstance = object.indexCount;
+		command.instanceCount = 1;
+		command.startIndexLocation = object.startIndex;
+		command.baseVertexLocation = object.baseVertex;
+		command.startInstanceLocation = 0;
+		command.padding = 0;
+	}
+	return commandCount;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+
+#include "FrustumCulling.h"
+
+// Layouts shared with Shaders/culling.hlsl. The cull pass reads one GpuCullObject
+// per scene object and appends a GpuDrawCommand for each one that survives.
+
+// Root constants of the cull pass. Planes are (normal, distance), inward facing.
+struct GpuCullConstants
+{
+    float planes[6][4];
+    uint32_t objectCount;
+    uint32_t maxCommands;       // Capacity of the command buffer; later survivors are counted but not written.
+};
+
+// Element of the objects StructuredBuffer (tightly packed, 56 bytes).
+struct GpuCullObject
+{
+    uint64_t material;          // GPU virtual address of the material constants.
+    uint64_t instance;          // GPU virtual address of the object's instance data.
+    uint32_t indexCount;
+    uint32_t startIndex;
+    int32_t baseVertex;
+    uint32_t padding;
+    float centerX, centerY, centerZ;
+    float extentX, extentY, extentZ;
+};
+
+// One ExecuteIndirect command: the material root CBV, the instance root SRV,
+// then D3D12_DRAW_INDEXED_ARGUMENTS.
+struct GpuDrawCommand
+{
+    uint64_t material;
+    uint64_t instance;
+    uint32_t indexCountPerInstance;
+    uint32_t instanceCount;
+    uint32_t startIndexLocation;
+    int32_t baseVertexLocation;
+    uint32_t startInstanceLocation;
+    uint32_t padding;
+};
+
+static_assert(sizeof(GpuCullConstants) == 26 * 4, "GpuCullConstants must match CullConstants in culling.hlsl.");
+static_assert(sizeof(GpuCullObject) == 56, "GpuCullObject must match CullObject in culling.hlsl.");
+static_assert(sizeof(GpuDrawCommand) == 40, "GpuDrawCommand must match the command signature stride.");
+
+void SetCullConstants(const Frustum& frustum, uint32_t objectCount, uint32_t maxCommands, GpuCullConstants& constants);
+
+// CPU reference of the CSMain kernel in culling.hlsl, one loop iteration per
+// thread. It performs the same float operations in the same order and, like
+// D3D, flushes denormal inputs and results to zero, so it keeps exactly the
+// objects the GPU keeps. The GPU appends survivors in whatever order its
+// threads reach the counter, so only the set of commands is comparable; here
+// they come out in object order. Returns the survivor count, which like the
+// GPU's count may exceed maxCommands.
+uint32_t CullAndCompact(const GpuCullConstants& constants, const GpuCullObject* pObjects, GpuDrawCommand* pCommands);
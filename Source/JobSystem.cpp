@@ -0,0 +1,454 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define JOB_SYSTEM_PAUSE() _mm_pause()
+#else
+#define JOB_SYSTEM_PAUSE() std::this_thread::yield()
+#endif
+
+namespace
+{
+	// Worker identity of the calling thread.
+	thread_local const JobSystem* t_pJobSystem = nullptr;
+	thread_local uint32_t t_workerIndex = UINT32_MAX;
+
+	const uint32_t SpinCountBeforeSleep = 64;
+
+	// Chase-Lev deque with a fixed power-of-two capacity ("Correct and Efficient
+	// Work-Stealing for Weak Memory Models", Le et al. 2013). Only the owning
+	// worker calls Push and Pop; any thread may call Steal.
+	class WorkStealingQueue
+	{
+	public:
+		static const int64_t Capacity = JobSystem::MaxJobsPerWorker;
+		static const int64_t Mask = Capacity - 1;
+
+		WorkStealingQueue() : m_top(0), m_bottom(0)
+		{
+			for (auto& slot : m_slots)
+			{
+				slot.store(nullptr, std::memory_order_relaxed);
+			}
+		}
+
+		bool Push(Job* pJob)
+		{
+			const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+			const int64_t top = m_top.load(std::memory_order_acquire);
+			if (bottom - top >= Capacity)
+			{
+				return false;
+			}
+
+			// Publishes the job's contents to whichever thread steals it.
+			m_slots[bottom & Mask].store(pJob, std::memory_order_relaxed);
+			m_bottom.store(bottom + 1, std::memory_order_release);
+			return true;
+		}
+
+		Job* Pop()
+		{
+			const int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+			m_bottom.store(bottom, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t top = m_top.load(std::memory_order_relaxed);
+
+			if (top > bottom)
+			{
+				// Empty.
+				m_bottom.store(bottom + 1, std::memory_order_relaxed);
+				return nullptr;
+			}
+
+			Job* pJob = m_slots[bottom & Mask].load(std::memory_order_relaxed);
+			if (top == bottom)
+			{
+				// Last element: race any thief for it.
+				if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				{
+					pJob = nullptr;
+				}
+				m_bottom.store(bottom + 1, std::memory_order_relaxed);
+			}
+			return pJob;
+		}
+
+		Job* Steal()
+		{
+			int64_t top = m_top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const int64_t bottom = m_bottom.load(std::memory_order_acquire);
+
+			if (top >= bottom)
+			{
+				return nullptr;
+			}
+
+			Job* pJob = m_slots[top & Mask].load(std::memory_order_relaxed);
+			if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			{
+				return nullptr;
+			}
+			return pJob;
+		}
+
+	private:
+		// Thieves hammer m_top while the owner works on m_bottom; keep them on separate cache lines.
+		std::atomic<int64_t> m_top;
+		char m_padding0[64 - sizeof(std::atomic<int64_t>)];
+		std::atomic<int64_t> m_bottom;
+		char m_padding1[64 - sizeof(std::atomic<int64_t>)];
+		std::atomic<Job*> m_slots[Capacity];
+	};
+
+	void PinCurrentThread(uint32_t core)
+	{
+#if defined(_WIN32)
+		SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << (core % (sizeof(DWORD_PTR) * 8)));
+#elif defined(__linux__)
+		cpu_set_t cpuSet;
+		CPU_ZERO(&cpuSet);
+		CPU_SET(core % CPU_SETSIZE, &cpuSet);
+		pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+#else
+		(void)core;
+#endif
+	}
+}
+
+struct JobSystem::Worker
+{
+	WorkStealingQueue queue;
+	Job jobs[MaxJobsPerWorker];
+	uint32_t nextJob = 0;
+	uint32_t randomState = 0;
+	std::thread thread;
+};
+
+static_assert(sizeof(Job) == 64, "Job is expected to fill one cache line.");
+static_assert((JobSystem::MaxJobsPerWorker & (JobSystem::MaxJobsPerWorker - 1)) == 0, "MaxJobsPerWorker must be a power of two.");
+
+JobSystem::JobSystem(uint32_t workerCount, bool pinThreads) :
+	m_workerCount(workerCount),
+	m_exit(false),
+	m_sleepingWorkers(0),
+	m_wakeEpoch(0)
+{
+	if (m_workerCount == 0)
+	{
+		m_workerCount = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	m_workers.reset(new Worker[m_workerCount]);
+	for (uint32_t i = 0; i < m_workerCount; i++)
+	{
+		m_workers[i].randomState = 0x9E3779B9u * (i + 1);
+		for (Job& job : m_workers[i].jobs)
+		{
+			job.pending.store(false, std::memory_order_relaxed);
+		}
+	}
+
+	// The creating thread is worker 0.
+	t_pJobSystem = this;
+	t_workerIndex = 0;
+	if (pinThreads)
+	{
+		PinCurrentThread(0);
+	}
+
+	for (uint32_t i = 1; i < m_workerCount; i++)
+	{
+		m_workers[i].thread = std::thread(&JobSystem::WorkerMain, this, i, pinThreads);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_exit = true;
+		m_wakeEpoch++;
+	}
+	m_sleepCondition.notify_all();
+
+	for (uint32_t i = 1; i < m_workerCount; i++)
+	{
+		m_workers[i].thread.join();
+	}
+
+	if (t_pJobSystem == this)
+	{
+		t_pJobSystem = nullptr;
+		t_workerIndex = UINT32_MAX;
+	}
+}
+
+uint32_t JobSystem::GetCurrentWorkerIndex() const
+{
+	return t_pJobSystem == this ? t_workerIndex : UINT32_MAX;
+}
+
+Job* JobSystem::AllocateJob(JobCounter& counter)
+{
+	const uint32_t workerIndex = GetCurrentWorkerIndex();
+	if (workerIndex == UINT32_MAX)
+	{
+		return nullptr;
+	}
+
+	// Jobs come from a per-worker ring. If the slot we wrap onto is still queued
+	// or running, help out until it frees up rather than overwrite it. When there
+	// is nothing left to help with, the slot's job may be running further up this
+	// very stack and waiting would never end, so the caller runs the job inline.
+	Worker& worker = m_workers[workerIndex];
+	Job* pJob = &worker.jobs[worker.nextJob & (MaxJobsPerWorker - 1)];
+	while (pJob->pending.load(std::memory_order_acquire))
+	{
+		Job* pOther = FindJob(workerIndex);
+		if (pOther == nullptr)
+		{
+			return nullptr;
+		}
+		Execute(pOther);
+	}
+	worker.nextJob++;
+
+	pJob->pending.store(true, std::memory_order_relaxed);
+	pJob->pCounter = &counter;
+	pJob->pNextContinuation = nullptr;
+	pJob->begin = 0;
+	pJob->end = 0;
+	counter.m_pending.fetch_add(1, std::memory_order_relaxed);
+	return pJob;
+}
+
+void JobSystem::Submit(Job* pJob)
+{
+	const uint32_t workerIndex = GetCurrentWorkerIndex();
+	if (workerIndex == UINT32_MAX || !m_workers[workerIndex].queue.Push(pJob))
+	{
+		// Our deque is full (or we are not a worker): run it now.
+		Execute(pJob);
+		return;
+	}
+
+	WakeWorkers();
+}
+
+void JobSystem::AddContinuation(JobCounter& dependency, Job* pJob)
+{
+	{
+		std::lock_guard<std::mutex> lock(dependency.m_mutex);
+		if (dependency.m_pending.load(std::memory_order_acquire) != 0)
+		{
+			pJob->pNextContinuation = dependency.m_pContinuations;
+			dependency.m_pContinuations = pJob;
+			return;
+		}
+	}
+
+	Submit(pJob);
+}
+
+void JobSystem::Execute(Job* pJob)
+{
+	pJob->pFunction(*pJob);
+
+	// Release the slot before signalling so a waiter can immediately reuse it.
+	JobCounter* pCounter = pJob->pCounter;
+	pJob->pending.store(false, std::memory_order_release);
+
+	// Not the last job: a lock-free decrement is enough.
+	uint32_t pending = pCounter->m_pending.load(std::memory_order_relaxed);
+	while (pending > 1)
+	{
+		if (pCounter->m_pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+		{
+			return;
+		}
+	}
+
+	// Possibly the last job. Decrement under the counter's lock so that Wait, which
+	// takes the same lock before returning, cannot destroy the counter under us.
+	Job* pContinuations = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(pCounter->m_mutex);
+		if (pCounter->m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			pContinuations = pCounter->m_pContinuations;
+			pCounter->m_pContinuations = nullptr;
+		}
+	}
+
+	while (pContinuations)
+	{
+		Job* pNext = pContinuations->pNextContinuation;
+		Submit(pContinuations);
+		pContinuations = pNext;
+	}
+}
+
+Job* JobSystem::FindJob(uint32_t workerIndex)
+{
+	Worker& worker = m_workers[workerIndex];
+	if (Job* pJob = worker.queue.Pop())
+	{
+		return pJob;
+	}
+
+	// Steal from the other workers, starting at a random victim.
+	uint32_t state = worker.randomState;
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	worker.randomState = state;
+
+	for (uint32_t i = 0; i < m_workerCount; i++)
+	{
+		const uint32_t victim = (state + i) % m_workerCount;
+		if (victim == workerIndex)
+		{
+			continue;
+		}
+
+		if (Job* pJob = m_workers[victim].queue.Steal())
+		{
+			return pJob;
+		}
+	}
+
+	return nullptr;
+}
+
+void JobSystem::WakeWorkers()
+{
+	// Pairs with the seq_cst increment in WorkerMain: either we see the sleeper
+	// or the sleeper's re-check sees the job we just pushed.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (m_sleepingWorkers.load(std::memory_order_relaxed) > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			m_wakeEpoch++;
+		}
+		m_sleepCondition.notify_one();
+	}
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	const uint32_t workerIndex = GetCurrentWorkerIndex();
+
+	while (!counter.IsDone())
+	{
+		Job* pJob = workerIndex != UINT32_MAX ? FindJob(workerIndex) : nullptr;
+		if (pJob)
+		{
+			Execute(pJob);
+		}
+		else
+		{
+			JOB_SYSTEM_PAUSE();
+		}
+	}
+
+	// Wait for the thread that retired the last job to let go of the counter.
+	std::lock_guard<std::mutex> lock(counter.m_mutex);
+}
+
+void JobSystem::ParallelForJob(Job& job)
+{
+	JobSystem* pJobSystem = const_cast<JobSystem*>(t_pJobSystem);
+	const ParallelForData* pData = *reinterpret_cast<const ParallelForData* const*>(job.storage);
+
+	// Keep halving, handing the upper half to the deque where idle workers can steal it.
+	uint32_t begin = job.begin;
+	uint32_t end = job.end;
+	while (end - begin > pData->grainSize)
+	{
+		const uint32_t middle = begin + (end - begin) / 2;
+
+		Job* pSplit = pJobSystem->AllocateJob(*job.pCounter);
+		if (pSplit == nullptr)
+		{
+			// Out of job slots: run the rest here, still in grain-sized ranges.
+			for (; end - begin > pData->grainSize; begin += pData->grainSize)
+			{
+				pData->pInvoke(pData->pFunction, begin, begin + pData->grainSize);
+			}
+			break;
+		}
+		pSplit->pFunction = &ParallelForJob;
+		pSplit->begin = middle;
+		pSplit->end = end;
+		StoreFunctor(*pSplit, pData);
+		pJobSystem->Submit(pSplit);
+
+		end = middle;
+	}
+
+	pData->pInvoke(pData->pFunction, begin, end);
+}
+
+void JobSystem::WorkerMain(uint32_t workerIndex, bool pinThread)
+{
+	t_pJobSystem = this;
+	t_workerIndex = workerIndex;
+	if (pinThread)
+	{
+		PinCurrentThread(workerIndex);
+	}
+
+	uint32_t idleSpins = 0;
+	while (!m_exit.load(std::memory_order_relaxed))
+	{
+		if (Job* pJob = FindJob(workerIndex))
+		{
+			Execute(pJob);
+			idleSpins = 0;
+			continue;
+		}
+
+		if (++idleSpins < SpinCountBeforeSleep)
+		{
+			JOB_SYSTEM_PAUSE();
+			continue;
+		}
+
+		// Announce we are about to sleep, then look for work one last time.
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		const uint64_t epoch = m_wakeEpoch;
+		m_sleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+		lock.unlock();
+
+		if (Job* pJob = FindJob(workerIndex))
+		{
+			m_sleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+			Execute(pJob);
+			idleSpins = 0;
+			continue;
+		}
+
+		lock.lock();
+		m_sleepCondition.wait(lock, [this, epoch] { return m_wakeEpoch != epoch || m_exit; });
+		m_sleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+		idleSpins = 0;
+	}
+}
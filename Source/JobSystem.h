@@ -0,0 +1,195 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+
+class JobSystem;
+struct Job;
+
+// Number of jobs still pending. Every job submitted against a counter increments
+// it, and completion decrements it. Jobs queued with JobSystem::RunAfter start
+// once the counter they depend on reaches zero.
+class JobCounter
+{
+public:
+    JobCounter() : m_pending(0), m_pContinuations(nullptr) {}
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    bool IsDone() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+
+    std::atomic<uint32_t> m_pending;
+    std::mutex m_mutex;
+    Job* m_pContinuations;
+};
+
+// One cache line per job.
+struct Job
+{
+    static const size_t StorageSize = 24;
+
+    void (*pFunction)(Job& job);
+    JobCounter* pCounter;
+    Job* pNextContinuation;
+    uint32_t begin;
+    uint32_t end;
+    std::atomic<bool> pending;
+    alignas(8) unsigned char storage[StorageSize];
+};
+
+// Portable work-stealing scheduler. Each worker owns a lock-free Chase-Lev deque:
+// it pushes and pops at the bottom, idle workers steal from the top of a random
+// victim. The thread that creates the JobSystem becomes worker 0 and helps run
+// jobs while it waits on a counter. Jobs may only be submitted from worker threads;
+// anything submitted from another thread runs inline.
+//
+// Job functors are stored inside the job, so they must be trivially destructible and
+// no larger than Job::StorageSize (capture pointers and references, not containers).
+class JobSystem
+{
+public:
+    static const uint32_t MaxJobsPerWorker = 4096;
+
+    // workerCount of 0 uses every hardware thread. With pinThreads each spawned
+    // worker is bound to one logical core.
+    explicit JobSystem(uint32_t workerCount = 0, bool pinThreads = false);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    uint32_t GetWorkerCount() const { return m_workerCount; }
+
+    // Index of the calling thread, or UINT32_MAX if it is not one of our workers.
+    uint32_t GetCurrentWorkerIndex() const;
+
+    template<typename F>
+    void Run(JobCounter& counter, const F& function)
+    {
+        Job* pJob = AllocateJob(counter);
+        if (pJob == nullptr)
+        {
+            function();
+            return;
+        }
+
+        StoreFunctor(*pJob, function);
+        pJob->pFunction = &InvokeFunctor<F>;
+        Submit(pJob);
+    }
+
+    // Queue a job that only becomes runnable once dependency reaches zero.
+    template<typename F>
+    void RunAfter(JobCounter& dependency, JobCounter& counter, const F& function)
+    {
+        Job* pJob = AllocateJob(counter);
+        if (pJob == nullptr)
+        {
+            Wait(dependency);
+            function();
+            return;
+        }
+
+        StoreFunctor(*pJob, function);
+        pJob->pFunction = &InvokeFunctor<F>;
+        AddContinuation(dependency, pJob);
+    }
+
+    // Calls function(begin, end) over [0, count) in ranges of at most grainSize
+    // elements. Ranges are split recursively so other workers can steal the
+    // larger halves. Returns when every range has finished.
+    template<typename F>
+    void ParallelFor(uint32_t count, uint32_t grainSize, const F& function)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        grainSize = grainSize > 0 ? grainSize : 1;
+        if (count <= grainSize || GetCurrentWorkerIndex() == UINT32_MAX)
+        {
+            function(0u, count);
+            return;
+        }
+
+        ParallelForData data = { &function, &InvokeRange<F>, grainSize };
+        JobCounter counter;
+        Job* pJob = AllocateJob(counter);
+        if (pJob == nullptr)
+        {
+            function(0u, count);
+            return;
+        }
+
+        pJob->pFunction = &ParallelForJob;
+        pJob->begin = 0;
+        pJob->end = count;
+        StoreFunctor(*pJob, &data);
+        Submit(pJob);
+
+        Wait(counter);
+    }
+
+    // Run other jobs until the counter reaches zero.
+    void Wait(JobCounter& counter);
+
+private:
+    struct Worker;
+
+    struct ParallelForData
+    {
+        const void* pFunction;
+        void (*pInvoke)(const void* pFunction, uint32_t begin, uint32_t end);
+        uint32_t grainSize;
+    };
+
+    template<typename F>
+    static void StoreFunctor(Job& job, const F& function)
+    {
+        static_assert(sizeof(F) <= Job::StorageSize, "Job functor too large; capture by reference or pointer.");
+        static_assert(alignof(F) <= 8, "Job functor is over-aligned.");
+        static_assert(std::is_trivially_destructible<F>::value, "Job functors must be trivially destructible.");
+        new (job.storage) F(function);
+    }
+
+    template<typename F>
+    static void InvokeFunctor(Job& job)
+    {
+        (*reinterpret_cast<F*>(job.storage))();
+    }
+
+    template<typename F>
+    static void InvokeRange(const void* pFunction, uint32_t begin, uint32_t end)
+    {
+        (*static_cast<const F*>(pFunction))(begin, end);
+    }
+
+    static void ParallelForJob(Job& job);
+
+    Job* AllocateJob(JobCounter& counter);
+    void Submit(Job* pJob);
+    void AddContinuation(JobCounter& dependency, Job* pJob);
+    void Execute(Job* pJob);
+    Job* FindJob(uint32_t workerIndex);
+    void WakeWorkers();
+    void WorkerMain(uint32_t workerIndex, bool pinThread);
+
+    uint32_t m_workerCount;
+    std::unique_ptr<Worker[]> m_workers;
+
+    std::atomic<bool> m_exit;
+    std::atomic<uint32_t> m_sleepingWorkers;
+    std::mutex m_sleepMutex;
+    std::condition_variable m_sleepCondition;
+    uint64_t m_wakeEpoch;
+};
@@ -0,0 +1,52 @@
+#include "LodSelection.h"
+
+#include <algorithm>
+
+uint32_t SelectLod(const LodChain& chain, float errorScale, uint32_t currentLod, const LodSettings& settings)
+{
+	uint32_t lod = chain.lodCount - 1;
+	while (lod > 0 && chain.geometricErrors[lod] * errorScale > settings.maxPixelError)
+	{
+		lod--;
+	}
+
+	currentLod = std::min(currentLod, chain.lodCount - 1);
+	if (lod <= currentLod)
+	{
+		return lod;
+	}
+
+	const float coarsenError = settings.maxPixelError * (1.0f - settings.hysteresis);
+	while (lod > currentLod && chain.geometricErrors[lod] * errorScale > coarsenError)
+	{
+		lod--;
+	}
+	return lod;
+}
+
+float UpdateLodState(LodState& state, uint32_t lod, uint32_t frame, const LodSettings& settings)
+{
+	const bool drawnLastFrame = state.lastFrame != 0 && state.lastFrame + 1 == frame;
+	state.lastFrame = frame;
+
+	if (!drawnLastFrame || settings.fadeFrames == 0)
+	{
+		state.lod = static_cast<uint8_t>(lod);
+		state.fadeFramesLeft = 0;
+		return 1.0f;
+	}
+
+	if (state.fadeFramesLeft > 0)
+	{
+		state.fadeFramesLeft--;
+	}
+	if (state.fadeFramesLeft == 0 && lod != state.lod)
+	{
+		state.fadingLod = state.lod;
+		state.lod = static_cast<uint8_t>(lod);
+		state.fadeFramesLeft = static_cast<uint16_t>(settings.fadeFrames);
+	}
+
+	// Never 0 while fading, so both LODs cover some pixels on every frame of the crossfade.
+	return 1.0f - static_cast<float>(state.fadeFramesLeft) / static_cast<float>(settings.fadeFrames + 1);
+}
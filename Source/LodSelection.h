@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+
+static const uint32_t MaxLodCount = 8;
+
+// Geometric error of each level of detail of a mesh, finest first: how far its
+// surface strays from the original, in mesh units. Errors must not decrease.
+struct LodChain
+{
+    float geometricErrors[MaxLodCount];
+    uint32_t lodCount;
+};
+
+struct LodSettings
+{
+    float maxPixelError;        // The coarsest LOD whose error projects to at most this many pixels is picked.
+    float hysteresis;           // Switching to a coarser LOD also needs its error under maxPixelError * (1 - hysteresis).
+    uint32_t fadeFrames;        // Length of the dithered crossfade between two LODs, 0 to switch at once.
+};
+
+// Per object, kept from frame to frame.
+struct LodState
+{
+    uint8_t lod;
+    uint8_t fadingLod;          // Fading out while fadeFramesLeft is non-zero.
+    uint16_t fadeFramesLeft;
+    uint32_t lastFrame;         // 0 if never drawn.
+};
+
+// errorScale converts mesh units to pixels at the object: its world scale times
+// the pixels one world unit covers at its distance from the eye. Refining is
+// immediate, but coarsening only happens once the coarser LOD is well under the
+// threshold, so objects near a switching distance do not flip every frame.
+uint32_t SelectLod(const LodChain& chain, float errorScale, uint32_t currentLod, const LodSettings& settings);
+
+// Advance an object's state by one frame towards lod. A change starts a
+// crossfade from the current LOD, and changes requested during a crossfade wait
+// for it to end. Objects that were not drawn in the previous frame switch at
+// once. Frames are counted from 1.
+//
+// Returns the share of pixels state.lod covers, in (0, 1] and 1 outside a
+// crossfade; state.fadingLod is drawn with the complementary pattern.
+float UpdateLodState(LodState& state, uint32_t lod, uint32_t frame, const LodSettings& settings);
@@ -2,9 +2,54 @@
 #include "Engine.h"
 #include "App.h"
 
+struct CommandLine
+{
+    UINT frameCount;    // Number of frames the CPU may run ahead of the GPU, e.g. "-frames 3".
+    bool importOnly;    // "-import": cook the meshes in the Meshes directory and exit.
+};
+
+static bool IsSwitch(LPCWSTR arg, LPCWSTR name)
+{
+    return (arg[0] == L'-' || arg[0] == L'/') && _wcsicmp(arg + 1, name) == 0;
+}
+
+static CommandLine ParseCommandLine()
+{
+    CommandLine commandLine = { 2, false };
+
+    int argc;
+    LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    for (int i = 1; i < argc; ++i)
+    {
+        if (IsSwitch(argv[i], L"frames") && i + 1 < argc)
+        {
+            commandLine.frameCount = static_cast<UINT>(_wtoi(argv[++i]));
+        }
+        else if (IsSwitch(argv[i], L"import"))
+        {
+            commandLine.importOnly = true;
+        }
+    }
+    LocalFree(argv);
+
+    return commandLine;
+}
+
 _Use_decl_annotations_
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow)
 {
-    Engine engine(1280, 720);
+    const CommandLine commandLine = ParseCommandLine();
+    Engine engine(1280, 720, commandLine.frameCount);
+    if (commandLine.importOnly)
+    {
+        // Report to the console this was started from, if any. The exit code is
+        // nonzero if a source could not be imported or the cache written.
+        FILE* pConsole;
+        if (AttachConsole(ATTACH_PARENT_PROCESS) && freopen_s(&pConsole, "CONOUT$", "w", stdout) == 0)
+        {
+            setvbuf(stdout, nullptr, _IONBF, 0);
+        }
+        return engine.CookMeshSources() ? 0 : 1;
+    }
     return App::Run(&engine, hInstance, nCmdShow);
 }
@@ -0,0 +1,327 @@
+#include "MeshFile.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	uint64_t AlignUp(uint64_t value)
+	{
+		return (value + MeshFileAlignment - 1) & ~static_cast<uint64_t>(MeshFileAlignment - 1);
+	}
+
+	uint64_t GetTablesSize(uint64_t streamCount, uint64_t meshCount, uint64_t lodCount, uint64_t meshletCount)
+	{
+		return sizeof(MeshFileHeader) + streamCount * sizeof(MeshFileStream) + meshCount * sizeof(MeshFileMesh) + lodCount * sizeof(MeshFileLod) +
+			meshletCount * sizeof(Meshlet);
+	}
+
+	// True if the LOD's meshlets are in the table and each one covers triangles of the LOD.
+	bool AreMeshletsValid(const MeshFileLod& lod, const Meshlet* pMeshlets, uint32_t meshletCount)
+	{
+		if (lod.firstMeshlet > meshletCount || lod.meshletCount > meshletCount - lod.firstMeshlet)
+		{
+			return false;
+		}
+		for (uint32_t i = lod.firstMeshlet; i < lod.firstMeshlet + lod.meshletCount; i++)
+		{
+			const Meshlet& meshlet = pMeshlets[i];
+			if (meshlet.triangleCount == 0 || meshlet.triangleCount > MaxMeshletTriangles || meshlet.startIndex > lod.indexCount ||
+				meshlet.triangleCount * 3 > lod.indexCount - meshlet.startIndex)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// True if [offset, offset + size) is an aligned range of the file past its tables.
+	bool IsSectionValid(uint64_t offset, uint64_t size, uint64_t tablesSize, uint64_t fileSize)
+	{
+		return offset % MeshFileAlignment == 0 && offset >= tablesSize && offset <= fileSize && size <= fileSize - offset;
+	}
+
+#if !defined(_WIN32)
+	// Paths are converted with the current locale.
+	std::string NarrowPath(const std::wstring& path)
+	{
+		std::vector<char> narrow(path.size() * MB_CUR_MAX + 1);
+		const size_t length = wcstombs(narrow.data(), path.c_str(), narrow.size());
+		return length == static_cast<size_t>(-1) ? std::string() : std::string(narrow.data(), length);
+	}
+#endif
+
+	FILE* OpenForWriting(const std::wstring& path)
+	{
+#if defined(_WIN32)
+		FILE* pFile = nullptr;
+		return _wfopen_s(&pFile, path.c_str(), L"wb") == 0 ? pFile : nullptr;
+#else
+		return fopen(NarrowPath(path).c_str(), "wb");
+#endif
+	}
+
+	bool WritePadded(FILE* pFile, const void* pData, uint64_t size, uint64_t& offset)
+	{
+		static const uint8_t zeros[MeshFileAlignment] = {};
+		const uint64_t padding = AlignUp(offset + size) - (offset + size);
+		offset += size + padding;
+		return (size == 0 || fwrite(pData, 1, static_cast<size_t>(size), pFile) == size) &&
+			(padding == 0 || fwrite(zeros, 1, static_cast<size_t>(padding), pFile) == padding);
+	}
+}
+
+bool WriteMeshFile(const std::wstring& path, const MeshFileDesc& desc)
+{
+	if (desc.indexSize != 2 && desc.indexSize != 4)
+	{
+		return false;
+	}
+	for (uint32_t mesh = 0; mesh < desc.meshCount; mesh++)
+	{
+		const MeshFileMesh& meshDesc = desc.pMeshes[mesh];
+		if (meshDesc.lodCount == 0 || meshDesc.firstLod > desc.lodCount || meshDesc.lodCount > desc.lodCount - meshDesc.firstLod)
+		{
+			return false;
+		}
+	}
+	for (uint32_t lod = 0; lod < desc.lodCount; lod++)
+	{
+		const MeshFileLod& lodDesc = desc.pLods[lod];
+		if (lodDesc.startIndex > desc.indexCount || lodDesc.indexCount > desc.indexCount - lodDesc.startIndex ||
+			lodDesc.baseVertex < 0 || static_cast<uint32_t>(lodDesc.baseVertex) > desc.vertexCount ||
+			!AreMeshletsValid(lodDesc, desc.pMeshlets, desc.meshletCount))
+		{
+			return false;
+		}
+	}
+
+	// Lay the file out before writing it, since the tables come first.
+	MeshFileHeader header = {};
+	header.magic = MeshFileMagic;
+	header.version = MeshFileVersion;
+	header.streamCount = desc.streamCount;
+	header.meshCount = desc.meshCount;
+	header.lodCount = desc.lodCount;
+	header.meshletCount = desc.meshletCount;
+	header.vertexCount = desc.vertexCount;
+	header.indexCount = desc.indexCount;
+	header.indexSize = desc.indexSize;
+	header.sourceKey = desc.sourceKey;
+
+	std::vector<MeshFileStream> streams(desc.streamCount);
+	uint64_t offset = GetTablesSize(desc.streamCount, desc.meshCount, desc.lodCount, desc.meshletCount);
+	for (uint32_t stream = 0; stream < desc.streamCount; stream++)
+	{
+		streams[stream] = { desc.pStreams[stream].layout, desc.pStreams[stream].stride, offset };
+		offset = AlignUp(offset + static_cast<uint64_t>(desc.vertexCount) * desc.pStreams[stream].stride);
+	}
+	header.indexOffset = offset;
+	header.fileSize = offset + static_cast<uint64_t>(desc.indexCount) * desc.indexSize;
+
+	FILE* pFile = OpenForWriting(path);
+	if (pFile == nullptr)
+	{
+		return false;
+	}
+
+	offset = 0;
+	bool written = WritePadded(pFile, &header, sizeof(header), offset) &&
+		WritePadded(pFile, streams.data(), streams.size() * sizeof(MeshFileStream), offset) &&
+		WritePadded(pFile, desc.pMeshes, static_cast<uint64_t>(desc.meshCount) * sizeof(MeshFileMesh), offset) &&
+		WritePadded(pFile, desc.pLods, static_cast<uint64_t>(desc.lodCount) * sizeof(MeshFileLod), offset) &&
+		WritePadded(pFile, desc.pMeshlets, static_cast<uint64_t>(desc.meshletCount) * sizeof(Meshlet), offset);
+	for (uint32_t stream = 0; written && stream < desc.streamCount; stream++)
+	{
+		written = WritePadded(pFile, desc.pStreams[stream].pData, static_cast<uint64_t>(desc.vertexCount) * desc.pStreams[stream].stride, offset);
+	}
+
+	// The index data ends the file, unpadded.
+	const uint64_t indexBytes = static_cast<uint64_t>(desc.indexCount) * desc.indexSize;
+	written = written && (indexBytes == 0 || fwrite(desc.pIndices, 1, static_cast<size_t>(indexBytes), pFile) == indexBytes);
+	return fclose(pFile) == 0 && written;
+}
+
+MeshFile::MeshFile() :
+#if defined(_WIN32)
+	m_file(INVALID_HANDLE_VALUE),
+	m_mapping(nullptr),
+#else
+	m_file(-1),
+#endif
+	m_pView(nullptr),
+	m_viewSize(0),
+	m_pHeader(nullptr),
+	m_pStreams(nullptr),
+	m_pMeshes(nullptr),
+	m_pLods(nullptr),
+	m_pMeshlets(nullptr)
+{
+}
+
+MeshFile::~MeshFile()
+{
+	Close();
+}
+
+bool MeshFile::Open(const std::wstring& path)
+{
+	Close();
+
+#if defined(_WIN32)
+	m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	LARGE_INTEGER fileSize;
+	if (m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &fileSize) || static_cast<uint64_t>(fileSize.QuadPart) < sizeof(MeshFileHeader))
+	{
+		Close();
+		return false;
+	}
+	m_viewSize = static_cast<uint64_t>(fileSize.QuadPart);
+
+	m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	m_pView = m_mapping ? static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+#else
+	m_file = open(NarrowPath(path).c_str(), O_RDONLY);
+	struct stat fileStat;
+	if (m_file < 0 || fstat(m_file, &fileStat) != 0 || static_cast<uint64_t>(fileStat.st_size) < sizeof(MeshFileHeader))
+	{
+		Close();
+		return false;
+	}
+	m_viewSize = static_cast<uint64_t>(fileStat.st_size);
+
+	void* pView = mmap(nullptr, static_cast<size_t>(m_viewSize), PROT_READ, MAP_PRIVATE, m_file, 0);
+	if (pView != MAP_FAILED)
+	{
+		// The data is read once, front to back, on its way to the upload ring.
+		madvise(pView, static_cast<size_t>(m_viewSize), MADV_SEQUENTIAL);
+		m_pView = static_cast<const uint8_t*>(pView);
+	}
+#endif
+	if (m_pView == nullptr || !Validate(m_viewSize))
+	{
+		Close();
+		return false;
+	}
+
+	m_pHeader = reinterpret_cast<const MeshFileHeader*>(m_pView);
+	m_pStreams = reinterpret_cast<const MeshFileStream*>(m_pHeader + 1);
+	m_pMeshes = reinterpret_cast<const MeshFileMesh*>(m_pStreams + m_pHeader->streamCount);
+	m_pLods = reinterpret_cast<const MeshFileLod*>(m_pMeshes + m_pHeader->meshCount);
+	m_pMeshlets = reinterpret_cast<const Meshlet*>(m_pLods + m_pHeader->lodCount);
+	return true;
+}
+
+void MeshFile::Close()
+{
+#if defined(_WIN32)
+	if (m_pView)
+	{
+		UnmapViewOfFile(m_pView);
+	}
+	if (m_mapping)
+	{
+		CloseHandle(m_mapping);
+		m_mapping = nullptr;
+	}
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (m_pView)
+	{
+		munmap(const_cast<uint8_t*>(m_pView), static_cast<size_t>(m_viewSize));
+	}
+	if (m_file >= 0)
+	{
+		close(m_file);
+		m_file = -1;
+	}
+#endif
+	m_pView = nullptr;
+	m_viewSize = 0;
+	m_pHeader = nullptr;
+	m_pStreams = nullptr;
+	m_pMeshes = nullptr;
+	m_pLods = nullptr;
+	m_pMeshlets = nullptr;
+}
+
+uint32_t MeshFile::FindStream(EMeshVertexLayout layout, uint32_t stride) const
+{
+	for (uint32_t stream = 0; stream < m_pHeader->streamCount; stream++)
+	{
+		if (m_pStreams[stream].layout == layout && m_pStreams[stream].stride == stride)
+		{
+			return stream;
+		}
+	}
+	return UINT32_MAX;
+}
+
+// Checks every table entry against the file, touching only the tables' pages.
+bool MeshFile::Validate(uint64_t size) const
+{
+	const MeshFileHeader& header = *reinterpret_cast<const MeshFileHeader*>(m_pView);
+	if (header.magic != MeshFileMagic || header.version != MeshFileVersion || header.fileSize != size ||
+		(header.indexSize != 2 && header.indexSize != 4))
+	{
+		return false;
+	}
+
+	const uint64_t tablesSize = GetTablesSize(header.streamCount, header.meshCount, header.lodCount, header.meshletCount);
+	if (tablesSize > size || !IsSectionValid(header.indexOffset, static_cast<uint64_t>(header.indexCount) * header.indexSize, tablesSize, size))
+	{
+		return false;
+	}
+
+	const MeshFileStream* pStreams = reinterpret_cast<const MeshFileStream*>(&header + 1);
+	for (uint32_t stream = 0; stream < header.streamCount; stream++)
+	{
+		if (pStreams[stream].stride == 0 ||
+			!IsSectionValid(pStreams[stream].offset, static_cast<uint64_t>(header.vertexCount) * pStreams[stream].stride, tablesSize, size))
+		{
+			return false;
+		}
+	}
+
+	const MeshFileMesh* pMeshes = reinterpret_cast<const MeshFileMesh*>(pStreams + header.streamCount);
+	for (uint32_t mesh = 0; mesh < header.meshCount; mesh++)
+	{
+		if (pMeshes[mesh].lodCount == 0 || pMeshes[mesh].firstLod > header.lodCount || pMeshes[mesh].lodCount > header.lodCount - pMeshes[mesh].firstLod)
+		{
+			return false;
+		}
+	}
+
+	const MeshFileLod* pLods = reinterpret_cast<const MeshFileLod*>(pMeshes + header.meshCount);
+	const Meshlet* pMeshlets = reinterpret_cast<const Meshlet*>(pLods + header.lodCount);
+	for (uint32_t lod = 0; lod < header.lodCount; lod++)
+	{
+		if (pLods[lod].startIndex > header.indexCount || pLods[lod].indexCount > header.indexCount - pLods[lod].startIndex ||
+			pLods[lod].baseVertex < 0 || static_cast<uint32_t>(pLods[lod].baseVertex) > header.vertexCount ||
+			!AreMeshletsValid(pLods[lod], pMeshlets, header.meshletCount))
+		{
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "Meshlets.h"
+
+// Cooked mesh set: meshes sharing one vertex and one index buffer, each with a
+// chain of LODs. Little-endian, every section 16-byte aligned:
+//     MeshFileHeader
+//     MeshFileStream x streamCount
+//     MeshFileMesh   x meshCount
+//     MeshFileLod    x lodCount
+//     Meshlet        x meshletCount
+//     vertex data of each stream, then the index data
+// The file is memory-mapped and its data is handed out as pointers into the
+// mapping, so vertices and indices go from the page cache to the upload ring
+// without being parsed or copied in between.
+const uint32_t MeshFileMagic = 0x4853454D;     // "MESH"
+const uint32_t MeshFileVersion = 3;
+const uint32_t MeshFileAlignment = 16;
+
+// Vertex layout of a stream. Several streams may describe the same vertices,
+// for example a full one for drawing and a position-only one for depth.
+enum class EMeshVertexLayout : uint32_t
+{
+    PositionTexCoordNormalColor = 0,    // float3, float2, float3, float4: 48 bytes.
+    Packed = 1,                         // PackedVertex, positions quantized across the mesh's bounds: 20 bytes.
+};
+
+struct MeshFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t streamCount;
+    uint32_t meshCount;
+    uint32_t lodCount;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t indexSize;         // 2 or 4 bytes.
+    uint64_t indexOffset;
+    uint64_t fileSize;
+    uint64_t sourceKey;         // Identifies what the file was cooked from, 0 if unknown.
+    uint32_t meshletCount;
+    uint32_t reserved;
+};
+
+struct MeshFileStream
+{
+    EMeshVertexLayout layout;
+    uint32_t stride;
+    uint64_t offset;            // vertexCount * stride bytes from here.
+};
+
+struct MeshFileMesh
+{
+    float boundsCenter[3];      // Object space box around every LOD.
+    float boundsExtents[3];
+    uint32_t firstLod;          // Into the LOD table, finest first.
+    uint32_t lodCount;
+};
+
+// One indexed draw, as DrawIndexedInstanced takes it.
+struct MeshFileLod
+{
+    uint32_t indexCount;
+    uint32_t startIndex;
+    int32_t baseVertex;
+    float geometricError;       // Object space distance to the finest LOD's surface.
+    uint32_t firstMeshlet;      // Into the meshlet table, which splits the LOD's indices; none if meshletCount is 0.
+    uint32_t meshletCount;
+    uint32_t reserved[2];
+};
+
+static_assert(sizeof(MeshFileHeader) % MeshFileAlignment == 0 && sizeof(MeshFileStream) % MeshFileAlignment == 0 &&
+    sizeof(MeshFileMesh) % MeshFileAlignment == 0 && sizeof(MeshFileLod) % MeshFileAlignment == 0 &&
+    sizeof(Meshlet) % MeshFileAlignment == 0, "Mesh file tables must keep sections aligned");
+
+// What WriteMeshFile writes. Each stream's pData holds vertexCount vertices.
+struct MeshFileDesc
+{
+    struct Stream
+    {
+        EMeshVertexLayout layout;
+        uint32_t stride;
+        const void* pData;
+    };
+
+    const Stream* pStreams;
+    uint32_t streamCount;
+    uint32_t vertexCount;
+    const void* pIndices;
+    uint32_t indexSize;
+    uint32_t indexCount;
+    const MeshFileMesh* pMeshes;
+    uint32_t meshCount;
+    const MeshFileLod* pLods;
+    uint32_t lodCount;
+    const Meshlet* pMeshlets;
+    uint32_t meshletCount;
+    uint64_t sourceKey;
+};
+
+// Returns false if the description is inconsistent or the file cannot be written.
+bool WriteMeshFile(const std::wstring& path, const MeshFileDesc& desc);
+
+// Read-only view of a mesh file. Everything is validated when it is opened, so
+// the accessors can trust the tables; index values are not scanned, as the input
+// assembler reads zeros past the end of a vertex buffer. The accessors need an
+// open file, and their pointers stay valid until it is closed.
+class MeshFile
+{
+public:
+    MeshFile();
+    ~MeshFile();
+
+    MeshFile(const MeshFile&) = delete;
+    MeshFile& operator=(const MeshFile&) = delete;
+
+    // Returns false if the file is missing, of another version or malformed.
+    bool Open(const std::wstring& path);
+    void Close();
+
+    bool IsOpen() const { return m_pHeader != nullptr; }
+    uint64_t GetFileSize() const { return m_pHeader->fileSize; }
+    uint64_t GetSourceKey() const { return m_pHeader->sourceKey; }
+    uint32_t GetVertexCount() const { return m_pHeader->vertexCount; }
+    uint32_t GetIndexCount() const { return m_pHeader->indexCount; }
+    uint32_t GetIndexSize() const { return m_pHeader->indexSize; }
+    const void* GetIndexData() const { return m_pView + m_pHeader->indexOffset; }
+
+    uint32_t GetStreamCount() const { return m_pHeader->streamCount; }
+    const MeshFileStream& GetStream(uint32_t stream) const { return m_pStreams[stream]; }
+    const void* GetStreamData(uint32_t stream) const { return m_pView + m_pStreams[stream].offset; }
+
+    // Index of the first stream with the given layout and stride, or UINT32_MAX.
+    uint32_t FindStream(EMeshVertexLayout layout, uint32_t stride) const;
+
+    uint32_t GetMeshCount() const { return m_pHeader->meshCount; }
+    const MeshFileMesh& GetMesh(uint32_t mesh) const { return m_pMeshes[mesh]; }
+    const MeshFileLod& GetLod(uint32_t lod) const { return m_pLods[lod]; }
+    uint32_t GetMeshletCount() const { return m_pHeader->meshletCount; }
+    const Meshlet* GetMeshlets() const { return m_pMeshlets; }
+
+private:
+    bool Validate(uint64_t size) const;
+
+#if defined(_WIN32)
+    void* m_file;
+    void* m_mapping;
+#else
+    int m_file;
+#endif
+    const uint8_t* m_pView;
+    uint64_t m_viewSize;
+    const MeshFileHeader* m_pHeader;
+    const MeshFileStream* m_pStreams;
+    const MeshFileMesh* m_pMeshes;
+    const MeshFileLod* m_pLods;
+    const Meshlet* m_pMeshlets;
+};
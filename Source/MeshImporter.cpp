@@ -0,0 +1,1579 @@
+#include "MeshImporter.h"
+#include "MeshFile.h"
+#include "JobSystem.h"
+#include "VertexPacking.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+namespace
+{
+	const uint64_t FnvOffsetBasis = 14695981039346656037ull;
+	const uint64_t FnvPrime = 1099511628211ull;
+
+	void HashBytes(uint64_t& hash, const void* pData, size_t size)
+	{
+		const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= pBytes[i];
+			hash *= FnvPrime;
+		}
+	}
+
+	// 64-bit hash of a vertex's bits, a word at a time.
+	uint64_t HashVertex(const MeshImportVertex& vertex)
+	{
+		uint32_t words[sizeof(MeshImportVertex) / 4];
+		memcpy(words, &vertex, sizeof(words));
+
+		uint64_t hash = FnvOffsetBasis;
+		for (uint32_t word : words)
+		{
+			hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+			hash ^= hash >> 29;
+		}
+		return hash ^ (hash >> 32);
+	}
+
+	// Calls function(begin, end) over [0, count), in parallel when there is a job system.
+	template<typename F>
+	void ForEachRange(JobSystem* pJobSystem, uint32_t count, uint32_t grainSize, const F& function)
+	{
+		if (pJobSystem == nullptr)
+		{
+			if (count > 0)
+			{
+				function(0u, count);
+			}
+			return;
+		}
+		pJobSystem->ParallelFor(count, grainSize, function);
+	}
+
+#if !defined(_WIN32)
+	// Paths are converted with the current locale.
+	std::string NarrowPath(const std::wstring& path)
+	{
+		std::vector<char> narrow(path.size() * MB_CUR_MAX + 1);
+		const size_t length = wcstombs(narrow.data(), path.c_str(), narrow.size());
+		return length == static_cast<size_t>(-1) ? std::string() : std::string(narrow.data(), length);
+	}
+#endif
+
+	// For error messages only: anything outside ASCII becomes '?'.
+	std::string PathToMessage(const std::wstring& path)
+	{
+		std::string message(path.size(), '?');
+		for (size_t i = 0; i < path.size(); i++)
+		{
+			if (path[i] < 0x80)
+			{
+				message[i] = static_cast<char>(path[i]);
+			}
+		}
+		return message;
+	}
+
+	std::wstring GetDirectory(const std::wstring& path)
+	{
+		const size_t slash = path.find_last_of(L"/\\");
+		return slash == std::wstring::npos ? std::wstring() : path.substr(0, slash + 1);
+	}
+
+	std::wstring GetLowerCaseExtension(const std::wstring& path)
+	{
+		const size_t dot = path.find_last_of(L'.');
+		std::wstring extension = dot == std::wstring::npos ? std::wstring() : path.substr(dot + 1);
+		for (wchar_t& character : extension)
+		{
+			if (character >= L'A' && character <= L'Z')
+			{
+				character = character - L'A' + L'a';
+			}
+		}
+		return extension;
+	}
+
+	struct FileStamp
+	{
+		uint64_t size;
+		int64_t modifiedTime;
+	};
+
+	bool GetFileStamp(const std::wstring& path, FileStamp& stamp)
+	{
+#if defined(_WIN32)
+		struct _stat64 fileStat;
+		if (_wstat64(path.c_str(), &fileStat) != 0)
+#else
+		struct stat fileStat;
+		if (stat(NarrowPath(path).c_str(), &fileStat) != 0)
+#endif
+		{
+			return false;
+		}
+		stamp.size = static_cast<uint64_t>(fileStat.st_size);
+		stamp.modifiedTime = static_cast<int64_t>(fileStat.st_mtime);
+		return true;
+	}
+
+	bool ReadWholeFile(const std::wstring& path, std::vector<char>& data)
+	{
+		FileStamp stamp;
+		if (!GetFileStamp(path, stamp) || stamp.size > SIZE_MAX)
+		{
+			return false;
+		}
+
+#if defined(_WIN32)
+		FILE* pFile = nullptr;
+		if (_wfopen_s(&pFile, path.c_str(), L"rb") != 0)
+		{
+			return false;
+		}
+#else
+		FILE* pFile = fopen(NarrowPath(path).c_str(), "rb");
+		if (pFile == nullptr)
+		{
+			return false;
+		}
+#endif
+		data.resize(static_cast<size_t>(stamp.size));
+		const bool read = data.empty() || fread(data.data(), 1, data.size(), pFile) == data.size();
+		fclose(pFile);
+		return read;
+	}
+
+	// Text parsing. Every function takes the current position by reference and
+	// never reads at or past pEnd.
+	bool IsDigit(char character)
+	{
+		return character >= '0' && character <= '9';
+	}
+
+	const char* SkipSpaces(const char* p, const char* pEnd)
+	{
+		while (p < pEnd && (*p == ' ' || *p == '\t' || *p == '\r'))
+		{
+			p++;
+		}
+		return p;
+	}
+
+	// Decimal number such as -1.25e-3. Exact for the short mantissas exporters
+	// write; longer ones may round differently from strtod in the last bit.
+	bool ParseDouble(const char*& p, const char* pEnd, double& value)
+	{
+		static const double powersOfTen[] =
+		{
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+		};
+
+		const char* s = p;
+		const bool negative = s < pEnd && *s == '-';
+		if (s < pEnd && (*s == '-' || *s == '+'))
+		{
+			s++;
+		}
+
+		uint64_t mantissa = 0;
+		int exponent = 0;
+		bool anyDigits = false;
+		for (; s < pEnd && IsDigit(*s); s++, anyDigits = true)
+		{
+			if (mantissa < 100000000000000000ull)
+			{
+				mantissa = mantissa * 10 + (*s - '0');
+			}
+			else
+			{
+				exponent++;
+			}
+		}
+		if (s < pEnd && *s == '.')
+		{
+			for (s++; s < pEnd && IsDigit(*s); s++, anyDigits = true)
+			{
+				if (mantissa < 100000000000000000ull)
+				{
+					mantissa = mantissa * 10 + (*s - '0');
+					exponent--;
+				}
+			}
+		}
+		if (!anyDigits)
+		{
+			return false;
+		}
+
+		if (s < pEnd && (*s == 'e' || *s == 'E'))
+		{
+			const char* e = s + 1;
+			const bool negativeExponent = e < pEnd && *e == '-';
+			if (e < pEnd && (*e == '-' || *e == '+'))
+			{
+				e++;
+			}
+			if (e < pEnd && IsDigit(*e))
+			{
+				int exponentValue = 0;
+				for (; e < pEnd && IsDigit(*e); e++)
+				{
+					exponentValue = std::min(exponentValue * 10 + (*e - '0'), 10000);
+				}
+				exponent += negativeExponent ? -exponentValue : exponentValue;
+				s = e;
+			}
+		}
+
+		// Dividing by an exact power of ten rounds once, unlike multiplying by an inexact inverse.
+		double result = static_cast<double>(mantissa);
+		if (exponent >= 0)
+		{
+			result = exponent <= 22 ? result * powersOfTen[exponent] : result * pow(10.0, exponent);
+		}
+		else
+		{
+			result = exponent >= -22 ? result / powersOfTen[-exponent] : result * pow(10.0, exponent);
+		}
+
+		value = negative ? -result : result;
+		p = s;
+		return true;
+	}
+
+	bool ParseFloat(const char*& p, const char* pEnd, float& value)
+	{
+		double result;
+		if (!ParseDouble(p, pEnd, result))
+		{
+			return false;
+		}
+		value = static_cast<float>(result);
+		return true;
+	}
+
+	bool ParseInteger(const char*& p, const char* pEnd, int64_t& value)
+	{
+		const char* s = p;
+		const bool negative = s < pEnd && *s == '-';
+		if (s < pEnd && (*s == '-' || *s == '+'))
+		{
+			s++;
+		}
+		if (s == pEnd || !IsDigit(*s))
+		{
+			return false;
+		}
+
+		int64_t result = 0;
+		for (; s < pEnd && IsDigit(*s); s++)
+		{
+			result = std::min<int64_t>(result * 10 + (*s - '0'), INT64_C(1) << 40);
+		}
+		value = negative ? -result : result;
+		p = s;
+		return true;
+	}
+
+	// In double precision, so that the triangles of a flat polygon usually get the very same normal and weld.
+	void SetFaceNormal(MeshImportVertex* pTriangle, const bool (&hasNormal)[3])
+	{
+		const float* p0 = pTriangle[0].position;
+		const float* p1 = pTriangle[1].position;
+		const float* p2 = pTriangle[2].position;
+		const double e1[3] = { static_cast<double>(p1[0]) - p0[0], static_cast<double>(p1[1]) - p0[1], static_cast<double>(p1[2]) - p0[2] };
+		const double e2[3] = { static_cast<double>(p2[0]) - p0[0], static_cast<double>(p2[1]) - p0[1], static_cast<double>(p2[2]) - p0[2] };
+		const double cross[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+
+		const double length = sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+		float normal[3] = { 0.0f, 1.0f, 0.0f };
+		if (length > 0.0)
+		{
+			normal[0] = static_cast<float>(cross[0] / length);
+			normal[1] = static_cast<float>(cross[1] / length);
+			normal[2] = static_cast<float>(cross[2] / length);
+		}
+
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			if (!hasNormal[corner])
+			{
+				memcpy(pTriangle[corner].normal, normal, sizeof(normal));
+			}
+		}
+	}
+
+	// OBJ. Indices are resolved to zero-based ones while parsing; UINT32_MAX is absent.
+	struct ObjCorner
+	{
+		uint32_t position;
+		uint32_t texCoord;
+		uint32_t normal;
+	};
+
+	struct ObjChunk
+	{
+		const char* pBegin;
+		const char* pEnd;
+		uint32_t positionBase;          // Counts in the first pass, then the counts of the chunks before.
+		uint32_t texCoordBase;
+		uint32_t normalBase;
+		std::vector<ObjCorner> corners; // Three per triangle, already in the engine's winding.
+		const char* pErrorLine;
+	};
+
+	enum class EObjLine
+	{
+		Other,
+		Position,
+		TexCoord,
+		Normal,
+		Face,
+	};
+
+	// Classifies the line and moves p past its keyword.
+	EObjLine ClassifyObjLine(const char*& p, const char* pLineEnd)
+	{
+		p = SkipSpaces(p, pLineEnd);
+		const ptrdiff_t length = pLineEnd - p;
+		if (length >= 2 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			p += 2;
+			return EObjLine::Position;
+		}
+		if (length >= 3 && p[0] == 'v' && (p[1] == 't' || p[1] == 'n') && (p[2] == ' ' || p[2] == '\t'))
+		{
+			const EObjLine type = p[1] == 't' ? EObjLine::TexCoord : EObjLine::Normal;
+			p += 3;
+			return type;
+		}
+		if (length >= 2 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			p += 2;
+			return EObjLine::Face;
+		}
+		return EObjLine::Other;
+	}
+
+	const char* FindLineEnd(const char* p, const char* pEnd)
+	{
+		const char* pNewline = static_cast<const char*>(memchr(p, '\n', pEnd - p));
+		return pNewline ? pNewline : pEnd;
+	}
+
+	// One-based, or negative relative to count, the number defined so far.
+	bool ResolveObjIndex(int64_t index, uint32_t count, uint32_t total, uint32_t& resolved)
+	{
+		const int64_t zeroBased = index > 0 ? index - 1 : static_cast<int64_t>(count) + index;
+		if (index == 0 || zeroBased < 0 || zeroBased >= total)
+		{
+			return false;
+		}
+		resolved = static_cast<uint32_t>(zeroBased);
+		return true;
+	}
+
+	// Minimal JSON DOM for glTF. Objects keep their keys in order alongside their values.
+	struct JsonValue
+	{
+		enum class EType
+		{
+			Null,
+			Bool,
+			Number,
+			String,
+			Array,
+			Object,
+		};
+
+		EType type = EType::Null;
+		bool boolean = false;
+		double number = 0.0;
+		std::string string;
+		std::vector<std::string> keys;          // Of an object, one per element.
+		std::vector<JsonValue> elements;
+
+		const JsonValue* Find(const char* key) const
+		{
+			for (size_t i = 0; type == EType::Object && i < keys.size(); i++)
+			{
+				if (keys[i] == key)
+				{
+					return &elements[i];
+				}
+			}
+			return nullptr;
+		}
+
+		double GetNumber(const char* key, double fallback) const
+		{
+			const JsonValue* pValue = Find(key);
+			return pValue && pValue->type == EType::Number ? pValue->number : fallback;
+		}
+
+		// Indices, counts and byte sizes must be integers that fit T before they are
+		// cast; anything negative, fractional, non-finite or too large fails.
+		template <typename T>
+		bool GetIndexNumber(const char* key, double fallback, T& value) const
+		{
+			const double number = GetNumber(key, fallback);
+			if (!(number >= 0.0 && number < static_cast<double>(std::numeric_limits<T>::max()) + 1.0) || number != std::floor(number))
+			{
+				return false;
+			}
+			value = static_cast<T>(number);
+			return true;
+		}
+
+		const JsonValue* GetElement(const char* key, double index) const
+		{
+			const JsonValue* pArray = Find(key);
+			if (pArray == nullptr || pArray->type != EType::Array || !(index >= 0.0 && index < pArray->elements.size()) || index != std::floor(index))
+			{
+				return nullptr;
+			}
+			return &pArray->elements[static_cast<size_t>(index)];
+		}
+	};
+
+	void AppendUtf8(std::string& string, uint32_t codePoint)
+	{
+		if (codePoint < 0x80)
+		{
+			string += static_cast<char>(codePoint);
+		}
+		else if (codePoint < 0x800)
+		{
+			string += static_cast<char>(0xc0 | (codePoint >> 6));
+			string += static_cast<char>(0x80 | (codePoint & 0x3f));
+		}
+		else
+		{
+			string += static_cast<char>(0xe0 | (codePoint >> 12));
+			string += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+			string += static_cast<char>(0x80 | (codePoint & 0x3f));
+		}
+	}
+
+	bool ParseJsonString(const char*& p, const char* pEnd, std::string& string)
+	{
+		if (p == pEnd || *p != '"')
+		{
+			return false;
+		}
+		for (p++; p < pEnd && *p != '"'; p++)
+		{
+			if (*p != '\\')
+			{
+				string += *p;
+				continue;
+			}
+			if (++p == pEnd)
+			{
+				return false;
+			}
+			switch (*p)
+			{
+			case 'b': string += '\b'; break;
+			case 'f': string += '\f'; break;
+			case 'n': string += '\n'; break;
+			case 'r': string += '\r'; break;
+			case 't': string += '\t'; break;
+			case 'u':
+			{
+				// Surrogate pairs are kept as two three-byte sequences; glTF keys and URIs do not need them.
+				uint32_t codePoint = 0;
+				for (uint32_t digit = 0; digit < 4; digit++)
+				{
+					if (++p == pEnd)
+					{
+						return false;
+					}
+					const char c = *p;
+					const uint32_t value = IsDigit(c) ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : 16;
+					if (value == 16)
+					{
+						return false;
+					}
+					codePoint = codePoint * 16 + value;
+				}
+				AppendUtf8(string, codePoint);
+				break;
+			}
+			default: string += *p; break;
+			}
+		}
+		if (p == pEnd)
+		{
+			return false;
+		}
+		p++;
+		return true;
+	}
+
+	const char* SkipJsonSpaces(const char* p, const char* pEnd)
+	{
+		while (p < pEnd && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+		{
+			p++;
+		}
+		return p;
+	}
+
+	bool ParseJson(const char*& p, const char* pEnd, JsonValue& value, uint32_t depth)
+	{
+		p = SkipJsonSpaces(p, pEnd);
+		if (p == pEnd || depth > 64)
+		{
+			return false;
+		}
+
+		if (*p == '{' || *p == '[')
+		{
+			const bool isObject = *p == '{';
+			const char close = isObject ? '}' : ']';
+			value.type = isObject ? JsonValue::EType::Object : JsonValue::EType::Array;
+			p = SkipJsonSpaces(p + 1, pEnd);
+			if (p < pEnd && *p == close)
+			{
+				p++;
+				return true;
+			}
+			for (;;)
+			{
+				if (isObject)
+				{
+					value.keys.emplace_back();
+					p = SkipJsonSpaces(p, pEnd);
+					if (!ParseJsonString(p, pEnd, value.keys.back()))
+					{
+						return false;
+					}
+					p = SkipJsonSpaces(p, pEnd);
+					if (p == pEnd || *p++ != ':')
+					{
+						return false;
+					}
+				}
+				value.elements.emplace_back();
+				if (!ParseJson(p, pEnd, value.elements.back(), depth + 1))
+				{
+					return false;
+				}
+				p = SkipJsonSpaces(p, pEnd);
+				if (p < pEnd && *p == ',')
+				{
+					p++;
+					continue;
+				}
+				if (p < pEnd && *p == close)
+				{
+					p++;
+					return true;
+				}
+				return false;
+			}
+		}
+
+		if (*p == '"')
+		{
+			value.type = JsonValue::EType::String;
+			return ParseJsonString(p, pEnd, value.string);
+		}
+
+		static const char* const literals[] = { "true", "false", "null" };
+		for (uint32_t literal = 0; literal < 3; literal++)
+		{
+			const size_t length = strlen(literals[literal]);
+			if (static_cast<size_t>(pEnd - p) >= length && memcmp(p, literals[literal], length) == 0)
+			{
+				value.type = literal == 2 ? JsonValue::EType::Null : JsonValue::EType::Bool;
+				value.boolean = literal == 0;
+				p += length;
+				return true;
+			}
+		}
+
+		value.type = JsonValue::EType::Number;
+		return ParseDouble(p, pEnd, value.number);
+	}
+
+	bool DecodeBase64(const char* p, const char* pEnd, std::vector<uint8_t>& data)
+	{
+		uint32_t bits = 0;
+		uint32_t bitCount = 0;
+		for (; p < pEnd && *p != '='; p++)
+		{
+			const char c = *p;
+			const uint32_t value = (c >= 'A' && c <= 'Z') ? c - 'A' : (c >= 'a' && c <= 'z') ? c - 'a' + 26 :
+				IsDigit(c) ? c - '0' + 52 : c == '+' ? 62 : c == '/' ? 63 : 64;
+			if (value == 64)
+			{
+				return false;
+			}
+			bits = (bits << 6) | value;
+			bitCount += 6;
+			if (bitCount >= 8)
+			{
+				bitCount -= 8;
+				data.push_back(static_cast<uint8_t>(bits >> bitCount));
+			}
+		}
+		return true;
+	}
+
+	// glTF accessor, validated against its buffer view.
+	struct GltfAccessor
+	{
+		const uint8_t* pData;
+		uint32_t count;
+		uint32_t stride;
+		uint32_t componentType;
+		uint32_t componentCount;
+		bool normalized;
+	};
+
+	struct GltfBuffer
+	{
+		const uint8_t* pData;
+		uint64_t size;
+	};
+
+	const uint32_t GltfByte = 5120;
+	const uint32_t GltfUnsignedByte = 5121;
+	const uint32_t GltfShort = 5122;
+	const uint32_t GltfUnsignedShort = 5123;
+	const uint32_t GltfUnsignedInt = 5125;
+	const uint32_t GltfFloat = 5126;
+	const uint32_t GltfTriangles = 4;
+
+	uint32_t GetComponentSize(uint32_t componentType)
+	{
+		switch (componentType)
+		{
+		case GltfByte:
+		case GltfUnsignedByte: return 1;
+		case GltfShort:
+		case GltfUnsignedShort: return 2;
+		case GltfUnsignedInt:
+		case GltfFloat: return 4;
+		default: return 0;
+		}
+	}
+
+	bool GetGltfAccessor(const JsonValue& root, const std::vector<GltfBuffer>& buffers, double index, GltfAccessor& accessor)
+	{
+		const JsonValue* pAccessor = root.GetElement("accessors", index);
+		const JsonValue* pView = pAccessor ? root.GetElement("bufferViews", pAccessor->GetNumber("bufferView", -1.0)) : nullptr;
+		const JsonValue* pType = pAccessor ? pAccessor->Find("type") : nullptr;
+		if (pView == nullptr || pType == nullptr || pAccessor->Find("sparse") != nullptr)
+		{
+			return false;
+		}
+
+		static const char* const types[] = { "SCALAR", "VEC2", "VEC3", "VEC4" };
+		accessor.componentCount = 0;
+		for (uint32_t type = 0; type < 4; type++)
+		{
+			accessor.componentCount = pType->string == types[type] ? type + 1 : accessor.componentCount;
+		}
+
+		uint32_t buffer = 0;
+		if (!pView->GetIndexNumber("buffer", -1.0, buffer) || !pAccessor->GetIndexNumber("componentType", 0.0, accessor.componentType) ||
+			!pAccessor->GetIndexNumber("count", 0.0, accessor.count))
+		{
+			return false;
+		}
+
+		const uint32_t elementSize = GetComponentSize(accessor.componentType) * accessor.componentCount;
+		const JsonValue* pNormalized = pAccessor->Find("normalized");
+		accessor.normalized = pNormalized && pNormalized->boolean;
+		uint64_t viewOffset = 0;
+		uint64_t viewLength = 0;
+		uint64_t accessorOffset = 0;
+		if (!pView->GetIndexNumber("byteStride", elementSize, accessor.stride) || !pView->GetIndexNumber("byteOffset", 0.0, viewOffset) ||
+			!pView->GetIndexNumber("byteLength", 0.0, viewLength) || !pAccessor->GetIndexNumber("byteOffset", 0.0, accessorOffset) ||
+			elementSize == 0 || buffer >= buffers.size() || accessor.stride < elementSize)
+		{
+			return false;
+		}
+
+		const GltfBuffer& source = buffers[buffer];
+		const uint64_t accessorSize = accessor.count == 0 ? 0 : static_cast<uint64_t>(accessor.count - 1) * accessor.stride + elementSize;
+		if (viewOffset > source.size || viewLength > source.size - viewOffset || accessorOffset > viewLength || accessorSize > viewLength - accessorOffset)
+		{
+			return false;
+		}
+
+		accessor.pData = source.pData + viewOffset + accessorOffset;
+		return true;
+	}
+
+	// Reads up to count components of one element as floats, converting normalized integers.
+	void ReadGltfFloats(const GltfAccessor& accessor, uint32_t element, float* pValues, uint32_t count)
+	{
+		const uint8_t* pElement = accessor.pData + static_cast<size_t>(element) * accessor.stride;
+		count = std::min(count, accessor.componentCount);
+		for (uint32_t component = 0; component < count; component++)
+		{
+			switch (accessor.componentType)
+			{
+			case GltfFloat:
+				memcpy(&pValues[component], pElement + component * 4, 4);
+				break;
+			case GltfUnsignedByte:
+				pValues[component] = accessor.normalized ? pElement[component] / 255.0f : pElement[component];
+				break;
+			case GltfByte:
+			{
+				const int8_t value = static_cast<int8_t>(pElement[component]);
+				pValues[component] = accessor.normalized ? std::max(value / 127.0f, -1.0f) : value;
+				break;
+			}
+			case GltfUnsignedShort:
+			{
+				uint16_t value;
+				memcpy(&value, pElement + component * 2, 2);
+				pValues[component] = accessor.normalized ? value / 65535.0f : value;
+				break;
+			}
+			case GltfShort:
+			{
+				int16_t value;
+				memcpy(&value, pElement + component * 2, 2);
+				pValues[component] = accessor.normalized ? std::max(value / 32767.0f, -1.0f) : value;
+				break;
+			}
+			default:
+				uint32_t value;
+				memcpy(&value, pElement + component * 4, 4);
+				pValues[component] = static_cast<float>(value);
+				break;
+			}
+		}
+	}
+
+	uint32_t ReadGltfIndex(const GltfAccessor& accessor, uint32_t element)
+	{
+		const uint8_t* pElement = accessor.pData + static_cast<size_t>(element) * accessor.stride;
+		if (accessor.componentType == GltfUnsignedByte)
+		{
+			return *pElement;
+		}
+		if (accessor.componentType == GltfUnsignedShort)
+		{
+			uint16_t value;
+			memcpy(&value, pElement, 2);
+			return value;
+		}
+		uint32_t value;
+		memcpy(&value, pElement, 4);
+		return value;
+	}
+
+	const uint32_t GlbMagic = 0x46546C67;           // "glTF"
+	const uint32_t GlbJsonChunk = 0x4E4F534A;       // "JSON"
+	const uint32_t GlbBinaryChunk = 0x004E4942;     // "BIN\0"
+
+	// External buffers of a glTF file, for the cache key. Data URIs and the GLB chunk have no file.
+	void GetGltfDependencies(const std::wstring& path, const JsonValue& root, std::vector<std::wstring>& dependencies)
+	{
+		const JsonValue* pBuffers = root.Find("buffers");
+		for (size_t i = 0; pBuffers && pBuffers->type == JsonValue::EType::Array && i < pBuffers->elements.size(); i++)
+		{
+			const JsonValue* pUri = pBuffers->elements[i].Find("uri");
+			if (pUri && pUri->type == JsonValue::EType::String && pUri->string.compare(0, 5, "data:") != 0)
+			{
+				// Only plain ASCII URIs are supported; they are not percent-decoded.
+				dependencies.push_back(GetDirectory(path) + std::wstring(pUri->string.begin(), pUri->string.end()));
+			}
+		}
+	}
+}
+
+MeshImporter::MeshImporter(JobSystem* pJobSystem) :
+	m_pJobSystem(pJobSystem),
+	m_stats()
+{
+}
+
+bool MeshImporter::Fail(const std::string& error)
+{
+	m_error = error;
+	return false;
+}
+
+bool MeshImporter::Import(const std::wstring& path, ImportedMesh& mesh)
+{
+	std::vector<char> file;
+	if (!ReadWholeFile(path, file))
+	{
+		return Fail(PathToMessage(path) + ": cannot be read");
+	}
+
+	const std::wstring extension = GetLowerCaseExtension(path);
+	bool imported = false;
+	if (extension == L"obj")
+	{
+		imported = ImportObj(file);
+	}
+	else if (extension == L"gltf" || extension == L"glb")
+	{
+		imported = ImportGltf(path, file);
+	}
+	else
+	{
+		m_error = "unknown file type";
+	}
+
+	if (!imported)
+	{
+		return Fail(PathToMessage(path) + ": " + m_error);
+	}
+
+	Weld(mesh);
+	return true;
+}
+
+bool MeshImporter::ImportObj(const std::vector<char>& text)
+{
+	const char* pText = text.data();
+	const char* pTextEnd = pText + text.size();
+
+	// Chunks of whole lines.
+	std::vector<ObjChunk> chunks;
+	for (const char* p = pText; p < pTextEnd;)
+	{
+		const char* pChunkEnd = pTextEnd - p > static_cast<ptrdiff_t>(ObjChunkSize) ? FindLineEnd(p + ObjChunkSize, pTextEnd) : pTextEnd;
+		pChunkEnd = pChunkEnd < pTextEnd ? pChunkEnd + 1 : pChunkEnd;
+		chunks.push_back({ p, pChunkEnd, 0, 0, 0, {}, nullptr });
+		p = pChunkEnd;
+	}
+	const uint32_t chunkCount = static_cast<uint32_t>(chunks.size());
+
+	// First pass: count what each chunk defines.
+	ForEachRange(m_pJobSystem, chunkCount, 1, [&chunks](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			ObjChunk& chunk = chunks[i];
+			for (const char* p = chunk.pBegin; p < chunk.pEnd;)
+			{
+				const char* pLineEnd = FindLineEnd(p, chunk.pEnd);
+				switch (ClassifyObjLine(p, pLineEnd))
+				{
+				case EObjLine::Position: chunk.positionBase++; break;
+				case EObjLine::TexCoord: chunk.texCoordBase++; break;
+				case EObjLine::Normal: chunk.normalBase++; break;
+				default: break;
+				}
+				p = pLineEnd + 1;
+			}
+		}
+	});
+
+	uint32_t positionCount = 0;
+	uint32_t texCoordCount = 0;
+	uint32_t normalCount = 0;
+	for (ObjChunk& chunk : chunks)
+	{
+		std::swap(positionCount, chunk.positionBase);
+		std::swap(texCoordCount, chunk.texCoordBase);
+		std::swap(normalCount, chunk.normalBase);
+		positionCount += chunk.positionBase;
+		texCoordCount += chunk.texCoordBase;
+		normalCount += chunk.normalBase;
+	}
+
+	// Second pass: parse into the shared arrays and resolve the faces' indices.
+	std::vector<float> positions(positionCount * 3);
+	std::vector<float> colors(positionCount * 3, 1.0f);
+	std::vector<float> texCoords(texCoordCount * 2);
+	std::vector<float> normals(normalCount * 3);
+	ForEachRange(m_pJobSystem, chunkCount, 1, [&](uint32_t begin, uint32_t end)
+	{
+		std::vector<ObjCorner> face;
+		for (uint32_t i = begin; i < end; i++)
+		{
+			ObjChunk& chunk = chunks[i];
+			uint32_t position = chunk.positionBase;
+			uint32_t texCoord = chunk.texCoordBase;
+			uint32_t normal = chunk.normalBase;
+			for (const char* pLine = chunk.pBegin; pLine < chunk.pEnd && chunk.pErrorLine == nullptr;)
+			{
+				const char* pLineEnd = FindLineEnd(pLine, chunk.pEnd);
+				const char* p = pLine;
+				bool valid = true;
+				switch (ClassifyObjLine(p, pLineEnd))
+				{
+				case EObjLine::Position:
+				{
+					// x y z, then either w or the r g b of the vertex color extension.
+					float* pPosition = &positions[position * 3];
+					for (uint32_t component = 0; component < 3 && valid; component++)
+					{
+						p = SkipSpaces(p, pLineEnd);
+						valid = ParseFloat(p, pLineEnd, pPosition[component]);
+					}
+					float extra[3];
+					uint32_t extraCount = 0;
+					for (p = SkipSpaces(p, pLineEnd); extraCount < 3 && ParseFloat(p, pLineEnd, extra[extraCount]); p = SkipSpaces(p, pLineEnd))
+					{
+						extraCount++;
+					}
+					if (extraCount == 3)
+					{
+						memcpy(&colors[position * 3], extra, sizeof(extra));
+					}
+					position++;
+					break;
+				}
+				case EObjLine::TexCoord:
+				{
+					float* pTexCoord = &texCoords[texCoord * 2];
+					p = SkipSpaces(p, pLineEnd);
+					valid = ParseFloat(p, pLineEnd, pTexCoord[0]);
+					p = SkipSpaces(p, pLineEnd);
+					if (!ParseFloat(p, pLineEnd, pTexCoord[1]))
+					{
+						pTexCoord[1] = 0.0f;
+					}
+					texCoord++;
+					break;
+				}
+				case EObjLine::Normal:
+				{
+					float* pNormal = &normals[normal * 3];
+					for (uint32_t component = 0; component < 3 && valid; component++)
+					{
+						p = SkipSpaces(p, pLineEnd);
+						valid = ParseFloat(p, pLineEnd, pNormal[component]);
+					}
+					normal++;
+					break;
+				}
+				case EObjLine::Face:
+				{
+					// v, v/vt, v//vn or v/vt/vn per corner.
+					face.clear();
+					for (p = SkipSpaces(p, pLineEnd); valid && p < pLineEnd; p = SkipSpaces(p, pLineEnd))
+					{
+						ObjCorner corner = { UINT32_MAX, UINT32_MAX, UINT32_MAX };
+						int64_t index;
+						valid = ParseInteger(p, pLineEnd, index) && ResolveObjIndex(index, position, positionCount, corner.position);
+						if (valid && p < pLineEnd && *p == '/')
+						{
+							p++;
+							if (p < pLineEnd && *p != '/')
+							{
+								valid = ParseInteger(p, pLineEnd, index) && ResolveObjIndex(index, texCoord, texCoordCount, corner.texCoord);
+							}
+							if (valid && p < pLineEnd && *p == '/')
+							{
+								p++;
+								valid = ParseInteger(p, pLineEnd, index) && ResolveObjIndex(index, normal, normalCount, corner.normal);
+							}
+						}
+						valid = valid && (p == pLineEnd || *p == ' ' || *p == '\t' || *p == '\r');
+						face.push_back(corner);
+					}
+
+					// A fan, wound the other way for the left-handed space.
+					valid = valid && face.size() >= 3;
+					for (size_t corner = 2; valid && corner < face.size(); corner++)
+					{
+						chunk.corners.push_back(face[0]);
+						chunk.corners.push_back(face[corner]);
+						chunk.corners.push_back(face[corner - 1]);
+					}
+					break;
+				}
+				default:
+					break;
+				}
+
+				chunk.pErrorLine = valid ? nullptr : pLine;
+				pLine = pLineEnd + 1;
+			}
+		}
+	});
+
+	std::vector<uint32_t> cornerOffsets(chunkCount + 1, 0);
+	for (uint32_t i = 0; i < chunkCount; i++)
+	{
+		if (chunks[i].pErrorLine)
+		{
+			const char* pLineEnd = FindLineEnd(chunks[i].pErrorLine, pTextEnd);
+			return Fail("malformed line \"" + std::string(chunks[i].pErrorLine, std::min<ptrdiff_t>(pLineEnd - chunks[i].pErrorLine, 80)) + "\"");
+		}
+		if (chunks[i].corners.size() > UINT32_MAX - cornerOffsets[i])
+		{
+			return Fail("too many triangles");
+		}
+		cornerOffsets[i + 1] = cornerOffsets[i] + static_cast<uint32_t>(chunks[i].corners.size());
+	}
+	if (cornerOffsets[chunkCount] == 0)
+	{
+		return Fail("no faces");
+	}
+
+	// Gather every corner's attributes in the engine's space.
+	m_corners.resize(cornerOffsets[chunkCount]);
+	ForEachRange(m_pJobSystem, chunkCount, 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const std::vector<ObjCorner>& corners = chunks[i].corners;
+			MeshImportVertex* pVertices = &m_corners[cornerOffsets[i]];
+			for (size_t triangle = 0; triangle < corners.size(); triangle += 3)
+			{
+				bool hasNormal[3];
+				for (uint32_t c = 0; c < 3; c++)
+				{
+					const ObjCorner& corner = corners[triangle + c];
+					MeshImportVertex& vertex = pVertices[triangle + c];
+					const float* pPosition = &positions[corner.position * 3];
+					const float* pColor = &colors[corner.position * 3];
+					vertex.position[0] = pPosition[0];
+					vertex.position[1] = pPosition[1];
+					vertex.position[2] = -pPosition[2];
+					vertex.texCoord[0] = corner.texCoord != UINT32_MAX ? texCoords[corner.texCoord * 2] : 0.0f;
+					vertex.texCoord[1] = corner.texCoord != UINT32_MAX ? 1.0f - texCoords[corner.texCoord * 2 + 1] : 0.0f;
+					hasNormal[c] = corner.normal != UINT32_MAX;
+					if (hasNormal[c])
+					{
+						vertex.normal[0] = normals[corner.normal * 3];
+						vertex.normal[1] = normals[corner.normal * 3 + 1];
+						vertex.normal[2] = -normals[corner.normal * 3 + 2];
+					}
+					vertex.color[0] = pColor[0];
+					vertex.color[1] = pColor[1];
+					vertex.color[2] = pColor[2];
+					vertex.color[3] = 1.0f;
+				}
+				if (!hasNormal[0] || !hasNormal[1] || !hasNormal[2])
+				{
+					SetFaceNormal(&pVertices[triangle], hasNormal);
+				}
+			}
+		}
+	});
+	return true;
+}
+
+bool MeshImporter::ImportGltf(const std::wstring& path, const std::vector<char>& file)
+{
+	// A .glb is a header followed by a JSON chunk and an optional binary chunk.
+	const char* pJson = file.data();
+	const char* pJsonEnd = pJson + file.size();
+	GltfBuffer binaryChunk = { nullptr, 0 };
+	uint32_t header[5] = {};        // Magic, version, length, then the JSON chunk's length and type.
+	if (file.size() >= sizeof(header))
+	{
+		memcpy(header, file.data(), sizeof(header));
+	}
+	if (header[0] == GlbMagic)
+	{
+		if (header[1] != 2 || header[2] > file.size() || header[2] < sizeof(header) || header[4] != GlbJsonChunk || header[3] > header[2] - sizeof(header))
+		{
+			return Fail("malformed GLB header");
+		}
+		pJson = file.data() + sizeof(header);
+		pJsonEnd = pJson + header[3];
+
+		const uint64_t binaryOffset = sizeof(header) + ((header[3] + 3ull) & ~3ull);
+		uint32_t chunkHeader[2];
+		if (binaryOffset + sizeof(chunkHeader) <= header[2])
+		{
+			memcpy(chunkHeader, file.data() + binaryOffset, sizeof(chunkHeader));
+			if (chunkHeader[1] == GlbBinaryChunk && chunkHeader[0] <= header[2] - binaryOffset - sizeof(chunkHeader))
+			{
+				binaryChunk = { reinterpret_cast<const uint8_t*>(file.data() + binaryOffset + sizeof(chunkHeader)), chunkHeader[0] };
+			}
+		}
+	}
+
+	JsonValue root;
+	if (!ParseJson(pJson, pJsonEnd, root, 0) || root.type != JsonValue::EType::Object)
+	{
+		return Fail("malformed JSON");
+	}
+
+	// Buffers come from data URIs, files next to the source or the GLB binary chunk.
+	const JsonValue* pBuffers = root.Find("buffers");
+	const size_t bufferCount = pBuffers && pBuffers->type == JsonValue::EType::Array ? pBuffers->elements.size() : 0;
+	std::vector<std::vector<uint8_t>> bufferData(bufferCount);
+	std::vector<GltfBuffer> buffers(bufferCount);
+	for (size_t i = 0; i < bufferCount; i++)
+	{
+		const JsonValue& buffer = pBuffers->elements[i];
+		const JsonValue* pUri = buffer.Find("uri");
+		if (pUri == nullptr && i == 0 && binaryChunk.pData)
+		{
+			buffers[i] = binaryChunk;
+		}
+		else if (pUri && pUri->string.compare(0, 5, "data:") == 0)
+		{
+			const size_t comma = pUri->string.find(";base64,");
+			if (comma == std::string::npos || !DecodeBase64(pUri->string.data() + comma + 8, pUri->string.data() + pUri->string.size(), bufferData[i]))
+			{
+				return Fail("malformed data URI in buffer " + std::to_string(i));
+			}
+			buffers[i] = { bufferData[i].data(), bufferData[i].size() };
+		}
+		else if (pUri)
+		{
+			std::vector<char> data;
+			const std::wstring bufferPath = GetDirectory(path) + std::wstring(pUri->string.begin(), pUri->string.end());
+			if (!ReadWholeFile(bufferPath, data))
+			{
+				return Fail("cannot read buffer " + pUri->string);
+			}
+			bufferData[i].assign(data.begin(), data.end());
+			buffers[i] = { bufferData[i].data(), bufferData[i].size() };
+		}
+		else
+		{
+			return Fail("buffer " + std::to_string(i) + " has no data");
+		}
+
+		uint64_t byteLength = 0;
+		if (!buffer.GetIndexNumber("byteLength", 0.0, byteLength) || buffers[i].size < byteLength)
+		{
+			return Fail("buffer " + std::to_string(i) + " is shorter than its byteLength");
+		}
+	}
+
+	// Every triangle primitive of every mesh.
+	struct Primitive
+	{
+		GltfAccessor positions;
+		GltfAccessor normals;
+		GltfAccessor texCoords;
+		GltfAccessor colors;
+		GltfAccessor indices;
+		bool hasNormals;
+		bool hasTexCoords;
+		bool hasColors;
+		bool hasIndices;
+		uint32_t triangleCount;
+		uint32_t firstCorner;
+	};
+
+	std::vector<Primitive> primitives;
+	const JsonValue* pMeshes = root.Find("meshes");
+	uint64_t cornerCount = 0;
+	for (size_t meshIndex = 0; pMeshes && pMeshes->type == JsonValue::EType::Array && meshIndex < pMeshes->elements.size(); meshIndex++)
+	{
+		const JsonValue* pPrimitives = pMeshes->elements[meshIndex].Find("primitives");
+		for (size_t i = 0; pPrimitives && pPrimitives->type == JsonValue::EType::Array && i < pPrimitives->elements.size(); i++)
+		{
+			const JsonValue& source = pPrimitives->elements[i];
+			const JsonValue* pAttributes = source.Find("attributes");
+			if (source.GetNumber("mode", GltfTriangles) != GltfTriangles || pAttributes == nullptr)
+			{
+				continue;
+			}
+
+			Primitive primitive = {};
+			const std::string name = "mesh " + std::to_string(meshIndex) + " primitive " + std::to_string(i);
+			if (!GetGltfAccessor(root, buffers, pAttributes->GetNumber("POSITION", -1.0), primitive.positions) || primitive.positions.componentCount != 3)
+			{
+				return Fail(name + " has no usable POSITION");
+			}
+			primitive.hasNormals = pAttributes->Find("NORMAL") != nullptr;
+			primitive.hasTexCoords = pAttributes->Find("TEXCOORD_0") != nullptr;
+			primitive.hasColors = pAttributes->Find("COLOR_0") != nullptr;
+			primitive.hasIndices = source.Find("indices") != nullptr;
+			if ((primitive.hasNormals && (!GetGltfAccessor(root, buffers, pAttributes->GetNumber("NORMAL", -1.0), primitive.normals) || primitive.normals.count < primitive.positions.count)) ||
+				(primitive.hasTexCoords && (!GetGltfAccessor(root, buffers, pAttributes->GetNumber("TEXCOORD_0", -1.0), primitive.texCoords) || primitive.texCoords.count < primitive.positions.count)) ||
+				(primitive.hasColors && (!GetGltfAccessor(root, buffers, pAttributes->GetNumber("COLOR_0", -1.0), primitive.colors) || primitive.colors.count < primitive.positions.count)) ||
+				(primitive.hasIndices && (!GetGltfAccessor(root, buffers, source.GetNumber("indices", -1.0), primitive.indices) || primitive.indices.componentCount != 1 ||
+					primitive.indices.componentType == GltfByte || primitive.indices.componentType == GltfShort || primitive.indices.componentType == GltfFloat)))
+			{
+				return Fail(name + " has a malformed accessor");
+			}
+
+			primitive.triangleCount = (primitive.hasIndices ? primitive.indices.count : primitive.positions.count) / 3;
+			primitive.firstCorner = static_cast<uint32_t>(cornerCount);
+			cornerCount += primitive.triangleCount * 3ull;
+			if (cornerCount > UINT32_MAX)
+			{
+				return Fail("too many triangles");
+			}
+			primitives.push_back(primitive);
+		}
+	}
+	if (cornerCount == 0)
+	{
+		return Fail("no triangles");
+	}
+
+	// Decode the corners in parallel, primitive by primitive.
+	m_corners.resize(static_cast<size_t>(cornerCount));
+	std::atomic<bool> indexOutOfRange(false);
+	for (const Primitive& primitive : primitives)
+	{
+		ForEachRange(m_pJobSystem, primitive.triangleCount, CornersPerJob / 3, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t triangle = begin; triangle < end; triangle++)
+			{
+				MeshImportVertex* pTriangle = &m_corners[primitive.firstCorner + triangle * 3];
+				bool hasNormal[3];
+				for (uint32_t c = 0; c < 3; c++)
+				{
+					// Corners 1 and 2 are swapped for the left-handed space.
+					static const uint32_t sourceCorners[3] = { 0, 2, 1 };
+					const uint32_t element = triangle * 3 + sourceCorners[c];
+					uint32_t vertex = primitive.hasIndices ? ReadGltfIndex(primitive.indices, element) : element;
+					if (vertex >= primitive.positions.count)
+					{
+						indexOutOfRange.store(true, std::memory_order_relaxed);
+						vertex = 0;
+					}
+
+					MeshImportVertex& corner = pTriangle[c];
+					corner = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f, 1.0f } };
+					ReadGltfFloats(primitive.positions, vertex, corner.position, 3);
+					corner.position[2] = -corner.position[2];
+					hasNormal[c] = primitive.hasNormals;
+					if (primitive.hasNormals)
+					{
+						ReadGltfFloats(primitive.normals, vertex, corner.normal, 3);
+						corner.normal[2] = -corner.normal[2];
+					}
+					if (primitive.hasTexCoords)
+					{
+						ReadGltfFloats(primitive.texCoords, vertex, corner.texCoord, 2);
+					}
+					if (primitive.hasColors)
+					{
+						ReadGltfFloats(primitive.colors, vertex, corner.color, 4);
+					}
+				}
+				if (!primitive.hasNormals)
+				{
+					SetFaceNormal(pTriangle, hasNormal);
+				}
+			}
+		});
+	}
+
+	if (indexOutOfRange.load())
+	{
+		return Fail("index out of range");
+	}
+	return true;
+}
+
+void MeshImporter::Weld(ImportedMesh& mesh)
+{
+	const uint32_t cornerCount = static_cast<uint32_t>(m_corners.size());
+	const uint32_t bucketCount = 1u << WeldBucketBits;
+	m_hashes.resize(cornerCount);
+	m_bucketKeys.resize(cornerCount);
+	m_sortedCorners.resize(cornerCount);
+	m_firstCorners.resize(cornerCount);
+
+	// Hash every corner; the top bits pick its bucket. Negative zeros, which negating z
+	// creates, are made positive first so that they do not keep vertices apart.
+	ForEachRange(m_pJobSystem, cornerCount, CornersPerJob, [this](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			float* pValues = reinterpret_cast<float*>(&m_corners[i]);
+			for (uint32_t value = 0; value < sizeof(MeshImportVertex) / sizeof(float); value++)
+			{
+				pValues[value] = pValues[value] == 0.0f ? 0.0f : pValues[value];
+			}
+
+			const uint64_t hash = HashVertex(m_corners[i]);
+			m_hashes[i] = hash;
+			m_bucketKeys[i] = hash >> (64 - WeldBucketBits);
+			m_sortedCorners[i] = i;
+		}
+	});
+
+	// Stable, so each bucket lists its corners in order and the first one seen of a kind is the first in the mesh.
+	m_sorter.Sort(m_bucketKeys.data(), m_sortedCorners.data(), cornerCount, m_pJobSystem);
+
+	std::vector<uint32_t> bucketStarts(bucketCount + 1);
+	for (uint32_t bucket = 0; bucket <= bucketCount; bucket++)
+	{
+		bucketStarts[bucket] = static_cast<uint32_t>(std::lower_bound(m_bucketKeys.begin(), m_bucketKeys.end(), static_cast<uint64_t>(bucket)) - m_bucketKeys.begin());
+	}
+
+	ForEachRange(m_pJobSystem, bucketCount, 1, [&](uint32_t begin, uint32_t end)
+	{
+		// Hashes are kept in the table so probing only reads corners on a likely match.
+		struct Entry
+		{
+			uint64_t hash;
+			uint32_t corner;
+		};
+		std::vector<Entry> table;
+		for (uint32_t bucket = begin; bucket < end; bucket++)
+		{
+			// Open addressing on the hash's low bits, at most half full.
+			const uint32_t start = bucketStarts[bucket];
+			const uint32_t count = bucketStarts[bucket + 1] - start;
+			uint32_t tableSize = 16;
+			while (tableSize < count * 2)
+			{
+				tableSize *= 2;
+			}
+			table.assign(tableSize, { 0, UINT32_MAX });
+
+			for (uint32_t k = start; k < start + count; k++)
+			{
+				const uint32_t corner = m_sortedCorners[k];
+				const uint64_t hash = m_hashes[corner];
+				uint32_t slot = static_cast<uint32_t>(hash) & (tableSize - 1);
+				while (table[slot].corner != UINT32_MAX &&
+					(table[slot].hash != hash || memcmp(&m_corners[table[slot].corner], &m_corners[corner], sizeof(MeshImportVertex)) != 0))
+				{
+					slot = (slot + 1) & (tableSize - 1);
+				}
+				if (table[slot].corner == UINT32_MAX)
+				{
+					table[slot] = { hash, corner };
+				}
+				m_firstCorners[corner] = table[slot].corner;
+			}
+		}
+	});
+
+	// Number the vertices in order of first use. A first corner's entry is replaced by its vertex index,
+	// which the later corners that refer to it read.
+	mesh.vertices.clear();
+	mesh.indices.resize(cornerCount);
+	for (uint32_t i = 0; i < cornerCount; i++)
+	{
+		const uint32_t first = m_firstCorners[i];
+		if (first == i)
+		{
+			m_firstCorners[i] = static_cast<uint32_t>(mesh.vertices.size());
+			mesh.vertices.push_back(m_corners[i]);
+		}
+		mesh.indices[i] = m_firstCorners[first];
+	}
+
+	float boundsMin[3] = { INFINITY, INFINITY, INFINITY };
+	float boundsMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+	for (const MeshImportVertex& vertex : mesh.vertices)
+	{
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			boundsMin[axis] = std::min(boundsMin[axis], vertex.position[axis]);
+			boundsMax[axis] = std::max(boundsMax[axis], vertex.position[axis]);
+		}
+	}
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		mesh.boundsCenter[axis] = 0.5f * (boundsMin[axis] + boundsMax[axis]);
+		mesh.boundsExtents[axis] = 0.5f * (boundsMax[axis] - boundsMin[axis]);
+	}
+}
+
+// Welding left every vertex referenced, so none are dropped and the bounds hold.
+void MeshImporter::Optimize(ImportedMesh& mesh, std::vector<Meshlet>& meshlets)
+{
+	const uint32_t indexCount = static_cast<uint32_t>(mesh.indices.size());
+	const uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+	meshlets.clear();
+	if (indexCount == 0)
+	{
+		return;
+	}
+
+	OptimizeVertexCache(mesh.indices.data(), mesh.indices.data(), indexCount, vertexCount);
+	OptimizeOverdraw(mesh.indices.data(), mesh.indices.data(), indexCount, mesh.vertices[0].position, sizeof(MeshImportVertex), vertexCount, 1.05f);
+
+	// Meshlets keep their triangles' order, and the fetch pass only renumbers vertices, so both passes' work survives.
+	BuildMeshlets(mesh.indices.data(), indexCount, mesh.vertices[0].position, sizeof(MeshImportVertex), vertexCount, meshlets);
+
+	std::vector<MeshImportVertex> vertices(vertexCount);
+	vertices.resize(OptimizeVertexFetch(vertices.data(), mesh.indices.data(), indexCount, mesh.vertices.data(), vertexCount, sizeof(MeshImportVertex)));
+	mesh.vertices.swap(vertices);
+}
+
+bool MeshImporter::Cook(const std::vector<std::wstring>& sourcePaths, const std::wstring& cachePath)
+{
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	m_stats = Stats();
+
+	const uint64_t sourceKey = ComputeSourceKey(sourcePaths);
+	{
+		MeshFile cache;
+		if (cache.Open(cachePath) && cache.GetSourceKey() == sourceKey)
+		{
+			m_stats.cacheHit = true;
+			m_stats.meshCount = cache.GetMeshCount();
+			m_stats.vertexCount = cache.GetVertexCount();
+			m_stats.triangleCount = cache.GetIndexCount() / 3;
+			m_stats.meshletCount = cache.GetMeshletCount();
+			m_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			return true;
+		}
+	}
+
+	std::vector<ImportedMesh> meshes(sourcePaths.size());
+	uint64_t vertexCount = 0;
+	uint64_t indexCount = 0;
+	size_t maxMeshVertexCount = 0;
+	for (size_t i = 0; i < sourcePaths.size(); i++)
+	{
+		if (!Import(sourcePaths[i], meshes[i]))
+		{
+			return false;
+		}
+		vertexCount += meshes[i].vertices.size();
+		indexCount += meshes[i].indices.size();
+		maxMeshVertexCount = std::max(maxMeshVertexCount, meshes[i].vertices.size());
+	}
+	if (vertexCount > UINT32_MAX || indexCount > UINT32_MAX)
+	{
+		return Fail("too many vertices for one mesh file");
+	}
+
+	// Scored in the simulator's FIFO cache before and after.
+	std::vector<VertexCacheStats> cacheStats(meshes.size() * 2);
+	std::vector<std::vector<Meshlet>> meshMeshlets(meshes.size());
+	ForEachRange(m_pJobSystem, static_cast<uint32_t>(meshes.size()), 1, [&meshes, &cacheStats, &meshMeshlets](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			ImportedMesh& mesh = meshes[i];
+			cacheStats[i * 2] = SimulateVertexCache(mesh.indices.data(), static_cast<uint32_t>(mesh.indices.size()), static_cast<uint32_t>(mesh.vertices.size()));
+			Optimize(mesh, meshMeshlets[i]);
+			cacheStats[i * 2 + 1] = SimulateVertexCache(mesh.indices.data(), static_cast<uint32_t>(mesh.indices.size()), static_cast<uint32_t>(mesh.vertices.size()));
+		}
+	});
+	for (size_t i = 0; i < cacheStats.size(); i++)
+	{
+		VertexCacheStats& total = i % 2 == 0 ? m_stats.cacheBefore : m_stats.cacheAfter;
+		total.transformCount += cacheStats[i].transformCount;
+	}
+
+	// Every mesh is one LOD; indices are relative to its base vertex.
+	const uint32_t indexSize = maxMeshVertexCount <= 0x10000 ? 2 : 4;
+	std::vector<MeshImportVertex> vertices;
+	std::vector<PackedVertex> packedVertices(static_cast<size_t>(vertexCount));
+	std::vector<uint8_t> indices;
+	std::vector<MeshFileMesh> fileMeshes;
+	std::vector<MeshFileLod> fileLods;
+	std::vector<Meshlet> meshlets;
+	vertices.reserve(static_cast<size_t>(vertexCount));
+	indices.reserve(static_cast<size_t>(indexCount * indexSize));
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		const ImportedMesh& mesh = meshes[i];
+		const MeshFileMesh fileMesh =
+		{
+			{ mesh.boundsCenter[0], mesh.boundsCenter[1], mesh.boundsCenter[2] },
+			{ mesh.boundsExtents[0], mesh.boundsExtents[1], mesh.boundsExtents[2] },
+			static_cast<uint32_t>(fileLods.size()),
+			1
+		};
+		fileMeshes.push_back(fileMesh);
+		fileLods.push_back({ static_cast<uint32_t>(mesh.indices.size()), static_cast<uint32_t>(indices.size() / indexSize), static_cast<int32_t>(vertices.size()), 0.0f,
+			static_cast<uint32_t>(meshlets.size()), static_cast<uint32_t>(meshMeshlets[i].size()), { 0, 0 } });
+		meshlets.insert(meshlets.end(), meshMeshlets[i].begin(), meshMeshlets[i].end());
+
+		// Positions are quantized across the mesh's own bounds.
+		const PositionQuantization quantization = GetPositionQuantization(mesh.boundsCenter, mesh.boundsExtents);
+		PackVertices(&packedVertices[vertices.size()], mesh.vertices.data(), sizeof(MeshImportVertex), static_cast<uint32_t>(mesh.vertices.size()), quantization);
+		vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+		for (uint32_t index : mesh.indices)
+		{
+			const uint16_t shortIndex = static_cast<uint16_t>(index);
+			const uint8_t* pIndex = indexSize == 2 ? reinterpret_cast<const uint8_t*>(&shortIndex) : reinterpret_cast<const uint8_t*>(&index);
+			indices.insert(indices.end(), pIndex, pIndex + indexSize);
+		}
+		m_stats.triangleCount += mesh.indices.size() / 3;
+	}
+
+	const MeshFileDesc::Stream streams[] =
+	{
+		{ EMeshVertexLayout::PositionTexCoordNormalColor, sizeof(MeshImportVertex), vertices.data() },
+		{ EMeshVertexLayout::Packed, sizeof(PackedVertex), packedVertices.data() },
+	};
+	MeshFileDesc desc = {};
+	desc.pStreams = streams;
+	desc.streamCount = static_cast<uint32_t>(sizeof(streams) / sizeof(streams[0]));
+	desc.vertexCount = static_cast<uint32_t>(vertexCount);
+	desc.pIndices = indices.data();
+	desc.indexSize = indexSize;
+	desc.indexCount = static_cast<uint32_t>(indexCount);
+	desc.pMeshes = fileMeshes.data();
+	desc.meshCount = static_cast<uint32_t>(fileMeshes.size());
+	desc.pLods = fileLods.data();
+	desc.lodCount = static_cast<uint32_t>(fileLods.size());
+	desc.pMeshlets = meshlets.data();
+	desc.meshletCount = static_cast<uint32_t>(meshlets.size());
+	desc.sourceKey = sourceKey;
+	if (!WriteMeshFile(cachePath, desc))
+	{
+		return Fail(PathToMessage(cachePath) + ": cannot be written");
+	}
+
+	m_stats.meshCount = desc.meshCount;
+	m_stats.vertexCount = desc.vertexCount;
+	m_stats.meshletCount = desc.meshletCount;
+	VertexCacheStats* const pTotals[] = { &m_stats.cacheBefore, &m_stats.cacheAfter };
+	for (VertexCacheStats* pTotal : pTotals)
+	{
+		pTotal->acmr = m_stats.triangleCount > 0 ? static_cast<float>(static_cast<double>(pTotal->transformCount) / m_stats.triangleCount) : 0.0f;
+		pTotal->atvr = desc.vertexCount > 0 ? static_cast<float>(pTotal->transformCount) / desc.vertexCount : 0.0f;
+	}
+	m_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+uint64_t MeshImporter::ComputeSourceKey(const std::vector<std::wstring>& sourcePaths)
+{
+	uint64_t hash = FnvOffsetBasis;
+	const uint32_t version = ImporterVersion;
+	HashBytes(hash, &version, sizeof(version));
+
+	std::vector<std::wstring> files;
+	for (const std::wstring& path : sourcePaths)
+	{
+		files.push_back(path);
+		std::vector<char> json;
+		if (GetLowerCaseExtension(path) == L"gltf" && ReadWholeFile(path, json))
+		{
+			JsonValue root;
+			const char* pJson = json.data();
+			if (ParseJson(pJson, pJson + json.size(), root, 0))
+			{
+				GetGltfDependencies(path, root, files);
+			}
+		}
+	}
+
+	// Missing files hash as empty; importing them fails anyway.
+	for (const std::wstring& file : files)
+	{
+		FileStamp stamp = {};
+		GetFileStamp(file, stamp);
+		HashBytes(hash, file.data(), file.size() * sizeof(wchar_t));
+		HashBytes(hash, &stamp.size, sizeof(stamp.size));
+		HashBytes(hash, &stamp.modifiedTime, sizeof(stamp.modifiedTime));
+	}
+
+	// Zero means unknown in a mesh file.
+	return hash != 0 ? hash : 1;
+}
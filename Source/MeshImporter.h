@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Meshlets.h"
+#include "MeshOptimizer.h"
+#include "RadixSort.h"
+
+class JobSystem;
+
+// EMeshVertexLayout::PositionTexCoordNormalColor, the layout of Engine::Vertex.
+struct MeshImportVertex
+{
+    float position[3];
+    float texCoord[2];
+    float normal[3];
+    float color[4];
+};
+
+// One source file as a welded triangle list: no two vertices are identical.
+struct ImportedMesh
+{
+    std::vector<MeshImportVertex> vertices;
+    std::vector<uint32_t> indices;
+    float boundsCenter[3];
+    float boundsExtents[3];
+};
+
+// Imports OBJ (.obj), glTF (.gltf) and binary glTF (.glb) meshes and cooks them
+// into a MeshFile. Sources are converted to the engine's left-handed space by
+// negating z and reversing the winding. Corners without a normal get their
+// face's, and those without a color are white.
+//
+// OBJ files are parsed in chunks of lines, in parallel over pJobSystem when
+// given: a first pass counts each chunk's positions, texture coordinates and
+// normals so that relative indices resolve while the second pass parses. A
+// glTF file becomes one mesh made of every triangle primitive of every mesh,
+// decoded in parallel, with node transforms ignored. Either way the corners
+// are then welded in parallel: they are bucketed by hash and each bucket is
+// deduplicated with its own hash table, keeping first occurrences in order, so
+// the result does not depend on the number of threads.
+class MeshImporter
+{
+public:
+    struct Stats
+    {
+        bool cacheHit;              // Cook found the cache up to date.
+        uint32_t meshCount;
+        uint32_t vertexCount;       // After welding.
+        uint64_t triangleCount;
+        VertexCacheStats cacheBefore;   // Of every mesh as imported and as cooked, zero on a cache hit.
+        VertexCacheStats cacheAfter;
+        uint32_t meshletCount;
+        double seconds;
+    };
+
+    explicit MeshImporter(JobSystem* pJobSystem = nullptr);
+
+    // Returns false, with GetError describing why, if the file cannot be read or parsed.
+    bool Import(const std::wstring& path, ImportedMesh& mesh);
+
+    // Cook every source, one mesh each with a single LOD, into cachePath, unless it
+    // already holds them: the key stored in the file covers the importer version and
+    // the path, size and modification time of every source and of the buffers glTF
+    // files reference. Indices are 16-bit when every mesh has at most 65536
+    // vertices. Each mesh's triangles are reordered for the vertex cache and for
+    // overdraw, split into meshlets, and then its vertices are reordered for fetch
+    // locality, in parallel across meshes. The vertices are written both as floats
+    // and packed, with positions quantized across each mesh's bounds. Returns false
+    // if an import or the write fails.
+    bool Cook(const std::vector<std::wstring>& sourcePaths, const std::wstring& cachePath);
+
+    const std::string& GetError() const { return m_error; }
+    const Stats& GetStats() const { return m_stats; }      // Of the last Cook.
+
+    static uint64_t ComputeSourceKey(const std::vector<std::wstring>& sourcePaths);
+
+private:
+    static const uint32_t ImporterVersion = 4;
+    static const uint32_t ObjChunkSize = 1 << 20;
+    static const uint32_t CornersPerJob = 16384;
+    static const uint32_t WeldBucketBits = 8;
+
+    // Both fill m_corners.
+    bool ImportObj(const std::vector<char>& text);
+    bool ImportGltf(const std::wstring& path, const std::vector<char>& file);
+    void Weld(ImportedMesh& mesh);
+    bool Fail(const std::string& error);
+    static void Optimize(ImportedMesh& mesh, std::vector<Meshlet>& meshlets);
+
+    JobSystem* m_pJobSystem;
+    std::string m_error;
+    Stats m_stats;
+    std::vector<MeshImportVertex> m_corners;        // Import scratch, three per triangle.
+    std::vector<uint64_t> m_hashes;                 // Weld scratch, per corner.
+    std::vector<uint64_t> m_bucketKeys;
+    std::vector<uint32_t> m_sortedCorners;          // By bucket, then by index.
+    std::vector<uint32_t> m_firstCorners;           // Per corner, the first identical one.
+    RadixSorter m_sorter;
+};
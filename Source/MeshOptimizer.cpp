@@ -0,0 +1,355 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	// Forsyth's tuning: the last triangle's vertices score a flat 0.75 so that the
+	// next triangle does not merely reuse them, the rest fall off with their LRU
+	// position, and vertices with few triangles left are boosted so that they are
+	// finished off instead of being left behind as isolated triangles.
+	const uint32_t ForsythCacheSize = 32;
+	const uint32_t ForsythMaxValence = 32;
+
+	struct ForsythScores
+	{
+		float cache[ForsythCacheSize];
+		float valence[ForsythMaxValence + 1];
+	};
+
+	void InitForsythScores(ForsythScores& scores)
+	{
+		for (uint32_t position = 0; position < ForsythCacheSize; position++)
+		{
+			scores.cache[position] = position < 3 ? 0.75f :
+				powf(1.0f - static_cast<float>(position - 3) / (ForsythCacheSize - 3), 1.5f);
+		}
+		scores.valence[0] = 0.0f;
+		for (uint32_t valence = 1; valence <= ForsythMaxValence; valence++)
+		{
+			scores.valence[valence] = 2.0f / sqrtf(static_cast<float>(valence));
+		}
+	}
+
+	float GetVertexScore(const ForsythScores& scores, int32_t cachePosition, uint32_t liveCount)
+	{
+		return (cachePosition >= 0 ? scores.cache[cachePosition] : 0.0f) + scores.valence[std::min(liveCount, ForsythMaxValence)];
+	}
+
+	// FIFO cache replay: a vertex is cached while fewer than cacheSize others have
+	// been transformed since it was. Bumping time by cacheSize flushes the cache.
+	struct FifoCache
+	{
+		std::vector<uint32_t> transformTimes;      // 0 if never transformed.
+		uint32_t time;
+		uint32_t size;
+
+		FifoCache(uint32_t vertexCount, uint32_t cacheSize) : transformTimes(vertexCount, 0), time(cacheSize + 1), size(cacheSize) {}
+
+		uint32_t Replay(const uint32_t* pTriangle)
+		{
+			uint32_t misses = 0;
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				if (time - transformTimes[pTriangle[corner]] > size)
+				{
+					transformTimes[pTriangle[corner]] = time++;
+					misses++;
+				}
+			}
+			return misses;
+		}
+
+		void Flush()
+		{
+			time += size;
+		}
+	};
+
+	const float* GetPosition(const float* pPositions, uint32_t positionStride, uint32_t vertex)
+	{
+		return reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(pPositions) + static_cast<size_t>(vertex) * positionStride);
+	}
+}
+
+VertexCacheStats SimulateVertexCache(const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize)
+{
+	FifoCache cache(vertexCount, cacheSize);
+	uint32_t transformCount = 0;
+	for (uint32_t index = 0; index + 3 <= indexCount; index += 3)
+	{
+		transformCount += cache.Replay(pIndices + index);
+	}
+
+	uint32_t referencedCount = 0;
+	for (uint32_t time : cache.transformTimes)
+	{
+		referencedCount += time != 0 ? 1 : 0;
+	}
+
+	VertexCacheStats stats = {};
+	stats.transformCount = transformCount;
+	stats.acmr = indexCount >= 3 ? static_cast<float>(transformCount) / (indexCount / 3) : 0.0f;
+	stats.atvr = referencedCount > 0 ? static_cast<float>(transformCount) / referencedCount : 0.0f;
+	return stats;
+}
+
+void OptimizeVertexCache(uint32_t* pDestination, const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount)
+{
+	const uint32_t triangleCount = indexCount / 3;
+	const std::vector<uint32_t> indices(pIndices, pIndices + triangleCount * 3);
+
+	ForsythScores scores;
+	InitForsythScores(scores);
+
+	// Each vertex's live triangles are the first liveCounts[vertex] of its adjacency list.
+	std::vector<uint32_t> liveCounts(vertexCount, 0);
+	for (uint32_t vertex : indices)
+	{
+		liveCounts[vertex]++;
+	}
+	std::vector<uint32_t> firstAdjacencies(vertexCount + 1, 0);
+	for (uint32_t vertex = 0; vertex < vertexCount; vertex++)
+	{
+		firstAdjacencies[vertex + 1] = firstAdjacencies[vertex] + liveCounts[vertex];
+	}
+	std::vector<uint32_t> adjacency(indices.size());
+	{
+		std::vector<uint32_t> cursors(firstAdjacencies.begin(), firstAdjacencies.end() - 1);
+		for (uint32_t index = 0; index < indices.size(); index++)
+		{
+			adjacency[cursors[indices[index]]++] = index / 3;
+		}
+	}
+
+	std::vector<int32_t> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (uint32_t vertex = 0; vertex < vertexCount; vertex++)
+	{
+		vertexScores[vertex] = GetVertexScore(scores, -1, liveCounts[vertex]);
+	}
+
+	uint32_t bestTriangle = UINT32_MAX;
+	float bestScore = 0.0f;
+	for (uint32_t triangle = 0; triangle < triangleCount; triangle++)
+	{
+		const uint32_t* pTriangle = &indices[triangle * 3];
+		const float score = vertexScores[pTriangle[0]] + vertexScores[pTriangle[1]] + vertexScores[pTriangle[2]];
+		if (score > bestScore)
+		{
+			bestTriangle = triangle;
+			bestScore = score;
+		}
+	}
+
+	std::vector<uint8_t> emitted(triangleCount, 0);
+	uint32_t nextTriangle = 0;
+	uint32_t cache[ForsythCacheSize + 3];
+	uint32_t cacheCount = 0;
+	for (uint32_t output = 0; output < triangleCount; output++)
+	{
+		// Out of triangles around the cache: restart from the first one left.
+		if (bestTriangle == UINT32_MAX)
+		{
+			while (emitted[nextTriangle])
+			{
+				nextTriangle++;
+			}
+			bestTriangle = nextTriangle;
+		}
+
+		const uint32_t* pTriangle = &indices[bestTriangle * 3];
+		memcpy(pDestination + output * 3, pTriangle, 3 * sizeof(uint32_t));
+		emitted[bestTriangle] = 1;
+
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			const uint32_t vertex = pTriangle[corner];
+			uint32_t* pLive = &adjacency[firstAdjacencies[vertex]];
+			const uint32_t liveCount = liveCounts[vertex];
+			*std::find(pLive, pLive + liveCount, bestTriangle) = pLive[liveCount - 1];
+			liveCounts[vertex] = liveCount - 1;
+		}
+
+		// The triangle's vertices move to the front; whatever ends up past the end is evicted.
+		uint32_t newCache[ForsythCacheSize + 3];
+		uint32_t newCacheCount = 0;
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			if (std::find(newCache, newCache + newCacheCount, pTriangle[corner]) == newCache + newCacheCount)
+			{
+				newCache[newCacheCount++] = pTriangle[corner];
+			}
+		}
+		for (uint32_t entry = 0; entry < cacheCount; entry++)
+		{
+			const uint32_t vertex = cache[entry];
+			if (vertex != pTriangle[0] && vertex != pTriangle[1] && vertex != pTriangle[2])
+			{
+				newCache[newCacheCount++] = vertex;
+			}
+		}
+		for (uint32_t entry = 0; entry < newCacheCount; entry++)
+		{
+			const uint32_t vertex = newCache[entry];
+			cachePositions[vertex] = entry < ForsythCacheSize ? static_cast<int32_t>(entry) : -1;
+			vertexScores[vertex] = GetVertexScore(scores, cachePositions[vertex], liveCounts[vertex]);
+		}
+		cacheCount = std::min(newCacheCount, ForsythCacheSize);
+		memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+
+		// Only the triangles around vertices whose score changed can have become the best.
+		bestTriangle = UINT32_MAX;
+		bestScore = 0.0f;
+		for (uint32_t entry = 0; entry < newCacheCount; entry++)
+		{
+			const uint32_t vertex = newCache[entry];
+			const uint32_t* pLive = &adjacency[firstAdjacencies[vertex]];
+			for (uint32_t live = 0; live < liveCounts[vertex]; live++)
+			{
+				const uint32_t* pCandidate = &indices[pLive[live] * 3];
+				const float score = vertexScores[pCandidate[0]] + vertexScores[pCandidate[1]] + vertexScores[pCandidate[2]];
+				if (score > bestScore)
+				{
+					bestTriangle = pLive[live];
+					bestScore = score;
+				}
+			}
+		}
+	}
+}
+
+void OptimizeOverdraw(uint32_t* pDestination, const uint32_t* pIndices, uint32_t indexCount, const float* pPositions, uint32_t positionStride,
+	uint32_t vertexCount, float threshold)
+{
+	const uint32_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+	const std::vector<uint32_t> indices(pIndices, pIndices + triangleCount * 3);
+
+	// Hard cuts where every vertex of a triangle misses: the cache starts over there anyway.
+	std::vector<uint32_t> hardStarts;
+	FifoCache cache(vertexCount, VertexCacheSize);
+	for (uint32_t triangle = 0; triangle < triangleCount; triangle++)
+	{
+		if (cache.Replay(&indices[triangle * 3]) == 3 || triangle == 0)
+		{
+			hardStarts.push_back(triangle);
+		}
+	}
+	hardStarts.push_back(triangleCount);
+
+	// Soft cuts inside each of those runs, while the misses so far, counting a flush at
+	// every cut, stay within threshold times those of the uncut run.
+	std::vector<uint32_t> clusterStarts;
+	for (size_t hard = 0; hard + 1 < hardStarts.size(); hard++)
+	{
+		const uint32_t begin = hardStarts[hard];
+		const uint32_t end = hardStarts[hard + 1];
+
+		uint32_t runMisses = 0;
+		cache.Flush();
+		for (uint32_t triangle = begin; triangle < end; triangle++)
+		{
+			runMisses += cache.Replay(&indices[triangle * 3]);
+		}
+
+		const float missBudget = threshold * runMisses / (end - begin);
+		uint32_t misses = 0;
+		clusterStarts.push_back(begin);
+		cache.Flush();
+		for (uint32_t triangle = begin; triangle < end; triangle++)
+		{
+			if (triangle > begin && misses <= missBudget * (triangle - begin))
+			{
+				clusterStarts.push_back(triangle);
+				cache.Flush();
+			}
+			misses += cache.Replay(&indices[triangle * 3]);
+		}
+	}
+	const uint32_t clusterCount = static_cast<uint32_t>(clusterStarts.size());
+	clusterStarts.push_back(triangleCount);
+
+	// Area weighted centroids and normals, of the mesh and of each cluster.
+	std::vector<double> clusterSums(clusterCount * 7, 0.0);       // Centroid times area, area, normal times area.
+	double meshSums[4] = {};
+	for (uint32_t cluster = 0; cluster < clusterCount; cluster++)
+	{
+		double* pSums = &clusterSums[cluster * 7];
+		for (uint32_t triangle = clusterStarts[cluster]; triangle < clusterStarts[cluster + 1]; triangle++)
+		{
+			const float* p0 = GetPosition(pPositions, positionStride, indices[triangle * 3 + 0]);
+			const float* p1 = GetPosition(pPositions, positionStride, indices[triangle * 3 + 1]);
+			const float* p2 = GetPosition(pPositions, positionStride, indices[triangle * 3 + 2]);
+			const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			const float cross[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			const double area = 0.5 * sqrt(static_cast<double>(cross[0]) * cross[0] + static_cast<double>(cross[1]) * cross[1] + static_cast<double>(cross[2]) * cross[2]);
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				pSums[axis] += area * (static_cast<double>(p0[axis]) + p1[axis] + p2[axis]) / 3.0;
+				pSums[4 + axis] += cross[axis];
+			}
+			pSums[3] += area;
+		}
+		for (uint32_t sum = 0; sum < 4; sum++)
+		{
+			meshSums[sum] += pSums[sum];
+		}
+	}
+
+	// Clusters facing away from the centre, most of all those furthest out, are drawn first.
+	std::vector<float> sortKeys(clusterCount, 0.0f);
+	for (uint32_t cluster = 0; cluster < clusterCount; cluster++)
+	{
+		const double* pSums = &clusterSums[cluster * 7];
+		const double normalLength = sqrt(pSums[4] * pSums[4] + pSums[5] * pSums[5] + pSums[6] * pSums[6]);
+		if (pSums[3] > 0.0 && meshSums[3] > 0.0 && normalLength > 0.0)
+		{
+			double key = 0.0;
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				key += (pSums[axis] / pSums[3] - meshSums[axis] / meshSums[3]) * pSums[4 + axis];
+			}
+			sortKeys[cluster] = static_cast<float>(key / normalLength);
+		}
+	}
+	std::vector<uint32_t> order(clusterCount);
+	for (uint32_t cluster = 0; cluster < clusterCount; cluster++)
+	{
+		order[cluster] = cluster;
+	}
+	std::stable_sort(order.begin(), order.end(), [&sortKeys](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	uint32_t* pOutput = pDestination;
+	for (uint32_t cluster : order)
+	{
+		const uint32_t count = (clusterStarts[cluster + 1] - clusterStarts[cluster]) * 3;
+		memcpy(pOutput, &indices[clusterStarts[cluster] * 3], count * sizeof(uint32_t));
+		pOutput += count;
+	}
+}
+
+uint32_t OptimizeVertexFetch(void* pDestination, uint32_t* pIndices, uint32_t indexCount, const void* pVertices, uint32_t vertexCount, uint32_t vertexSize)
+{
+	std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+	uint32_t count = 0;
+	for (uint32_t index = 0; index < indexCount; index++)
+	{
+		uint32_t& newVertex = remap[pIndices[index]];
+		if (newVertex == UINT32_MAX)
+		{
+			newVertex = count++;
+			memcpy(static_cast<uint8_t*>(pDestination) + static_cast<size_t>(newVertex) * vertexSize,
+				static_cast<const uint8_t*>(pVertices) + static_cast<size_t>(pIndices[index]) * vertexSize, vertexSize);
+		}
+		pIndices[index] = newVertex;
+	}
+	return count;
+}
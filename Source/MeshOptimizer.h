@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+// Entries of the FIFO post-transform cache the simulator models by default,
+// a conservative size for current GPUs.
+static const uint32_t VertexCacheSize = 16;
+
+struct VertexCacheStats
+{
+    uint32_t transformCount;    // Cache misses, each one a vertex shader invocation.
+    float acmr;                 // Transforms per triangle: 3 at worst, near 0.5 for a well ordered grid.
+    float atvr;                 // Transforms per referenced vertex: 1 at best.
+};
+
+// Replays an indexed triangle list through a FIFO cache of cacheSize entries.
+VertexCacheStats SimulateVertexCache(const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize = VertexCacheSize);
+
+// The three passes below are meant to run in order. pDestination may be pIndices.
+
+// Reorders triangles so that they reuse recently transformed vertices, greedily
+// emitting the best scored triangle around a modelled LRU cache (Forsyth's
+// linear-speed algorithm). Isolated triangles restart from the first one left.
+void OptimizeVertexCache(uint32_t* pDestination, const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount);
+
+// Reorders runs of the vertex cache optimized triangles so that the ones facing
+// away from the mesh's centre, which tend to hide the others, are drawn first.
+// The runs are cut where the cache restarts anyway, and also elsewhere as long as
+// the ACMR stays under threshold times what it was; 1.05 is a good trade. Positions
+// are three floats every positionStride bytes.
+void OptimizeOverdraw(uint32_t* pDestination, const uint32_t* pIndices, uint32_t indexCount, const float* pPositions, uint32_t positionStride,
+    uint32_t vertexCount, float threshold);
+
+// Reorders vertices by first use, so that vertex fetch walks memory forward, and
+// rewrites the indices to match. Unreferenced vertices are dropped; returns how
+// many are left in pDestination, which must not overlap pVertices.
+uint32_t OptimizeVertexFetch(void* pDestination, uint32_t* pIndices, uint32_t indexCount, const void* pVertices, uint32_t vertexCount, uint32_t vertexSize);
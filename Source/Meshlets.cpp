@@ -0,0 +1,353 @@
+#include "Meshlets.h"
+#include "FrustumCulling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	// How much bending the normal cone by 180 degrees costs, in added vertices.
+	const float ConeWeight = 1.0f;
+
+	const float* GetPosition(const float* pPositions, uint32_t positionStride, uint32_t vertex)
+	{
+		return reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(pPositions) + static_cast<size_t>(vertex) * positionStride);
+	}
+
+	// Vertices of the triangle that are not in the meshlet yet; repeated ones count once.
+	uint32_t CountNewVertices(const uint32_t* pTriangle, const std::vector<uint32_t>& vertexMeshlets, uint32_t meshlet)
+	{
+		uint32_t count = 0;
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			const uint32_t vertex = pTriangle[corner];
+			if (vertexMeshlets[vertex] != meshlet && (corner == 0 || vertex != pTriangle[0]) && (corner < 2 || vertex != pTriangle[1]))
+			{
+				count++;
+			}
+		}
+		return count;
+	}
+
+	// Bounding sphere around the box of the vertices, and the normal cone of the non-degenerate triangles.
+	Meshlet MakeMeshlet(const uint32_t* pIndices, uint32_t triangleCount, uint32_t vertexCount, const float* pPositions, uint32_t positionStride,
+		const std::vector<float>& normals, const std::vector<uint32_t>& triangles)
+	{
+		Meshlet meshlet = {};
+		meshlet.triangleCount = triangleCount;
+		meshlet.vertexCount = vertexCount;
+
+		float boxMin[3] = { INFINITY, INFINITY, INFINITY };
+		float boxMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+		for (uint32_t index = 0; index < triangleCount * 3; index++)
+		{
+			const float* pPosition = GetPosition(pPositions, positionStride, pIndices[index]);
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				boxMin[axis] = std::min(boxMin[axis], pPosition[axis]);
+				boxMax[axis] = std::max(boxMax[axis], pPosition[axis]);
+			}
+		}
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			meshlet.center[axis] = 0.5f * (boxMin[axis] + boxMax[axis]);
+		}
+		double radiusSquared = 0.0;
+		for (uint32_t index = 0; index < triangleCount * 3; index++)
+		{
+			const float* pPosition = GetPosition(pPositions, positionStride, pIndices[index]);
+			double distanceSquared = 0.0;
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				const double delta = static_cast<double>(pPosition[axis]) - meshlet.center[axis];
+				distanceSquared += delta * delta;
+			}
+			radiusSquared = std::max(radiusSquared, distanceSquared);
+		}
+		meshlet.radius = nextafterf(static_cast<float>(sqrt(radiusSquared)), INFINITY);
+
+		double axisSum[3] = {};
+		for (uint32_t triangle : triangles)
+		{
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				axisSum[axis] += normals[triangle * 3 + axis];
+			}
+		}
+		const double axisLength = sqrt(axisSum[0] * axisSum[0] + axisSum[1] * axisSum[1] + axisSum[2] * axisSum[2]);
+		double minDot = axisLength > 0.0 ? 1.0 : -1.0;
+		for (uint32_t axis = 0; axis < 3 && axisLength > 0.0; axis++)
+		{
+			meshlet.coneAxis[axis] = static_cast<float>(axisSum[axis] / axisLength);
+		}
+		for (uint32_t triangle : triangles)
+		{
+			const float* pNormal = &normals[triangle * 3];
+			if (pNormal[0] != 0.0f || pNormal[1] != 0.0f || pNormal[2] != 0.0f)
+			{
+				minDot = std::min(minDot, static_cast<double>(pNormal[0]) * meshlet.coneAxis[0] + static_cast<double>(pNormal[1]) * meshlet.coneAxis[1] +
+					static_cast<double>(pNormal[2]) * meshlet.coneAxis[2]);
+			}
+		}
+
+		// A cone of a hemisphere or more is never seen from behind as a whole.
+		if (minDot <= 0.0)
+		{
+			meshlet.coneSin = 1.0f;
+			meshlet.coneCos = 0.0f;
+		}
+		else
+		{
+			meshlet.coneSin = static_cast<float>(sqrt(1.0 - minDot * minDot));
+			meshlet.coneCos = static_cast<float>(minDot);
+		}
+		return meshlet;
+	}
+}
+
+void BuildMeshlets(uint32_t* pIndices, uint32_t indexCount, const float* pPositions, uint32_t positionStride, uint32_t vertexCount,
+	std::vector<Meshlet>& meshlets)
+{
+	meshlets.clear();
+	const uint32_t triangleCount = indexCount / 3;
+	const std::vector<uint32_t> indices(pIndices, pIndices + triangleCount * 3);
+
+	// Unit normals, zero for degenerate triangles.
+	std::vector<float> normals(triangleCount * 3, 0.0f);
+	for (uint32_t triangle = 0; triangle < triangleCount; triangle++)
+	{
+		const float* p0 = GetPosition(pPositions, positionStride, indices[triangle * 3 + 0]);
+		const float* p1 = GetPosition(pPositions, positionStride, indices[triangle * 3 + 1]);
+		const float* p2 = GetPosition(pPositions, positionStride, indices[triangle * 3 + 2]);
+		const double e1[3] = { static_cast<double>(p1[0]) - p0[0], static_cast<double>(p1[1]) - p0[1], static_cast<double>(p1[2]) - p0[2] };
+		const double e2[3] = { static_cast<double>(p2[0]) - p0[0], static_cast<double>(p2[1]) - p0[1], static_cast<double>(p2[2]) - p0[2] };
+		const double cross[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+		const double length = sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+		for (uint32_t axis = 0; axis < 3 && length > 0.0; axis++)
+		{
+			normals[triangle * 3 + axis] = static_cast<float>(cross[axis] / length);
+		}
+	}
+
+	// Triangles around each vertex.
+	std::vector<uint32_t> firstAdjacencies(vertexCount + 1, 0);
+	for (uint32_t vertex : indices)
+	{
+		firstAdjacencies[vertex + 1]++;
+	}
+	for (uint32_t vertex = 0; vertex < vertexCount; vertex++)
+	{
+		firstAdjacencies[vertex + 1] += firstAdjacencies[vertex];
+	}
+	std::vector<uint32_t> adjacency(indices.size());
+	{
+		std::vector<uint32_t> cursors(firstAdjacencies.begin(), firstAdjacencies.end() - 1);
+		for (uint32_t index = 0; index < indices.size(); index++)
+		{
+			adjacency[cursors[indices[index]]++] = index / 3;
+		}
+	}
+
+	// Stamped with the meshlet being grown, so nothing needs clearing between meshlets.
+	std::vector<uint32_t> vertexMeshlets(vertexCount, UINT32_MAX);
+	std::vector<uint32_t> candidateMeshlets(triangleCount, UINT32_MAX);
+	std::vector<uint8_t> used(triangleCount, 0);
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> triangles;
+	uint32_t nextSeed = 0;
+	uint32_t output = 0;
+	for (;;)
+	{
+		while (nextSeed < triangleCount && used[nextSeed])
+		{
+			nextSeed++;
+		}
+		if (nextSeed == triangleCount)
+		{
+			break;
+		}
+
+		const uint32_t meshlet = static_cast<uint32_t>(meshlets.size());
+		uint32_t meshletVertexCount = 0;
+		float normalSum[3] = {};
+		candidates.clear();
+		triangles.clear();
+		for (uint32_t triangle = nextSeed; triangle != UINT32_MAX;)
+		{
+			used[triangle] = 1;
+			triangles.push_back(triangle);
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t vertex = indices[triangle * 3 + corner];
+				if (vertexMeshlets[vertex] == meshlet)
+				{
+					continue;
+				}
+				vertexMeshlets[vertex] = meshlet;
+				meshletVertexCount++;
+				for (uint32_t adjacent = firstAdjacencies[vertex]; adjacent < firstAdjacencies[vertex + 1]; adjacent++)
+				{
+					const uint32_t neighbour = adjacency[adjacent];
+					if (!used[neighbour] && candidateMeshlets[neighbour] != meshlet)
+					{
+						candidateMeshlets[neighbour] = meshlet;
+						candidates.push_back(neighbour);
+					}
+				}
+			}
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				normalSum[axis] += normals[triangle * 3 + axis];
+			}
+			if (triangles.size() == MaxMeshletTriangles)
+			{
+				break;
+			}
+
+			const float normalLength = sqrtf(normalSum[0] * normalSum[0] + normalSum[1] * normalSum[1] + normalSum[2] * normalSum[2]);
+			const float coneAxis[3] =
+			{
+				normalLength > 0.0f ? normalSum[0] / normalLength : 0.0f,
+				normalLength > 0.0f ? normalSum[1] / normalLength : 0.0f,
+				normalLength > 0.0f ? normalSum[2] / normalLength : 0.0f,
+			};
+
+			// Drop the candidates used since, and keep the cheapest one that fits.
+			triangle = UINT32_MAX;
+			float bestCost = INFINITY;
+			size_t keptCount = 0;
+			for (size_t c = 0; c < candidates.size(); c++)
+			{
+				const uint32_t candidate = candidates[c];
+				if (used[candidate])
+				{
+					continue;
+				}
+				candidates[keptCount++] = candidate;
+
+				const uint32_t newVertexCount = CountNewVertices(&indices[candidate * 3], vertexMeshlets, meshlet);
+				if (meshletVertexCount + newVertexCount > MaxMeshletVertices)
+				{
+					continue;
+				}
+				const float* pNormal = &normals[candidate * 3];
+				const float cost = newVertexCount + ConeWeight * 0.5f * (1.0f - (pNormal[0] * coneAxis[0] + pNormal[1] * coneAxis[1] + pNormal[2] * coneAxis[2]));
+				if (cost < bestCost || (cost == bestCost && candidate < triangle))
+				{
+					triangle = candidate;
+					bestCost = cost;
+				}
+			}
+			candidates.resize(keptCount);
+
+			// An island used up: carry on with the next triangle in order, which is usually close by.
+			if (candidates.empty())
+			{
+				while (nextSeed < triangleCount && used[nextSeed])
+				{
+					nextSeed++;
+				}
+				if (nextSeed < triangleCount && meshletVertexCount + CountNewVertices(&indices[nextSeed * 3], vertexMeshlets, meshlet) <= MaxMeshletVertices)
+				{
+					triangle = nextSeed;
+				}
+			}
+		}
+
+		// In their original order, which keeps the vertex cache order within the meshlet.
+		std::sort(triangles.begin(), triangles.end());
+		uint32_t* pMeshletIndices = pIndices + output * 3;
+		for (size_t t = 0; t < triangles.size(); t++)
+		{
+			memcpy(pMeshletIndices + t * 3, &indices[triangles[t] * 3], 3 * sizeof(uint32_t));
+		}
+		meshlets.push_back(MakeMeshlet(pMeshletIndices, static_cast<uint32_t>(triangles.size()), meshletVertexCount, pPositions, positionStride, normals, triangles));
+		meshlets.back().startIndex = output * 3;
+		output += static_cast<uint32_t>(triangles.size());
+	}
+}
+
+void GetMeshletCullView(const Frustum& frustum, const SceneMatrix& world, const float* pEye, MeshletCullView& view)
+{
+	// A world plane p . n + d = 0 is (p M) . n + d = 0 in object space, with M's rows as the basis.
+	const float (&m)[4][4] = world.m;
+	for (uint32_t plane = 0; plane < 6; plane++)
+	{
+		const float n[3] = { frustum.normalX[plane], frustum.normalY[plane], frustum.normalZ[plane] };
+		float objectPlane[4];
+		for (uint32_t row = 0; row < 4; row++)
+		{
+			objectPlane[row] = m[row][0] * n[0] + m[row][1] * n[1] + m[row][2] * n[2];
+		}
+		objectPlane[3] += frustum.distance[plane];
+
+		const float length = sqrtf(objectPlane[0] * objectPlane[0] + objectPlane[1] * objectPlane[1] + objectPlane[2] * objectPlane[2]);
+		for (uint32_t component = 0; component < 4; component++)
+		{
+			view.planes[plane][component] = length > 0.0f ? objectPlane[component] / length : 0.0f;
+		}
+	}
+
+	// The eye is (eye - translation) times the inverse of the 3x3 part, the adjugate over the determinant.
+	const float cofactors[3][3] =
+	{
+		{ m[1][1] * m[2][2] - m[1][2] * m[2][1], m[1][2] * m[2][0] - m[1][0] * m[2][2], m[1][0] * m[2][1] - m[1][1] * m[2][0] },
+		{ m[0][2] * m[2][1] - m[0][1] * m[2][2], m[0][0] * m[2][2] - m[0][2] * m[2][0], m[0][1] * m[2][0] - m[0][0] * m[2][1] },
+		{ m[0][1] * m[1][2] - m[0][2] * m[1][1], m[0][2] * m[1][0] - m[0][0] * m[1][2], m[0][0] * m[1][1] - m[0][1] * m[1][0] },
+	};
+	const float determinant = m[0][0] * cofactors[0][0] + m[0][1] * cofactors[0][1] + m[0][2] * cofactors[0][2];
+	const float relativeEye[3] = { pEye[0] - m[3][0], pEye[1] - m[3][1], pEye[2] - m[3][2] };
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		view.eye[axis] = determinant != 0.0f ?
+			(relativeEye[0] * cofactors[axis][0] + relativeEye[1] * cofactors[axis][1] + relativeEye[2] * cofactors[axis][2]) / determinant : 0.0f;
+	}
+	view.cullBackFacing = determinant > 0.0f;
+}
+
+uint32_t CullMeshlets(const MeshletCullView& view, const Meshlet* pMeshlets, uint32_t meshletCount, MeshletIndexRange* pRanges, MeshletCullStats& stats)
+{
+	uint32_t rangeCount = 0;
+	for (uint32_t i = 0; i < meshletCount; i++)
+	{
+		const Meshlet& meshlet = pMeshlets[i];
+		stats.triangleCount += meshlet.triangleCount;
+
+		bool outside = false;
+		for (uint32_t plane = 0; plane < 6 && !outside; plane++)
+		{
+			const float* pPlane = view.planes[plane];
+			outside = pPlane[0] * meshlet.center[0] + pPlane[1] * meshlet.center[1] + pPlane[2] * meshlet.center[2] + pPlane[3] < -meshlet.radius;
+		}
+		if (outside)
+		{
+			stats.outsideTriangleCount += meshlet.triangleCount;
+			continue;
+		}
+
+		// Splitting the direction to the centre along the axis (u) and across it (w), the sphere is
+		// inside the back facing cone when its distance to the cone's surface exceeds the radius.
+		if (view.cullBackFacing)
+		{
+			const float toCenter[3] = { meshlet.center[0] - view.eye[0], meshlet.center[1] - view.eye[1], meshlet.center[2] - view.eye[2] };
+			const float u = toCenter[0] * meshlet.coneAxis[0] + toCenter[1] * meshlet.coneAxis[1] + toCenter[2] * meshlet.coneAxis[2];
+			const float w = sqrtf(std::max(toCenter[0] * toCenter[0] + toCenter[1] * toCenter[1] + toCenter[2] * toCenter[2] - u * u, 0.0f));
+			if (meshlet.coneCos * u - meshlet.coneSin * w > meshlet.radius)
+			{
+				stats.backFacingTriangleCount += meshlet.triangleCount;
+				continue;
+			}
+		}
+
+		if (rangeCount > 0 && pRanges[rangeCount - 1].startIndex + pRanges[rangeCount - 1].indexCount == meshlet.startIndex)
+		{
+			pRanges[rangeCount - 1].indexCount += meshlet.triangleCount * 3;
+		}
+		else
+		{
+			pRanges[rangeCount++] = { meshlet.startIndex, meshlet.triangleCount * 3 };
+		}
+	}
+	return rangeCount;
+}
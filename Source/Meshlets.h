@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct Frustum;
+struct SceneMatrix;
+
+static const uint32_t MaxMeshletVertices = 64;
+static const uint32_t MaxMeshletTriangles = 124;
+
+// A small cluster of a mesh's triangles, contiguous in its index buffer, with
+// the bounds that let it be culled as a whole. Also the layout of the mesh
+// file's meshlet table.
+struct Meshlet
+{
+    float center[3];            // Bounding sphere of its vertices.
+    float radius;
+    float coneAxis[3];          // Unit average of its triangles' normals.
+    float coneSin;              // Of the widest angle between one of the normals and the axis,
+    float coneCos;              // 1 and 0 when the normals span a hemisphere or more.
+    uint32_t startIndex;        // Relative to the index range the meshlets were built from.
+    uint32_t triangleCount;
+    uint32_t vertexCount;
+};
+
+static_assert(sizeof(Meshlet) == 48, "Meshlet is a mesh file table entry and must keep sections aligned");
+
+// Splits a triangle list into meshlets of at most MaxMeshletVertices vertices and
+// MaxMeshletTriangles triangles, and reorders pIndices so that each one's
+// triangles are contiguous. Meshlets are seeded in index order and grown with
+// the neighbouring triangle that adds the fewest vertices and bends the normal
+// cone the least; a meshlet whose neighbours are all used up continues with the
+// next unused triangle. Within a meshlet the triangles keep their order, so an
+// index buffer optimized for the vertex cache stays mostly so. Positions are
+// three floats every positionStride bytes, in a space where the outward normal
+// of a triangle (a, b, c) is (b - a) x (c - a).
+void BuildMeshlets(uint32_t* pIndices, uint32_t indexCount, const float* pPositions, uint32_t positionStride, uint32_t vertexCount,
+    std::vector<Meshlet>& meshlets);
+
+// A view of one object, moved into the object's space so that its meshlets are
+// tested as they are stored.
+struct MeshletCullView
+{
+    float planes[6][4];         // Inward facing (normal, distance), normalized in object space.
+    float eye[3];
+    bool cullBackFacing;        // Not when the world matrix mirrors, which flips the winding.
+};
+
+// world uses row vectors and must be affine, as scene matrices are.
+void GetMeshletCullView(const Frustum& frustum, const SceneMatrix& world, const float* pEye, MeshletCullView& view);
+
+struct MeshletIndexRange
+{
+    uint32_t startIndex;        // Relative, like Meshlet::startIndex.
+    uint32_t indexCount;
+};
+
+// Triangles rejected, added to by every CullMeshlets call.
+struct MeshletCullStats
+{
+    uint64_t triangleCount;             // Tested.
+    uint64_t outsideTriangleCount;      // In meshlets entirely behind a frustum plane.
+    uint64_t backFacingTriangleCount;   // In meshlets the eye sees only the back of.
+};
+
+// Keeps the meshlets whose bounding sphere reaches into the frustum and whose
+// normal cone does not face away from the eye. A meshlet is back facing when,
+// seen from the eye, its whole bounding sphere lies within 90 degrees minus the
+// cone's half angle of coneAxis: then every triangle is seen from behind.
+// Writes the kept index ranges, runs of consecutive meshlets merged, to pRanges,
+// which has room for meshletCount, and returns how many there are.
+uint32_t CullMeshlets(const MeshletCullView& view, const Meshlet* pMeshlets, uint32_t meshletCount, MeshletIndexRange* pRanges, MeshletCullStats& stats);
@@ -0,0 +1,516 @@
+#include "OcclusionCulling.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define OCCLUSION_CULLING_X64 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define OCCLUSION_CULLING_AVX2_FUNCTION
+#else
+#define OCCLUSION_CULLING_AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+	// Every path visits the pixels of rows [minY, maxY] within the triangle's
+	// x bounds and evaluates the edge and depth planes with the same operations in
+	// the same order, so they write identical depths.
+	void RasterizeTriangleScalar(const OcclusionTriangle& t, float* pDepth, uint32_t width, int32_t minY, int32_t maxY)
+	{
+		for (int32_t y = minY; y <= maxY; y++)
+		{
+			const float py = static_cast<float>(y) + 0.5f;
+			float* pRow = pDepth + y * width;
+			for (int32_t x = t.minX; x <= t.maxX; x++)
+			{
+				const float px = static_cast<float>(x) + 0.5f;
+				const float e0 = (t.edgeA[0] * px + t.edgeB[0] * py) + t.edgeC[0];
+				const float e1 = (t.edgeA[1] * px + t.edgeB[1] * py) + t.edgeC[1];
+				const float e2 = (t.edgeA[2] * px + t.edgeB[2] * py) + t.edgeC[2];
+				if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f)
+				{
+					const float depth = (t.depthA * px + t.depthB * py) + t.depthC;
+					pRow[x] = depth < pRow[x] ? depth : pRow[x];
+				}
+			}
+		}
+	}
+
+#if OCCLUSION_CULLING_X64
+	// 4 pixels per iteration. Rows are a multiple of 8 pixels, so groups aligned to 4 never cross one.
+	void RasterizeTriangleSSE(const OcclusionTriangle& t, float* pDepth, uint32_t width, int32_t minY, int32_t maxY)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128i laneOffsets = _mm_setr_epi32(0, 1, 2, 3);
+		const __m128i beforeMinX = _mm_set1_epi32(t.minX - 1);
+		const __m128i afterMaxX = _mm_set1_epi32(t.maxX + 1);
+		const __m128 a0 = _mm_set1_ps(t.edgeA[0]), a1 = _mm_set1_ps(t.edgeA[1]), a2 = _mm_set1_ps(t.edgeA[2]);
+		const __m128 c0 = _mm_set1_ps(t.edgeC[0]), c1 = _mm_set1_ps(t.edgeC[1]), c2 = _mm_set1_ps(t.edgeC[2]);
+		const __m128 depthA = _mm_set1_ps(t.depthA);
+		const __m128 depthC = _mm_set1_ps(t.depthC);
+
+		for (int32_t y = minY; y <= maxY; y++)
+		{
+			const float py = static_cast<float>(y) + 0.5f;
+			const __m128 bpy0 = _mm_set1_ps(t.edgeB[0] * py);
+			const __m128 bpy1 = _mm_set1_ps(t.edgeB[1] * py);
+			const __m128 bpy2 = _mm_set1_ps(t.edgeB[2] * py);
+			const __m128 depthBpy = _mm_set1_ps(t.depthB * py);
+			float* pRow = pDepth + y * width;
+
+			for (int32_t x = t.minX & ~3; x <= t.maxX; x += 4)
+			{
+				const __m128i xi = _mm_add_epi32(_mm_set1_epi32(x), laneOffsets);
+				const __m128 px = _mm_add_ps(_mm_cvtepi32_ps(xi), half);
+				const __m128 e0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, px), bpy0), c0);
+				const __m128 e1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a1, px), bpy1), c1);
+				const __m128 e2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a2, px), bpy2), c2);
+				const __m128 inBounds = _mm_castsi128_ps(_mm_and_si128(_mm_cmpgt_epi32(xi, beforeMinX), _mm_cmplt_epi32(xi, afterMaxX)));
+				const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_and_ps(_mm_cmpge_ps(e2, zero), inBounds));
+				if (_mm_movemask_ps(inside) == 0)
+				{
+					continue;
+				}
+
+				const __m128 depth = _mm_add_ps(_mm_add_ps(_mm_mul_ps(depthA, px), depthBpy), depthC);
+				const __m128 previous = _mm_loadu_ps(pRow + x);
+				const __m128 nearest = _mm_min_ps(depth, previous);
+				_mm_storeu_ps(pRow + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, previous)));
+			}
+		}
+	}
+
+	// 8 pixels per iteration.
+	OCCLUSION_CULLING_AVX2_FUNCTION
+	void RasterizeTriangleAVX2(const OcclusionTriangle& t, float* pDepth, uint32_t width, int32_t minY, int32_t maxY)
+	{
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 half = _mm256_set1_ps(0.5f);
+		const __m256i laneOffsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		const __m256i beforeMinX = _mm256_set1_epi32(t.minX - 1);
+		const __m256i afterMaxX = _mm256_set1_epi32(t.maxX + 1);
+		const __m256 a0 = _mm256_set1_ps(t.edgeA[0]), a1 = _mm256_set1_ps(t.edgeA[1]), a2 = _mm256_set1_ps(t.edgeA[2]);
+		const __m256 c0 = _mm256_set1_ps(t.edgeC[0]), c1 = _mm256_set1_ps(t.edgeC[1]), c2 = _mm256_set1_ps(t.edgeC[2]);
+		const __m256 depthA = _mm256_set1_ps(t.depthA);
+		const __m256 depthC = _mm256_set1_ps(t.depthC);
+
+		for (int32_t y = minY; y <= maxY; y++)
+		{
+			const float py = static_cast<float>(y) + 0.5f;
+			const __m256 bpy0 = _mm256_set1_ps(t.edgeB[0] * py);
+			const __m256 bpy1 = _mm256_set1_ps(t.edgeB[1] * py);
+			const __m256 bpy2 = _mm256_set1_ps(t.edgeB[2] * py);
+			const __m256 depthBpy = _mm256_set1_ps(t.depthB * py);
+			float* pRow = pDepth + y * width;
+
+			for (int32_t x = t.minX & ~7; x <= t.maxX; x += 8)
+			{
+				const __m256i xi = _mm256_add_epi32(_mm256_set1_epi32(x), laneOffsets);
+				const __m256 px = _mm256_add_ps(_mm256_cvtepi32_ps(xi), half);
+				const __m256 e0 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a0, px), bpy0), c0);
+				const __m256 e1 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a1, px), bpy1), c1);
+				const __m256 e2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a2, px), bpy2), c2);
+				const __m256 inBounds = _mm256_castsi256_ps(_mm256_and_si256(_mm256_cmpgt_epi32(xi, beforeMinX), _mm256_cmpgt_epi32(afterMaxX, xi)));
+				const __m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(e0, zero, _CMP_GE_OQ), _mm256_cmp_ps(e1, zero, _CMP_GE_OQ)),
+					_mm256_and_ps(_mm256_cmp_ps(e2, zero, _CMP_GE_OQ), inBounds));
+				if (_mm256_movemask_ps(inside) == 0)
+				{
+					continue;
+				}
+
+				const __m256 depth = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(depthA, px), depthBpy), depthC);
+				const __m256 previous = _mm256_loadu_ps(pRow + x);
+				_mm256_storeu_ps(pRow + x, _mm256_blendv_ps(previous, _mm256_min_ps(depth, previous), inside));
+			}
+		}
+	}
+#endif
+}
+
+OcclusionBuffer::OcclusionBuffer(uint32_t width, uint32_t height) :
+	m_width(width),
+	m_height(height),
+	m_levelCount(1),
+	m_viewProj(),
+	m_depth(width * height, 1.0f)
+{
+	assert(width >= 8 && (width & (width - 1)) == 0 && height > 0 && (height & (height - 1)) == 0);
+
+	while ((m_width >> m_levelCount) > 0 || (m_height >> m_levelCount) > 0)
+	{
+		m_levelCount++;
+	}
+
+	// Level 0 is the depth buffer itself.
+	m_minDepths.resize(m_levelCount);
+	m_maxDepths.resize(m_levelCount);
+	for (uint32_t level = 1; level < m_levelCount; level++)
+	{
+		const uint32_t texelCount = std::max(m_width >> level, 1u) * std::max(m_height >> level, 1u);
+		m_minDepths[level].resize(texelCount, 1.0f);
+		m_maxDepths[level].resize(texelCount, 1.0f);
+	}
+}
+
+void OcclusionBuffer::Begin(const SceneMatrix& viewProj)
+{
+	m_viewProj = viewProj;
+	m_triangles.clear();
+	std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+}
+
+void OcclusionBuffer::AddOccluder(const float* pPositions, uint32_t vertexStride, const uint16_t* pIndices, uint32_t indexCount, const SceneMatrix& world)
+{
+	// World and view-projection combined, so each vertex is transformed once.
+	float m[4][4];
+	for (int row = 0; row < 4; row++)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			m[row][column] = world.m[row][0] * m_viewProj.m[0][column] + world.m[row][1] * m_viewProj.m[1][column] +
+				world.m[row][2] * m_viewProj.m[2][column] + world.m[row][3] * m_viewProj.m[3][column];
+		}
+	}
+
+	uint32_t vertexCount = 0;
+	for (uint32_t i = 0; i < indexCount; i++)
+	{
+		vertexCount = std::max(vertexCount, pIndices[i] + 1u);
+	}
+
+	m_clipPositions.resize(vertexCount * 4);
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		const float* pPosition = reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(pPositions) + v * vertexStride);
+		for (int column = 0; column < 4; column++)
+		{
+			m_clipPositions[v * 4 + column] = pPosition[0] * m[0][column] + pPosition[1] * m[1][column] + pPosition[2] * m[2][column] + m[3][column];
+		}
+	}
+
+	typedef const float (&ClipVertex)[4];
+	for (uint32_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		AddClippedTriangle(
+			reinterpret_cast<ClipVertex>(m_clipPositions[pIndices[i] * 4]),
+			reinterpret_cast<ClipVertex>(m_clipPositions[pIndices[i + 1] * 4]),
+			reinterpret_cast<ClipVertex>(m_clipPositions[pIndices[i + 2] * 4]));
+	}
+}
+
+// Clip against the near plane, z >= 0, which leaves a triangle or a quad.
+void OcclusionBuffer::AddClippedTriangle(const float (&v0)[4], const float (&v1)[4], const float (&v2)[4])
+{
+	const float (*const vertices[3])[4] = { &v0, &v1, &v2 };
+	float polygon[4][4];
+	uint32_t vertexCount = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		const float (&a)[4] = *vertices[i];
+		const float (&b)[4] = *vertices[(i + 1) % 3];
+		if (a[2] >= 0.0f)
+		{
+			std::copy(a, a + 4, polygon[vertexCount++]);
+		}
+		if ((a[2] >= 0.0f) != (b[2] >= 0.0f))
+		{
+			const float t = a[2] / (a[2] - b[2]);
+			for (int c = 0; c < 4; c++)
+			{
+				polygon[vertexCount][c] = a[c] + t * (b[c] - a[c]);
+			}
+			polygon[vertexCount++][2] = 0.0f;
+		}
+	}
+
+	if (vertexCount >= 3)
+	{
+		SetupTriangle(polygon[0], polygon[1], polygon[2]);
+	}
+	if (vertexCount == 4)
+	{
+		SetupTriangle(polygon[0], polygon[2], polygon[3]);
+	}
+}
+
+void OcclusionBuffer::SetupTriangle(const float (&v0)[4], const float (&v1)[4], const float (&v2)[4])
+{
+	if (v0[3] <= 0.0f || v1[3] <= 0.0f || v2[3] <= 0.0f)
+	{
+		return;
+	}
+
+	// Screen space, y down.
+	const float (*const vertices[3])[4] = { &v0, &v1, &v2 };
+	float x[3], y[3], z[3];
+	for (int i = 0; i < 3; i++)
+	{
+		const float (&v)[4] = *vertices[i];
+		const float invW = 1.0f / v[3];
+		x[i] = (v[0] * invW * 0.5f + 0.5f) * m_width;
+		y[i] = (0.5f - v[1] * invW * 0.5f) * m_height;
+		z[i] = v[2] * invW;
+	}
+
+	// Clockwise on screen is a positive area; anything else faces away or is degenerate.
+	const float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (!(area > 0.0f))
+	{
+		return;
+	}
+
+	const float minX = std::max(std::min(std::min(x[0], x[1]), x[2]), 0.0f);
+	const float minY = std::max(std::min(std::min(y[0], y[1]), y[2]), 0.0f);
+	const float maxX = std::min(std::max(std::max(x[0], x[1]), x[2]), static_cast<float>(m_width - 1));
+	const float maxY = std::min(std::max(std::max(y[0], y[1]), y[2]), static_cast<float>(m_height - 1));
+	if (minX > maxX || minY > maxY)
+	{
+		return;
+	}
+
+	OcclusionTriangle t;
+	for (int i = 0; i < 3; i++)
+	{
+		const int j = (i + 1) % 3;
+		t.edgeA[i] = y[i] - y[j];
+		t.edgeB[i] = x[j] - x[i];
+		t.edgeC[i] = (y[j] - y[i]) * x[i] - (x[j] - x[i]) * y[i];
+	}
+
+	// A tilted occluder is farther at some corner of a pixel than at its center,
+	// and a box in between must not be hidden there: store the farthest depth
+	// of the triangle's plane over the pixel.
+	const float dzdx = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+	const float dzdy = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+	t.depthA = dzdx;
+	t.depthB = dzdy;
+	t.depthC = z[0] - dzdx * x[0] - dzdy * y[0] + 0.5f * (std::fabs(dzdx) + std::fabs(dzdy));
+
+	t.minX = static_cast<int32_t>(minX);
+	t.minY = static_cast<int32_t>(minY);
+	t.maxX = static_cast<int32_t>(maxX);
+	t.maxY = static_cast<int32_t>(maxY);
+	m_triangles.push_back(t);
+}
+
+void OcclusionBuffer::Rasterize(JobSystem* pJobSystem, ECullingPath path)
+{
+	const uint32_t bandCount = (m_height + BandHeight - 1) / BandHeight;
+	if (pJobSystem != nullptr)
+	{
+		pJobSystem->ParallelFor(bandCount, 1, [this, path](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t band = begin; band < end; band++)
+			{
+				RasterizeBand(band, path);
+			}
+		});
+	}
+	else
+	{
+		for (uint32_t band = 0; band < bandCount; band++)
+		{
+			RasterizeBand(band, path);
+		}
+	}
+
+	BuildHierarchy();
+}
+
+// Each band owns its rows, so bands can be rasterized concurrently without sharing pixels.
+void OcclusionBuffer::RasterizeBand(uint32_t band, ECullingPath path)
+{
+	const int32_t bandMinY = static_cast<int32_t>(band * BandHeight);
+	const int32_t bandMaxY = static_cast<int32_t>(std::min((band + 1) * BandHeight, m_height)) - 1;
+	for (const OcclusionTriangle& t : m_triangles)
+	{
+		const int32_t minY = std::max(t.minY, bandMinY);
+		const int32_t maxY = std::min(t.maxY, bandMaxY);
+		if (minY > maxY)
+		{
+			continue;
+		}
+
+		switch (path)
+		{
+#if OCCLUSION_CULLING_X64
+		case ECullingPath::AVX2:
+			RasterizeTriangleAVX2(t, m_depth.data(), m_width, minY, maxY);
+			break;
+		case ECullingPath::SSE:
+			RasterizeTriangleSSE(t, m_depth.data(), m_width, minY, maxY);
+			break;
+#endif
+		default:
+			RasterizeTriangleScalar(t, m_depth.data(), m_width, minY, maxY);
+			break;
+		}
+	}
+}
+
+// Each level halves the one below; at the edges of a non-square buffer a
+// dimension that is already 1 stays 1.
+void OcclusionBuffer::BuildHierarchy()
+{
+	for (uint32_t level = 1; level < m_levelCount; level++)
+	{
+		const uint32_t sourceWidth = std::max(m_width >> (level - 1), 1u);
+		const uint32_t sourceHeight = std::max(m_height >> (level - 1), 1u);
+		const uint32_t width = std::max(m_width >> level, 1u);
+		const uint32_t height = std::max(m_height >> level, 1u);
+		const float* pSourceMin = GetMinDepths(level - 1);
+		const float* pSourceMax = GetMaxDepths(level - 1);
+		float* pMin = m_minDepths[level].data();
+		float* pMax = m_maxDepths[level].data();
+
+		for (uint32_t y = 0; y < height; y++)
+		{
+			const uint32_t row0 = std::min(2 * y, sourceHeight - 1) * sourceWidth;
+			const uint32_t row1 = std::min(2 * y + 1, sourceHeight - 1) * sourceWidth;
+			for (uint32_t x = 0; x < width; x++)
+			{
+				const uint32_t x0 = std::min(2 * x, sourceWidth - 1);
+				const uint32_t x1 = std::min(2 * x + 1, sourceWidth - 1);
+				pMin[y * width + x] = std::min(std::min(pSourceMin[row0 + x0], pSourceMin[row0 + x1]), std::min(pSourceMin[row1 + x0], pSourceMin[row1 + x1]));
+				pMax[y * width + x] = std::max(std::max(pSourceMax[row0 + x0], pSourceMax[row0 + x1]), std::max(pSourceMax[row1 + x0], pSourceMax[row1 + x1]));
+			}
+		}
+	}
+}
+
+bool OcclusionBuffer::IsBoxVisible(float cx, float cy, float cz, float ex, float ey, float ez) const
+{
+	const float (&m)[4][4] = m_viewProj.m;
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	float nearestDepth = FLT_MAX;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		const float x = (corner & 1) ? cx + ex : cx - ex;
+		const float y = (corner & 2) ? cy + ey : cy - ey;
+		const float z = (corner & 4) ? cz + ez : cz - ez;
+		const float clipX = x * m[0][0] + y * m[1][0] + z * m[2][0] + m[3][0];
+		const float clipY = x * m[0][1] + y * m[1][1] + z * m[2][1] + m[3][1];
+		const float clipZ = x * m[0][2] + y * m[1][2] + z * m[2][2] + m[3][2];
+		const float clipW = x * m[0][3] + y * m[1][3] + z * m[2][3] + m[3][3];
+		if (clipZ < 0.0f || clipW <= 0.0f)
+		{
+			return true;
+		}
+
+		const float invW = 1.0f / clipW;
+		const float screenX = (clipX * invW * 0.5f + 0.5f) * m_width;
+		const float screenY = (0.5f - clipY * invW * 0.5f) * m_height;
+		minX = std::min(minX, screenX);
+		minY = std::min(minY, screenY);
+		maxX = std::max(maxX, screenX);
+		maxY = std::max(maxY, screenY);
+		nearestDepth = std::min(nearestDepth, clipZ * invW);
+	}
+
+	// Off screen there is nothing to be visible on.
+	if (maxX < 0.0f || maxY < 0.0f || minX >= m_width || minY >= m_height)
+	{
+		return false;
+	}
+
+	// Pixels whose area the rectangle, grown by a pixel on each side, touches:
+	// [left, right] x [top, bottom]. An occluder writes every pixel whose center
+	// it covers, so a box may show through the uncovered part of such a pixel;
+	// a pixel further out then has its center uncovered too.
+	const uint32_t rect[4] =
+	{
+		static_cast<uint32_t>(std::max(minX - 1.0f, 0.0f)),
+		static_cast<uint32_t>(std::max(minY - 1.0f, 0.0f)),
+		static_cast<uint32_t>(std::min(maxX + 1.0f, static_cast<float>(m_width - 1))),
+		static_cast<uint32_t>(std::min(maxY + 1.0f, static_cast<float>(m_height - 1))),
+	};
+
+	// Start from the finest level at which the rectangle spans at most 2 x 2 texels.
+	uint32_t level = 0;
+	while (level + 1 < m_levelCount && ((rect[2] >> level) - (rect[0] >> level) > 1 || (rect[3] >> level) - (rect[1] >> level) > 1))
+	{
+		level++;
+	}
+
+	for (uint32_t y = rect[1] >> level; y <= rect[3] >> level; y++)
+	{
+		for (uint32_t x = rect[0] >> level; x <= rect[2] >> level; x++)
+		{
+			if (IsTexelVisible(level, x, y, rect, nearestDepth))
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// A texel whose farthest depth is in front of the box hides it entirely; one
+// whose nearest depth is behind the box has a pixel under the rectangle where it
+// shows. Anything in between is decided by the children under the rectangle.
+bool OcclusionBuffer::IsTexelVisible(uint32_t level, uint32_t x, uint32_t y, const uint32_t (&rect)[4], float depth) const
+{
+	const uint32_t texel = y * std::max(m_width >> level, 1u) + x;
+	if (depth > GetMaxDepths(level)[texel])
+	{
+		return false;
+	}
+	if (level == 0 || depth <= GetMinDepths(level)[texel])
+	{
+		return true;
+	}
+
+	const uint32_t childLevel = level - 1;
+	const uint32_t childMaxX = std::min(std::min(2 * x + 1, std::max(m_width >> childLevel, 1u) - 1), rect[2] >> childLevel);
+	const uint32_t childMaxY = std::min(std::min(2 * y + 1, std::max(m_height >> childLevel, 1u) - 1), rect[3] >> childLevel);
+	for (uint32_t childY = std::max(2 * y, rect[1] >> childLevel); childY <= childMaxY; childY++)
+	{
+		for (uint32_t childX = std::max(2 * x, rect[0] >> childLevel); childX <= childMaxX; childX++)
+		{
+			if (IsTexelVisible(childLevel, childX, childY, rect, depth))
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+uint32_t OcclusionBuffer::CullBoxes(const SceneBoundsView& bounds, uint32_t* pIndices, uint32_t count, JobSystem* pJobSystem)
+{
+	m_visibleFlags.resize(count);
+	const auto TestBoxes = [this, &bounds, pIndices](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t k = begin; k < end; k++)
+		{
+			const uint32_t i = pIndices[k];
+			m_visibleFlags[k] = IsBoxVisible(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i], bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]) ? 1 : 0;
+		}
+	};
+
+	if (pJobSystem != nullptr)
+	{
+		pJobSystem->ParallelFor(count, MinBoxesPerJob, TestBoxes);
+	}
+	else
+	{
+		TestBoxes(0, count);
+	}
+
+	uint32_t visibleCount = 0;
+	for (uint32_t k = 0; k < count; k++)
+	{
+		if (m_visibleFlags[k])
+		{
+			pIndices[visibleCount++] = pIndices[k];
+		}
+	}
+	return visibleCount;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "FrustumCulling.h"
+
+class JobSystem;
+
+// Screen space setup of one occluder triangle. Pixel (x, y) is sampled at
+// (x + 0.5, y + 0.5); the depth plane is offset to give the farthest depth
+// over the pixel instead.
+struct OcclusionTriangle
+{
+    float edgeA[3];         // Edge functions a * x + b * y + c, non-negative inside.
+    float edgeB[3];
+    float edgeC[3];
+    float depthA;           // Depth plane a * x + b * y + c.
+    float depthB;
+    float depthC;
+    int32_t minX, minY;     // Pixel bounds, clamped to the buffer.
+    int32_t maxX, maxY;
+};
+
+// Software occlusion culling. A few large occluders are rasterized on the CPU
+// into a small depth buffer, which is reduced into a hierarchy of per-texel
+// minimum and maximum depths; object bounds are then tested against it before
+// their draws are built. Depth is z / w of the DirectX clip space, 0 at the
+// near plane. Each pixel keeps the nearest occluder whose triangles cover its
+// center, at that occluder's farthest depth within the pixel, and boxes are
+// tested against the pixels their screen rectangle touches plus a one pixel
+// border, so boxes peeking past an occluder's edge by less than a pixel stay
+// visible.
+//
+// Each frame: Begin, AddOccluder per occluder, Rasterize, then any number of
+// IsBoxVisible or CullBoxes calls.
+class OcclusionBuffer
+{
+public:
+    // Both powers of two, width at least 8.
+    OcclusionBuffer(uint32_t width = 256, uint32_t height = 128);
+
+    // Clear the depth buffer and set the view of the following calls.
+    void Begin(const SceneMatrix& viewProj);
+
+    // Queue an indexed triangle list. pPositions points at the x, y and z floats
+    // of the first vertex. Triangles are clipped against the near plane, and
+    // those facing away (counterclockwise on screen) are skipped.
+    void AddOccluder(const float* pPositions, uint32_t vertexStride, const uint16_t* pIndices, uint32_t indexCount, const SceneMatrix& world);
+
+    // Rasterize the queued triangles in horizontal bands, in parallel over
+    // pJobSystem when given, and build the hierarchy. Every path writes the same
+    // depths bit for bit.
+    void Rasterize(JobSystem* pJobSystem = nullptr, ECullingPath path = GetBestCullingPath());
+
+    // False only if every pixel under the box's screen rectangle holds an
+    // occluder in front of the box's nearest point. Boxes crossing the near
+    // plane are always visible.
+    bool IsBoxVisible(float cx, float cy, float cz, float ex, float ey, float ez) const;
+
+    // Remove the occluded objects from pIndices, dense indices into bounds,
+    // keeping the order of the others, and return how many remain.
+    uint32_t CullBoxes(const SceneBoundsView& bounds, uint32_t* pIndices, uint32_t count, JobSystem* pJobSystem = nullptr);
+
+    uint32_t GetWidth() const { return m_width; }
+    uint32_t GetHeight() const { return m_height; }
+    uint32_t GetTriangleCount() const { return static_cast<uint32_t>(m_triangles.size()); }
+    const float* GetDepth() const { return m_depth.data(); }    // Row major, valid after Rasterize.
+
+private:
+    static const uint32_t BandHeight = 16;
+    static const uint32_t MinBoxesPerJob = 1024;
+
+    void AddClippedTriangle(const float (&v0)[4], const float (&v1)[4], const float (&v2)[4]);
+    void SetupTriangle(const float (&v0)[4], const float (&v1)[4], const float (&v2)[4]);
+    void RasterizeBand(uint32_t band, ECullingPath path);
+    void BuildHierarchy();
+    const float* GetMinDepths(uint32_t level) const { return level == 0 ? m_depth.data() : m_minDepths[level].data(); }
+    const float* GetMaxDepths(uint32_t level) const { return level == 0 ? m_depth.data() : m_maxDepths[level].data(); }
+    bool IsTexelVisible(uint32_t level, uint32_t x, uint32_t y, const uint32_t (&rect)[4], float depth) const;
+
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_levelCount;
+    SceneMatrix m_viewProj;
+    std::vector<float> m_clipPositions;             // AddOccluder scratch, x, y, z and w per vertex.
+    std::vector<OcclusionTriangle> m_triangles;
+    std::vector<float> m_depth;
+    std::vector<std::vector<float>> m_minDepths;    // Per level, level 0 being m_depth itself.
+    std::vector<std::vector<float>> m_maxDepths;
+    std::vector<uint8_t> m_visibleFlags;            // CullBoxes scratch.
+};
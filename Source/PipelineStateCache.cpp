@@ -0,0 +1,410 @@
+#include "stdafx.h"
+#include "PipelineStateCache.h"
+#include "DXHelper.h"
+
+#include <chrono>
+#include <fstream>
+
+namespace
+{
+	// FNV-1a. Structures with padding are hashed field by field so uninitialized
+	// padding bytes never leak into the key.
+	class Hasher
+	{
+	public:
+		Hasher() : m_hash(14695981039346656037ull) {}
+
+		void AddBytes(const void* pData, SIZE_T size)
+		{
+			const UINT8* pBytes = static_cast<const UINT8*>(pData);
+			for (SIZE_T i = 0; i < size; i++)
+			{
+				m_hash ^= pBytes[i];
+				m_hash *= 1099511628211ull;
+			}
+		}
+
+		template<typename T>
+		void Add(const T& value)
+		{
+			AddBytes(&value, sizeof(T));
+		}
+
+		void AddString(const char* pString)
+		{
+			const SIZE_T length = pString ? strlen(pString) : 0;
+			Add(length);
+			AddBytes(pString, length);
+		}
+
+		void AddShader(const D3D12_SHADER_BYTECODE& shader)
+		{
+			Add(shader.BytecodeLength);
+			AddBytes(shader.pShaderBytecode, shader.BytecodeLength);
+		}
+
+		UINT64 Get() const { return m_hash; }
+
+	private:
+		UINT64 m_hash;
+	};
+
+	void HashStencilOp(Hasher& hasher, const D3D12_DEPTH_STENCILOP_DESC& desc)
+	{
+		hasher.Add(desc.StencilFailOp);
+		hasher.Add(desc.StencilDepthFailOp);
+		hasher.Add(desc.StencilPassOp);
+		hasher.Add(desc.StencilFunc);
+	}
+
+	HRESULT CreatePipelineState(ID3D12Device* pDevice, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, ComPtr<ID3D12PipelineState>& pipelineState)
+	{
+		return pDevice->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pipelineState));
+	}
+
+	HRESULT CreatePipelineState(ID3D12Device* pDevice, const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc, ComPtr<ID3D12PipelineState>& pipelineState)
+	{
+		return pDevice->CreateComputePipelineState(&desc, IID_PPV_ARGS(&pipelineState));
+	}
+
+	double MillisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+PipelineStateCache::PipelineStateCache(ID3D12Device* pDevice, const std::wstring& path, UINT64 adapterId) :
+	m_device(pDevice),
+	m_path(path),
+	m_adapterId(adapterId),
+	m_dirty(false),
+	m_stats{}
+{
+	Load();
+}
+
+void PipelineStateCache::RegisterRootSignature(ID3D12RootSignature* pRootSignature, const void* pSerialized, SIZE_T size)
+{
+	Hasher hasher;
+	hasher.AddBytes(pSerialized, size);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_rootSignatureHashes[pRootSignature] = hasher.Get();
+}
+
+ID3D12PipelineState* PipelineStateCache::GetGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats.requests++;
+
+	const auto rootSignature = m_rootSignatureHashes.find(desc.pRootSignature);
+	const bool persistent = rootSignature != m_rootSignatureHashes.end();
+	const UINT64 hash = HashDesc(desc, persistent ? rootSignature->second : static_cast<UINT64>(reinterpret_cast<UINT_PTR>(desc.pRootSignature)));
+	return GetPipelineState(desc, hash, persistent);
+}
+
+ID3D12PipelineState* PipelineStateCache::GetComputePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats.requests++;
+
+	const auto rootSignature = m_rootSignatureHashes.find(desc.pRootSignature);
+	const bool persistent = rootSignature != m_rootSignatureHashes.end();
+	const UINT64 hash = HashDesc(desc, persistent ? rootSignature->second : static_cast<UINT64>(reinterpret_cast<UINT_PTR>(desc.pRootSignature)));
+	return GetPipelineState(desc, hash, persistent);
+}
+
+// Shared by both pipeline types; the caller holds m_mutex.
+template<typename Desc>
+ID3D12PipelineState* PipelineStateCache::GetPipelineState(const Desc& desc, UINT64 hash, bool persistent)
+{
+	const auto existing = m_pipelineStates.find(hash);
+	if (existing != m_pipelineStates.end())
+	{
+		m_stats.memoryHits++;
+		m_stats.savedMilliseconds += existing->second.creationMilliseconds;
+		return existing->second.pipelineState.Get();
+	}
+
+	Entry entry;
+	const auto start = std::chrono::steady_clock::now();
+
+	const auto blob = persistent ? m_blobs.find(hash) : m_blobs.end();
+	if (blob != m_blobs.end())
+	{
+		Desc cachedDesc = desc;
+		cachedDesc.CachedPSO.pCachedBlob = blob->second.blob.data();
+		cachedDesc.CachedPSO.CachedBlobSizeInBytes = blob->second.blob.size();
+
+		if (SUCCEEDED(CreatePipelineState(m_device.Get(), cachedDesc, entry.pipelineState)))
+		{
+			const double milliseconds = MillisecondsSince(start);
+			m_stats.diskHits++;
+			m_stats.creationMilliseconds += milliseconds;
+			m_stats.savedMilliseconds += std::max(blob->second.creationMilliseconds - milliseconds, 0.0);
+
+			entry.creationMilliseconds = blob->second.creationMilliseconds;
+			blob->second.requested = true;
+			ID3D12PipelineState* pPipelineState = entry.pipelineState.Get();
+			m_pipelineStates[hash] = entry;
+			return pPipelineState;
+		}
+
+		// Typically D3D12_ERROR_DRIVER_VERSION_MISMATCH after a driver update.
+		m_stats.rejectedBlobs++;
+		m_blobs.erase(blob);
+		m_dirty = true;
+	}
+
+	const auto compileStart = std::chrono::steady_clock::now();
+	const HRESULT hr = CreatePipelineState(m_device.Get(), desc, entry.pipelineState);
+	if (FAILED(hr))
+	{
+		char message[128];
+		sprintf_s(message, "PipelineStateCache: the device rejected a pipeline state (0x%08X)\n", static_cast<unsigned>(hr));
+		OutputDebugStringA(message);
+		return nullptr;
+	}
+	entry.creationMilliseconds = MillisecondsSince(compileStart);
+
+	m_stats.misses++;
+	m_stats.creationMilliseconds += MillisecondsSince(start);
+
+	if (persistent)
+	{
+		ComPtr<ID3DBlob> cachedBlob;
+		if (SUCCEEDED(entry.pipelineState->GetCachedBlob(&cachedBlob)))
+		{
+			const UINT8* pBytes = static_cast<const UINT8*>(cachedBlob->GetBufferPointer());
+			BlobEntry& blobEntry = m_blobs[hash];
+			blobEntry.blob.assign(pBytes, pBytes + cachedBlob->GetBufferSize());
+			blobEntry.creationMilliseconds = entry.creationMilliseconds;
+			blobEntry.requested = true;
+			m_dirty = true;
+		}
+	}
+
+	ID3D12PipelineState* pPipelineState = entry.pipelineState.Get();
+	m_pipelineStates[hash] = entry;
+	return pPipelineState;
+}
+
+// File layout: magic, version, adapter id, entry count, then per entry the
+// hash, the original creation time in microseconds, the blob size and the blob.
+void PipelineStateCache::Load()
+{
+	std::ifstream file(m_path, std::ios::binary | std::ios::ate);
+	if (!file)
+	{
+		return;
+	}
+	const UINT64 fileSize = static_cast<UINT64>(file.tellg());
+	file.seekg(0);
+
+	UINT32 magic = 0;
+	UINT32 version = 0;
+	UINT64 adapterId = 0;
+	UINT32 entryCount = 0;
+	file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+	file.read(reinterpret_cast<char*>(&version), sizeof(version));
+	file.read(reinterpret_cast<char*>(&adapterId), sizeof(adapterId));
+	file.read(reinterpret_cast<char*>(&entryCount), sizeof(entryCount));
+	if (!file || magic != FileMagic || version != FileVersion || adapterId != m_adapterId)
+	{
+		// Rewrite it for this adapter on the next Save.
+		m_dirty = true;
+		return;
+	}
+
+	for (UINT32 i = 0; i < entryCount; i++)
+	{
+		UINT64 hash = 0;
+		UINT64 creationMicroseconds = 0;
+		UINT64 size = 0;
+		file.read(reinterpret_cast<char*>(&hash), sizeof(hash));
+		file.read(reinterpret_cast<char*>(&creationMicroseconds), sizeof(creationMicroseconds));
+		file.read(reinterpret_cast<char*>(&size), sizeof(size));
+
+		// Truncated or corrupt file: keep what was complete. The size is checked
+		// against what is left before allocating anything for it.
+		if (!file || size > fileSize - static_cast<UINT64>(file.tellg()))
+		{
+			m_dirty = true;
+			break;
+		}
+
+		BlobEntry entry;
+		entry.blob.resize(static_cast<size_t>(size));
+		entry.creationMilliseconds = static_cast<double>(creationMicroseconds) / 1000.0;
+		entry.requested = false;
+		file.read(reinterpret_cast<char*>(entry.blob.data()), static_cast<std::streamsize>(size));
+		if (!file)
+		{
+			m_dirty = true;
+			break;
+		}
+
+		m_blobs[hash] = std::move(entry);
+	}
+}
+
+void PipelineStateCache::Save()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	UINT32 entryCount = 0;
+	for (const auto& blob : m_blobs)
+	{
+		entryCount += blob.second.requested ? 1 : 0;
+	}
+	if (!m_dirty && entryCount == m_blobs.size())
+	{
+		return;
+	}
+
+	std::ofstream file(m_path, std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		return;
+	}
+
+	const UINT32 magic = FileMagic;
+	const UINT32 version = FileVersion;
+	file.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+	file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+	file.write(reinterpret_cast<const char*>(&m_adapterId), sizeof(m_adapterId));
+	file.write(reinterpret_cast<const char*>(&entryCount), sizeof(entryCount));
+
+	for (const auto& blob : m_blobs)
+	{
+		if (!blob.second.requested)
+		{
+			continue;
+		}
+
+		const UINT64 hash = blob.first;
+		const UINT64 creationMicroseconds = static_cast<UINT64>(blob.second.creationMilliseconds * 1000.0);
+		const UINT64 size = blob.second.blob.size();
+		file.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+		file.write(reinterpret_cast<const char*>(&creationMicroseconds), sizeof(creationMicroseconds));
+		file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+		file.write(reinterpret_cast<const char*>(blob.second.blob.data()), static_cast<std::streamsize>(size));
+	}
+
+	m_dirty = !file;
+}
+
+PipelineStateCache::Stats PipelineStateCache::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void PipelineStateCache::ReportStats(const char* label) const
+{
+	const Stats stats = GetStats();
+	const UINT hits = stats.memoryHits + stats.diskHits;
+
+	char message[256];
+	sprintf_s(message, "PipelineStateCache (%s): %u requests, %u memory hits, %u disk hits, %u misses, %u rejected blobs, %.1f%% hit rate, %.2f ms creating, %.2f ms saved\n",
+		label, stats.requests, stats.memoryHits, stats.diskHits, stats.misses, stats.rejectedBlobs,
+		stats.requests > 0 ? 100.0 * hits / stats.requests : 0.0, stats.creationMilliseconds, stats.savedMilliseconds);
+	OutputDebugStringA(message);
+}
+
+UINT64 PipelineStateCache::HashDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, UINT64 rootSignatureHash)
+{
+	const UINT32 pipelineType = GraphicsPipeline;
+	Hasher hasher;
+	hasher.Add(pipelineType);
+	hasher.Add(rootSignatureHash);
+
+	hasher.AddShader(desc.VS);
+	hasher.AddShader(desc.PS);
+	hasher.AddShader(desc.DS);
+	hasher.AddShader(desc.HS);
+	hasher.AddShader(desc.GS);
+
+	hasher.Add(desc.StreamOutput.NumEntries);
+	for (UINT i = 0; i < desc.StreamOutput.NumEntries; i++)
+	{
+		const D3D12_SO_DECLARATION_ENTRY& entry = desc.StreamOutput.pSODeclaration[i];
+		hasher.Add(entry.Stream);
+		hasher.AddString(entry.SemanticName);
+		hasher.Add(entry.SemanticIndex);
+		hasher.Add(entry.StartComponent);
+		hasher.Add(entry.ComponentCount);
+		hasher.Add(entry.OutputSlot);
+	}
+	hasher.Add(desc.StreamOutput.NumStrides);
+	hasher.AddBytes(desc.StreamOutput.pBufferStrides, desc.StreamOutput.NumStrides * sizeof(UINT));
+	hasher.Add(desc.StreamOutput.RasterizedStream);
+
+	hasher.Add(desc.BlendState.AlphaToCoverageEnable);
+	hasher.Add(desc.BlendState.IndependentBlendEnable);
+	for (const D3D12_RENDER_TARGET_BLEND_DESC& target : desc.BlendState.RenderTarget)
+	{
+		hasher.Add(target.BlendEnable);
+		hasher.Add(target.LogicOpEnable);
+		hasher.Add(target.SrcBlend);
+		hasher.Add(target.DestBlend);
+		hasher.Add(target.BlendOp);
+		hasher.Add(target.SrcBlendAlpha);
+		hasher.Add(target.DestBlendAlpha);
+		hasher.Add(target.BlendOpAlpha);
+		hasher.Add(target.LogicOp);
+		hasher.Add(target.RenderTargetWriteMask);
+	}
+	hasher.Add(desc.SampleMask);
+
+	// Every rasterizer field is four bytes wide, so the struct has no padding.
+	hasher.Add(desc.RasterizerState);
+
+	hasher.Add(desc.DepthStencilState.DepthEnable);
+	hasher.Add(desc.DepthStencilState.DepthWriteMask);
+	hasher.Add(desc.DepthStencilState.DepthFunc);
+	hasher.Add(desc.DepthStencilState.StencilEnable);
+	hasher.Add(desc.DepthStencilState.StencilReadMask);
+	hasher.Add(desc.DepthStencilState.StencilWriteMask);
+	HashStencilOp(hasher, desc.DepthStencilState.FrontFace);
+	HashStencilOp(hasher, desc.DepthStencilState.BackFace);
+
+	hasher.Add(desc.InputLayout.NumElements);
+	for (UINT i = 0; i < desc.InputLayout.NumElements; i++)
+	{
+		const D3D12_INPUT_ELEMENT_DESC& element = desc.InputLayout.pInputElementDescs[i];
+		hasher.AddString(element.SemanticName);
+		hasher.Add(element.SemanticIndex);
+		hasher.Add(element.Format);
+		hasher.Add(element.InputSlot);
+		hasher.Add(element.AlignedByteOffset);
+		hasher.Add(element.InputSlotClass);
+		hasher.Add(element.InstanceDataStepRate);
+	}
+
+	hasher.Add(desc.IBStripCutValue);
+	hasher.Add(desc.PrimitiveTopologyType);
+	hasher.Add(desc.NumRenderTargets);
+	for (UINT i = 0; i < desc.NumRenderTargets; i++)
+	{
+		hasher.Add(desc.RTVFormats[i]);
+	}
+	hasher.Add(desc.DSVFormat);
+	hasher.Add(desc.SampleDesc.Count);
+	hasher.Add(desc.SampleDesc.Quality);
+	hasher.Add(desc.NodeMask);
+	hasher.Add(desc.Flags);
+
+	return hasher.Get();
+}
+
+UINT64 PipelineStateCache::HashDesc(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc, UINT64 rootSignatureHash)
+{
+	const UINT32 pipelineType = ComputePipeline;
+	Hasher hasher;
+	hasher.Add(pipelineType);
+	hasher.Add(rootSignatureHash);
+	hasher.AddShader(desc.CS);
+	hasher.Add(desc.NodeMask);
+	hasher.Add(desc.Flags);
+	return hasher.Get();
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <mutex>
+#include <unordered_map>
+
+using Microsoft::WRL::ComPtr;
+
+// Creates pipeline state objects through a cache keyed by a stable 64-bit hash of
+// the full description: shader bytecode, input layout, root signature, render
+// target formats and the raster, blend and depth-stencil state. Identical
+// descriptions share one PSO at runtime, and the driver's cached blob of every
+// PSO is persisted so the next launch can skip most of the compilation. A blob
+// the driver rejects (new driver, other adapter) falls back to a full creation.
+// Thread-safe.
+class PipelineStateCache
+{
+public:
+    struct Stats
+    {
+        UINT requests;
+        UINT memoryHits;            // Returned an existing PSO.
+        UINT diskHits;              // Created from a persisted blob.
+        UINT misses;                // Compiled from scratch.
+        UINT rejectedBlobs;         // Persisted blobs the driver refused.
+        double creationMilliseconds;
+        double savedMilliseconds;   // Compile time of the original creation minus what the hits took.
+    };
+
+    // adapterId identifies the GPU the blobs were created on; a file written for another one is ignored.
+    PipelineStateCache(ID3D12Device* pDevice, const std::wstring& path, UINT64 adapterId);
+
+    // Root signatures are hashed by their serialized form, which is stable across
+    // runs. PSOs using an unregistered root signature are cached at runtime only.
+    void RegisterRootSignature(ID3D12RootSignature* pRootSignature, const void* pSerialized, SIZE_T size);
+
+    // Return nullptr if the device rejects the description, e.g. stages whose
+    // interfaces do not match after a shader edit.
+    ID3D12PipelineState* GetGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc);
+    ID3D12PipelineState* GetComputePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc);
+
+    // Write the blobs of the PSOs requested since startup, if that differs from
+    // what was loaded. Blobs nothing asked for, e.g. of shaders edited during an
+    // earlier hot-reload session, are dropped so the file does not keep growing.
+    void Save();
+
+    Stats GetStats() const;
+    void ReportStats(const char* label) const;
+
+    static UINT64 HashDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, UINT64 rootSignatureHash);
+    static UINT64 HashDesc(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc, UINT64 rootSignatureHash);
+
+private:
+    static const UINT32 FileMagic = 0x434f5350;    // "PSOC"
+    static const UINT32 FileVersion = 2;
+
+    // Leads every hash so graphics and compute descriptions can never collide.
+    static const UINT32 GraphicsPipeline = 0;
+    static const UINT32 ComputePipeline = 1;
+
+    struct Entry
+    {
+        ComPtr<ID3D12PipelineState> pipelineState;
+        double creationMilliseconds;
+    };
+
+    struct BlobEntry
+    {
+        std::vector<UINT8> blob;
+        double creationMilliseconds;    // Of the creation that produced the blob, without a cache.
+        bool requested;                 // By this run, so it is saved.
+    };
+
+    template<typename Desc>
+    ID3D12PipelineState* GetPipelineState(const Desc& desc, UINT64 hash, bool persistent);
+
+    void Load();
+
+    ComPtr<ID3D12Device> m_device;
+    std::wstring m_path;
+    UINT64 m_adapterId;
+
+    std::unordered_map<UINT64, Entry> m_pipelineStates;
+    std::unordered_map<UINT64, BlobEntry> m_blobs;
+    std::unordered_map<ID3D12RootSignature*, UINT64> m_rootSignatureHashes;
+    bool m_dirty;
+
+    Stats m_stats;
+    mutable std::mutex m_mutex;
+};
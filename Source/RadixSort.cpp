@@ -0,0 +1,143 @@
+#include "RadixSort.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	// Calls function(block) for every block, in parallel when there is more than one.
+	template<typename F>
+	void ForEachBlock(JobSystem* pJobSystem, uint32_t blockCount, const F& function)
+	{
+		if (pJobSystem == nullptr || blockCount == 1)
+		{
+			for (uint32_t block = 0; block < blockCount; block++)
+			{
+				function(block);
+			}
+			return;
+		}
+
+		pJobSystem->ParallelFor(blockCount, 1, [&function](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t block = begin; block < end; block++)
+			{
+				function(block);
+			}
+		});
+	}
+}
+
+void RadixSorter::Sort(uint64_t* pKeys, uint32_t* pValues, uint32_t count, JobSystem* pJobSystem)
+{
+	if (count < 2)
+	{
+		return;
+	}
+
+	uint32_t blockCount = 1;
+	if (pJobSystem != nullptr)
+	{
+		blockCount = std::max(1u, std::min(count / MinKeysPerBlock, pJobSystem->GetWorkerCount() * MaxBlocksPerWorker));
+	}
+	const uint32_t blockSize = (count + blockCount - 1) / blockCount;
+
+	m_keyScratch.resize(count);
+	m_valueScratch.resize(count);
+	m_blockBuckets.resize(blockCount * BucketCount);
+	m_blockVaryingBits.resize(blockCount);
+
+	// Bits that differ between any key and the first one. Digits without any are already sorted.
+	const uint64_t firstKey = pKeys[0];
+	ForEachBlock(pJobSystem, blockCount, [&](uint32_t block)
+	{
+		const uint32_t begin = block * blockSize;
+		const uint32_t end = std::min(begin + blockSize, count);
+		uint64_t varyingBits = 0;
+		for (uint32_t i = begin; i < end; i++)
+		{
+			varyingBits |= pKeys[i] ^ firstKey;
+		}
+		m_blockVaryingBits[block] = varyingBits;
+	});
+
+	uint64_t varyingBits = 0;
+	for (uint32_t block = 0; block < blockCount; block++)
+	{
+		varyingBits |= m_blockVaryingBits[block];
+	}
+
+	uint64_t* pSourceKeys = pKeys;
+	uint32_t* pSourceValues = pValues;
+	uint64_t* pDestKeys = m_keyScratch.data();
+	uint32_t* pDestValues = m_valueScratch.data();
+
+	for (uint32_t shift = 0; shift < 64; shift += 8)
+	{
+		if (((varyingBits >> shift) & (BucketCount - 1)) == 0)
+		{
+			continue;
+		}
+
+		// Count each block's digits.
+		ForEachBlock(pJobSystem, blockCount, [&](uint32_t block)
+		{
+			uint32_t* pBuckets = &m_blockBuckets[block * BucketCount];
+			std::fill(pBuckets, pBuckets + BucketCount, 0u);
+
+			const uint32_t begin = block * blockSize;
+			const uint32_t end = std::min(begin + blockSize, count);
+			for (uint32_t i = begin; i < end; i++)
+			{
+				pBuckets[(pSourceKeys[i] >> shift) & (BucketCount - 1)]++;
+			}
+		});
+
+		// Turn the counts into output offsets: by digit, then by block, which keeps the sort stable.
+		uint32_t offset = 0;
+		for (uint32_t digit = 0; digit < BucketCount; digit++)
+		{
+			for (uint32_t block = 0; block < blockCount; block++)
+			{
+				uint32_t& bucket = m_blockBuckets[block * BucketCount + digit];
+				const uint32_t bucketCount = bucket;
+				bucket = offset;
+				offset += bucketCount;
+			}
+		}
+
+		ForEachBlock(pJobSystem, blockCount, [&](uint32_t block)
+		{
+			uint32_t* pOffsets = &m_blockBuckets[block * BucketCount];
+
+			const uint32_t begin = block * blockSize;
+			const uint32_t end = std::min(begin + blockSize, count);
+			for (uint32_t i = begin; i < end; i++)
+			{
+				const uint64_t key = pSourceKeys[i];
+				const uint32_t position = pOffsets[(key >> shift) & (BucketCount - 1)]++;
+				pDestKeys[position] = key;
+				pDestValues[position] = pSourceValues[i];
+			}
+		});
+
+		std::swap(pSourceKeys, pDestKeys);
+		std::swap(pSourceValues, pDestValues);
+	}
+
+	// After an odd number of passes the result is in the scratch arrays.
+	if (pSourceKeys != pKeys)
+	{
+		ForEachBlock(pJobSystem, blockCount, [&](uint32_t block)
+		{
+			const uint32_t begin = block * blockSize;
+			const uint32_t end = std::min(begin + blockSize, count);
+			if (begin < end)
+			{
+				memcpy(pKeys + begin, pSourceKeys + begin, (end - begin) * sizeof(uint64_t));
+				memcpy(pValues + begin, pSourceValues + begin, (end - begin) * sizeof(uint32_t));
+			}
+		});
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// Stable LSD radix sort of 64-bit keys carrying 32-bit values, 8 bits per pass.
+// Passes over digits that are equal in every key are skipped, so keys that only
+// vary in a few fields sort in a few passes. Inputs large enough to benefit are
+// split into blocks that are counted and scattered in parallel. Scratch memory
+// is kept between calls.
+class RadixSorter
+{
+public:
+    RadixSorter() {}
+
+    // pJobSystem may be null to sort on the calling thread.
+    void Sort(uint64_t* pKeys, uint32_t* pValues, uint32_t count, JobSystem* pJobSystem = nullptr);
+
+private:
+    static const uint32_t BucketCount = 256;
+    static const uint32_t MinKeysPerBlock = 16384;
+    static const uint32_t MaxBlocksPerWorker = 4;
+
+    std::vector<uint64_t> m_keyScratch;
+    std::vector<uint32_t> m_valueScratch;
+    std::vector<uint32_t> m_blockBuckets;       // BucketCount counts, then offsets, per block.
+    std::vector<uint64_t> m_blockVaryingBits;
+};
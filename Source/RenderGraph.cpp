@@ -0,0 +1,489 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <cassert>
+#include <queue>
+
+void RenderGraphBuilder::Read(RenderGraphResource resource, ERenderGraphState state)
+{
+	m_graph.AddAccess(m_passIndex, resource, state, false);
+}
+
+void RenderGraphBuilder::Write(RenderGraphResource resource, ERenderGraphState state)
+{
+	m_graph.AddAccess(m_passIndex, resource, state, true);
+}
+
+void RenderGraphBuilder::SetSideEffects()
+{
+	m_graph.m_passes[m_passIndex].sideEffects = true;
+}
+
+RenderGraph::RenderGraph() :
+	m_stats{},
+	m_compiled(false)
+{
+}
+
+void RenderGraph::Reset()
+{
+	m_resources.clear();
+	m_passes.clear();
+	m_executionOrder.clear();
+	m_barriers.clear();
+	m_finalBarriers.clear();
+	m_stats = {};
+	m_compiled = false;
+}
+
+RenderGraphResource RenderGraph::ImportResource(const char* name, ERenderGraphState initialState, ERenderGraphState finalState)
+{
+	Resource resource = {};
+	resource.name = name;
+	resource.imported = true;
+	resource.initialState = initialState;
+	resource.finalState = finalState;
+	resource.firstUse = UINT32_MAX;
+	resource.lastUse = UINT32_MAX;
+	m_resources.push_back(resource);
+
+	return static_cast<RenderGraphResource>(m_resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::CreateTransientResource(const char* name, uint64_t size, uint64_t alignment, uint32_t heapGroup)
+{
+	assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+	Resource resource = {};
+	resource.name = name;
+	resource.imported = false;
+	resource.size = size;
+	resource.alignment = alignment;
+	resource.heapGroup = heapGroup;
+	resource.firstUse = UINT32_MAX;
+	resource.lastUse = UINT32_MAX;
+	m_resources.push_back(resource);
+
+	m_compiled = false;
+	return static_cast<RenderGraphResource>(m_resources.size() - 1);
+}
+
+void RenderGraph::AddPass(const char* name, const std::function<void(RenderGraphBuilder&)>& setup, const std::function<void()>& execute)
+{
+	Pass pass;
+	pass.name = name;
+	pass.execute = execute;
+	pass.sideEffects = false;
+	pass.culled = false;
+	pass.barrierBegin = 0;
+	pass.barrierCount = 0;
+	m_passes.push_back(std::move(pass));
+
+	RenderGraphBuilder builder(*this, static_cast<uint32_t>(m_passes.size() - 1));
+	setup(builder);
+
+	m_compiled = false;
+}
+
+void RenderGraph::AddAccess(uint32_t passIndex, RenderGraphResource resource, ERenderGraphState state, bool write)
+{
+	assert(resource < m_resources.size());
+	assert(write == IsWriteState(state));
+
+	// One access per resource per pass. Reads combine; a write takes precedence.
+	for (Access& access : m_passes[passIndex].accesses)
+	{
+		if (access.resource == resource)
+		{
+			if (write)
+			{
+				access.state = state;
+				access.write = true;
+			}
+			else if (!access.write)
+			{
+				access.state = access.state | state;
+			}
+			return;
+		}
+	}
+
+	m_passes[passIndex].accesses.push_back({ resource, state, write });
+}
+
+void RenderGraph::Compile()
+{
+	m_executionOrder.clear();
+	m_barriers.clear();
+	m_finalBarriers.clear();
+	m_stats = {};
+
+	BuildDependencies();
+	CullPasses();
+	SortPasses();
+	PlanTransientResources();
+	ComputeBarriers();
+
+	m_stats.passCount = static_cast<uint32_t>(m_executionOrder.size());
+	m_stats.culledPassCount = static_cast<uint32_t>(m_passes.size() - m_executionOrder.size());
+	m_compiled = true;
+}
+
+void RenderGraph::BuildDependencies()
+{
+	const uint32_t noPass = UINT32_MAX;
+	std::vector<uint32_t> lastWriter(m_resources.size(), noPass);
+	std::vector<std::vector<uint32_t>> readersSinceWrite(m_resources.size());
+
+	for (uint32_t passIndex = 0; passIndex < m_passes.size(); passIndex++)
+	{
+		Pass& pass = m_passes[passIndex];
+		pass.dependencies.clear();
+		pass.orderAfter.clear();
+
+		for (const Access& access : pass.accesses)
+		{
+			const uint32_t writer = lastWriter[access.resource];
+
+			// Read after write, and write after write: writes are assumed to keep
+			// earlier contents (blending, partial updates), so both keep the writer alive.
+			if (writer != noPass)
+			{
+				pass.dependencies.push_back(writer);
+			}
+
+			if (access.write)
+			{
+				// Write after read only constrains ordering.
+				for (uint32_t reader : readersSinceWrite[access.resource])
+				{
+					if (reader != passIndex)
+					{
+						pass.orderAfter.push_back(reader);
+					}
+				}
+
+				lastWriter[access.resource] = passIndex;
+				readersSinceWrite[access.resource].clear();
+			}
+			else
+			{
+				readersSinceWrite[access.resource].push_back(passIndex);
+			}
+		}
+	}
+}
+
+void RenderGraph::CullPasses()
+{
+	// Roots are passes with side effects or that write a resource leaving the graph.
+	std::vector<uint32_t> stack;
+	for (uint32_t passIndex = 0; passIndex < m_passes.size(); passIndex++)
+	{
+		Pass& pass = m_passes[passIndex];
+		pass.culled = true;
+
+		bool root = pass.sideEffects;
+		for (const Access& access : pass.accesses)
+		{
+			root |= access.write && m_resources[access.resource].imported;
+		}
+
+		if (root)
+		{
+			stack.push_back(passIndex);
+		}
+	}
+
+	// Everything a root transitively depends on survives.
+	while (!stack.empty())
+	{
+		const uint32_t passIndex = stack.back();
+		stack.pop_back();
+
+		Pass& pass = m_passes[passIndex];
+		if (!pass.culled)
+		{
+			continue;
+		}
+
+		pass.culled = false;
+		for (uint32_t dependency : pass.dependencies)
+		{
+			if (m_passes[dependency].culled)
+			{
+				stack.push_back(dependency);
+			}
+		}
+	}
+}
+
+void RenderGraph::SortPasses()
+{
+	// Kahn's algorithm over the surviving passes, preferring declaration order among ready passes.
+	std::vector<uint32_t> inDegree(m_passes.size(), 0);
+	std::vector<std::vector<uint32_t>> successors(m_passes.size());
+
+	for (uint32_t passIndex = 0; passIndex < m_passes.size(); passIndex++)
+	{
+		const Pass& pass = m_passes[passIndex];
+		if (pass.culled)
+		{
+			continue;
+		}
+
+		auto addEdges = [&](const std::vector<uint32_t>& predecessors)
+		{
+			for (uint32_t predecessor : predecessors)
+			{
+				if (!m_passes[predecessor].culled)
+				{
+					successors[predecessor].push_back(passIndex);
+					inDegree[passIndex]++;
+				}
+			}
+		};
+		addEdges(pass.dependencies);
+		addEdges(pass.orderAfter);
+	}
+
+	std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> ready;
+	for (uint32_t passIndex = 0; passIndex < m_passes.size(); passIndex++)
+	{
+		if (!m_passes[passIndex].culled && inDegree[passIndex] == 0)
+		{
+			ready.push(passIndex);
+		}
+	}
+
+	while (!ready.empty())
+	{
+		const uint32_t passIndex = ready.top();
+		ready.pop();
+		m_executionOrder.push_back(passIndex);
+
+		for (uint32_t successor : successors[passIndex])
+		{
+			if (--inDegree[successor] == 0)
+			{
+				ready.push(successor);
+			}
+		}
+	}
+}
+
+void RenderGraph::PlanTransientResources()
+{
+	for (Resource& resource : m_resources)
+	{
+		if (!resource.imported)
+		{
+			resource.firstUse = UINT32_MAX;
+			resource.lastUse = UINT32_MAX;
+			resource.heapOffset = 0;
+			resource.aliased = false;
+		}
+	}
+
+	// Lifetimes span from the first to the last surviving pass touching the resource.
+	for (uint32_t position = 0; position < m_executionOrder.size(); position++)
+	{
+		for (const Access& access : m_passes[m_executionOrder[position]].accesses)
+		{
+			Resource& resource = m_resources[access.resource];
+			if (resource.imported)
+			{
+				continue;
+			}
+
+			if (resource.firstUse == UINT32_MAX)
+			{
+				assert(access.write && "First access to a transient resource must write it.");
+				resource.firstUse = position;
+				resource.initialState = access.state;
+				resource.finalState = access.state;
+			}
+			resource.lastUse = position;
+		}
+	}
+
+	m_transientRequests.clear();
+	m_transientRequestResources.clear();
+	for (RenderGraphResource index = 0; index < m_resources.size(); index++)
+	{
+		const Resource& resource = m_resources[index];
+		if (!resource.imported && resource.firstUse != UINT32_MAX)
+		{
+			m_transientRequests.push_back({ resource.size, resource.alignment, resource.firstUse, resource.lastUse, resource.heapGroup });
+			m_transientRequestResources.push_back(index);
+		}
+	}
+
+	m_transientPlanner.Plan(m_transientRequests, m_transientPlacements);
+
+	for (size_t i = 0; i < m_transientRequestResources.size(); i++)
+	{
+		Resource& resource = m_resources[m_transientRequestResources[i]];
+		resource.heapOffset = m_transientPlacements[i].offset;
+		resource.aliased = m_transientPlacements[i].aliased;
+	}
+
+	m_stats.transientResourceCount = static_cast<uint32_t>(m_transientRequests.size());
+	m_stats.transientMemory = m_transientPlanner.GetPlannedSize();
+	m_stats.naiveTransientMemory = m_transientPlanner.GetNaiveSize();
+}
+
+void RenderGraph::ComputeBarriers()
+{
+	// For every read, the union of read states up to the next write of the same
+	// resource. Transitioning straight into that union saves a barrier per
+	// additional reader (e.g. SRV in one pass, indirect argument in the next).
+	std::vector<std::vector<ERenderGraphState>> readUnion(m_passes.size());
+	std::vector<ERenderGraphState> pendingReads(m_resources.size(), ERenderGraphState::Common);
+
+	for (auto it = m_executionOrder.rbegin(); it != m_executionOrder.rend(); ++it)
+	{
+		const Pass& pass = m_passes[*it];
+		std::vector<ERenderGraphState>& unions = readUnion[*it];
+		unions.resize(pass.accesses.size());
+
+		for (size_t i = 0; i < pass.accesses.size(); i++)
+		{
+			const Access& access = pass.accesses[i];
+			if (access.write)
+			{
+				pendingReads[access.resource] = ERenderGraphState::Common;
+				unions[i] = access.state;
+			}
+			else
+			{
+				pendingReads[access.resource] = pendingReads[access.resource] | access.state;
+				unions[i] = pendingReads[access.resource];
+			}
+		}
+	}
+
+	std::vector<ERenderGraphState> currentState(m_resources.size());
+	for (size_t i = 0; i < m_resources.size(); i++)
+	{
+		currentState[i] = m_resources[i].initialState;
+	}
+
+	// Transients go back to their initial state once their last pass is done, while
+	// they are still the active resource in their memory, so next frame starts the same.
+	std::vector<std::vector<RenderGraphResource>> expiring(m_executionOrder.size() + 1);
+	for (RenderGraphResource resource : m_transientRequestResources)
+	{
+		expiring[m_resources[resource].lastUse + 1].push_back(resource);
+	}
+
+	auto restoreExpired = [&](uint32_t position, std::vector<RenderGraphBarrier>& barriers)
+	{
+		for (RenderGraphResource resource : expiring[position])
+		{
+			if (currentState[resource] != m_resources[resource].initialState)
+			{
+				barriers.push_back({ ERenderGraphBarrierType::Transition, resource, currentState[resource], m_resources[resource].initialState });
+				currentState[resource] = m_resources[resource].initialState;
+			}
+		}
+	};
+
+	for (uint32_t position = 0; position < m_executionOrder.size(); position++)
+	{
+		const uint32_t passIndex = m_executionOrder[position];
+		Pass& pass = m_passes[passIndex];
+		pass.barrierBegin = static_cast<uint32_t>(m_barriers.size());
+
+		restoreExpired(position, m_barriers);
+
+		for (size_t i = 0; i < pass.accesses.size(); i++)
+		{
+			const Access& access = pass.accesses[i];
+			ERenderGraphState& current = currentState[access.resource];
+			const Resource& resource = m_resources[access.resource];
+
+			if (!resource.imported && resource.firstUse == position && resource.aliased)
+			{
+				m_barriers.push_back({ ERenderGraphBarrierType::Aliasing, access.resource, current, current });
+			}
+
+			if (access.write)
+			{
+				if (current != access.state)
+				{
+					m_barriers.push_back({ ERenderGraphBarrierType::Transition, access.resource, current, access.state });
+					current = access.state;
+				}
+				else if (access.state == ERenderGraphState::UnorderedAccess && resource.firstUse != position)
+				{
+					// Consecutive UAV writes still need the previous one to finish.
+					m_barriers.push_back({ ERenderGraphBarrierType::UnorderedAccess, access.resource, current, current });
+				}
+			}
+			else
+			{
+				// Already in a read-only state that covers this read?
+				const bool covered = !IsWriteState(current) && current != ERenderGraphState::Common && (current & access.state) == access.state;
+				if (!covered)
+				{
+					const ERenderGraphState target = readUnion[passIndex][i];
+					m_barriers.push_back({ ERenderGraphBarrierType::Transition, access.resource, current, target });
+					current = target;
+				}
+			}
+		}
+
+		pass.barrierCount = static_cast<uint32_t>(m_barriers.size()) - pass.barrierBegin;
+		if (pass.barrierCount > 0)
+		{
+			m_stats.barrierBatchCount++;
+		}
+	}
+
+	restoreExpired(static_cast<uint32_t>(m_executionOrder.size()), m_finalBarriers);
+
+	for (RenderGraphResource resource = 0; resource < m_resources.size(); resource++)
+	{
+		const Resource& desc = m_resources[resource];
+		if (desc.imported && currentState[resource] != desc.finalState)
+		{
+			m_finalBarriers.push_back({ ERenderGraphBarrierType::Transition, resource, currentState[resource], desc.finalState });
+		}
+	}
+
+	if (!m_finalBarriers.empty())
+	{
+		m_stats.barrierBatchCount++;
+	}
+	m_stats.barrierCount = static_cast<uint32_t>(m_barriers.size() + m_finalBarriers.size());
+}
+
+void RenderGraph::Execute(IRenderGraphBackend& backend)
+{
+	if (!m_compiled)
+	{
+		Compile();
+	}
+
+	backend.PrepareTransientResources(*this);
+
+	for (uint32_t passIndex : m_executionOrder)
+	{
+		const Pass& pass = m_passes[passIndex];
+		if (pass.barrierCount > 0)
+		{
+			backend.ResourceBarriers(&m_barriers[pass.barrierBegin], pass.barrierCount);
+		}
+
+		if (pass.execute)
+		{
+			pass.execute();
+		}
+	}
+
+	if (!m_finalBarriers.empty())
+	{
+		backend.ResourceBarriers(m_finalBarriers.data(), static_cast<uint32_t>(m_finalBarriers.size()));
+	}
+}
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "TransientResourcePlanner.h"
+
+// API-independent resource states. Read states may be combined; a pass that
+// writes a resource must use exactly one write state for it.
+enum class ERenderGraphState : uint32_t
+{
+    Common          = 0,
+    Present         = 0,
+    RenderTarget    = 1 << 0,
+    DepthWrite      = 1 << 1,
+    DepthRead       = 1 << 2,
+    UnorderedAccess = 1 << 3,
+    ShaderResource  = 1 << 4,
+    CopySource      = 1 << 5,
+    CopyDest        = 1 << 6,
+    IndirectArgument = 1 << 7,
+    VertexBuffer    = 1 << 8,
+    IndexBuffer     = 1 << 9,
+
+    WriteMask = RenderTarget | DepthWrite | UnorderedAccess | CopyDest,
+};
+
+inline ERenderGraphState operator|(ERenderGraphState a, ERenderGraphState b) { return static_cast<ERenderGraphState>(static_cast<uint32_t>(a) | static_cast<uint32_t>(b)); }
+inline ERenderGraphState operator&(ERenderGraphState a, ERenderGraphState b) { return static_cast<ERenderGraphState>(static_cast<uint32_t>(a) & static_cast<uint32_t>(b)); }
+inline bool IsWriteState(ERenderGraphState state) { return (state & ERenderGraphState::WriteMask) != ERenderGraphState::Common; }
+
+typedef uint32_t RenderGraphResource;
+static const RenderGraphResource InvalidRenderGraphResource = UINT32_MAX;
+
+enum class ERenderGraphBarrierType : uint32_t
+{
+    Transition,
+    UnorderedAccess,
+    Aliasing,       // resource becomes the active resource in memory it shares with others.
+};
+
+struct RenderGraphBarrier
+{
+    ERenderGraphBarrierType type;
+    RenderGraphResource resource;
+    ERenderGraphState before;
+    ERenderGraphState after;
+};
+
+class RenderGraph;
+
+// Receives the barriers the graph computes. The D3D12 backend translates them
+// into ResourceBarrier calls; the null backend only counts them.
+class IRenderGraphBackend
+{
+public:
+    virtual ~IRenderGraphBackend() {}
+
+    // Called by Execute before the first pass, once the transient placements are known.
+    virtual void PrepareTransientResources(const RenderGraph& graph) { (void)graph; }
+
+    virtual void ResourceBarriers(const RenderGraphBarrier* pBarriers, uint32_t count) = 0;
+};
+
+class NullRenderGraphBackend : public IRenderGraphBackend
+{
+public:
+    NullRenderGraphBackend() : m_barrierCount(0), m_batchCount(0) {}
+
+    void ResourceBarriers(const RenderGraphBarrier* pBarriers, uint32_t count) override
+    {
+        (void)pBarriers;
+        m_barrierCount += count;
+        m_batchCount++;
+    }
+
+    uint64_t GetBarrierCount() const { return m_barrierCount; }
+    uint64_t GetBatchCount() const { return m_batchCount; }
+
+private:
+    uint64_t m_barrierCount;
+    uint64_t m_batchCount;
+};
+
+// Handed to a pass's setup callback to declare what the pass touches.
+class RenderGraphBuilder
+{
+public:
+    void Read(RenderGraphResource resource, ERenderGraphState state);
+    void Write(RenderGraphResource resource, ERenderGraphState state);
+
+    // Keep the pass even if nothing reads its outputs (e.g. readbacks, queries).
+    void SetSideEffects();
+
+private:
+    friend class RenderGraph;
+    RenderGraphBuilder(RenderGraph& graph, uint32_t passIndex) : m_graph(graph), m_passIndex(passIndex) {}
+
+    RenderGraph& m_graph;
+    uint32_t m_passIndex;
+};
+
+// Frame graph rebuilt every frame. Passes declare their reads and writes; Compile
+// orders them topologically, culls passes whose outputs are never consumed and
+// computes the minimal set of state transitions, batched per pass.
+class RenderGraph
+{
+public:
+    struct Stats
+    {
+        uint32_t passCount;
+        uint32_t culledPassCount;
+        uint32_t barrierCount;
+        uint32_t barrierBatchCount;
+        uint32_t transientResourceCount;
+        uint64_t transientMemory;           // Sum of the transient heap sizes.
+        uint64_t naiveTransientMemory;      // What the transients would take without aliasing.
+    };
+
+    RenderGraph();
+
+    // Drop all passes and resources, keeping allocations for the next frame.
+    void Reset();
+
+    // A resource owned outside the graph. It is in initialState when the frame
+    // starts and is transitioned to finalState at the end. Writes to imported
+    // resources are considered outputs of the frame.
+    RenderGraphResource ImportResource(const char* name, ERenderGraphState initialState, ERenderGraphState finalState);
+
+    // A resource owned by the graph that only lives within the frame. Transients
+    // whose lifetimes do not overlap share memory, so the first pass using one
+    // must not depend on its contents, and must write render targets and depth
+    // buffers as a target or copy destination (the D3D12 backend discards them
+    // after their aliasing barrier). size and alignment come from the backend
+    // (e.g. GetResourceAllocationInfo); only transients with the same heapGroup
+    // may alias each other.
+    RenderGraphResource CreateTransientResource(const char* name, uint64_t size, uint64_t alignment, uint32_t heapGroup = 0);
+
+    void AddPass(const char* name, const std::function<void(RenderGraphBuilder&)>& setup, const std::function<void()>& execute);
+
+    void Compile();
+    void Execute(IRenderGraphBackend& backend);
+
+    const Stats& GetStats() const { return m_stats; }
+    uint32_t GetResourceCount() const { return static_cast<uint32_t>(m_resources.size()); }
+    const char* GetResourceName(RenderGraphResource resource) const { return m_resources[resource].name.c_str(); }
+
+    // Transient placement, valid after Compile. Transients only used by culled
+    // passes get no memory. A transient's initial state is the state of its first
+    // access; the graph returns it to that state at the end of its lifetime.
+    bool IsTransient(RenderGraphResource resource) const { return !m_resources[resource].imported; }
+    bool IsTransientAllocated(RenderGraphResource resource) const { return m_resources[resource].firstUse != UINT32_MAX; }
+    uint32_t GetTransientHeapGroup(RenderGraphResource resource) const { return m_resources[resource].heapGroup; }
+    uint64_t GetTransientHeapOffset(RenderGraphResource resource) const { return m_resources[resource].heapOffset; }
+    ERenderGraphState GetInitialState(RenderGraphResource resource) const { return m_resources[resource].initialState; }
+    uint32_t GetTransientHeapGroupCount() const { return m_transientPlanner.GetHeapGroupCount(); }
+    uint64_t GetTransientHeapSize(uint32_t heapGroup) const { return m_transientPlanner.GetHeapSize(heapGroup); }
+
+    // Compiled pass order, excluding culled passes. Valid after Compile.
+    const std::vector<uint32_t>& GetExecutionOrder() const { return m_executionOrder; }
+    const char* GetPassName(uint32_t passIndex) const { return m_passes[passIndex].name.c_str(); }
+
+private:
+    friend class RenderGraphBuilder;
+
+    struct Access
+    {
+        RenderGraphResource resource;
+        ERenderGraphState state;
+        bool write;
+    };
+
+    struct Resource
+    {
+        std::string name;
+        bool imported;
+        ERenderGraphState initialState;
+        ERenderGraphState finalState;
+
+        // Transient resources only.
+        uint64_t size;
+        uint64_t alignment;
+        uint32_t heapGroup;
+        uint64_t heapOffset;
+        uint32_t firstUse;      // Positions in the execution order.
+        uint32_t lastUse;
+        bool aliased;
+    };
+
+    struct Pass
+    {
+        std::string name;
+        std::function<void()> execute;
+        std::vector<Access> accesses;
+        std::vector<uint32_t> dependencies;     // Passes whose writes this pass reads (RAW).
+        std::vector<uint32_t> orderAfter;       // Additional ordering edges (WAR, WAW).
+        bool sideEffects;
+        bool culled;
+        uint32_t barrierBegin;
+        uint32_t barrierCount;
+    };
+
+    void AddAccess(uint32_t passIndex, RenderGraphResource resource, ERenderGraphState state, bool write);
+    void BuildDependencies();
+    void CullPasses();
+    void SortPasses();
+    void PlanTransientResources();
+    void ComputeBarriers();
+
+    std::vector<Resource> m_resources;
+    std::vector<Pass> m_passes;
+    std::vector<uint32_t> m_executionOrder;
+    std::vector<RenderGraphBarrier> m_barriers;
+    std::vector<RenderGraphBarrier> m_finalBarriers;
+    TransientResourcePlanner m_transientPlanner;
+    std::vector<TransientResourcePlanner::Request> m_transientRequests;
+    std::vector<TransientResourcePlanner::Placement> m_transientPlacements;
+    std::vector<RenderGraphResource> m_transientRequestResources;
+    Stats m_stats;
+    bool m_compiled;
+};
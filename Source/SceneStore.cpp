@@ -0,0 +1,425 @@
+#include "SceneStore.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+SceneStore::SceneStore() :
+	m_freeSlot(EndOfList),
+	m_structureChanged(false),
+	m_orderBroken(false)
+{
+}
+
+// Applies f to every per-object float array, so adding a component cannot miss a resize or a move.
+template<typename F>
+void SceneStore::ForEachFloatArray(const F& f)
+{
+	std::vector<float>* const arrays[] =
+	{
+		&m_positionX, &m_positionY, &m_positionZ,
+		&m_rotationX, &m_rotationY, &m_rotationZ, &m_rotationW,
+		&m_scaleX, &m_scaleY, &m_scaleZ,
+		&m_localCenterX, &m_localCenterY, &m_localCenterZ,
+		&m_localExtentX, &m_localExtentY, &m_localExtentZ,
+		&m_worldCenterX, &m_worldCenterY, &m_worldCenterZ,
+		&m_worldExtentX, &m_worldExtentY, &m_worldExtentZ,
+	};
+	for (std::vector<float>* pArray : arrays)
+	{
+		f(*pArray);
+	}
+}
+
+template<typename T>
+void SceneStore::Permute(std::vector<T>& array, const std::vector<uint32_t>& order)
+{
+	std::vector<T> permuted(order.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		permuted[i] = array[order[i]];
+	}
+	array.swap(permuted);
+}
+
+void SceneStore::Reserve(uint32_t objectCount)
+{
+	ForEachFloatArray([objectCount](std::vector<float>& array) { array.reserve(objectCount); });
+
+	m_slots.reserve(objectCount);
+	m_handles.reserve(objectCount);
+	m_worldMatrices.reserve(objectCount);
+	m_meshes.reserve(objectCount);
+	m_materials.reserve(objectCount);
+	m_parentSlots.reserve(objectCount);
+	m_levels.reserve(objectCount);
+	m_dirty.reserve(objectCount);
+	m_worldChanged.reserve(objectCount);
+	m_parentIndices.reserve(objectCount);
+}
+
+SceneObjectHandle SceneStore::Create(const SceneObjectDesc& desc, SceneObjectHandle parent)
+{
+	const uint32_t denseIndex = GetObjectCount();
+
+	uint32_t parentSlot = EndOfList;
+	uint32_t parentIndex = EndOfList;
+	uint32_t level = 0;
+	if (!parent.IsNull())
+	{
+		parentSlot = parent.index;
+		parentIndex = Resolve(parent);
+		level = m_levels[parentIndex] + 1;
+		m_slots[parent.index].childCount++;
+	}
+
+	uint32_t slotIndex = m_freeSlot;
+	if (slotIndex != EndOfList)
+	{
+		m_freeSlot = m_slots[slotIndex].denseIndex;
+	}
+	else
+	{
+		slotIndex = static_cast<uint32_t>(m_slots.size());
+		m_slots.push_back({ 0, 0, 0 });
+	}
+
+	Slot& slot = m_slots[slotIndex];
+	slot.denseIndex = denseIndex;
+	const SceneObjectHandle handle = { slotIndex, slot.generation };
+
+	m_handles.push_back(handle);
+	m_positionX.push_back(desc.position.x);
+	m_positionY.push_back(desc.position.y);
+	m_positionZ.push_back(desc.position.z);
+	m_rotationX.push_back(desc.rotation.x);
+	m_rotationY.push_back(desc.rotation.y);
+	m_rotationZ.push_back(desc.rotation.z);
+	m_rotationW.push_back(desc.rotation.w);
+	m_scaleX.push_back(desc.scale.x);
+	m_scaleY.push_back(desc.scale.y);
+	m_scaleZ.push_back(desc.scale.z);
+	m_localCenterX.push_back(desc.boundsCenter.x);
+	m_localCenterY.push_back(desc.boundsCenter.y);
+	m_localCenterZ.push_back(desc.boundsCenter.z);
+	m_localExtentX.push_back(desc.boundsExtents.x);
+	m_localExtentY.push_back(desc.boundsExtents.y);
+	m_localExtentZ.push_back(desc.boundsExtents.z);
+	m_worldCenterX.push_back(0.0f);
+	m_worldCenterY.push_back(0.0f);
+	m_worldCenterZ.push_back(0.0f);
+	m_worldExtentX.push_back(0.0f);
+	m_worldExtentY.push_back(0.0f);
+	m_worldExtentZ.push_back(0.0f);
+	m_worldMatrices.push_back(SceneMatrix());
+	m_meshes.push_back(desc.mesh);
+	m_materials.push_back(desc.material);
+	m_parentSlots.push_back(parentSlot);
+	m_levels.push_back(level);
+	m_dirty.push_back(1);
+	m_worldChanged.push_back(0);
+
+	// Usable right away; the next UpdateWorld recomputes it once the parent is current.
+	ComputeWorld(denseIndex, parentIndex != EndOfList ? &m_worldMatrices[parentIndex] : nullptr);
+
+	m_structureChanged = true;
+	m_orderBroken |= denseIndex > 0 && m_levels[denseIndex - 1] > level;
+	return handle;
+}
+
+void SceneStore::Destroy(SceneObjectHandle handle)
+{
+	const uint32_t denseIndex = Resolve(handle);
+	const uint32_t lastIndex = GetObjectCount() - 1;
+	assert(m_slots[handle.index].childCount == 0);
+
+	if (m_parentSlots[denseIndex] != EndOfList)
+	{
+		m_slots[m_parentSlots[denseIndex]].childCount--;
+	}
+
+	// Keep the arrays packed by moving the last object into the hole.
+	if (denseIndex != lastIndex)
+	{
+		ForEachFloatArray([denseIndex, lastIndex](std::vector<float>& array) { array[denseIndex] = array[lastIndex]; });
+
+		m_handles[denseIndex] = m_handles[lastIndex];
+		m_worldMatrices[denseIndex] = m_worldMatrices[lastIndex];
+		m_meshes[denseIndex] = m_meshes[lastIndex];
+		m_materials[denseIndex] = m_materials[lastIndex];
+		m_parentSlots[denseIndex] = m_parentSlots[lastIndex];
+		m_levels[denseIndex] = m_levels[lastIndex];
+		m_dirty[denseIndex] = m_dirty[lastIndex];
+		m_worldChanged[denseIndex] = m_worldChanged[lastIndex];
+		m_slots[m_handles[denseIndex].index].denseIndex = denseIndex;
+
+		// The moved object may now sit between shallower and deeper ones.
+		const uint32_t level = m_levels[denseIndex];
+		m_orderBroken |= (denseIndex > 0 && m_levels[denseIndex - 1] > level) || (denseIndex + 1 < lastIndex && level > m_levels[denseIndex + 1]);
+	}
+
+	ForEachFloatArray([](std::vector<float>& array) { array.pop_back(); });
+	m_handles.pop_back();
+	m_worldMatrices.pop_back();
+	m_meshes.pop_back();
+	m_materials.pop_back();
+	m_parentSlots.pop_back();
+	m_levels.pop_back();
+	m_dirty.pop_back();
+	m_worldChanged.pop_back();
+	m_structureChanged = true;
+
+	Slot& slot = m_slots[handle.index];
+	slot.generation++;
+	slot.denseIndex = m_freeSlot;
+	m_freeSlot = handle.index;
+}
+
+bool SceneStore::IsValid(SceneObjectHandle handle) const
+{
+	if (handle.index >= m_slots.size())
+	{
+		return false;
+	}
+
+	// Free slots have already moved on to the next generation.
+	const Slot& slot = m_slots[handle.index];
+	return slot.generation == handle.generation && slot.denseIndex < GetObjectCount() && m_handles[slot.denseIndex].index == handle.index;
+}
+
+void SceneStore::SetPosition(SceneObjectHandle handle, const SceneFloat3& position)
+{
+	const uint32_t i = Resolve(handle);
+	m_positionX[i] = position.x;
+	m_positionY[i] = position.y;
+	m_positionZ[i] = position.z;
+	m_dirty[i] = 1;
+}
+
+void SceneStore::SetRotation(SceneObjectHandle handle, const SceneFloat4& rotation)
+{
+	const uint32_t i = Resolve(handle);
+	m_rotationX[i] = rotation.x;
+	m_rotationY[i] = rotation.y;
+	m_rotationZ[i] = rotation.z;
+	m_rotationW[i] = rotation.w;
+	m_dirty[i] = 1;
+}
+
+void SceneStore::SetScale(SceneObjectHandle handle, const SceneFloat3& scale)
+{
+	const uint32_t i = Resolve(handle);
+	m_scaleX[i] = scale.x;
+	m_scaleY[i] = scale.y;
+	m_scaleZ[i] = scale.z;
+	m_dirty[i] = 1;
+}
+
+void SceneStore::SetMesh(SceneObjectHandle handle, uint32_t mesh)
+{
+	m_meshes[Resolve(handle)] = mesh;
+}
+
+void SceneStore::SetMaterial(SceneObjectHandle handle, uint32_t material)
+{
+	m_materials[Resolve(handle)] = material;
+}
+
+void SceneStore::UpdateWorld(JobSystem* pJobSystem, uint32_t grainSize)
+{
+	const uint32_t objectCount = GetObjectCount();
+	if (m_structureChanged)
+	{
+		if (m_orderBroken)
+		{
+			RestoreOrder();
+		}
+
+		m_parentIndices.resize(objectCount);
+		m_levelStarts.clear();
+		for (uint32_t i = 0; i < objectCount; i++)
+		{
+			const uint32_t parentSlot = m_parentSlots[i];
+			m_parentIndices[i] = parentSlot;
+			if (parentSlot != EndOfList)
+			{
+				m_parentIndices[i] = m_slots[parentSlot].denseIndex;
+			}
+			while (m_levelStarts.size() <= m_levels[i])
+			{
+				m_levelStarts.push_back(i);
+			}
+		}
+		m_levelStarts.push_back(objectCount);
+
+		m_structureChanged = false;
+		m_orderBroken = false;
+	}
+
+	// Each level only reads the level above, which the previous iteration finished.
+	for (size_t level = 0; level + 1 < m_levelStarts.size(); level++)
+	{
+		const uint32_t begin = m_levelStarts[level];
+		const uint32_t end = m_levelStarts[level + 1];
+		if (pJobSystem != nullptr)
+		{
+			pJobSystem->ParallelFor(end - begin, grainSize, [this, begin](uint32_t rangeBegin, uint32_t rangeEnd)
+			{
+				UpdateLevel(begin + rangeBegin, begin + rangeEnd);
+			});
+		}
+		else
+		{
+			UpdateLevel(begin, end);
+		}
+	}
+}
+
+// An object's world matrix is recomputed when its own transform changed or its
+// parent's world matrix did; clean subtrees only cost a flag test per object.
+void SceneStore::UpdateLevel(uint32_t begin, uint32_t end)
+{
+	for (uint32_t i = begin; i < end; i++)
+	{
+		const uint32_t parentIndex = m_parentIndices[i];
+		const bool parentChanged = parentIndex != EndOfList && m_worldChanged[parentIndex];
+		if (!m_dirty[i] && !parentChanged)
+		{
+			m_worldChanged[i] = 0;
+			continue;
+		}
+
+		ComputeWorld(i, parentIndex != EndOfList ? &m_worldMatrices[parentIndex] : nullptr);
+		m_dirty[i] = 0;
+		m_worldChanged[i] = 1;
+	}
+}
+
+// World = scale * rotation * translation * parent world, in the row-vector
+// convention of DirectXMath. The world box encloses the transformed local box:
+// its extents are the local extents projected onto each world axis.
+void SceneStore::ComputeWorld(uint32_t i, const SceneMatrix* pParentWorld)
+{
+	const float qx = m_rotationX[i];
+	const float qy = m_rotationY[i];
+	const float qz = m_rotationZ[i];
+	const float qw = m_rotationW[i];
+	const float sx = m_scaleX[i];
+	const float sy = m_scaleY[i];
+	const float sz = m_scaleZ[i];
+
+	float local[4][3];
+	local[0][0] = (1.0f - 2.0f * (qy * qy + qz * qz)) * sx;
+	local[0][1] = 2.0f * (qx * qy + qz * qw) * sx;
+	local[0][2] = 2.0f * (qx * qz - qy * qw) * sx;
+	local[1][0] = 2.0f * (qx * qy - qz * qw) * sy;
+	local[1][1] = (1.0f - 2.0f * (qx * qx + qz * qz)) * sy;
+	local[1][2] = 2.0f * (qy * qz + qx * qw) * sy;
+	local[2][0] = 2.0f * (qx * qz + qy * qw) * sz;
+	local[2][1] = 2.0f * (qy * qz - qx * qw) * sz;
+	local[2][2] = (1.0f - 2.0f * (qx * qx + qy * qy)) * sz;
+	local[3][0] = m_positionX[i];
+	local[3][1] = m_positionY[i];
+	local[3][2] = m_positionZ[i];
+
+	float (&m)[4][4] = m_worldMatrices[i].m;
+	if (pParentWorld == nullptr)
+	{
+		for (int row = 0; row < 4; row++)
+		{
+			m[row][0] = local[row][0];
+			m[row][1] = local[row][1];
+			m[row][2] = local[row][2];
+		}
+	}
+	else
+	{
+		// Both matrices are affine, so the last column stays (0, 0, 0, 1).
+		const float (&p)[4][4] = pParentWorld->m;
+		for (int row = 0; row < 4; row++)
+		{
+			const float w = row == 3 ? 1.0f : 0.0f;
+			m[row][0] = local[row][0] * p[0][0] + local[row][1] * p[1][0] + local[row][2] * p[2][0] + w * p[3][0];
+			m[row][1] = local[row][0] * p[0][1] + local[row][1] * p[1][1] + local[row][2] * p[2][1] + w * p[3][1];
+			m[row][2] = local[row][0] * p[0][2] + local[row][1] * p[1][2] + local[row][2] * p[2][2] + w * p[3][2];
+		}
+	}
+	m[0][3] = 0.0f;
+	m[1][3] = 0.0f;
+	m[2][3] = 0.0f;
+	m[3][3] = 1.0f;
+
+	const float cx = m_localCenterX[i];
+	const float cy = m_localCenterY[i];
+	const float cz = m_localCenterZ[i];
+	const float ex = m_localExtentX[i];
+	const float ey = m_localExtentY[i];
+	const float ez = m_localExtentZ[i];
+
+	m_worldCenterX[i] = cx * m[0][0] + cy * m[1][0] + cz * m[2][0] + m[3][0];
+	m_worldCenterY[i] = cx * m[0][1] + cy * m[1][1] + cz * m[2][1] + m[3][1];
+	m_worldCenterZ[i] = cx * m[0][2] + cy * m[1][2] + cz * m[2][2] + m[3][2];
+	m_worldExtentX[i] = ex * std::fabs(m[0][0]) + ey * std::fabs(m[1][0]) + ez * std::fabs(m[2][0]);
+	m_worldExtentY[i] = ex * std::fabs(m[0][1]) + ey * std::fabs(m[1][1]) + ez * std::fabs(m[2][1]);
+	m_worldExtentZ[i] = ex * std::fabs(m[0][2]) + ey * std::fabs(m[1][2]) + ez * std::fabs(m[2][2]);
+}
+
+// Stable counting sort of every dense array by level, so each level becomes one
+// contiguous range again. Objects within a level keep their relative order.
+void SceneStore::RestoreOrder()
+{
+	const uint32_t objectCount = GetObjectCount();
+	const uint32_t levelCount = objectCount > 0 ? *std::max_element(m_levels.begin(), m_levels.end()) + 1 : 0;
+
+	std::vector<uint32_t> levelOffsets(levelCount + 1, 0);
+	for (uint32_t i = 0; i < objectCount; i++)
+	{
+		levelOffsets[m_levels[i] + 1]++;
+	}
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		levelOffsets[level + 1] += levelOffsets[level];
+	}
+
+	// order[new dense index] = old dense index.
+	std::vector<uint32_t> order(objectCount);
+	for (uint32_t i = 0; i < objectCount; i++)
+	{
+		order[levelOffsets[m_levels[i]]++] = i;
+	}
+
+	ForEachFloatArray([&order](std::vector<float>& array) { Permute(array, order); });
+	Permute(m_handles, order);
+	Permute(m_worldMatrices, order);
+	Permute(m_meshes, order);
+	Permute(m_materials, order);
+	Permute(m_parentSlots, order);
+	Permute(m_levels, order);
+	Permute(m_dirty, order);
+	Permute(m_worldChanged, order);
+
+	for (uint32_t i = 0; i < objectCount; i++)
+	{
+		m_slots[m_handles[i].index].denseIndex = i;
+	}
+}
+
+SceneBoundsView SceneStore::GetWorldBounds() const
+{
+	SceneBoundsView view;
+	view.centerX = m_worldCenterX.data();
+	view.centerY = m_worldCenterY.data();
+	view.centerZ = m_worldCenterZ.data();
+	view.extentX = m_worldExtentX.data();
+	view.extentY = m_worldExtentY.data();
+	view.extentZ = m_worldExtentZ.data();
+	view.count = GetObjectCount();
+	return view;
+}
+
+uint32_t SceneStore::Resolve(SceneObjectHandle handle) const
+{
+	assert(IsValid(handle));
+	return m_slots[handle.index].denseIndex;
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// Plain vector types, layout compatible with XMFLOAT3, XMFLOAT4 and XMFLOAT4X4.
+struct SceneFloat3
+{
+    float x, y, z;
+};
+
+struct SceneFloat4
+{
+    float x, y, z, w;
+};
+
+struct SceneMatrix
+{
+    float m[4][4];      // Row major, row vectors (v * M), translation in the last row.
+};
+
+// Reference to a scene object. The generation changes every time the object's
+// slot is reused, so stale handles are detected instead of reaching the slot's
+// next owner.
+struct SceneObjectHandle
+{
+    uint32_t index;
+    uint32_t generation;
+
+    bool IsNull() const { return index == UINT32_MAX; }
+};
+
+static const SceneObjectHandle NullSceneObjectHandle = { UINT32_MAX, 0 };
+
+struct SceneObjectDesc
+{
+    SceneFloat3 position;
+    SceneFloat4 rotation;       // Unit quaternion.
+    SceneFloat3 scale;
+    SceneFloat3 boundsCenter;   // Local space AABB.
+    SceneFloat3 boundsExtents;
+    uint32_t mesh;
+    uint32_t material;
+};
+
+// Structure-of-arrays view of axis-aligned boxes, one entry per dense index.
+struct SceneBoundsView
+{
+    const float* centerX;
+    const float* centerY;
+    const float* centerZ;
+    const float* extentX;
+    const float* extentY;
+    const float* extentZ;
+    uint32_t count;
+};
+
+// Scene objects stored as structure of arrays. Live objects are packed at dense
+// indices [0, GetObjectCount()), so per-frame passes stream through each array
+// linearly and only touch the components they need. Destroying an object moves
+// the last one into its place; handles stay valid because they go through a
+// slot table that maps them to the current dense index.
+//
+// Objects may have a parent, in which case their position, rotation and scale
+// are relative to it. The dense arrays are kept in breadth-first order (by depth
+// in the hierarchy), so each level is one contiguous range and every parent is
+// updated before its children. Creating and destroying objects can break that
+// order; UpdateWorld restores it, which also changes dense indices.
+//
+// Not thread-safe.
+class SceneStore
+{
+public:
+    SceneStore();
+
+    SceneStore(const SceneStore&) = delete;
+    SceneStore& operator=(const SceneStore&) = delete;
+
+    void Reserve(uint32_t objectCount);
+
+    SceneObjectHandle Create(const SceneObjectDesc& desc, SceneObjectHandle parent = NullSceneObjectHandle);
+
+    // Children must be destroyed before their parent.
+    void Destroy(SceneObjectHandle handle);
+    bool IsValid(SceneObjectHandle handle) const;
+
+    void SetPosition(SceneObjectHandle handle, const SceneFloat3& position);
+    void SetRotation(SceneObjectHandle handle, const SceneFloat4& rotation);
+    void SetScale(SceneObjectHandle handle, const SceneFloat3& scale);
+    void SetMesh(SceneObjectHandle handle, uint32_t mesh);
+    void SetMaterial(SceneObjectHandle handle, uint32_t material);
+
+    // Recompute the world matrices and world bounds of objects whose transform,
+    // or an ancestor's, changed since the last update. Levels are processed in
+    // order, each split into ranges of grainSize objects over pJobSystem.
+    void UpdateWorld(JobSystem* pJobSystem = nullptr, uint32_t grainSize = 4096);
+
+    uint32_t GetObjectCount() const { return static_cast<uint32_t>(m_handles.size()); }
+    uint32_t GetDenseIndex(SceneObjectHandle handle) const { return m_slots[handle.index].denseIndex; }
+    SceneObjectHandle GetHandle(uint32_t denseIndex) const { return m_handles[denseIndex]; }
+
+    // For structures that key objects by handle.index, which unlike the dense index never changes.
+    uint32_t GetSlotDenseIndex(uint32_t slot) const { return m_slots[slot].denseIndex; }
+    uint32_t GetSlotCount() const { return static_cast<uint32_t>(m_slots.size()); }
+
+    // Per dense index, valid after UpdateWorld. GetWorldChanged is non-zero for
+    // objects whose world matrix the last UpdateWorld recomputed.
+    const SceneMatrix* GetWorldMatrices() const { return m_worldMatrices.data(); }
+    const uint8_t* GetWorldChanged() const { return m_worldChanged.data(); }
+    SceneBoundsView GetWorldBounds() const;
+    const uint32_t* GetMeshes() const { return m_meshes.data(); }
+    const uint32_t* GetMaterials() const { return m_materials.data(); }
+
+private:
+    struct Slot
+    {
+        uint32_t denseIndex;    // Next free slot while the slot is unused.
+        uint32_t generation;
+        uint32_t childCount;
+    };
+
+    static const uint32_t EndOfList = UINT32_MAX;
+
+    uint32_t Resolve(SceneObjectHandle handle) const;
+    void ComputeWorld(uint32_t i, const SceneMatrix* pParentWorld);
+    void UpdateLevel(uint32_t begin, uint32_t end);
+    void RestoreOrder();
+
+    template<typename F>
+    void ForEachFloatArray(const F& f);
+
+    template<typename T>
+    static void Permute(std::vector<T>& array, const std::vector<uint32_t>& order);
+
+    std::vector<Slot> m_slots;
+    uint32_t m_freeSlot;
+
+    // Dense arrays.
+    std::vector<SceneObjectHandle> m_handles;
+    std::vector<float> m_positionX, m_positionY, m_positionZ;
+    std::vector<float> m_rotationX, m_rotationY, m_rotationZ, m_rotationW;
+    std::vector<float> m_scaleX, m_scaleY, m_scaleZ;
+    std::vector<float> m_localCenterX, m_localCenterY, m_localCenterZ;
+    std::vector<float> m_localExtentX, m_localExtentY, m_localExtentZ;
+    std::vector<float> m_worldCenterX, m_worldCenterY, m_worldCenterZ;
+    std::vector<float> m_worldExtentX, m_worldExtentY, m_worldExtentZ;
+    std::vector<SceneMatrix> m_worldMatrices;
+    std::vector<uint32_t> m_meshes;
+    std::vector<uint32_t> m_materials;
+    std::vector<uint32_t> m_parentSlots;        // EndOfList for roots.
+    std::vector<uint32_t> m_levels;             // Depth in the hierarchy, 0 for roots.
+    std::vector<uint8_t> m_dirty;               // Local transform changed since the last UpdateWorld.
+    std::vector<uint8_t> m_worldChanged;
+
+    // Derived from the dense arrays whenever objects were created or destroyed.
+    std::vector<uint32_t> m_parentIndices;      // Dense index of the parent, EndOfList for roots.
+    std::vector<uint32_t> m_levelStarts;        // First dense index of each level, then the object count.
+    bool m_structureChanged;
+    bool m_orderBroken;                         // Some object precedes one at a lower level.
+};
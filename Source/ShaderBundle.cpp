@@ -0,0 +1,110 @@
+#include "stdafx.h"
+#include "ShaderBundle.h"
+#include "ShaderSource.h"
+
+ShaderBundle::ShaderBundle() :
+	m_file(INVALID_HANDLE_VALUE),
+	m_mapping(nullptr),
+	m_pView(nullptr),
+	m_pIndex(nullptr),
+	m_shaderCount(0)
+{
+}
+
+ShaderBundle::~ShaderBundle()
+{
+	Close();
+}
+
+bool ShaderBundle::Open(const std::wstring& path)
+{
+	Close();
+
+	m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(m_file, &fileSize) || static_cast<UINT64>(fileSize.QuadPart) < sizeof(Header))
+	{
+		Close();
+		return false;
+	}
+
+	m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	m_pView = m_mapping ? static_cast<const UINT8*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+	if (m_pView == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	// Validate everything up front so lookups can trust the index.
+	const UINT64 size = static_cast<UINT64>(fileSize.QuadPart);
+	const Header* pHeader = reinterpret_cast<const Header*>(m_pView);
+	bool valid = pHeader->magic == BundleMagic && pHeader->version == BundleVersion &&
+		sizeof(Header) + static_cast<UINT64>(pHeader->shaderCount) * sizeof(IndexEntry) <= size;
+
+	const IndexEntry* pIndex = reinterpret_cast<const IndexEntry*>(m_pView + sizeof(Header));
+	for (UINT i = 0; valid && i < pHeader->shaderCount; i++)
+	{
+		valid = pIndex[i].offset <= size && pIndex[i].size <= size - pIndex[i].offset && (i == 0 || pIndex[i - 1].key < pIndex[i].key);
+	}
+
+	if (!valid)
+	{
+		Close();
+		return false;
+	}
+
+	m_pIndex = pIndex;
+	m_shaderCount = pHeader->shaderCount;
+	return true;
+}
+
+void ShaderBundle::Close()
+{
+	if (m_pView)
+	{
+		UnmapViewOfFile(m_pView);
+		m_pView = nullptr;
+	}
+	if (m_mapping)
+	{
+		CloseHandle(m_mapping);
+		m_mapping = nullptr;
+	}
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+	}
+	m_pIndex = nullptr;
+	m_shaderCount = 0;
+}
+
+bool ShaderBundle::Find(UINT64 key, D3D12_SHADER_BYTECODE* pBytecode) const
+{
+	const IndexEntry* pEnd = m_pIndex + m_shaderCount;
+	const IndexEntry* pEntry = std::lower_bound(m_pIndex, pEnd, key, [](const IndexEntry& entry, UINT64 value) { return entry.key < value; });
+	if (pEntry == pEnd || pEntry->key != key)
+	{
+		return false;
+	}
+
+	pBytecode->pShaderBytecode = m_pView + pEntry->offset;
+	pBytecode->BytecodeLength = static_cast<SIZE_T>(pEntry->size);
+	return true;
+}
+
+UINT64 ShaderBundle::ComputeKey(const std::wstring& sourcePath, const D3D_SHADER_MACRO* pDefines, const char* entryPoint, const char* target)
+{
+	std::vector<ShaderDefine> defines;
+	for (const D3D_SHADER_MACRO* pDefine = pDefines; pDefine && pDefine->Name; pDefine++)
+	{
+		defines.push_back({ pDefine->Name, pDefine->Definition });
+	}
+	return ComputeShaderKey(sourcePath, defines.data(), defines.size(), entryPoint, target);
+}
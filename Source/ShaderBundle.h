@@ -0,0 +1,49 @@
+#pragma once
+
+// Read-only view of the bytecode bundle written by Tools/build_shader_bundle.py.
+// The file is memory-mapped and lookups return pointers into the mapping, so
+// bytecode is never copied; it stays valid until the bundle is closed.
+class ShaderBundle
+{
+public:
+    ShaderBundle();
+    ~ShaderBundle();
+
+    ShaderBundle(const ShaderBundle&) = delete;
+    ShaderBundle& operator=(const ShaderBundle&) = delete;
+
+    // Returns false if the file is missing or malformed; every lookup then misses.
+    bool Open(const std::wstring& path);
+    void Close();
+
+    bool Find(UINT64 key, D3D12_SHADER_BYTECODE* pBytecode) const;
+    UINT GetShaderCount() const { return m_shaderCount; }
+
+    // Key of one permutation, see ComputeShaderKey.
+    static UINT64 ComputeKey(const std::wstring& sourcePath, const D3D_SHADER_MACRO* pDefines, const char* entryPoint, const char* target);
+
+private:
+    static const UINT32 BundleMagic = 0x4E424853;  // "SHBN"
+    static const UINT32 BundleVersion = 1;
+
+    struct Header
+    {
+        UINT32 magic;
+        UINT32 version;
+        UINT32 shaderCount;
+        UINT32 reserved;
+    };
+
+    struct IndexEntry
+    {
+        UINT64 key;
+        UINT64 offset;
+        UINT64 size;
+    };
+
+    HANDLE m_file;
+    HANDLE m_mapping;
+    const UINT8* m_pView;
+    const IndexEntry* m_pIndex;
+    UINT m_shaderCount;
+};
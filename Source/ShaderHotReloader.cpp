@@ -0,0 +1,251 @@
+#include "stdafx.h"
+#include "ShaderHotReloader.h"
+#include "ShaderSource.h"
+
+#include <chrono>
+
+namespace
+{
+	// Editors often save in several steps (truncate, write, rename); let them finish.
+	const DWORD SettleMilliseconds = 50;
+
+	// Also poll, for files on volumes without change notifications.
+	const DWORD PollMilliseconds = 1000;
+
+	std::wstring GetDirectory(const std::wstring& path)
+	{
+		const size_t slash = path.find_last_of(L"\\/");
+		return slash == std::wstring::npos ? std::wstring(L".") : path.substr(0, slash);
+	}
+}
+
+ShaderHotReloader::ShaderHotReloader() :
+	m_stopEvent(CreateEvent(nullptr, TRUE, FALSE, nullptr))
+{
+	m_thread = std::thread(&ShaderHotReloader::WatcherMain, this);
+}
+
+ShaderHotReloader::~ShaderHotReloader()
+{
+	SetEvent(m_stopEvent);
+	m_thread.join();
+
+	for (HANDLE notification : m_changeNotifications)
+	{
+		FindCloseChangeNotification(notification);
+	}
+	CloseHandle(m_stopEvent);
+}
+
+UINT ShaderHotReloader::AddShader(const std::wstring& sourcePath, const D3D_SHADER_MACRO* pDefines, const char* entryPoint, const char* target)
+{
+	Shader shader;
+	shader.sourcePath = sourcePath;
+	for (const D3D_SHADER_MACRO* pDefine = pDefines; pDefine && pDefine->Name; pDefine++)
+	{
+		shader.defines.emplace_back(pDefine->Name, pDefine->Definition ? pDefine->Definition : "1");
+	}
+	shader.entryPoint = entryPoint;
+	shader.target = target;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	UpdateWatchedFiles(shader);
+	m_shaders.push_back(shader);
+	return static_cast<UINT>(m_shaders.size() - 1);
+}
+
+bool ShaderHotReloader::TakeResults(std::vector<Result>& results)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_results.empty())
+	{
+		return false;
+	}
+
+	results.insert(results.end(), m_results.begin(), m_results.end());
+	m_results.clear();
+	return true;
+}
+
+ULONGLONG ShaderHotReloader::GetCurrentFileTime()
+{
+	FILETIME now;
+	GetSystemTimeAsFileTime(&now);
+	return (static_cast<ULONGLONG>(now.dwHighDateTime) << 32) | now.dwLowDateTime;
+}
+
+void ShaderHotReloader::WatcherMain()
+{
+	for (;;)
+	{
+		std::vector<HANDLE> handles(1, m_stopEvent);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			handles.insert(handles.end(), m_changeNotifications.begin(), m_changeNotifications.end());
+		}
+
+		const DWORD wait = WaitForMultipleObjects(static_cast<DWORD>(handles.size()), handles.data(), FALSE, PollMilliseconds);
+		if (wait == WAIT_OBJECT_0)
+		{
+			return;
+		}
+		if (wait > WAIT_OBJECT_0 && wait < WAIT_OBJECT_0 + handles.size())
+		{
+			FindNextChangeNotification(handles[wait - WAIT_OBJECT_0]);
+			Sleep(SettleMilliseconds);
+		}
+
+		// Which watched files changed, and when were they saved?
+		std::vector<std::wstring> changedFiles;
+		ULONGLONG saveTime = 0;
+		std::vector<Shader> shaders;
+		std::vector<UINT> shaderIds;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (WatchedFile& file : m_watchedFiles)
+			{
+				const ULONGLONG lastWriteTime = GetLastWriteTime(file.path);
+				if (lastWriteTime != 0 && lastWriteTime != file.lastWriteTime)
+				{
+					file.lastWriteTime = lastWriteTime;
+					changedFiles.push_back(file.path);
+					saveTime = std::max(saveTime, lastWriteTime);
+				}
+			}
+
+			// Only the entry points that depend on a changed file are recompiled,
+			// along with those of an earlier save that did not compile.
+			if (changedFiles.empty())
+			{
+				continue;
+			}
+			for (UINT id = 0; id < m_shaders.size(); id++)
+			{
+				bool changed = std::find(m_failedShaderIds.begin(), m_failedShaderIds.end(), id) != m_failedShaderIds.end();
+				for (size_t f = 0; !changed && f < m_shaders[id].files.size(); f++)
+				{
+					changed = std::find(changedFiles.begin(), changedFiles.end(), m_shaders[id].files[f]) != changedFiles.end();
+				}
+				if (changed)
+				{
+					shaders.push_back(m_shaders[id]);
+					shaderIds.push_back(id);
+				}
+			}
+		}
+
+		// Compile without holding the lock so the render thread never waits on the compiler.
+		std::vector<Result> results;
+		for (size_t i = 0; i < shaders.size(); i++)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			ComPtr<ID3DBlob> bytecode = Compile(shaders[i]);
+			const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			if (bytecode)
+			{
+				results.push_back({ shaderIds[i], bytecode, saveTime, milliseconds });
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		// The edit may have added or removed includes.
+		for (UINT id : shaderIds)
+		{
+			UpdateWatchedFiles(m_shaders[id]);
+		}
+
+		// The entry points of one save are published together, or not at all, so
+		// that stages sharing an interface are never paired across versions.
+		if (results.size() == shaders.size())
+		{
+			m_results.insert(m_results.end(), results.begin(), results.end());
+			m_failedShaderIds.clear();
+		}
+		else
+		{
+			m_failedShaderIds = shaderIds;
+		}
+	}
+}
+
+// Refresh the include graph of a shader and start watching any file new to it.
+void ShaderHotReloader::UpdateWatchedFiles(Shader& shader)
+{
+	std::vector<ShaderSourceFile> sources;
+	ReadShaderSources(shader.sourcePath, sources);
+
+	shader.files.clear();
+	for (const ShaderSourceFile& source : sources)
+	{
+		shader.files.push_back(source.path);
+
+		const bool watched = std::any_of(m_watchedFiles.begin(), m_watchedFiles.end(), [&](const WatchedFile& file) { return file.path == source.path; });
+		if (!watched)
+		{
+			m_watchedFiles.push_back({ source.path, GetLastWriteTime(source.path) });
+			WatchDirectory(GetDirectory(source.path));
+		}
+	}
+}
+
+void ShaderHotReloader::WatchDirectory(const std::wstring& directory)
+{
+	// WaitForMultipleObjects takes at most MAXIMUM_WAIT_OBJECTS, one of which is the stop event.
+	if (std::find(m_watchedDirectories.begin(), m_watchedDirectories.end(), directory) != m_watchedDirectories.end() ||
+		m_changeNotifications.size() + 1 >= MAXIMUM_WAIT_OBJECTS)
+	{
+		return;
+	}
+
+	HANDLE notification = FindFirstChangeNotificationW(directory.c_str(), FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+	if (notification != INVALID_HANDLE_VALUE)
+	{
+		m_watchedDirectories.push_back(directory);
+		m_changeNotifications.push_back(notification);
+	}
+}
+
+ComPtr<ID3DBlob> ShaderHotReloader::Compile(const Shader& shader)
+{
+	UINT compileFlags = 0;
+#if defined(_DEBUG) || defined(DBG)
+	compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#endif
+
+	std::vector<D3D_SHADER_MACRO> defines;
+	for (const auto& define : shader.defines)
+	{
+		defines.push_back({ define.first.c_str(), define.second.c_str() });
+	}
+	defines.push_back({ nullptr, nullptr });
+
+	ComPtr<ID3DBlob> bytecode;
+	ComPtr<ID3DBlob> errors;
+	const HRESULT hr = D3DCompileFromFile(shader.sourcePath.c_str(), defines.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE,
+		shader.entryPoint.c_str(), shader.target.c_str(), compileFlags, 0, &bytecode, &errors);
+
+	if (errors)
+	{
+		OutputDebugStringA(static_cast<const char*>(errors->GetBufferPointer()));
+	}
+	if (FAILED(hr))
+	{
+		char message[256];
+		sprintf_s(message, "ShaderHotReloader: %s (%s) failed to compile, keeping the previous version\n", shader.entryPoint.c_str(), shader.target.c_str());
+		OutputDebugStringA(message);
+		return nullptr;
+	}
+
+	return bytecode;
+}
+
+ULONGLONG ShaderHotReloader::GetLastWriteTime(const std::wstring& path)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &attributes))
+	{
+		return 0;
+	}
+	return (static_cast<ULONGLONG>(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+}
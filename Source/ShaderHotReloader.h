@@ -0,0 +1,74 @@
+#pragma once
+
+#include <mutex>
+#include <thread>
+
+using Microsoft::WRL::ComPtr;
+
+// Watches the sources of registered shader entry points, including everything
+// they #include, and recompiles only the entry points whose files changed. The
+// watcher sleeps on directory change notifications and compiles on its own
+// thread; the results are picked up by the render thread at a frame boundary.
+// Compile errors are reported through OutputDebugString and leave the previous
+// bytecode of every entry point the save affected in place. Compiles with FXC,
+// so the bytecode it replaces must be DXBC too.
+class ShaderHotReloader
+{
+public:
+    struct Result
+    {
+        UINT shaderId;
+        ComPtr<ID3DBlob> bytecode;
+        ULONGLONG saveTime;             // Last write of the changed file, as a FILETIME.
+        double compileMilliseconds;
+    };
+
+    ShaderHotReloader();
+    ~ShaderHotReloader();
+
+    ShaderHotReloader(const ShaderHotReloader&) = delete;
+    ShaderHotReloader& operator=(const ShaderHotReloader&) = delete;
+
+    // Returns the id reported in results. Defines are copied.
+    UINT AddShader(const std::wstring& sourcePath, const D3D_SHADER_MACRO* pDefines, const char* entryPoint, const char* target);
+
+    // Move finished recompilations into results, whole saves at a time. Returns
+    // false if there were none.
+    bool TakeResults(std::vector<Result>& results);
+
+    static ULONGLONG GetCurrentFileTime();
+
+private:
+    struct Shader
+    {
+        std::wstring sourcePath;
+        std::vector<std::pair<std::string, std::string>> defines;
+        std::string entryPoint;
+        std::string target;
+        std::vector<std::wstring> files;    // Source and includes, from the last compile.
+    };
+
+    struct WatchedFile
+    {
+        std::wstring path;
+        ULONGLONG lastWriteTime;
+    };
+
+    void WatcherMain();
+    void UpdateWatchedFiles(Shader& shader);
+    void WatchDirectory(const std::wstring& directory);
+    ComPtr<ID3DBlob> Compile(const Shader& shader);
+    static ULONGLONG GetLastWriteTime(const std::wstring& path);
+
+    std::vector<Shader> m_shaders;
+    std::vector<UINT> m_failedShaderIds;    // Of the last save, retried with the next.
+    std::vector<WatchedFile> m_watchedFiles;
+    std::vector<std::wstring> m_watchedDirectories;
+    std::vector<HANDLE> m_changeNotifications;
+    std::mutex m_mutex;                 // Guards everything above and m_results.
+
+    std::vector<Result> m_results;
+
+    HANDLE m_stopEvent;
+    std::thread m_thread;
+};
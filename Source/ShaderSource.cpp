@@ -0,0 +1,114 @@
+#include "ShaderSource.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cwctype>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+	const uint64_t FnvOffsetBasis = 14695981039346656037ull;
+	const uint64_t FnvPrime = 1099511628211ull;
+
+	// Hashes size bytes and a zero terminator.
+	void HashTerminated(uint64_t& hash, const char* pData, size_t size)
+	{
+		for (size_t i = 0; i <= size; i++)
+		{
+			hash ^= i < size ? static_cast<uint8_t>(pData[i]) : 0;
+			hash *= FnvPrime;
+		}
+	}
+
+	std::wstring NormalizePath(const std::wstring& path)
+	{
+		std::wstring normalized = path;
+		for (wchar_t& c : normalized)
+		{
+			c = (c == L'/') ? L'\\' : static_cast<wchar_t>(std::towlower(c));
+		}
+		return normalized;
+	}
+
+	void ReadShaderSource(const std::wstring& path, std::vector<ShaderSourceFile>& files, std::vector<std::wstring>& visited)
+	{
+		const std::wstring normalized = NormalizePath(path);
+		if (std::find(visited.begin(), visited.end(), normalized) != visited.end())
+		{
+			return;
+		}
+		visited.push_back(normalized);
+
+#if defined(_WIN32)
+		std::ifstream file(path, std::ios::binary);
+#else
+		// Only the Windows library opens wide paths; elsewhere they are expected to be ASCII.
+		std::ifstream file(std::string(path.begin(), path.end()), std::ios::binary);
+#endif
+		std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		content.erase(std::remove(content.begin(), content.end(), '\r'), content.end());
+
+		files.push_back({ path, content });
+
+		const size_t slash = path.find_last_of(L"\\/");
+		const std::wstring directory = slash == std::wstring::npos ? std::wstring() : path.substr(0, slash + 1);
+
+		// Lines of the form: #include "file"
+		size_t lineStart = 0;
+		while (lineStart < content.size())
+		{
+			size_t i = content.find_first_not_of(" \t", lineStart);
+			if (i != std::string::npos && content[i] == '#')
+			{
+				i = content.find_first_not_of(" \t", i + 1);
+				if (i != std::string::npos && content.compare(i, 7, "include") == 0)
+				{
+					i = content.find_first_not_of(" \t", i + 7);
+					if (i != std::string::npos && content[i] == '"')
+					{
+						const size_t end = content.find('"', i + 1);
+						if (end != std::string::npos && end > i + 1)
+						{
+							const std::string include = content.substr(i + 1, end - i - 1);
+							ReadShaderSource(directory + std::wstring(include.begin(), include.end()), files, visited);
+						}
+					}
+				}
+			}
+
+			const size_t lineEnd = content.find('\n', lineStart);
+			lineStart = lineEnd == std::string::npos ? content.size() : lineEnd + 1;
+		}
+	}
+}
+
+void ReadShaderSources(const std::wstring& path, std::vector<ShaderSourceFile>& files)
+{
+	files.clear();
+
+	std::vector<std::wstring> visited;
+	ReadShaderSource(path, files, visited);
+}
+
+uint64_t ComputeShaderKey(const std::wstring& sourcePath, const ShaderDefine* pDefines, size_t defineCount, const char* entryPoint, const char* target)
+{
+	uint64_t hash = FnvOffsetBasis;
+	HashTerminated(hash, entryPoint, strlen(entryPoint));
+	HashTerminated(hash, target, strlen(target));
+
+	for (size_t i = 0; i < defineCount; i++)
+	{
+		const std::string define = std::string(pDefines[i].name) + "=" + (pDefines[i].value ? pDefines[i].value : "1");
+		HashTerminated(hash, define.data(), define.size());
+	}
+	HashTerminated(hash, nullptr, 0);
+
+	std::vector<ShaderSourceFile> sources;
+	ReadShaderSources(sourcePath, sources);
+	for (const ShaderSourceFile& source : sources)
+	{
+		HashTerminated(hash, source.content.data(), source.content.size());
+	}
+	return hash;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct ShaderSourceFile
+{
+    std::wstring path;
+    std::string content;    // Carriage returns stripped, so checkouts with either line ending agree.
+};
+
+// Read a shader source and every file it pulls in through #include "file",
+// depth first, each file once. Includes are resolved relative to the including
+// file. Missing files are returned with empty content.
+void ReadShaderSources(const std::wstring& path, std::vector<ShaderSourceFile>& files);
+
+struct ShaderDefine
+{
+    const char* name;
+    const char* value;      // nullptr stands for "1".
+};
+
+// Key of one permutation in the shader bundle: FNV-1a over the entry point, the
+// target, "NAME=VALUE" per define and the sources from ReadShaderSources, each
+// followed by a zero byte, with one more after the defines. Must match
+// shader_key in Tools/build_shader_bundle.py.
+uint64_t ComputeShaderKey(const std::wstring& sourcePath, const ShaderDefine* pDefines, size_t defineCount, const char* entryPoint, const char* target);
@@ -0,0 +1,115 @@
+#include "TransientResourcePlanner.h"
+
+#include <algorithm>
+
+namespace
+{
+	inline uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	inline bool LifetimesOverlap(const TransientResourcePlanner::Request& a, const TransientResourcePlanner::Request& b)
+	{
+		return a.firstPass <= b.lastPass && b.firstPass <= a.lastPass;
+	}
+}
+
+uint64_t TransientResourcePlanner::Plan(const std::vector<Request>& requests, std::vector<Placement>& placements)
+{
+	placements.assign(requests.size(), Placement{ 0, 0, false });
+	m_heapSizes.clear();
+	m_plannedSize = 0;
+	m_naiveSize = 0;
+
+	// Greedy first fit, largest resources first: big allocations are the hardest
+	// to fit later and small ones fill the gaps between them.
+	m_order.resize(requests.size());
+	for (uint32_t i = 0; i < m_order.size(); i++)
+	{
+		m_order[i] = i;
+	}
+	std::sort(m_order.begin(), m_order.end(), [&requests](uint32_t a, uint32_t b)
+	{
+		if (requests[a].heapGroup != requests[b].heapGroup)
+			return requests[a].heapGroup < requests[b].heapGroup;
+		if (requests[a].size != requests[b].size)
+			return requests[a].size > requests[b].size;
+		return requests[a].firstPass < requests[b].firstPass;
+	});
+
+	m_placed.clear();
+	for (uint32_t index : m_order)
+	{
+		const Request& request = requests[index];
+		m_naiveSize += AlignUp(request.size, request.alignment);
+
+		// Memory ranges of already placed resources that are alive at the same time,
+		// sorted by offset, are the obstacles; take the first gap that fits.
+		struct Range
+		{
+			uint64_t begin;
+			uint64_t end;
+		};
+		std::vector<Range> obstacles;
+		for (uint32_t other : m_placed)
+		{
+			if (requests[other].heapGroup == request.heapGroup && LifetimesOverlap(request, requests[other]))
+			{
+				obstacles.push_back({ placements[other].offset, placements[other].offset + requests[other].size });
+			}
+		}
+		std::sort(obstacles.begin(), obstacles.end(), [](const Range& a, const Range& b) { return a.begin < b.begin; });
+
+		uint64_t offset = 0;
+		for (const Range& obstacle : obstacles)
+		{
+			if (AlignUp(offset, request.alignment) + request.size <= obstacle.begin)
+			{
+				break;
+			}
+			offset = std::max(offset, obstacle.end);
+		}
+		offset = AlignUp(offset, request.alignment);
+
+		Placement& placement = placements[index];
+		placement.heapGroup = request.heapGroup;
+		placement.offset = offset;
+
+		if (request.heapGroup >= m_heapSizes.size())
+		{
+			m_heapSizes.resize(request.heapGroup + 1, 0);
+		}
+		m_heapSizes[request.heapGroup] = std::max(m_heapSizes[request.heapGroup], offset + request.size);
+
+		m_placed.push_back(index);
+	}
+
+	// Both resources of every pair that shares some memory are aliased.
+	for (uint32_t i = 0; i < requests.size(); i++)
+	{
+		for (uint32_t j = i + 1; j < requests.size(); j++)
+		{
+			if (requests[i].heapGroup != requests[j].heapGroup)
+			{
+				continue;
+			}
+
+			const uint64_t beginI = placements[i].offset;
+			const uint64_t endI = beginI + requests[i].size;
+			const uint64_t beginJ = placements[j].offset;
+			const uint64_t endJ = beginJ + requests[j].size;
+			if (beginI < endJ && beginJ < endI)
+			{
+				placements[i].aliased = true;
+				placements[j].aliased = true;
+			}
+		}
+	}
+
+	for (uint64_t heapSize : m_heapSizes)
+	{
+		m_plannedSize += heapSize;
+	}
+	return m_plannedSize;
+}
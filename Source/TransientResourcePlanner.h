@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Packs transient resources into shared heaps so that resources whose lifetimes
+// do not overlap can share memory. Lifetimes are inclusive ranges of pass
+// indices within one frame. Resources only share memory with resources of the
+// same heap group (e.g. buffers and render targets on resource heap tier 1).
+class TransientResourcePlanner
+{
+public:
+    static const uint32_t NoAlias = UINT32_MAX;
+
+    struct Request
+    {
+        uint64_t size;
+        uint64_t alignment;
+        uint32_t firstPass;
+        uint32_t lastPass;
+        uint32_t heapGroup;
+    };
+
+    struct Placement
+    {
+        uint32_t heapGroup;
+        uint64_t offset;
+        // True if the resource shares memory with any other resource of its
+        // heap group. Placed resources are kept across frames, so the one that
+        // used the memory last, earlier this frame or later in the previous
+        // one, may still be active: it needs an aliasing barrier before its
+        // first use every frame.
+        bool aliased;
+    };
+
+    // Fills placements (one per request) and returns the peak memory over all heap groups.
+    uint64_t Plan(const std::vector<Request>& requests, std::vector<Placement>& placements);
+
+    uint32_t GetHeapGroupCount() const { return static_cast<uint32_t>(m_heapSizes.size()); }
+    uint64_t GetHeapSize(uint32_t heapGroup) const { return m_heapSizes[heapGroup]; }
+
+    // Total size with aliasing versus one dedicated allocation per resource.
+    uint64_t GetPlannedSize() const { return m_plannedSize; }
+    uint64_t GetNaiveSize() const { return m_naiveSize; }
+
+private:
+    std::vector<uint32_t> m_order;
+    std::vector<uint32_t> m_placed;
+    std::vector<uint64_t> m_heapSizes;
+    uint64_t m_plannedSize = 0;
+    uint64_t m_naiveSize = 0;
+};
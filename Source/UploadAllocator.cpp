@@ -0,0 +1,80 @@
+#include "stdafx.h"
+#include "UploadAllocator.h"
+#include "DXHelper.h"
+
+UploadAllocator::UploadAllocator(ID3D12Device* pDevice, UINT64 pageSize) :
+	m_device(pDevice),
+	m_pageAllocator(pageSize)
+{
+}
+
+UploadAllocator::~UploadAllocator()
+{
+	for (auto& page : m_pages)
+	{
+		if (page)
+		{
+			page->resource->Unmap(0, nullptr);
+		}
+	}
+}
+
+UploadAllocator::Allocation UploadAllocator::Allocate(UINT64 size, UINT64 alignment)
+{
+	// Alignment must be a power of two.
+	bool createPage;
+	const UploadPageAllocator::Allocation placement = m_pageAllocator.Allocate(size, alignment, createPage);
+	if (createPage)
+	{
+		CreatePage(placement.page);
+	}
+
+	const Page& page = *m_pages[placement.page];
+	Allocation allocation;
+	allocation.pCpuAddress = page.pCpuAddress + placement.offset;
+	allocation.gpuAddress = page.gpuAddress + placement.offset;
+	allocation.pResource = page.resource.Get();
+	allocation.offset = placement.offset;
+	return allocation;
+}
+
+void UploadAllocator::FinishFrame(UINT64 fenceValue)
+{
+	m_pageAllocator.FinishFrame(fenceValue);
+}
+
+void UploadAllocator::RetirePages(UINT64 completedFenceValue)
+{
+	m_freedPages.clear();
+	m_pageAllocator.RetirePages(completedFenceValue, m_freedPages);
+	for (UINT32 pageIndex : m_freedPages)
+	{
+		m_pages[pageIndex]->resource->Unmap(0, nullptr);
+		m_pages[pageIndex].reset();
+	}
+}
+
+void UploadAllocator::CreatePage(UINT32 pageIndex)
+{
+	std::unique_ptr<Page> page(new Page());
+	const UINT64 size = m_pageAllocator.GetPageSize(pageIndex);
+
+	ThrowIfFailed(m_device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(size),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&page->resource)));
+
+	// Pages stay mapped for their whole lifetime.
+	CD3DX12_RANGE readRange(0, 0);
+	ThrowIfFailed(page->resource->Map(0, &readRange, reinterpret_cast<void**>(&page->pCpuAddress)));
+	page->gpuAddress = page->resource->GetGPUVirtualAddress();
+
+	if (pageIndex >= m_pages.size())
+	{
+		m_pages.resize(pageIndex + 1);
+	}
+	m_pages[pageIndex] = std::move(page);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "UploadPageAllocator.h"
+
+using Microsoft::WRL::ComPtr;
+
+// Linear sub-allocator over persistently mapped pages of upload heap memory.
+// Pages are filled front to back and handed back to the pool only once the
+// fence value of the frame that last wrote them has been reached, so the CPU
+// never overwrites data the GPU may still be reading. UploadPageAllocator
+// decides where allocations go; this class backs its pages with committed
+// resources. Not thread-safe.
+class UploadAllocator
+{
+public:
+    static const UINT64 DefaultPageSize = 1024 * 1024;
+
+    struct Allocation
+    {
+        void* pCpuAddress;
+        D3D12_GPU_VIRTUAL_ADDRESS gpuAddress;
+        ID3D12Resource* pResource;
+        UINT64 offset;
+    };
+
+    UploadAllocator(ID3D12Device* pDevice, UINT64 pageSize = DefaultPageSize);
+    ~UploadAllocator();
+
+    Allocation Allocate(UINT64 size, UINT64 alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+
+    template<typename T>
+    D3D12_GPU_VIRTUAL_ADDRESS AllocateConstants(const T& data)
+    {
+        Allocation allocation = Allocate(sizeof(T));
+        memcpy(allocation.pCpuAddress, &data, sizeof(T));
+        return allocation.gpuAddress;
+    }
+
+    // Everything allocated since the previous call is owned by the GPU until fenceValue completes.
+    void FinishFrame(UINT64 fenceValue);
+
+    // Return pages whose fence has completed to the pool.
+    void RetirePages(UINT64 completedFenceValue);
+
+    UINT64 GetPageCount() const { return m_pageAllocator.GetPageCount(); }
+    UINT64 GetBytesAllocated() const { return m_pageAllocator.GetBytesAllocated(); }
+
+private:
+    struct Page
+    {
+        ComPtr<ID3D12Resource> resource;
+        UINT8* pCpuAddress;
+        D3D12_GPU_VIRTUAL_ADDRESS gpuAddress;
+    };
+
+    void CreatePage(UINT32 pageIndex);
+
+    ComPtr<ID3D12Device> m_device;
+    UploadPageAllocator m_pageAllocator;
+    std::vector<std::unique_ptr<Page>> m_pages;     // By page index, null once freed.
+    std::vector<UINT32> m_freedPages;               // RetirePages scratch.
+};
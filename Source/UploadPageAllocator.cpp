@@ -0,0 +1,96 @@
+#include "UploadPageAllocator.h"
+
+#include <algorithm>
+
+UploadPageAllocator::UploadPageAllocator(uint64_t pageSize) :
+	m_pageSize(pageSize),
+	m_currentPage(NoPage),
+	m_currentOffset(0),
+	m_bytesAllocated(0),
+	m_pageCount(0)
+{
+}
+
+UploadPageAllocator::Allocation UploadPageAllocator::Allocate(uint64_t size, uint64_t alignment, bool& createPage)
+{
+	const uint64_t alignedOffset = (m_currentOffset + alignment - 1) & ~(alignment - 1);
+
+	createPage = false;
+	if (m_currentPage == NoPage || alignedOffset + size > m_pageSizes[m_currentPage])
+	{
+		m_currentPage = AcquirePage(size, createPage);
+		m_usedPages.push_back(m_currentPage);
+		m_currentOffset = 0;
+	}
+	else
+	{
+		m_currentOffset = alignedOffset;
+	}
+
+	const Allocation allocation = { m_currentPage, m_currentOffset };
+	m_currentOffset += size;
+	m_bytesAllocated += size;
+	return allocation;
+}
+
+void UploadPageAllocator::FinishFrame(uint64_t fenceValue)
+{
+	for (uint32_t page : m_usedPages)
+	{
+		m_retiredPages.push_back({ fenceValue, page });
+	}
+	m_usedPages.clear();
+
+	// The next allocation starts on a fresh page; the partially filled one belongs to this frame.
+	m_currentPage = NoPage;
+	m_currentOffset = 0;
+}
+
+void UploadPageAllocator::RetirePages(uint64_t completedFenceValue, std::vector<uint32_t>& freedPages)
+{
+	// Pages are retired in submission order, so stop at the first one still in flight.
+	while (!m_retiredPages.empty() && m_retiredPages.front().fenceValue <= completedFenceValue)
+	{
+		const uint32_t page = m_retiredPages.front().page;
+		m_retiredPages.pop_front();
+
+		if (m_pageSizes[page] > m_pageSize)
+		{
+			m_pageSizes[page] = 0;
+			m_freeIndices.push_back(page);
+			m_pageCount--;
+			freedPages.push_back(page);
+		}
+		else
+		{
+			m_availablePages.push_back(page);
+		}
+	}
+}
+
+uint32_t UploadPageAllocator::AcquirePage(uint64_t minSize, bool& created)
+{
+	if (minSize <= m_pageSize && !m_availablePages.empty())
+	{
+		const uint32_t page = m_availablePages.back();
+		m_availablePages.pop_back();
+		return page;
+	}
+
+	// Requests larger than a page get a dedicated page that is freed rather than pooled.
+	uint32_t page;
+	if (!m_freeIndices.empty())
+	{
+		page = m_freeIndices.back();
+		m_freeIndices.pop_back();
+	}
+	else
+	{
+		page = static_cast<uint32_t>(m_pageSizes.size());
+		m_pageSizes.push_back(0);
+	}
+	m_pageSizes[page] = std::max(minSize, m_pageSize);
+	m_pageCount++;
+	created = true;
+	return page;
+}
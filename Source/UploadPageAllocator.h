@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// The bookkeeping of UploadAllocator, apart from the device: which page each
+// allocation lands in and at what offset, and when a page may be filled again.
+// Pages are identified by index; the caller backs each new page with memory and
+// releases the memory of the pages RetirePages hands back.
+class UploadPageAllocator
+{
+public:
+    static const uint32_t NoPage = UINT32_MAX;
+
+    struct Allocation
+    {
+        uint32_t page;
+        uint64_t offset;
+    };
+
+    explicit UploadPageAllocator(uint64_t pageSize);
+
+    // alignment must be a power of two. createPage is set when the allocation
+    // opens a page index that has no memory yet; it needs GetPageSize(page) bytes.
+    Allocation Allocate(uint64_t size, uint64_t alignment, bool& createPage);
+
+    // Everything allocated since the previous call is owned by the GPU until fenceValue completes.
+    void FinishFrame(uint64_t fenceValue);
+
+    // Return pages whose fence has completed to the pool. Pages made for
+    // allocations larger than a page are not pooled: their indices are appended
+    // to freedPages for the caller to release, and may be handed out again.
+    void RetirePages(uint64_t completedFenceValue, std::vector<uint32_t>& freedPages);
+
+    uint64_t GetPageSize(uint32_t page) const { return m_pageSizes[page]; }
+    uint32_t GetPageCount() const { return m_pageCount; }
+    uint64_t GetBytesAllocated() const { return m_bytesAllocated; }
+
+private:
+    struct RetiredPage
+    {
+        uint64_t fenceValue;
+        uint32_t page;
+    };
+
+    uint32_t AcquirePage(uint64_t minSize, bool& created);
+
+    uint64_t m_pageSize;
+    std::vector<uint64_t> m_pageSizes;      // Per index, 0 once freed.
+    std::vector<uint32_t> m_freeIndices;
+    std::vector<uint32_t> m_availablePages;
+    std::vector<uint32_t> m_usedPages;
+    std::deque<RetiredPage> m_retiredPages;
+
+    uint32_t m_currentPage;
+    uint64_t m_currentOffset;
+    uint64_t m_bytesAllocated;
+    uint32_t m_pageCount;
+};
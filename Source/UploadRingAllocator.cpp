@@ -0,0 +1,41 @@
+#include "UploadRingAllocator.h"
+
+UploadRingAllocator::UploadRingAllocator(uint64_t ringSize) :
+	m_ringSize(ringSize),
+	m_head(0),
+	m_tail(0)
+{
+}
+
+uint64_t UploadRingAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+	uint64_t head = (m_head + alignment - 1) & ~(alignment - 1);
+
+	const uint64_t physicalHead = head % m_ringSize;
+	if (physicalHead + size > m_ringSize)
+	{
+		head += m_ringSize - physicalHead;
+	}
+
+	if (head + size - m_tail > m_ringSize)
+	{
+		return NoSpace;
+	}
+
+	m_head = head + size;
+	return head % m_ringSize;
+}
+
+void UploadRingAllocator::Submit(uint64_t fenceValue)
+{
+	m_submissions.push_back({ fenceValue, m_head });
+}
+
+void UploadRingAllocator::RetireSubmissions(uint64_t completedFenceValue)
+{
+	while (!m_submissions.empty() && m_submissions.front().fenceValue <= completedFenceValue)
+	{
+		m_tail = m_submissions.front().ringEnd;
+		m_submissions.pop_front();
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+// The bookkeeping of CopyUploader's staging ring, apart from the device: where
+// each allocation lands in the ring, and when its space may be filled again.
+// Offsets grow monotonically and map to the ring modulo its size; allocations
+// never wrap, the remainder of the ring is skipped instead.
+class UploadRingAllocator
+{
+public:
+    static const uint64_t NoSpace = UINT64_MAX;
+
+    explicit UploadRingAllocator(uint64_t ringSize);
+
+    // Returns the physical offset of size contiguous bytes, or NoSpace until
+    // enough submissions retire. alignment must be a power of two, and size at
+    // most GetMaxAllocationSize(), which always fits once the ring is empty.
+    uint64_t Allocate(uint64_t size, uint64_t alignment);
+
+    // Everything allocated since the previous call is owned by the GPU until fenceValue completes.
+    void Submit(uint64_t fenceValue);
+
+    // Free the space of the submissions whose fence has completed.
+    void RetireSubmissions(uint64_t completedFenceValue);
+
+    // The fence value to wait for before space is freed, or 0 if nothing is in
+    // flight: then only submitting what was allocated can free any.
+    uint64_t GetOldestFenceValue() const { return m_submissions.empty() ? 0 : m_submissions.front().fenceValue; }
+
+    uint64_t GetRingSize() const { return m_ringSize; }
+    uint64_t GetMaxAllocationSize() const { return m_ringSize / 2; }
+    uint64_t GetUsedSize() const { return m_head - m_tail; }
+
+private:
+    struct Submission
+    {
+        uint64_t fenceValue;
+        uint64_t ringEnd;       // Ring head after this submission's data; freed up to here on completion.
+    };
+
+    uint64_t m_ringSize;
+    uint64_t m_head;
+    uint64_t m_tail;
+    std::deque<Submission> m_submissions;
+};
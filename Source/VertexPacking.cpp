@@ -0,0 +1,201 @@
+#include "VertexPacking.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	const float Unorm16Max = 65535.0f;
+	const float Snorm16Max = 32767.0f;
+
+	float SignNotZero(float value)
+	{
+		return value >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	// Unit normal of a code, as the shader decodes it: SNORM16 reads -32768 as -1 too.
+	void DecodeOctahedralFloats(float u, float v, float* pNormal)
+	{
+		float x = std::max(u / Snorm16Max, -1.0f);
+		float y = std::max(v / Snorm16Max, -1.0f);
+		const float z = 1.0f - fabsf(x) - fabsf(y);
+		const float t = std::max(-z, 0.0f);
+		x += x >= 0.0f ? -t : t;
+		y += y >= 0.0f ? -t : t;
+
+		const float length = sqrtf(x * x + y * y + z * z);
+		pNormal[0] = x / length;
+		pNormal[1] = y / length;
+		pNormal[2] = z / length;
+	}
+}
+
+PositionQuantization GetPositionQuantization(const float* pBoundsCenter, const float* pBoundsExtents)
+{
+	PositionQuantization quantization;
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		quantization.scale[axis] = 2.0f * pBoundsExtents[axis];
+		quantization.offset[axis] = pBoundsCenter[axis] - pBoundsExtents[axis];
+	}
+	return quantization;
+}
+
+void PackVertices(PackedVertex* pDestination, const void* pVertices, uint32_t vertexStride, uint32_t count, const PositionQuantization& quantization)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		float vertex[12];
+		memcpy(vertex, static_cast<const uint8_t*>(pVertices) + static_cast<size_t>(i) * vertexStride, sizeof(vertex));
+
+		PackedVertex& packed = pDestination[i];
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			const float scale = quantization.scale[axis];
+			const float unit = scale > 0.0f ? (vertex[axis] - quantization.offset[axis]) / scale : 0.0f;
+			packed.position[axis] = static_cast<uint16_t>(std::min(std::max(unit, 0.0f), 1.0f) * Unorm16Max + 0.5f);
+		}
+		packed.position[3] = 0;
+		packed.texCoord[0] = FloatToHalf(vertex[3]);
+		packed.texCoord[1] = FloatToHalf(vertex[4]);
+		EncodeOctahedral(&vertex[5], packed.normal);
+		for (uint32_t channel = 0; channel < 4; channel++)
+		{
+			packed.color[channel] = static_cast<uint8_t>(std::min(std::max(vertex[8 + channel], 0.0f), 1.0f) * 255.0f + 0.5f);
+		}
+	}
+}
+
+void UnpackVertex(const PackedVertex& vertex, const PositionQuantization& quantization, float* pUnpacked)
+{
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		pUnpacked[axis] = vertex.position[axis] / Unorm16Max * quantization.scale[axis] + quantization.offset[axis];
+	}
+	pUnpacked[3] = HalfToFloat(vertex.texCoord[0]);
+	pUnpacked[4] = HalfToFloat(vertex.texCoord[1]);
+	DecodeOctahedral(vertex.normal, &pUnpacked[5]);
+	for (uint32_t channel = 0; channel < 4; channel++)
+	{
+		pUnpacked[8 + channel] = vertex.color[channel] / 255.0f;
+	}
+}
+
+uint16_t FloatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+	const uint32_t exponent = (bits >> 23) & 0xFF;
+	uint32_t mantissa = bits & 0x7FFFFF;
+
+	if (exponent == 0xFF)
+	{
+		return static_cast<uint16_t>(sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0));
+	}
+
+	const int32_t halfExponent = static_cast<int32_t>(exponent) - 127 + 15;
+	if (halfExponent >= 31)
+	{
+		return static_cast<uint16_t>(sign | 0x7C00);
+	}
+
+	// Drops shift bits, rounding to nearest even; a carry out of the mantissa correctly bumps the exponent.
+	uint32_t half;
+	uint32_t shift;
+	if (halfExponent <= 0)
+	{
+		if (halfExponent < -10)
+		{
+			return sign;
+		}
+		mantissa |= 0x800000;
+		shift = static_cast<uint32_t>(14 - halfExponent);
+		half = mantissa >> shift;
+	}
+	else
+	{
+		shift = 13;
+		half = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> shift);
+	}
+	const uint32_t remainder = mantissa & ((1u << shift) - 1);
+	const uint32_t halfway = 1u << (shift - 1);
+	if (remainder > halfway || (remainder == halfway && (half & 1) != 0))
+	{
+		half++;
+	}
+	return static_cast<uint16_t>(sign | half);
+}
+
+float HalfToFloat(uint16_t value)
+{
+	const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+	const uint32_t exponent = (value >> 10) & 0x1F;
+	const uint32_t mantissa = value & 0x3FF;
+
+	uint32_t bits;
+	if (exponent == 0x1F)
+	{
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else if (exponent != 0)
+	{
+		bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+	}
+	else
+	{
+		// Zero or subnormal: mantissa * 2^-24, exact in a float.
+		const float magnitude = mantissa * (1.0f / 16777216.0f);
+		memcpy(&bits, &magnitude, sizeof(bits));
+		bits |= sign;
+	}
+
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+void EncodeOctahedral(const float* pNormal, int16_t* pEncoded)
+{
+	const float length = sqrtf(pNormal[0] * pNormal[0] + pNormal[1] * pNormal[1] + pNormal[2] * pNormal[2]);
+	const float l1 = fabsf(pNormal[0]) + fabsf(pNormal[1]) + fabsf(pNormal[2]);
+	if (length == 0.0f || !(l1 < INFINITY))
+	{
+		pEncoded[0] = 0;
+		pEncoded[1] = 0;
+		return;
+	}
+
+	float u = pNormal[0] / l1;
+	float v = pNormal[1] / l1;
+	if (pNormal[2] < 0.0f)
+	{
+		const float foldedU = (1.0f - fabsf(v)) * SignNotZero(u);
+		v = (1.0f - fabsf(u)) * SignNotZero(v);
+		u = foldedU;
+	}
+
+	const float floorU = floorf(u * Snorm16Max);
+	const float floorV = floorf(v * Snorm16Max);
+	float bestDot = -2.0f;
+	for (uint32_t candidate = 0; candidate < 4; candidate++)
+	{
+		const float codeU = std::min(std::max(floorU + (candidate & 1), -Snorm16Max), Snorm16Max);
+		const float codeV = std::min(std::max(floorV + (candidate >> 1), -Snorm16Max), Snorm16Max);
+		float decoded[3];
+		DecodeOctahedralFloats(codeU, codeV, decoded);
+		const float dot = (decoded[0] * pNormal[0] + decoded[1] * pNormal[1] + decoded[2] * pNormal[2]) / length;
+		if (dot > bestDot)
+		{
+			bestDot = dot;
+			pEncoded[0] = static_cast<int16_t>(codeU);
+			pEncoded[1] = static_cast<int16_t>(codeV);
+		}
+	}
+}
+
+void DecodeOctahedral(const int16_t* pEncoded, float* pNormal)
+{
+	DecodeOctahedralFloats(pEncoded[0], pEncoded[1], pNormal);
+}
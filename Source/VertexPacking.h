@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+// EMeshVertexLayout::Packed: 20 bytes instead of the 48 of the float layout,
+// read by the input assembler as R16G16B16A16_UNORM, R16G16_FLOAT, R16G16_SNORM
+// and R8G8B8A8_UNORM.
+struct PackedVertex
+{
+    uint16_t position[4];       // Across the mesh's bounds, see PositionQuantization; w is 0.
+    uint16_t texCoord[2];       // Half floats.
+    int16_t normal[2];          // Octahedral.
+    uint8_t color[4];           // Clamped to [0, 1].
+};
+
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex must match the packed input layout");
+
+// position = packed * scale + offset, with the packed position read in [0, 1].
+struct PositionQuantization
+{
+    float scale[3];
+    float offset[3];
+};
+
+// Spreads the box over the full UNORM16 range, which puts every position within
+// extents / 65535 of where it was. It only depends on the bounds, so the mesh's
+// bounds are all a reader needs to decode.
+PositionQuantization GetPositionQuantization(const float* pBoundsCenter, const float* pBoundsExtents);
+
+// pVertices holds count vertices of EMeshVertexLayout::PositionTexCoordNormalColor,
+// vertexStride bytes apart, inside the bounds the quantization was made for.
+void PackVertices(PackedVertex* pDestination, const void* pVertices, uint32_t vertexStride, uint32_t count, const PositionQuantization& quantization);
+
+// What the vertex shader reads: twelve floats of the float layout, with a unit normal.
+void UnpackVertex(const PackedVertex& vertex, const PositionQuantization& quantization, float* pUnpacked);
+
+// IEEE half precision, rounding to nearest even; overflow becomes infinity.
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t value);
+
+// Normals folded onto an octahedron and then its lower half onto the upper one,
+// which spends the bits evenly over the sphere. Of the four nearest SNORM16
+// codes, the encoder keeps the one that decodes closest to the normal.
+void EncodeOctahedral(const float* pNormal, int16_t* pEncoded);
+void DecodeOctahedral(const int16_t* pEncoded, float* pNormal);
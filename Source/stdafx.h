@@ -4,6 +4,10 @@
 #define WIN32_LEAN_AND_MEAN
 #endif
 
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
 #include <windows.h>
 
 #include <d3d12.h>
@@ -12,6 +16,11 @@
 #include <DirectXMath.h>
 #include "d3dx12.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
 #include <string>
+#include <vector>
+#include <memory>
 #include <wrl.h>
 #include <shellapi.h>
@@ -0,0 +1,260 @@
+#include "TestFramework.h"
+#include "DescriptorSlotAllocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	uint32_t GetMaxBenchmarkThreads()
+	{
+		return std::max(std::thread::hardware_concurrency(), 2u);
+	}
+
+	// What the allocator replaced: a free list behind a mutex.
+	class MutexSlotAllocator
+	{
+	public:
+		explicit MutexSlotAllocator(uint32_t capacity)
+		{
+			for (uint32_t i = capacity; i-- > 0;)
+			{
+				m_free.push_back(i);
+			}
+		}
+
+		uint32_t Allocate()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_free.empty())
+			{
+				return UINT32_MAX;
+			}
+			const uint32_t index = m_free.back();
+			m_free.pop_back();
+			return index;
+		}
+
+		void Free(uint32_t index)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_free.push_back(index);
+		}
+
+	private:
+		std::mutex m_mutex;
+		std::vector<uint32_t> m_free;
+	};
+}
+
+// Every slot can be handed out once, stale handles are detected and freed slots come back.
+TEST(DescriptorSlotAllocatorHandsOutEachSlotOnce)
+{
+	const uint32_t Capacity = 1000;
+	DescriptorSlotAllocator allocator(Capacity);
+	std::vector<BindlessHandle> handles;
+	std::vector<bool> seen(Capacity, false);
+	for (uint32_t i = 0; i < Capacity; i++)
+	{
+		const BindlessHandle handle = allocator.Allocate();
+		CHECK(!handle.IsNull() && handle.index < Capacity && !seen[handle.index]);
+		seen[handle.index] = true;
+		handles.push_back(handle);
+	}
+	CHECK(allocator.Allocate().IsNull());
+	CHECK(allocator.GetAllocatedCount() == Capacity);
+
+	const BindlessHandle freed = handles[17];
+	allocator.Free(freed);
+	CHECK(!allocator.IsValid(freed));
+	const BindlessHandle reused = allocator.Allocate();
+	CHECK(reused.index == freed.index && reused.generation != freed.generation && allocator.IsValid(reused));
+
+	CHECK(DescriptorSlotAllocator(0).Allocate().IsNull());
+}
+
+// Deferred frees only return once their fence value has completed.
+TEST(DescriptorSlotAllocatorReclaimsDeferredSlotsByFence)
+{
+	DescriptorSlotAllocator allocator(3);
+	const BindlessHandle a = allocator.Allocate();
+	const BindlessHandle b = allocator.Allocate();
+	const BindlessHandle c = allocator.Allocate();
+	allocator.FreeDeferred(a, 5);
+	allocator.FreeDeferred(b, 7);
+	CHECK(!allocator.IsValid(a) && !allocator.IsValid(b) && allocator.IsValid(c));
+	CHECK(allocator.GetAllocatedCount() == 1);
+
+	allocator.Reclaim(4);
+	CHECK(allocator.Allocate().IsNull());
+
+	allocator.Reclaim(5);
+	const BindlessHandle first = allocator.Allocate();
+	CHECK(first.index == a.index);
+	CHECK(allocator.Allocate().IsNull());
+
+	// b was kept pending across Reclaim calls.
+	allocator.Reclaim(7);
+	CHECK(allocator.Allocate().index == b.index);
+}
+
+// Threads allocate, free and defer-free against one allocator while another
+// thread advances a simulated fence and reclaims. Each slot records its owner:
+// a slot handed to two threads at once, or returned before its fence, fails.
+TEST(DescriptorSlotAllocatorSurvivesConcurrentUse)
+{
+	const uint32_t Capacity = 512;
+	const uint32_t ThreadCount = 4;
+	const uint32_t IterationCount = 100000;
+
+	DescriptorSlotAllocator allocator(Capacity);
+	std::unique_ptr<std::atomic<uint32_t>[]> owners(new std::atomic<uint32_t>[Capacity]);
+	std::unique_ptr<std::atomic<uint64_t>[]> retireFences(new std::atomic<uint64_t>[Capacity]);
+	for (uint32_t i = 0; i < Capacity; i++)
+	{
+		owners[i] = 0;
+		retireFences[i] = 0;
+	}
+	std::atomic<uint64_t> completedFence(0);
+	std::atomic<uint32_t> runningThreads(ThreadCount);
+	std::atomic<uint32_t> doubleAllocations(0);
+	std::atomic<uint32_t> earlyReuses(0);
+	std::atomic<uint32_t> staleHandles(0);
+
+	std::vector<std::thread> threads;
+	for (uint32_t t = 0; t < ThreadCount; t++)
+	{
+		threads.emplace_back([&, t]
+		{
+			std::mt19937 random(t + 1);
+			std::vector<BindlessHandle> held;
+			for (uint32_t i = 0; i < IterationCount; i++)
+			{
+				if (held.size() < 64 && random() % 2 == 0)
+				{
+					const BindlessHandle handle = allocator.Allocate();
+					if (!handle.IsNull())
+					{
+						uint32_t expected = 0;
+						doubleAllocations += !owners[handle.index].compare_exchange_strong(expected, t + 1);
+						earlyReuses += retireFences[handle.index].load() > completedFence.load();
+						held.push_back(handle);
+					}
+				}
+				else if (!held.empty())
+				{
+					const size_t pick = random() % held.size();
+					const BindlessHandle handle = held[pick];
+					held[pick] = held.back();
+					held.pop_back();
+
+					staleHandles += !allocator.IsValid(handle);
+					owners[handle.index] = 0;
+					if (random() % 2 == 0)
+					{
+						allocator.Free(handle);
+					}
+					else
+					{
+						// Retire with a fence value a few frames ahead of what the GPU has completed.
+						const uint64_t fenceValue = completedFence.load() + 1 + random() % 3;
+						retireFences[handle.index] = fenceValue;
+						allocator.FreeDeferred(handle, fenceValue);
+					}
+				}
+			}
+			for (const BindlessHandle& handle : held)
+			{
+				owners[handle.index] = 0;
+				allocator.Free(handle);
+			}
+			runningThreads--;
+		});
+	}
+
+	// The "GPU": completes one fence value at a time and reclaims.
+	while (runningThreads.load() > 0)
+	{
+		allocator.Reclaim(completedFence.fetch_add(1) + 1);
+		std::this_thread::yield();
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	CHECK(doubleAllocations.load() == 0);
+	CHECK(earlyReuses.load() == 0);
+	CHECK(staleHandles.load() == 0);
+	CHECK(allocator.GetAllocatedCount() == 0);
+
+	// Nothing leaked: once every fence retires, every slot can be allocated again.
+	allocator.Reclaim(UINT64_MAX);
+	std::vector<bool> seen(Capacity, false);
+	uint32_t allocated = 0;
+	for (BindlessHandle handle = allocator.Allocate(); !handle.IsNull(); handle = allocator.Allocate())
+	{
+		CHECK(!seen[handle.index]);
+		seen[handle.index] = true;
+		allocated++;
+	}
+	CHECK(allocated == Capacity);
+}
+
+// Allocate/free pairs per second from 1..N threads, against a mutex-protected free list.
+BENCHMARK(DescriptorSlotAllocatorThroughput)
+{
+	const uint32_t Capacity = 65536;
+	const uint32_t PairsPerThread = 1000000;
+	for (uint32_t threadCount = 1; threadCount <= GetMaxBenchmarkThreads(); threadCount *= 2)
+	{
+		for (uint32_t lockFree = 0; lockFree < 2; lockFree++)
+		{
+			DescriptorSlotAllocator allocator(Capacity);
+			MutexSlotAllocator mutexAllocator(Capacity);
+			std::vector<std::thread> threads;
+
+			const Stopwatch stopwatch;
+			for (uint32_t t = 0; t < threadCount; t++)
+			{
+				threads.emplace_back([&]
+				{
+					// Hold a few slots at a time, as a loader thread creating views does.
+					BindlessHandle handles[8];
+					for (uint32_t i = 0; i < PairsPerThread; i += 8)
+					{
+						for (BindlessHandle& handle : handles)
+						{
+							handle = lockFree ? allocator.Allocate() : BindlessHandle{ mutexAllocator.Allocate(), 0 };
+						}
+						for (const BindlessHandle& handle : handles)
+						{
+							if (lockFree)
+							{
+								allocator.Free(handle);
+							}
+							else
+							{
+								mutexAllocator.Free(handle.index);
+							}
+						}
+					}
+				});
+			}
+			for (std::thread& thread : threads)
+			{
+				thread.join();
+			}
+			const double seconds = stopwatch.GetSeconds();
+
+			printf("  %u threads, %-9s: %.1f M allocate/free pairs per second\n", threadCount, lockFree ? "lock-free" : "mutex",
+				threadCount * static_cast<double>(PairsPerThread) / seconds / 1e6);
+		}
+	}
+}
@@ -0,0 +1,334 @@
+#include "TestFramework.h"
+#include "DrawChunking.h"
+#include "JobSystem.h"
+#include "RadixSort.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	const uint32_t MaxRecordingJobs = 8;
+	const uint32_t MinDrawsPerJob = 64;
+
+	// Engine's draw sort key below the pass and pipeline state: material, mesh, depth bucket.
+	const uint32_t DepthBits = 16;
+	const uint32_t InstanceDataSize = 160;
+	const uint32_t InstancesPerChunk = 1024 * 1024 / InstanceDataSize;
+
+	uint64_t MakeKey(uint32_t material, uint32_t mesh, uint32_t depthBucket)
+	{
+		return (static_cast<uint64_t>(material) << 32) | (static_cast<uint64_t>(mesh) << 16) | depthBucket;
+	}
+
+	// Objects in alternating materials, spread over meshCount meshes and random depths.
+	void MakeDrawKeys(std::mt19937& random, uint32_t objectCount, uint32_t materialCount, uint32_t meshCount, std::vector<uint64_t>& keys, std::vector<uint32_t>& entries)
+	{
+		keys.resize(objectCount);
+		entries.resize(objectCount);
+		for (uint32_t i = 0; i < objectCount; i++)
+		{
+			keys[i] = MakeKey(i % materialCount, random() % meshCount, random() & 0xffff);
+			entries[i] = i;
+		}
+	}
+
+	// Stands in for ID3D12GraphicsCommandList: every call encodes a packet into the
+	// list's memory and spends a fixed amount of validation work on it, so
+	// recording costs CPU time and memory bandwidth the way a driver's does.
+	class MockCommandList
+	{
+	public:
+		static const uint32_t ValidationRounds = 24;
+
+		void Reset()
+		{
+			m_commands.clear();
+		}
+
+		void SetGraphicsRootConstantBufferView(uint32_t rootParameter, uint64_t address)
+		{
+			Encode(1, rootParameter, address, 0, 0);
+		}
+
+		void SetGraphicsRootShaderResourceView(uint32_t rootParameter, uint64_t address)
+		{
+			Encode(2, rootParameter, address, 0, 0);
+		}
+
+		void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance)
+		{
+			Encode(3, indexCount, instanceCount, startIndex, static_cast<uint64_t>(static_cast<uint32_t>(baseVertex)) << 32 | startInstance);
+		}
+
+		const std::vector<uint64_t>& GetCommands() const { return m_commands; }
+
+	private:
+		void Encode(uint64_t opcode, uint64_t a, uint64_t b, uint64_t c, uint64_t d)
+		{
+			uint64_t hash = opcode * 0x9E3779B97F4A7C15ull ^ a ^ b << 1 ^ c << 2 ^ d << 3;
+			for (uint32_t i = 0; i < ValidationRounds; i++)
+			{
+				hash ^= hash >> 29;
+				hash *= 0xBF58476D1CE4E5B9ull;
+			}
+			m_commands.push_back(opcode);
+			m_commands.push_back(a);
+			m_commands.push_back(b);
+			m_commands.push_back(c);
+			m_commands.push_back(d);
+			m_commands.push_back(hash);
+		}
+
+		std::vector<uint64_t> m_commands;
+	};
+
+	// Draws sorted by material, as the sort key orders them.
+	std::vector<DrawItem> MakeDrawItems(uint32_t drawCount, uint32_t materialCount)
+	{
+		std::vector<DrawItem> drawItems(drawCount);
+		for (uint32_t i = 0; i < drawCount; i++)
+		{
+			drawItems[i] = { i, 0x1000 + (i * materialCount / drawCount) * 256, 0x100000 + i * 64ull, 1 + i % 4, 36 + i % 5 * 3, i * 7, static_cast<int32_t>(i % 11) };
+		}
+		return drawItems;
+	}
+
+	// Records the frame the way Engine::RecordScenePass does and returns the number of lists used.
+	uint32_t RecordFrame(JobSystem& jobSystem, const std::vector<DrawItem>& drawItems, MockCommandList* pCommandLists, uint32_t recordingJobCount)
+	{
+		// Job functors only have room for a pointer and the chunk index.
+		struct Frame
+		{
+			const std::vector<DrawItem>& drawItems;
+			MockCommandList* pCommandLists;
+			DrawChunking chunks;
+			DrawRecordingStats stats[MaxRecordingJobs];
+		} frame = { drawItems, pCommandLists, DrawChunking(), {} };
+		frame.chunks.Split(static_cast<uint32_t>(drawItems.size()), MinDrawsPerJob, recordingJobCount);
+
+		JobCounter recording;
+		for (uint32_t i = 0; i < frame.chunks.GetChunkCount(); i++)
+		{
+			Frame* pFrame = &frame;
+			jobSystem.Run(recording, [pFrame, i]
+			{
+				MockCommandList& commandList = pFrame->pCommandLists[i];
+				commandList.Reset();
+				RecordDrawItems(&commandList, pFrame->drawItems.data(), pFrame->chunks.GetFirstDraw(i), pFrame->chunks.GetLastDraw(i), pFrame->stats[i]);
+			});
+		}
+		jobSystem.Wait(recording);
+		return frame.chunks.GetChunkCount();
+	}
+}
+
+// Chunks are contiguous, in order, cover every draw once and respect the limits.
+TEST(DrawChunkingCoversTheDrawListInOrder)
+{
+	const uint32_t drawCounts[] = { 0, 1, 63, 64, 65, 127, 128, 511, 512, 513, 1000, 100003 };
+	for (uint32_t drawCount : drawCounts)
+	{
+		for (uint32_t maxChunks = 1; maxChunks <= MaxRecordingJobs; maxChunks++)
+		{
+			DrawChunking chunks;
+			chunks.Split(drawCount, MinDrawsPerJob, maxChunks);
+
+			CHECK(chunks.GetChunkCount() >= 1 && chunks.GetChunkCount() <= maxChunks);
+			CHECK(chunks.GetChunkCount() <= std::max((drawCount + MinDrawsPerJob - 1) / MinDrawsPerJob, 1u));
+
+			uint32_t next = 0;
+			for (uint32_t i = 0; i < chunks.GetChunkCount(); i++)
+			{
+				CHECK(chunks.GetFirstDraw(i) == next);
+				CHECK(chunks.GetLastDraw(i) >= chunks.GetFirstDraw(i));
+				next = chunks.GetLastDraw(i);
+			}
+			CHECK(next == drawCount);
+		}
+	}
+
+	DrawChunking none;
+	none.Split(1000, MinDrawsPerJob, 0);
+	CHECK(none.GetChunkCount() == 0);
+}
+
+// Submitting the worker lists in chunk order replays exactly the serial recording.
+TEST(DrawChunkingParallelRecordingMatchesSerial)
+{
+	const std::vector<DrawItem> drawItems = MakeDrawItems(5000, 37);
+	MockCommandList serial;
+	DrawRecordingStats serialStats;
+	RecordDrawItems(&serial, drawItems.data(), 0, static_cast<uint32_t>(drawItems.size()), serialStats);
+	CHECK(serialStats.drawCount == drawItems.size());
+	CHECK(serialStats.materialSets == 37);
+
+	JobSystem jobSystem(4);
+	MockCommandList commandLists[MaxRecordingJobs];
+	for (uint32_t jobCount = 1; jobCount <= MaxRecordingJobs; jobCount++)
+	{
+		const uint32_t listCount = RecordFrame(jobSystem, drawItems, commandLists, jobCount);
+		CHECK(listCount == jobCount);
+
+		std::vector<uint64_t> replay;
+		for (uint32_t i = 0; i < listCount; i++)
+		{
+			replay.insert(replay.end(), commandLists[i].GetCommands().begin(), commandLists[i].GetCommands().end());
+		}
+
+		// Each list sets its first material again, so compare the draws and their bindings only.
+		std::vector<uint64_t> serialDraws;
+		std::vector<uint64_t> replayDraws;
+		for (uint32_t pass = 0; pass < 2; pass++)
+		{
+			const std::vector<uint64_t>& commands = pass == 0 ? serial.GetCommands() : replay;
+			std::vector<uint64_t>& draws = pass == 0 ? serialDraws : replayDraws;
+			for (size_t c = 0; c < commands.size(); c += 6)
+			{
+				if (commands[c] != 1)
+				{
+					draws.insert(draws.end(), commands.begin() + c, commands.begin() + c + 6);
+				}
+			}
+		}
+		CHECK(serialDraws == replayDraws);
+	}
+}
+
+// Runs cover the sorted entries in order; each shares one state and one chunk,
+// and a run only ends where the state or the chunk changes.
+TEST(DrawChunkingRunsShareStateWithinAChunk)
+{
+	std::mt19937 random(3);
+	const uint32_t objectCounts[] = { 0, 1, InstancesPerChunk - 1, InstancesPerChunk, InstancesPerChunk + 1, 3 * InstancesPerChunk + 17, 50000 };
+	const uint32_t meshCounts[] = { 1, 3, 40 };
+	RadixSorter sorter;
+	for (uint32_t objectCount : objectCounts)
+	{
+		for (uint32_t meshCount : meshCounts)
+		{
+			std::vector<uint64_t> keys;
+			std::vector<uint32_t> entries;
+			MakeDrawKeys(random, objectCount, 2, meshCount, keys, entries);
+			const std::vector<uint64_t> unsortedKeys = keys;
+			std::vector<DrawRun> runs(objectCount);
+			const uint32_t runCount = BuildDrawRuns(sorter, keys.data(), entries.data(), objectCount, DepthBits, InstancesPerChunk, runs.data());
+
+			uint32_t next = 0;
+			for (uint32_t r = 0; r < runCount; r++)
+			{
+				const DrawRun& run = runs[r];
+				CHECK(run.first == next && run.count > 0);
+				CHECK(run.first / InstancesPerChunk == (run.first + run.count - 1) / InstancesPerChunk);
+				for (uint32_t i = run.first; i < run.first + run.count; i++)
+				{
+					CHECK((keys[i] >> DepthBits) == (keys[run.first] >> DepthBits));
+					CHECK(keys[i] == unsortedKeys[entries[i]]);
+					CHECK(i == 0 || keys[i - 1] <= keys[i]);
+				}
+				if (r > 0 && run.first % InstancesPerChunk != 0)
+				{
+					CHECK((keys[run.first - 1] >> DepthBits) != (keys[run.first] >> DepthBits));
+				}
+				next = run.first + run.count;
+			}
+			CHECK(next == objectCount);
+		}
+	}
+}
+
+// 100k objects of one mesh in two alternating materials, the engine's benchmark
+// scene: draws with one per object and with instanced runs, the time to sort and
+// split the runs, and the time to record either list against the mock device.
+BENCHMARK(DrawChunkingInstanceRuns)
+{
+	const uint32_t ObjectCount = 100000;
+	const uint32_t FrameCount = 20;
+	std::mt19937 random(4);
+	RadixSorter sorter;
+	std::vector<uint64_t> keys;
+	std::vector<uint32_t> entries;
+	std::vector<DrawRun> runs(ObjectCount);
+
+	double buildMs = 0.0;
+	uint32_t runCount = 0;
+	for (uint32_t frame = 0; frame < FrameCount; frame++)
+	{
+		MakeDrawKeys(random, ObjectCount, 2, 1, keys, entries);
+		const Stopwatch stopwatch;
+		runCount = BuildDrawRuns(sorter, keys.data(), entries.data(), ObjectCount, DepthBits, InstancesPerChunk, runs.data());
+		buildMs += stopwatch.GetMilliseconds();
+	}
+	CHECK(runCount == (ObjectCount + InstancesPerChunk - 1) / InstancesPerChunk + 1);
+
+	std::vector<DrawItem> perObject(ObjectCount);
+	for (uint32_t i = 0; i < ObjectCount; i++)
+	{
+		perObject[i] = { keys[i], 0x1000 + (keys[i] >> 32) * 256, 0x100000 + i * InstanceDataSize, 1, 36, 0, 0 };
+	}
+	std::vector<DrawItem> instanced(runCount);
+	for (uint32_t r = 0; r < runCount; r++)
+	{
+		instanced[r] = perObject[runs[r].first];
+		instanced[r].instanceCount = runs[r].count;
+	}
+
+	const std::vector<DrawItem>* drawLists[] = { &perObject, &instanced };
+	double recordMs[2];
+	for (uint32_t list = 0; list < 2; list++)
+	{
+		MockCommandList commandList;
+		DrawRecordingStats stats;
+		const Stopwatch stopwatch;
+		for (uint32_t frame = 0; frame < FrameCount; frame++)
+		{
+			commandList.Reset();
+			RecordDrawItems(&commandList, drawLists[list]->data(), 0, static_cast<uint32_t>(drawLists[list]->size()), stats);
+		}
+		recordMs[list] = stopwatch.GetMilliseconds() / FrameCount;
+		DoNotOptimize(commandList.GetCommands().back());
+	}
+
+	printf("  %u objects, %u instances per chunk: %u draws one per object, %u instanced, %.3f ms to sort and split\n",
+		ObjectCount, InstancesPerChunk, ObjectCount, runCount, buildMs / FrameCount);
+	printf("  recording: %.3f ms per object, %.3f ms instanced\n", recordMs[0], recordMs[1]);
+}
+
+// Frame recording time of a 20000-draw list against the mock device, for 1..N
+// workers. Workers beyond the hardware thread count only show scheduling overhead.
+BENCHMARK(DrawChunkingRecordingScaling)
+{
+	const uint32_t DrawCount = 20000;
+	const uint32_t FrameCount = 50;
+	const std::vector<DrawItem> drawItems = MakeDrawItems(DrawCount, 200);
+	const uint32_t hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	const uint32_t maxWorkers = std::min(std::max(hardwareThreads, 2u), MaxRecordingJobs);
+
+	double singleThreadMs = 0.0;
+	for (uint32_t workerCount = 1; workerCount <= maxWorkers; workerCount++)
+	{
+		JobSystem jobSystem(workerCount);
+		std::unique_ptr<MockCommandList[]> commandLists(new MockCommandList[MaxRecordingJobs]);
+		RecordFrame(jobSystem, drawItems, commandLists.get(), workerCount);
+
+		const Stopwatch stopwatch;
+		uint32_t listCount = 0;
+		for (uint32_t frame = 0; frame < FrameCount; frame++)
+		{
+			listCount = RecordFrame(jobSystem, drawItems, commandLists.get(), workerCount);
+		}
+		const double frameMs = stopwatch.GetMilliseconds() / FrameCount;
+		DoNotOptimize(commandLists[0].GetCommands().back());
+
+		if (workerCount == 1)
+		{
+			singleThreadMs = frameMs;
+		}
+		printf("  %u workers, %u lists: %.3f ms per frame, %.2fx%s\n", workerCount, listCount, frameMs, singleThreadMs / frameMs,
+			workerCount > hardwareThreads ? " (more workers than hardware threads)" : "");
+	}
+}
@@ -0,0 +1,413 @@
+#include "TestFramework.h"
+#include "TestMath.h"
+#include "DynamicBvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// Objects wandering around a cube, with the BVH proxy of each live one.
+	struct World
+	{
+		std::vector<BvhBounds> bounds;
+		std::vector<uint32_t> proxies;
+		std::vector<bool> alive;
+		std::mt19937 random;
+		float range;
+
+		World(uint32_t count, uint32_t seed, float worldRange) :
+			random(seed),
+			range(worldRange)
+		{
+			for (uint32_t i = 0; i < count; i++)
+			{
+				bounds.push_back(MakeBounds());
+				proxies.push_back(uint32_t(DynamicBvh::NullProxy));
+				alive.push_back(false);
+			}
+		}
+
+		BvhBounds MakeBounds()
+		{
+			std::uniform_real_distribution<float> position(-range, range);
+			std::uniform_real_distribution<float> size(0.0f, range * 0.01f);
+			const float x = position(random);
+			const float y = position(random);
+			const float z = position(random);
+			return { x - size(random), y - size(random), z - size(random), x + size(random), y + size(random), z + size(random) };
+		}
+
+		void Offset(uint32_t i, float step)
+		{
+			std::uniform_real_distribution<float> offset(-step, step);
+			const float x = offset(random);
+			const float y = offset(random);
+			const float z = offset(random);
+			BvhBounds& b = bounds[i];
+			b = { b.minX + x, b.minY + y, b.minZ + z, b.maxX + x, b.maxY + y, b.maxZ + z };
+		}
+
+		void InsertAll(DynamicBvh& bvh)
+		{
+			for (uint32_t i = 0; i < bounds.size(); i++)
+			{
+				proxies[i] = bvh.Insert(bounds[i], i);
+				alive[i] = true;
+			}
+		}
+	};
+
+	double GetPlaneDistance(const Frustum& frustum, int plane, double x, double y, double z)
+	{
+		return frustum.normalX[plane] * x + frustum.normalY[plane] * y + frustum.normalZ[plane] * z + frustum.distance[plane];
+	}
+
+	// The least distance + radius over the planes: negative means outside one of them.
+	double GetFrustumMargin(const Frustum& frustum, const BvhBounds& b)
+	{
+		double margin = std::numeric_limits<double>::max();
+		for (int p = 0; p < 6; p++)
+		{
+			const double distance = GetPlaneDistance(frustum, p, 0.5 * (b.minX + b.maxX), 0.5 * (b.minY + b.maxY), 0.5 * (b.minZ + b.maxZ));
+			const double radius = 0.5 * (std::fabs(frustum.normalX[p]) * (b.maxX - b.minX) + std::fabs(frustum.normalY[p]) * (b.maxY - b.minY) +
+				std::fabs(frustum.normalZ[p]) * (b.maxZ - b.minZ));
+			margin = std::min(margin, distance + radius);
+		}
+		return margin;
+	}
+
+	double GetRayEntry(const BvhBounds& b, const float origin[3], const float direction[3])
+	{
+		const double minimum[3] = { b.minX, b.minY, b.minZ };
+		const double maximum[3] = { b.maxX, b.maxY, b.maxZ };
+		double entry = 0.0;
+		double exit = std::numeric_limits<double>::max();
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const double t0 = (minimum[axis] - origin[axis]) / direction[axis];
+			const double t1 = (maximum[axis] - origin[axis]) / direction[axis];
+			entry = std::max(entry, std::min(t0, t1));
+			exit = std::min(exit, std::max(t0, t1));
+		}
+		return entry <= exit ? entry : std::numeric_limits<double>::infinity();
+	}
+
+	// Check every query type against a linear scan over the proxies' enlarged boxes.
+	uint32_t CountQueryMismatches(const DynamicBvh& bvh, const World& world, std::mt19937& random)
+	{
+		uint32_t mismatches = 0;
+		std::vector<uint32_t> results;
+		std::vector<uint32_t> expected;
+		std::uniform_real_distribution<float> position(-world.range, world.range);
+
+		// Spheres use the same float test on every level, and parents contain their
+		// children exactly, so the result is exactly the brute force one.
+		for (uint32_t query = 0; query < 20; query++)
+		{
+			const float x = position(random);
+			const float y = position(random);
+			const float z = position(random);
+			const float radius = std::fabs(position(random)) * 0.3f;
+
+			results.clear();
+			bvh.QuerySphere(x, y, z, radius, results);
+			expected.clear();
+			for (uint32_t i = 0; i < world.bounds.size(); i++)
+			{
+				if (!world.alive[i])
+					continue;
+
+				const BvhBounds& b = bvh.GetBounds(world.proxies[i]);
+				const float dx = x - std::min(std::max(x, b.minX), b.maxX);
+				const float dy = y - std::min(std::max(y, b.minY), b.maxY);
+				const float dz = z - std::min(std::max(z, b.minZ), b.maxZ);
+				if (dx * dx + dy * dy + dz * dz <= radius * radius)
+				{
+					expected.push_back(i);
+				}
+			}
+			std::sort(results.begin(), results.end());
+			mismatches += results != expected;
+		}
+
+		// Frustums skip the tests under subtrees that are entirely inside, so compare
+		// with a small tolerance around the planes.
+		for (uint32_t query = 0; query < 20; query++)
+		{
+			Frustum frustum;
+			ExtractFrustum(MakeViewProjection({ position(random), position(random), position(random) }, { position(random), position(random), position(random) }), frustum);
+
+			results.clear();
+			bvh.QueryFrustum(frustum, results);
+			std::vector<bool> returned(world.bounds.size(), false);
+			for (uint32_t userData : results)
+			{
+				mismatches += userData >= world.bounds.size() || !world.alive[userData] || returned[userData];
+				returned[userData] = true;
+			}
+			for (uint32_t i = 0; i < world.bounds.size(); i++)
+			{
+				if (!world.alive[i])
+					continue;
+
+				const double margin = GetFrustumMargin(frustum, bvh.GetBounds(world.proxies[i]));
+				mismatches += (margin > 1e-3 && !returned[i]) || (margin < -1e-3 && returned[i]);
+			}
+		}
+
+		// Rays report the nearest entry into any enlarged box.
+		for (uint32_t query = 0; query < 20; query++)
+		{
+			const float origin[3] = { position(random), position(random), position(random) };
+			const float direction[3] = { position(random), position(random), position(random) };
+			const float maxDistance = 2.0f;
+
+			float distance = 0.0f;
+			const uint32_t hit = bvh.RayCast(origin, direction, maxDistance, &distance);
+
+			double nearest = std::numeric_limits<double>::infinity();
+			for (uint32_t i = 0; i < world.bounds.size(); i++)
+			{
+				if (world.alive[i])
+				{
+					nearest = std::min(nearest, GetRayEntry(bvh.GetBounds(world.proxies[i]), origin, direction));
+				}
+			}
+
+			if (nearest > maxDistance + 1e-4)
+			{
+				mismatches += hit != DynamicBvh::NullProxy && distance < maxDistance - 1e-4;
+			}
+			else if (nearest < maxDistance - 1e-4)
+			{
+				mismatches += hit == DynamicBvh::NullProxy || hit >= world.bounds.size() || !world.alive[hit] ||
+					std::fabs(distance - nearest) > 1e-4 ||
+					std::fabs(GetRayEntry(bvh.GetBounds(world.proxies[hit]), origin, direction) - nearest) > 1e-4;
+			}
+		}
+		return mismatches;
+	}
+
+	// Move a fraction of the objects by up to step, returning how many left their enlarged boxes.
+	uint32_t MoveSome(DynamicBvh& bvh, World& world, float fraction, float step)
+	{
+		std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+		uint32_t changed = 0;
+		for (uint32_t i = 0; i < world.bounds.size(); i++)
+		{
+			if (world.alive[i] && chance(world.random) < fraction)
+			{
+				world.Offset(i, step);
+				changed += bvh.Move(world.proxies[i], world.bounds[i]);
+			}
+		}
+		return changed;
+	}
+}
+
+// Small moves stay inside the margin and leave the tree alone; the enlarged box
+// always contains the object's real bounds.
+TEST(DynamicBvhMarginAbsorbsSmallMoves)
+{
+	DynamicBvh bvh(0.5f);
+	const BvhBounds bounds = { 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+	const uint32_t proxy = bvh.Insert(bounds, 7);
+	CHECK(bvh.GetUserData(proxy) == 7);
+	CHECK(bvh.GetProxyCount() == 1);
+
+	const BvhBounds nudged = { 0.25f, 0.0f, 0.0f, 1.25f, 1.0f, 1.0f };
+	CHECK(!bvh.Move(proxy, nudged));
+
+	const BvhBounds moved = { 5.0f, 0.0f, 0.0f, 6.0f, 1.0f, 1.0f };
+	CHECK(bvh.Move(proxy, moved));
+	bvh.Update();
+	const BvhBounds& enlarged = bvh.GetBounds(proxy);
+	CHECK(enlarged.minX <= 5.0f && enlarged.maxX >= 6.0f && enlarged.minY <= 0.0f && enlarged.maxY >= 1.0f);
+
+	std::vector<uint32_t> results;
+	bvh.QuerySphere(5.5f, 0.5f, 0.5f, 0.1f, results);
+	CHECK(results.size() == 1 && results[0] == 7);
+	results.clear();
+	bvh.QuerySphere(0.5f, 0.5f, 0.5f, 0.1f, results);
+	CHECK(results.empty());
+
+	bvh.Remove(proxy);
+	CHECK(bvh.GetProxyCount() == 0 && bvh.GetHeight() == 0);
+	float distance = 0.0f;
+	const float origin[3] = { -1.0f, 0.5f, 0.5f };
+	const float direction[3] = { 1.0f, 0.0f, 0.0f };
+	CHECK(bvh.RayCast(origin, direction, 100.0f, &distance) == DynamicBvh::NullProxy);
+}
+
+// Queries match brute force through rounds of moves, removals and insertions,
+// after refits, partial rebuilds and full rebuilds alike.
+TEST(DynamicBvhQueriesMatchBruteForce)
+{
+	World world(4000, 5, 100.0f);
+	DynamicBvh bvh(0.5f);
+	world.InsertAll(bvh);
+	bvh.Update();
+
+	std::mt19937 random(17);
+	CHECK(CountQueryMismatches(bvh, world, random) == 0);
+
+	uint32_t liveCount = 4000;
+	for (uint32_t round = 0; round < 12; round++)
+	{
+		// Alternate jitter within the margin, drift and teleports.
+		const float step = round % 3 == 0 ? 0.2f : round % 3 == 1 ? 5.0f : 200.0f;
+		MoveSome(bvh, world, 0.3f, step);
+
+		for (uint32_t i = round; i < world.bounds.size(); i += 37)
+		{
+			if (world.alive[i])
+			{
+				bvh.Remove(world.proxies[i]);
+				world.alive[i] = false;
+				liveCount--;
+			}
+			else
+			{
+				world.bounds[i] = world.MakeBounds();
+				world.proxies[i] = bvh.Insert(world.bounds[i], i);
+				world.alive[i] = true;
+				liveCount++;
+			}
+		}
+
+		if (round == 8)
+		{
+			bvh.Rebuild();
+		}
+		else
+		{
+			bvh.Update();
+		}
+
+		CHECK(bvh.GetProxyCount() == liveCount);
+		for (uint32_t i = 0; i < world.bounds.size(); i++)
+		{
+			if (world.alive[i])
+			{
+				const BvhBounds& enlarged = bvh.GetBounds(world.proxies[i]);
+				const BvhBounds& b = world.bounds[i];
+				CHECK(bvh.GetUserData(world.proxies[i]) == i);
+				CHECK(enlarged.minX <= b.minX && enlarged.minY <= b.minY && enlarged.minZ <= b.minZ &&
+					enlarged.maxX >= b.maxX && enlarged.maxY >= b.maxY && enlarged.maxZ >= b.maxZ);
+			}
+		}
+		CHECK(CountQueryMismatches(bvh, world, random) == 0);
+	}
+}
+
+// A full rebuild keeps the tree shallow; refits alone let its cost grow, and
+// Update's partial rebuilds pull it back under the degradation threshold.
+TEST(DynamicBvhUpdateBoundsDegradation)
+{
+	World world(20000, 9, 200.0f);
+	DynamicBvh bvh(0.1f, 2.0f);
+	world.InsertAll(bvh);
+	bvh.Rebuild();
+	const float builtCost = bvh.GetCost();
+	CHECK(bvh.GetHeight() < 64);
+
+	for (uint32_t frame = 0; frame < 20; frame++)
+	{
+		MoveSome(bvh, world, 0.5f, 40.0f);
+		bvh.Update();
+	}
+	CHECK(bvh.GetCost() < builtCost * 4.0f);
+
+	bvh.Rebuild();
+	CHECK(std::fabs(bvh.GetCost() - builtCost) < builtCost * 0.5f);
+}
+
+// Per frame cost of Update (refit plus partial rebuilds) against a full rebuild
+// as the moving fraction grows, and frustum query time from the tree against a
+// linear scan of every box.
+BENCHMARK(DynamicBvhUpdateAndQuery)
+{
+	const float fractions[] = { 0.01f, 0.1f, 0.5f };
+	for (uint32_t count : { 10000u, 100000u })
+	{
+		for (float fraction : fractions)
+		{
+			World world(count, 1, 500.0f);
+			DynamicBvh bvh(0.5f);
+			world.InsertAll(bvh);
+			bvh.Rebuild();
+
+			const uint32_t Frames = 20;
+			double moveMs = 0.0;
+			double updateMs = 0.0;
+			uint32_t changed = 0;
+			uint32_t rebuiltLeaves = 0;
+			for (uint32_t frame = 0; frame < Frames; frame++)
+			{
+				Stopwatch stopwatch;
+				changed += MoveSome(bvh, world, fraction, 3.0f);
+				moveMs += stopwatch.GetMilliseconds();
+				stopwatch.Restart();
+				rebuiltLeaves += bvh.Update();
+				updateMs += stopwatch.GetMilliseconds();
+			}
+			const float updatedCost = bvh.GetCost();
+
+			Stopwatch stopwatch;
+			bvh.Rebuild();
+			const double rebuildMs = stopwatch.GetMilliseconds();
+
+			printf("  %6u objects, %4.0f%% moving: move %.3f ms, update %.3f ms (%u left margin, %u leaves rebuilt), full rebuild %.3f ms, cost %.1f vs %.1f rebuilt\n",
+				count, fraction * 100.0f, moveMs / Frames, updateMs / Frames, changed / Frames, rebuiltLeaves / Frames, rebuildMs, updatedCost, bvh.GetCost());
+		}
+
+		World world(count, 2, 500.0f);
+		DynamicBvh bvh(0.5f);
+		world.InsertAll(bvh);
+		bvh.Rebuild();
+
+		std::vector<float> centerX, centerY, centerZ, extentX, extentY, extentZ;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const BvhBounds& b = bvh.GetBounds(world.proxies[i]);
+			centerX.push_back(0.5f * (b.minX + b.maxX));
+			centerY.push_back(0.5f * (b.minY + b.maxY));
+			centerZ.push_back(0.5f * (b.minZ + b.maxZ));
+			extentX.push_back(0.5f * (b.maxX - b.minX));
+			extentY.push_back(0.5f * (b.maxY - b.minY));
+			extentZ.push_back(0.5f * (b.maxZ - b.minZ));
+		}
+		const SceneBoundsView view = { centerX.data(), centerY.data(), centerZ.data(), extentX.data(), extentY.data(), extentZ.data(), count };
+
+		Frustum frustum;
+		ExtractFrustum(MakeViewProjection({ 0.0f, 10.0f, -600.0f }, { 0.0f, 0.0f, 0.0f }), frustum);
+
+		const uint32_t Repeats = 20;
+		std::vector<uint32_t> results;
+		Stopwatch stopwatch;
+		for (uint32_t r = 0; r < Repeats; r++)
+		{
+			results.clear();
+			bvh.QueryFrustum(frustum, results);
+		}
+		const double treeMs = stopwatch.GetMilliseconds() / Repeats;
+
+		std::vector<uint32_t> visible(count);
+		uint32_t visibleCount = 0;
+		stopwatch.Restart();
+		for (uint32_t r = 0; r < Repeats; r++)
+		{
+			visibleCount = CullBoxes(frustum, view, 0, count, visible.data(), GetBestCullingPath());
+		}
+		const double linearMs = stopwatch.GetMilliseconds() / Repeats;
+		DoNotOptimize(results.size() + visibleCount);
+
+		printf("  %6u objects: frustum query %.3f ms (%zu visible), linear CullBoxes %.3f ms (%u visible)\n",
+			count, treeMs, results.size(), linearMs, visibleCount);
+	}
+}
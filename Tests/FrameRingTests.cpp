@@ -0,0 +1,100 @@
+#include "TestFramework.h"
+#include "FrameRing.h"
+
+#include <deque>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// Stands in for the GPU: completes submitted frames in order, whenever told to
+	// or when the CPU blocks on a value it has not reached.
+	class FakeFence
+	{
+	public:
+		uint64_t GetCompletedValue() const { return m_completedValue; }
+		uint64_t GetStallCount() const { return m_stallCount; }
+
+		void Signal(uint64_t fenceValue) { m_pending.push_back(fenceValue); }
+
+		void Complete(uint32_t frameCount)
+		{
+			for (uint32_t i = 0; i < frameCount && !m_pending.empty(); i++)
+			{
+				m_completedValue = m_pending.front();
+				m_pending.pop_front();
+			}
+		}
+
+		void WaitFor(uint64_t fenceValue)
+		{
+			if (m_completedValue < fenceValue)
+			{
+				m_stallCount++;
+			}
+			while (m_completedValue < fenceValue && !m_pending.empty())
+			{
+				Complete(1);
+			}
+		}
+
+	private:
+		std::deque<uint64_t> m_pending;
+		uint64_t m_completedValue = 0;
+		uint64_t m_stallCount = 0;
+	};
+}
+
+// Drives the ring the way Engine::MoveToNextFrame does, with a GPU that runs a
+// random number of frames behind, and checks every slot before it is recorded into.
+TEST(FrameRingReusesSlotsOnlyAfterTheirFenceRetires)
+{
+	for (uint32_t frameCount = 1; frameCount <= 4; frameCount++)
+	{
+		std::mt19937 random(frameCount);
+		FrameRing ring(frameCount);
+		FakeFence fence;
+		std::vector<uint64_t> lastRecorded(frameCount, 0);
+		uint64_t fenceValue = 1;
+		for (uint32_t frame = 0; frame < 10000; frame++)
+		{
+			const uint32_t slot = ring.GetFrameIndex();
+			CHECK(slot < frameCount);
+			CHECK(fence.GetCompletedValue() >= lastRecorded[slot]);
+			CHECK(fenceValue - 1 - fence.GetCompletedValue() < frameCount);
+			lastRecorded[slot] = fenceValue;
+
+			fence.Signal(fenceValue);
+			const uint64_t waitValue = ring.Advance(fenceValue);
+			fenceValue++;
+
+			fence.Complete(random() % 3);
+			fence.WaitFor(waitValue);
+		}
+	}
+}
+
+// With a GPU that only moves when waited on, the CPU gets frameCount - 1 frames
+// ahead before its first stall and then waits for the frame frameCount back.
+TEST(FrameRingRunsFrameCountFramesAhead)
+{
+	for (uint32_t frameCount = 1; frameCount <= 4; frameCount++)
+	{
+		FrameRing ring(frameCount);
+		for (uint64_t fenceValue = 1; fenceValue <= 20; fenceValue++)
+		{
+			const uint64_t waitValue = ring.Advance(fenceValue);
+			CHECK(waitValue == (fenceValue + 1 > frameCount ? fenceValue + 1 - frameCount : 0));
+			CHECK(ring.GetFenceValue((ring.GetFrameIndex() + frameCount - 1) % frameCount) == fenceValue);
+		}
+
+		FakeFence fence;
+		FrameRing stallingRing(frameCount);
+		for (uint64_t fenceValue = 1; fenceValue <= 100; fenceValue++)
+		{
+			fence.Signal(fenceValue);
+			fence.WaitFor(stallingRing.Advance(fenceValue));
+		}
+		CHECK(fence.GetStallCount() == 100 - (frameCount - 1));
+	}
+}
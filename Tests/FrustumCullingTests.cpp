@@ -0,0 +1,203 @@
+#include "TestFramework.h"
+#include "TestMath.h"
+#include "FrustumCulling.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// Boxes and spheres scattered around and through a camera's frustum.
+	struct Objects
+	{
+		std::vector<float> centerX, centerY, centerZ;
+		std::vector<float> extentX, extentY, extentZ;
+		std::vector<float> radius;
+
+		explicit Objects(uint32_t count, uint32_t seed, float range)
+		{
+			std::mt19937 random(seed);
+			std::uniform_real_distribution<float> position(-range, range);
+			std::uniform_real_distribution<float> size(0.0f, range * 0.02f);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				centerX.push_back(position(random));
+				centerY.push_back(position(random));
+				centerZ.push_back(position(random));
+				extentX.push_back(size(random));
+				extentY.push_back(size(random));
+				extentZ.push_back(size(random));
+				radius.push_back(size(random));
+			}
+		}
+
+		SceneBoundsView GetBoxes() const
+		{
+			return { centerX.data(), centerY.data(), centerZ.data(), extentX.data(), extentY.data(), extentZ.data(), static_cast<uint32_t>(centerX.size()) };
+		}
+	};
+
+	std::vector<ECullingPath> GetSupportedPaths()
+	{
+		std::vector<ECullingPath> paths = { ECullingPath::Scalar };
+		if (GetBestCullingPath() != ECullingPath::Scalar)
+		{
+			paths.push_back(ECullingPath::SSE);
+		}
+		if (GetBestCullingPath() == ECullingPath::AVX2)
+		{
+			paths.push_back(ECullingPath::AVX2);
+		}
+		return paths;
+	}
+
+	const char* GetPathName(ECullingPath path)
+	{
+		return path == ECullingPath::AVX2 ? "AVX2" : path == ECullingPath::SSE ? "SSE" : "scalar";
+	}
+
+	double GetPlaneDistance(const Frustum& frustum, int plane, double x, double y, double z)
+	{
+		return frustum.normalX[plane] * x + frustum.normalY[plane] * y + frustum.normalZ[plane] * z + frustum.distance[plane];
+	}
+}
+
+// Points in front of the camera are inside all six planes, points behind it or
+// beyond the far plane are not, and the planes come out normalized.
+TEST(FrustumCullingExtractsNormalizedPlanes)
+{
+	Frustum frustum;
+	ExtractFrustum(MakeViewProjection({ 0.0f, 0.0f, -10.0f }, { 0.0f, 0.0f, 0.0f }, 1.0f, 1.0f, 1.0f, 100.0f), frustum);
+	for (int p = 0; p < 6; p++)
+	{
+		const double length = std::sqrt(frustum.normalX[p] * frustum.normalX[p] + frustum.normalY[p] * frustum.normalY[p] + frustum.normalZ[p] * frustum.normalZ[p]);
+		CHECK(std::fabs(length - 1.0) < 1e-5);
+		CHECK(GetPlaneDistance(frustum, p, 0.0, 0.0, 0.0) > 0.0);
+	}
+
+	// Near plane at z = -9 and far at z = 90, both in world units.
+	CHECK(std::fabs(GetPlaneDistance(frustum, 4, 0.0, 0.0, -9.0)) < 1e-4);
+	CHECK(std::fabs(GetPlaneDistance(frustum, 5, 0.0, 0.0, 90.0)) < 1e-3);
+	CHECK(GetPlaneDistance(frustum, 4, 0.0, 0.0, -11.0) < 0.0);
+	CHECK(GetPlaneDistance(frustum, 5, 0.0, 0.0, 95.0) < 0.0);
+}
+
+// Every path returns exactly the scalar result, for any range start and length
+// so that the SIMD remainders and unaligned starts are covered, and including
+// objects that graze a plane.
+TEST(FrustumCullingPathsMatchScalarExactly)
+{
+	const std::vector<ECullingPath> paths = GetSupportedPaths();
+	std::mt19937 random(13);
+	std::vector<uint32_t> expected(5000);
+	std::vector<uint32_t> visible(5000);
+	for (uint32_t view = 0; view < 50; view++)
+	{
+		std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+		Frustum frustum;
+		ExtractFrustum(MakeViewProjection({ position(random), position(random), position(random) }, { position(random), position(random), position(random) }), frustum);
+
+		// Half the objects are moved onto a plane, touching it from outside by at most their size.
+		Objects objects(5000, view, 60.0f);
+		for (uint32_t i = 0; i < 5000; i += 2)
+		{
+			const int p = random() % 6;
+			const float distance = static_cast<float>(GetPlaneDistance(frustum, p, objects.centerX[i], objects.centerY[i], objects.centerZ[i]));
+			const float offset = distance + objects.radius[i] * static_cast<float>(random() % 3) * 0.5f;
+			objects.centerX[i] -= frustum.normalX[p] * offset;
+			objects.centerY[i] -= frustum.normalY[p] * offset;
+			objects.centerZ[i] -= frustum.normalZ[p] * offset;
+		}
+
+		const uint32_t begin = random() % 17;
+		const uint32_t end = begin + random() % (5000 - begin);
+		const uint32_t expectedBoxes = CullBoxes(frustum, objects.GetBoxes(), begin, end, expected.data(), ECullingPath::Scalar);
+		for (ECullingPath path : paths)
+		{
+			const uint32_t count = CullBoxes(frustum, objects.GetBoxes(), begin, end, visible.data(), path);
+			CHECK(count == expectedBoxes && std::equal(expected.begin(), expected.begin() + count, visible.begin()));
+		}
+
+		const uint32_t expectedSpheres = CullSpheres(frustum, objects.centerX.data(), objects.centerY.data(), objects.centerZ.data(), objects.radius.data(),
+			begin, end, expected.data(), ECullingPath::Scalar);
+		for (ECullingPath path : paths)
+		{
+			const uint32_t count = CullSpheres(frustum, objects.centerX.data(), objects.centerY.data(), objects.centerZ.data(), objects.radius.data(),
+				begin, end, visible.data(), path);
+			CHECK(count == expectedSpheres && std::equal(expected.begin(), expected.begin() + count, visible.begin()));
+		}
+	}
+}
+
+// Against double precision: nothing that reaches inside the frustum is culled,
+// and everything entirely behind one plane is.
+TEST(FrustumCullingKeepsVisibleAndCullsOutsideObjects)
+{
+	Frustum frustum;
+	ExtractFrustum(MakeViewProjection({ 5.0f, 3.0f, -40.0f }, { 0.0f, 0.0f, 0.0f }), frustum);
+	const Objects objects(20000, 21, 80.0f);
+	std::vector<uint32_t> visible(20000);
+
+	for (ECullingPath path : GetSupportedPaths())
+	{
+		const uint32_t count = CullBoxes(frustum, objects.GetBoxes(), 0, 20000, visible.data(), path);
+		std::vector<bool> kept(20000, false);
+		for (uint32_t v = 0; v < count; v++)
+		{
+			CHECK(v == 0 || visible[v] > visible[v - 1]);
+			kept[visible[v]] = true;
+		}
+
+		uint32_t wrongCount = 0;
+		for (uint32_t i = 0; i < 20000; i++)
+		{
+			bool centerInside = true;
+			bool behindOnePlane = false;
+			for (int p = 0; p < 6; p++)
+			{
+				const double distance = GetPlaneDistance(frustum, p, objects.centerX[i], objects.centerY[i], objects.centerZ[i]);
+				const double radius = std::fabs(frustum.normalX[p]) * objects.extentX[i] + std::fabs(frustum.normalY[p]) * objects.extentY[i] +
+					std::fabs(frustum.normalZ[p]) * objects.extentZ[i];
+				centerInside = centerInside && distance > 1e-3;
+				behindOnePlane = behindOnePlane || distance + radius < -1e-3;
+			}
+			wrongCount += (centerInside && !kept[i]) || (behindOnePlane && kept[i]);
+		}
+		CHECK(wrongCount == 0);
+	}
+}
+
+// Objects culled per millisecond on each path, for a million boxes and spheres.
+BENCHMARK(FrustumCullingThroughput)
+{
+	const uint32_t Count = 1 << 20;
+	const Objects objects(Count, 3, 500.0f);
+	std::vector<uint32_t> visible(Count);
+	Frustum frustum;
+	ExtractFrustum(MakeViewProjection({ 0.0f, 10.0f, -300.0f }, { 0.0f, 0.0f, 0.0f }), frustum);
+
+	for (ECullingPath path : GetSupportedPaths())
+	{
+		const uint32_t Repeats = 10;
+		uint32_t boxCount = 0;
+		uint32_t sphereCount = 0;
+		Stopwatch stopwatch;
+		for (uint32_t r = 0; r < Repeats; r++)
+		{
+			boxCount = CullBoxes(frustum, objects.GetBoxes(), 0, Count, visible.data(), path);
+		}
+		const double boxMs = stopwatch.GetMilliseconds() / Repeats;
+		stopwatch.Restart();
+		for (uint32_t r = 0; r < Repeats; r++)
+		{
+			sphereCount = CullSpheres(frustum, objects.centerX.data(), objects.centerY.data(), objects.centerZ.data(), objects.radius.data(), 0, Count, visible.data(), path);
+		}
+		const double sphereMs = stopwatch.GetMilliseconds() / Repeats;
+		DoNotOptimize(boxCount + sphereCount);
+
+		printf("  %-6s: boxes %.0f objects/ms (%u visible), spheres %.0f objects/ms (%u visible)\n", GetPathName(path),
+			Count / boxMs, boxCount, Count / sphereMs, sphereCount);
+	}
+}
@@ -0,0 +1,153 @@
+#include "TestFramework.h"
+#include "TestMath.h"
+#include "GpuCulling.h"
+
+#include <cfloat>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// Objects scattered around and through the frustum, each with distinct draw arguments.
+	std::vector<GpuCullObject> MakeObjects(uint32_t count, uint32_t seed, float range)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> position(-range, range);
+		std::uniform_real_distribution<float> size(0.0f, range * 0.02f);
+
+		std::vector<GpuCullObject> objects(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			GpuCullObject& object = objects[i];
+			object.material = 0x10000ull + (i % 7) * 256;
+			object.instance = 0x80000000ull + i * 64ull;
+			object.indexCount = 3 * (i + 1);
+			object.startIndex = i * 11;
+			object.baseVertex = static_cast<int32_t>(i) - 100;
+			object.padding = 0;
+			object.centerX = position(random);
+			object.centerY = position(random);
+			object.centerZ = position(random);
+			object.extentX = size(random);
+			object.extentY = size(random);
+			object.extentZ = size(random);
+		}
+		return objects;
+	}
+
+	bool MatchesObject(const GpuDrawCommand& command, const GpuCullObject& object)
+	{
+		return command.material == object.material && command.instance == object.instance && command.indexCountPerInstance == object.indexCount &&
+			command.instanceCount == 1 && command.startIndexLocation == object.startIndex && command.baseVertexLocation == object.baseVertex &&
+			command.startInstanceLocation == 0 && command.padding == 0;
+	}
+
+	Frustum MakeFrustum(std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+		Frustum frustum;
+		ExtractFrustum(MakeViewProjection({ position(random), position(random), position(random) }, { position(random), position(random), position(random) }), frustum);
+		return frustum;
+	}
+}
+
+// The reference keeps exactly the objects CullBoxes keeps (the same test in the
+// same order), in object order, each with its own draw arguments.
+TEST(GpuCullingCompactsVisibleObjectsInOrder)
+{
+	std::mt19937 random(15);
+	for (uint32_t view = 0; view < 30; view++)
+	{
+		const std::vector<GpuCullObject> objects = MakeObjects(3000, view, 60.0f);
+		const Frustum frustum = MakeFrustum(random);
+
+		std::vector<float> centerX, centerY, centerZ, extentX, extentY, extentZ;
+		for (const GpuCullObject& object : objects)
+		{
+			centerX.push_back(object.centerX);
+			centerY.push_back(object.centerY);
+			centerZ.push_back(object.centerZ);
+			extentX.push_back(object.extentX);
+			extentY.push_back(object.extentY);
+			extentZ.push_back(object.extentZ);
+		}
+		const SceneBoundsView bounds = { centerX.data(), centerY.data(), centerZ.data(), extentX.data(), extentY.data(), extentZ.data(), 3000 };
+		std::vector<uint32_t> visible(3000);
+		const uint32_t visibleCount = CullBoxes(frustum, bounds, 0, 3000, visible.data(), ECullingPath::Scalar);
+
+		GpuCullConstants constants;
+		SetCullConstants(frustum, 3000, 3000, constants);
+		std::vector<GpuDrawCommand> commands(3000);
+		const uint32_t commandCount = CullAndCompact(constants, objects.data(), commands.data());
+
+		CHECK(commandCount == visibleCount);
+		for (uint32_t c = 0; c < commandCount && c < visibleCount; c++)
+		{
+			CHECK(MatchesObject(commands[c], objects[visible[c]]));
+		}
+	}
+}
+
+// Survivors past the capacity are counted but not written, and the commands
+// that are written are the first survivors.
+TEST(GpuCullingCountsPastCapacity)
+{
+	const std::vector<GpuCullObject> objects = MakeObjects(2000, 4, 30.0f);
+	Frustum frustum;
+	ExtractFrustum(MakeViewProjection({ 0.0f, 0.0f, -60.0f }, { 0.0f, 0.0f, 0.0f }), frustum);
+
+	GpuCullConstants constants;
+	SetCullConstants(frustum, 2000, 2000, constants);
+	std::vector<GpuDrawCommand> expected(2000);
+	const uint32_t survivorCount = CullAndCompact(constants, objects.data(), expected.data());
+	CHECK(survivorCount > 100);
+
+	const uint32_t capacity = survivorCount / 3;
+	SetCullConstants(frustum, 2000, capacity, constants);
+	std::vector<GpuDrawCommand> commands(capacity + 1);
+	memset(commands.data(), 0xcd, commands.size() * sizeof(GpuDrawCommand));
+	GpuDrawCommand sentinel;
+	memset(&sentinel, 0xcd, sizeof(sentinel));
+
+	CHECK(CullAndCompact(constants, objects.data(), commands.data()) == survivorCount);
+	CHECK(memcmp(commands.data(), expected.data(), capacity * sizeof(GpuDrawCommand)) == 0);
+	CHECK(memcmp(&commands[capacity], &sentinel, sizeof(sentinel)) == 0);
+
+	// No objects, or no room at all, writes nothing.
+	SetCullConstants(frustum, 0, capacity, constants);
+	CHECK(CullAndCompact(constants, objects.data(), commands.data()) == 0);
+	SetCullConstants(frustum, 2000, 0, constants);
+	CHECK(CullAndCompact(constants, objects.data(), &sentinel) == survivorCount);
+	CHECK(memcmp(&commands[capacity], &sentinel, sizeof(sentinel)) == 0);
+}
+
+// Like D3D, denormal inputs flush to zero: a point object behind a plane by only
+// a denormal distance stays visible, where unflushed math would cull it.
+TEST(GpuCullingFlushesDenormals)
+{
+	GpuCullConstants constants = {};
+	for (int p = 0; p < 6; p++)
+	{
+		constants.planes[p][p / 2] = p % 2 == 0 ? 1.0f : -1.0f;
+		constants.planes[p][3] = 10.0f;
+	}
+	constants.objectCount = 1;
+	constants.maxCommands = 1;
+
+	GpuCullObject object = MakeObjects(1, 1, 1.0f)[0];
+	object.centerX = object.centerY = object.centerZ = 0.0f;
+	object.extentX = object.extentY = object.extentZ = 0.0f;
+
+	GpuDrawCommand command;
+	CHECK(CullAndCompact(constants, &object, &command) == 1);
+	CHECK(MatchesObject(command, object));
+
+	constants.planes[0][0] = FLT_MIN / 4;
+	constants.planes[0][3] = -FLT_MIN / 4;
+	CHECK(CullAndCompact(constants, &object, &command) == 1);
+
+	// The smallest normal distance still culls.
+	constants.planes[0][3] = -FLT_MIN;
+	CHECK(CullAndCompact(constants, &object, &command) == 0);
+}
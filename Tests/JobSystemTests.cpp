@@ -0,0 +1,263 @@
+#include "TestFramework.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	uint32_t GetMaxBenchmarkWorkers()
+	{
+		return std::max(std::thread::hardware_concurrency(), 2u);
+	}
+
+	// A few hundred nanoseconds of arithmetic that the compiler cannot fold away.
+	uint64_t Work(uint32_t seed, uint32_t rounds)
+	{
+		uint64_t hash = seed;
+		for (uint32_t i = 0; i < rounds; i++)
+		{
+			hash ^= hash >> 31;
+			hash = hash * 0x9E3779B97F4A7C15ull + i;
+		}
+		return hash;
+	}
+
+	struct Tree
+	{
+		JobSystem* pJobSystem;
+		JobCounter* pCounter;
+		std::atomic<uint32_t>* pLeaves;
+	};
+
+	// Each job below depth 0 spawns two more, so jobs are submitted from every worker.
+	void Spawn(const Tree* pTree, uint32_t depth)
+	{
+		if (depth == 0)
+		{
+			pTree->pLeaves->fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			pTree->pJobSystem->Run(*pTree->pCounter, [pTree, depth] { Spawn(pTree, depth - 1); });
+		}
+	}
+}
+
+// Many more jobs than a worker's ring holds, each run exactly once.
+TEST(JobSystemRunsEveryJobOnce)
+{
+	const uint32_t JobCount = 50000;
+	for (uint32_t workerCount = 1; workerCount <= 4; workerCount++)
+	{
+		JobSystem jobSystem(workerCount);
+		std::unique_ptr<std::atomic<uint32_t>[]> runs(new std::atomic<uint32_t>[JobCount]);
+		for (uint32_t i = 0; i < JobCount; i++)
+		{
+			runs[i] = 0;
+		}
+
+		JobCounter counter;
+		std::atomic<uint32_t>* pRuns = runs.get();
+		for (uint32_t i = 0; i < JobCount; i++)
+		{
+			jobSystem.Run(counter, [pRuns, i] { pRuns[i].fetch_add(1, std::memory_order_relaxed); });
+		}
+		jobSystem.Wait(counter);
+
+		CHECK(counter.IsDone());
+		uint32_t wrongCount = 0;
+		for (uint32_t i = 0; i < JobCount; i++)
+		{
+			wrongCount += runs[i].load() != 1;
+		}
+		CHECK(wrongCount == 0);
+	}
+}
+
+// Jobs submitted from inside jobs are counted against the same counter.
+TEST(JobSystemWaitsForNestedJobs)
+{
+	const uint32_t Depth = 15;
+	JobSystem jobSystem(4);
+	JobCounter counter;
+	std::atomic<uint32_t> leaves(0);
+	const Tree tree = { &jobSystem, &counter, &leaves };
+	const Tree* pTree = &tree;
+	jobSystem.Run(counter, [pTree] { Spawn(pTree, Depth); });
+	jobSystem.Wait(counter);
+	CHECK(leaves.load() == 1u << Depth);
+}
+
+// A continuation starts only after every job of its dependency has finished.
+TEST(JobSystemRunAfterWaitsForItsDependency)
+{
+	const uint32_t JobCount = 1000;
+	JobSystem jobSystem(4);
+	for (uint32_t round = 0; round < 50; round++)
+	{
+		JobCounter first;
+		JobCounter second;
+		std::atomic<uint32_t> finished(0);
+		std::atomic<uint32_t> seenByContinuation(0);
+		std::atomic<uint32_t>* pFinished = &finished;
+		std::atomic<uint32_t>* pSeen = &seenByContinuation;
+
+		for (uint32_t i = 0; i < JobCount; i++)
+		{
+			// Work() never returns UINT64_MAX here; the comparison only keeps it from being optimized out.
+			jobSystem.Run(first, [pFinished, i] { pFinished->fetch_add(Work(i, 50) != UINT64_MAX, std::memory_order_relaxed); });
+		}
+		jobSystem.RunAfter(first, second, [pFinished, pSeen] { pSeen->store(pFinished->load()); });
+		jobSystem.Wait(second);
+
+		CHECK(seenByContinuation.load() == JobCount);
+	}
+
+	// A dependency that is already done runs the continuation straight away.
+	JobCounter done;
+	JobCounter after;
+	bool ran = false;
+	bool* pRan = &ran;
+	jobSystem.RunAfter(done, after, [pRan] { *pRan = true; });
+	jobSystem.Wait(after);
+	CHECK(ran);
+}
+
+// Every index is visited once, in ranges no larger than the grain size.
+TEST(JobSystemParallelForCoversTheRangeOnce)
+{
+	JobSystem jobSystem(4);
+	const uint32_t counts[] = { 1, 2, 7, 64, 1000, 4097, 100000 };
+	const uint32_t grainSizes[] = { 0, 1, 3, 64, 5000 };
+	for (uint32_t count : counts)
+	{
+		for (uint32_t grainSize : grainSizes)
+		{
+			std::vector<std::atomic<uint32_t>> visits(count);
+			for (std::atomic<uint32_t>& visit : visits)
+			{
+				visit = 0;
+			}
+			std::atomic<uint32_t> oversizedRanges(0);
+
+			jobSystem.ParallelFor(count, grainSize, [&](uint32_t begin, uint32_t end)
+			{
+				if (end - begin > std::max(grainSize, 1u) && end - begin != count)
+				{
+					oversizedRanges++;
+				}
+				for (uint32_t i = begin; i < end; i++)
+				{
+					visits[i].fetch_add(1, std::memory_order_relaxed);
+				}
+			});
+
+			CHECK(oversizedRanges.load() == 0);
+			CHECK(std::all_of(visits.begin(), visits.end(), [](const std::atomic<uint32_t>& visit) { return visit.load() == 1; }));
+		}
+	}
+}
+
+// Threads that are not workers run their jobs inline rather than queueing them.
+TEST(JobSystemRunsJobsFromOtherThreadsInline)
+{
+	JobSystem jobSystem(2);
+	bool inline_ = false;
+	std::thread thread([&]
+	{
+		JobCounter counter;
+		const std::thread::id id = std::this_thread::get_id();
+		const std::thread::id* pId = &id;
+		bool* pInline = &inline_;
+		jobSystem.Run(counter, [pId, pInline] { *pInline = std::this_thread::get_id() == *pId; });
+		*pInline = *pInline && counter.IsDone();
+	});
+	thread.join();
+	CHECK(inline_);
+}
+
+// Cost of submitting and running a job that does nothing, amortised over a batch.
+BENCHMARK(JobSystemEmptyJobOverhead)
+{
+	const uint32_t JobCount = 1000000;
+	for (uint32_t workerCount = 1; workerCount <= GetMaxBenchmarkWorkers(); workerCount *= 2)
+	{
+		JobSystem jobSystem(workerCount);
+		const Stopwatch stopwatch;
+		for (uint32_t batch = 0; batch < JobCount / 1000; batch++)
+		{
+			JobCounter counter;
+			for (uint32_t i = 0; i < 1000; i++)
+			{
+				jobSystem.Run(counter, [] {});
+			}
+			jobSystem.Wait(counter);
+		}
+		printf("  %u workers: %.1f ns per empty job\n", workerCount, stopwatch.GetSeconds() * 1e9 / JobCount);
+	}
+}
+
+// Time from fanning out 64 small jobs to the last one joining, as a frame's
+// systems do for each stage.
+BENCHMARK(JobSystemFanOutFanInLatency)
+{
+	const uint32_t RoundCount = 20000;
+	const uint32_t FanOut = 64;
+	for (uint32_t workerCount = 1; workerCount <= GetMaxBenchmarkWorkers(); workerCount *= 2)
+	{
+		JobSystem jobSystem(workerCount);
+		std::atomic<uint64_t> sink(0);
+		std::atomic<uint64_t>* pSink = &sink;
+
+		const Stopwatch stopwatch;
+		for (uint32_t round = 0; round < RoundCount; round++)
+		{
+			JobCounter counter;
+			for (uint32_t i = 0; i < FanOut; i++)
+			{
+				jobSystem.Run(counter, [pSink, i] { pSink->fetch_add(Work(i, 20), std::memory_order_relaxed); });
+			}
+			jobSystem.Wait(counter);
+		}
+		DoNotOptimize(sink.load());
+		printf("  %u workers: %.2f us per fan-out/fan-in of %u jobs\n", workerCount, stopwatch.GetSeconds() * 1e6 / RoundCount, FanOut);
+	}
+}
+
+// ParallelFor over compute-bound work for 1..N workers.
+BENCHMARK(JobSystemParallelForScaling)
+{
+	const uint32_t Count = 1 << 20;
+	std::vector<uint64_t> results(Count);
+	double singleWorkerMs = 0.0;
+	for (uint32_t workerCount = 1; workerCount <= GetMaxBenchmarkWorkers(); workerCount *= 2)
+	{
+		JobSystem jobSystem(workerCount);
+		const Stopwatch stopwatch;
+		for (uint32_t repeat = 0; repeat < 4; repeat++)
+		{
+			jobSystem.ParallelFor(Count, 4096, [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t i = begin; i < end; i++)
+				{
+					results[i] = Work(i + repeat, 32);
+				}
+			});
+		}
+		const double ms = stopwatch.GetMilliseconds() / 4;
+		DoNotOptimize(results[Count / 2]);
+
+		if (workerCount == 1)
+		{
+			singleWorkerMs = ms;
+		}
+		printf("  %u workers: %.2f ms for %u items, %.2fx\n", workerCount, ms, Count, singleWorkerMs / ms);
+	}
+}
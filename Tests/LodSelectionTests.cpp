@@ -0,0 +1,268 @@
+#include "TestFramework.h"
+#include "TestMath.h"
+#include "LodSelection.h"
+#include "FrustumCulling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+	const LodSettings Settings = { 1.0f, 0.25f, 8 };
+
+	LodChain MakeChain()
+	{
+		return { { 0.001f, 0.01f, 0.1f, 1.0f }, 4 };
+	}
+
+	// The engine's sphere: slices halve from 64 to 8, with half as many stacks,
+	// so a LOD has slices^2 triangles whose facets sit sin^2(pi / slices) inside.
+	LodChain MakeSphereChain(uint32_t* pTriangleCounts)
+	{
+		LodChain chain = {};
+		for (uint32_t slices = 64; slices >= 8; slices /= 2)
+		{
+			const float facet = std::sin(3.14159265f / slices);
+			pTriangleCounts[chain.lodCount] = slices * slices;
+			chain.geometricErrors[chain.lodCount++] = facet * facet;
+		}
+		return chain;
+	}
+
+	// The finest LOD a pixel error threshold allows, without hysteresis.
+	uint32_t ReferenceLod(const LodChain& chain, float errorScale, float maxPixelError)
+	{
+		uint32_t lod = 0;
+		while (lod + 1 < chain.lodCount && chain.geometricErrors[lod + 1] * errorScale <= maxPixelError)
+		{
+			lod++;
+		}
+		return lod;
+	}
+
+	// The pixel shader's 4x4 dither thresholds, and how many of the 16 pixels a
+	// LOD keeps for a given fade: its own share, or the rest for a negative fade.
+	const float DitherThresholds[16] =
+	{
+		0.5f / 16, 8.5f / 16, 2.5f / 16, 10.5f / 16,
+		12.5f / 16, 4.5f / 16, 14.5f / 16, 6.5f / 16,
+		3.5f / 16, 11.5f / 16, 1.5f / 16, 9.5f / 16,
+		15.5f / 16, 7.5f / 16, 13.5f / 16, 5.5f / 16,
+	};
+
+	uint32_t CountKeptPixels(float lodFade)
+	{
+		uint32_t count = 0;
+		for (float threshold : DitherThresholds)
+		{
+			count += (lodFade >= 0.0f ? lodFade - threshold : threshold + lodFade) >= 0.0f;
+		}
+		return count;
+	}
+}
+
+// Coming from the coarsest LOD, the pick is the coarsest LOD whose projected
+// error is under the threshold, and LOD 0 when none is.
+TEST(LodSelectionPicksTheCoarsestLodUnderTheThreshold)
+{
+	const LodChain chain = MakeChain();
+	CHECK(SelectLod(chain, 0.5f, 3, Settings) == 3);
+	CHECK(SelectLod(chain, 1.0f, 3, Settings) == 3);
+	CHECK(SelectLod(chain, 2.0f, 3, Settings) == 2);
+	CHECK(SelectLod(chain, 50.0f, 3, Settings) == 1);
+	CHECK(SelectLod(chain, 5000.0f, 3, Settings) == 0);
+
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> logScale(-1.0f, 5.0f);
+	for (uint32_t i = 0; i < 10000; i++)
+	{
+		const float errorScale = std::pow(10.0f, logScale(random));
+		CHECK(SelectLod(chain, errorScale, 3, Settings) == ReferenceLod(chain, errorScale, Settings.maxPixelError));
+	}
+}
+
+// A LOD whose error grew past the threshold is replaced by a finer one at once,
+// whatever the hysteresis.
+TEST(LodSelectionRefinesImmediately)
+{
+	const LodChain chain = MakeChain();
+	std::mt19937 random(2);
+	std::uniform_real_distribution<float> logScale(-1.0f, 5.0f);
+	for (uint32_t i = 0; i < 10000; i++)
+	{
+		const float errorScale = std::pow(10.0f, logScale(random));
+		const uint32_t lod = ReferenceLod(chain, errorScale, Settings.maxPixelError);
+		for (uint32_t currentLod = lod; currentLod < chain.lodCount; currentLod++)
+		{
+			CHECK(SelectLod(chain, errorScale, currentLod, Settings) == lod);
+		}
+	}
+}
+
+// Coarsening waits until the coarser LOD's error is under maxPixelError * (1 -
+// hysteresis). A distance jittering around a switch point changes the LOD on
+// about every other frame without hysteresis, and once with it.
+TEST(LodSelectionDoesNotCoarsenInsideTheHysteresisBand)
+{
+	const LodChain chain = MakeChain();
+	CHECK(SelectLod(chain, 8.0f, 1, Settings) == 1);
+	CHECK(SelectLod(chain, 7.0f, 1, Settings) == 2);
+	CHECK(SelectLod(chain, 0.8f, 1, Settings) == 2);
+	CHECK(SelectLod(chain, 0.7f, 1, Settings) == 3);
+
+	const LodSettings noHysteresis = { Settings.maxPixelError, 0.0f, 0 };
+	const LodSettings* settings[] = { &noHysteresis, &Settings };
+	uint32_t changeCounts[2];
+	for (uint32_t s = 0; s < 2; s++)
+	{
+		std::mt19937 random(3);
+		std::uniform_real_distribution<float> jitter(0.95f, 1.05f);
+		uint32_t lod = 0;
+		changeCounts[s] = 0;
+		for (uint32_t frame = 0; frame < 2000; frame++)
+		{
+			// LOD 2's error projects to one pixel, give or take 5%.
+			const uint32_t selected = SelectLod(chain, 10.0f * jitter(random), lod, *settings[s]);
+			changeCounts[s] += selected != lod;
+			lod = selected;
+		}
+	}
+	CHECK(changeCounts[0] > 500);
+	CHECK(changeCounts[1] == 1);
+}
+
+// A change crossfades over fadeFrames frames. The incoming LOD's share rises
+// within (0, 1], and with the outgoing LOD's complementary pattern every pixel
+// is drawn exactly once on every frame. It is 1 once the fade is over.
+TEST(LodSelectionFadeCoversEveryPixelOnce)
+{
+	LodState state = {};
+	CHECK(UpdateLodState(state, 2, 1, Settings) == 1.0f);
+	CHECK(state.lod == 2 && state.fadeFramesLeft == 0);
+
+	uint32_t frame = 2;
+	float previousFade = 0.0f;
+	for (uint32_t i = 0; i < Settings.fadeFrames; i++, frame++)
+	{
+		const float fade = UpdateLodState(state, 1, frame, Settings);
+		CHECK(state.lod == 1 && state.fadingLod == 2);
+		CHECK(fade > 0.0f && fade < 1.0f && fade > previousFade);
+		CHECK(CountKeptPixels(fade) + CountKeptPixels(-fade) == 16);
+		for (float threshold : DitherThresholds)
+		{
+			CHECK((fade - threshold >= 0.0f) != (threshold - fade >= 0.0f));
+		}
+		previousFade = fade;
+	}
+	CHECK(UpdateLodState(state, 1, frame, Settings) == 1.0f);
+	CHECK(state.lod == 1 && state.fadeFramesLeft == 0);
+}
+
+// A change requested during a crossfade waits for it to end, then starts a
+// crossfade of its own from the LOD the first one faded in.
+TEST(LodSelectionRequestsDuringAFadeWait)
+{
+	LodState state = {};
+	UpdateLodState(state, 3, 1, Settings);
+	UpdateLodState(state, 2, 2, Settings);
+	uint32_t frame = 3;
+	for (; state.fadeFramesLeft > 1; frame++)
+	{
+		CHECK(UpdateLodState(state, 1, frame, Settings) < 1.0f);
+		CHECK(state.lod == 2 && state.fadingLod == 3);
+	}
+
+	const float fade = UpdateLodState(state, 1, frame++, Settings);
+	CHECK(state.lod == 1 && state.fadingLod == 2);
+	CHECK(state.fadeFramesLeft == Settings.fadeFrames);
+	CHECK(fade > 0.0f && fade < 1.0f);
+}
+
+// An object that was not drawn in the previous frame switches without a fade,
+// even in the middle of one.
+TEST(LodSelectionFrameGapSnapsWithoutFading)
+{
+	LodState state = {};
+	UpdateLodState(state, 3, 1, Settings);
+	CHECK(UpdateLodState(state, 2, 2, Settings) < 1.0f);
+	CHECK(UpdateLodState(state, 2, 3, Settings) < 1.0f);
+
+	CHECK(UpdateLodState(state, 0, 5, Settings) == 1.0f);
+	CHECK(state.lod == 0 && state.fadeFramesLeft == 0);
+	CHECK(UpdateLodState(state, 0, 6, Settings) == 1.0f);
+
+	const LodSettings noFade = { Settings.maxPixelError, Settings.hysteresis, 0 };
+	CHECK(UpdateLodState(state, 3, 7, noFade) == 1.0f);
+	CHECK(state.lod == 3 && state.fadeFramesLeft == 0);
+}
+
+// Triangles submitted for the engine's benchmark scene, a grid of 100k small
+// spheres, as seen from its start position and from above, with every visible
+// sphere at LOD 0 and at the LOD the engine selects for a 720 pixel high view.
+BENCHMARK(LodSelectionSubmittedTriangles)
+{
+	uint32_t triangleCounts[MaxLodCount];
+	const LodChain chain = MakeSphereChain(triangleCounts);
+
+	const uint32_t ObjectCount = 100000;
+	const uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(ObjectCount))));
+	const float spacing = 0.4f;
+	const float scale = 0.1f;
+	const float radius = scale * std::sqrt(3.0f);
+	std::vector<float> centerX(ObjectCount), centerY(ObjectCount, 0.1f), centerZ(ObjectCount), radii(ObjectCount, radius);
+	for (uint32_t n = 0; n < ObjectCount; n++)
+	{
+		centerX[n] = (static_cast<float>(n % side) - 0.5f * side) * spacing;
+		centerZ[n] = (static_cast<float>(n / side) - 0.5f * side) * spacing;
+	}
+
+	const float fovY = 3.14159265f / 3;
+	const float nearPlane = 0.1f;
+	const float pixelsPerUnit = 720.0f / (2.0f * std::tan(fovY / 2));
+	const SceneMatrix projection = MakePerspective(fovY, 1280.0f / 720.0f, nearPlane, 100.0f);
+
+	struct View
+	{
+		const char* name;
+		SceneFloat3 eye;
+		SceneFloat3 target;
+	};
+	const View views[] =
+	{
+		{ "start", { 0.0f, 1.0f, -2.0f }, { 0.0f, 1.0f, -1.0f } },
+		{ "above", { 0.0f, 20.0f, -40.0f }, { 0.0f, 0.0f, 0.0f } },
+	};
+
+	std::vector<uint32_t> visible(ObjectCount);
+	for (const View& view : views)
+	{
+		Frustum frustum;
+		ExtractFrustum(MultiplyMatrices(MakeLookAt(view.eye, view.target, { 0.0f, 1.0f, 0.0f }), projection), frustum);
+		const uint32_t visibleCount = CullSpheres(frustum, centerX.data(), centerY.data(), centerZ.data(), radii.data(), 0, ObjectCount, visible.data(), GetBestCullingPath());
+
+		const Stopwatch stopwatch;
+		uint64_t trianglesWithLod = 0;
+		uint32_t lodObjects[MaxLodCount] = {};
+		for (uint32_t v = 0; v < visibleCount; v++)
+		{
+			const uint32_t i = visible[v];
+			const float dx = centerX[i] - view.eye.x;
+			const float dy = centerY[i] - view.eye.y;
+			const float dz = centerZ[i] - view.eye.z;
+			const float distance = std::max(std::sqrt(dx * dx + dy * dy + dz * dz) - radius, nearPlane);
+			const uint32_t lod = SelectLod(chain, scale * pixelsPerUnit / distance, chain.lodCount - 1, Settings);
+			trianglesWithLod += triangleCounts[lod];
+			lodObjects[lod]++;
+		}
+		const double selectMs = stopwatch.GetMilliseconds();
+		const uint64_t trianglesWithoutLod = static_cast<uint64_t>(visibleCount) * triangleCounts[0];
+
+		printf("  %s: %u visible, %.2f M triangles without LOD, %.2f M with LOD (%.1fx fewer), objects per LOD %u/%u/%u/%u, %.3f ms to select\n",
+			view.name, visibleCount, trianglesWithoutLod / 1e6, trianglesWithLod / 1e6,
+			trianglesWithLod > 0 ? static_cast<double>(trianglesWithoutLod) / static_cast<double>(trianglesWithLod) : 0.0,
+			lodObjects[0], lodObjects[1], lodObjects[2], lodObjects[3], selectMs);
+	}
+}
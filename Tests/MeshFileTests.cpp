@@ -0,0 +1,401 @@
+#include "TestFramework.h"
+#include "MeshFile.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const char* const TestPath = "MeshFileTest.mesh";
+
+	std::wstring Widen(const std::string& path)
+	{
+		return std::wstring(path.begin(), path.end());
+	}
+
+	// Removes the test's file when the test ends.
+	struct TemporaryFile
+	{
+		~TemporaryFile()
+		{
+			std::remove(TestPath);
+		}
+	};
+
+	std::vector<uint8_t> ReadBytes(const char* path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	void WriteBytes(const char* path, const std::vector<uint8_t>& bytes)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	}
+
+	// Mesh set contents, kept alive for the MeshFileDesc that points into them.
+	struct MeshSet
+	{
+		std::vector<uint8_t> fullVertices;
+		std::vector<uint8_t> packedVertices;
+		std::vector<uint8_t> indices;
+		std::vector<MeshFileMesh> meshes;
+		std::vector<MeshFileLod> lods;
+		std::vector<Meshlet> meshlets;
+		MeshFileDesc::Stream streams[2];
+		MeshFileDesc desc;
+
+		// Three meshes of one to three LODs over vertexCount vertices, the LODs split into meshlets.
+		MeshSet(uint32_t vertexCount, uint32_t indexSize, uint32_t trianglesPerLod, uint32_t seed)
+		{
+			std::mt19937 random(seed);
+			fullVertices.resize(static_cast<size_t>(vertexCount) * 48);
+			packedVertices.resize(static_cast<size_t>(vertexCount) * 20);
+			for (uint8_t& byte : fullVertices)
+			{
+				byte = static_cast<uint8_t>(random());
+			}
+			for (uint8_t& byte : packedVertices)
+			{
+				byte = static_cast<uint8_t>(random());
+			}
+
+			uint32_t indexCount = 0;
+			for (uint32_t mesh = 0; mesh < 3; mesh++)
+			{
+				MeshFileMesh meshDesc = { { mesh * 1.0f, 2.0f, 3.0f }, { 0.5f, 0.5f, 0.5f + mesh }, static_cast<uint32_t>(lods.size()), mesh + 1 };
+				meshes.push_back(meshDesc);
+				for (uint32_t lod = 0; lod <= mesh; lod++)
+				{
+					const uint32_t triangleCount = trianglesPerLod >> lod;
+					MeshFileLod lodDesc = { triangleCount * 3, indexCount, static_cast<int32_t>(mesh * vertexCount / 4), 0.01f * lod,
+						static_cast<uint32_t>(meshlets.size()), 0, { 0, 0 } };
+					for (uint32_t first = 0; first < triangleCount; first += MaxMeshletTriangles)
+					{
+						Meshlet meshlet = { { 1.0f, 2.0f, 3.0f }, 4.0f, { 0.0f, 0.0f, 1.0f }, 0.5f, 0.8f, first * 3,
+							std::min(MaxMeshletTriangles, triangleCount - first), 64 };
+						meshlets.push_back(meshlet);
+						lodDesc.meshletCount++;
+					}
+					lods.push_back(lodDesc);
+					indexCount += triangleCount * 3;
+				}
+			}
+
+			indices.resize(static_cast<size_t>(indexCount) * indexSize);
+			for (uint32_t i = 0; i < indexCount; i++)
+			{
+				const uint32_t index = random() % (vertexCount / 4);
+				memcpy(&indices[static_cast<size_t>(i) * indexSize], &index, indexSize);
+			}
+
+			streams[0] = { EMeshVertexLayout::PositionTexCoordNormalColor, 48, fullVertices.data() };
+			streams[1] = { EMeshVertexLayout::Packed, 20, packedVertices.data() };
+			desc.pStreams = streams;
+			desc.streamCount = 2;
+			desc.vertexCount = vertexCount;
+			desc.pIndices = indices.data();
+			desc.indexSize = indexSize;
+			desc.indexCount = indexCount;
+			desc.pMeshes = meshes.data();
+			desc.meshCount = static_cast<uint32_t>(meshes.size());
+			desc.pLods = lods.data();
+			desc.lodCount = static_cast<uint32_t>(lods.size());
+			desc.pMeshlets = meshlets.data();
+			desc.meshletCount = static_cast<uint32_t>(meshlets.size());
+			desc.sourceKey = 0x0123456789abcdefull + seed;
+		}
+	};
+
+	bool MatchesMeshSet(const MeshFile& file, const MeshSet& set)
+	{
+		const MeshFileDesc& desc = set.desc;
+		bool matches = file.GetVertexCount() == desc.vertexCount && file.GetIndexCount() == desc.indexCount && file.GetIndexSize() == desc.indexSize &&
+			file.GetSourceKey() == desc.sourceKey && file.GetStreamCount() == desc.streamCount && file.GetMeshCount() == desc.meshCount &&
+			file.GetMeshletCount() == desc.meshletCount;
+		matches = matches && memcmp(file.GetIndexData(), set.indices.data(), set.indices.size()) == 0;
+		for (uint32_t stream = 0; matches && stream < desc.streamCount; stream++)
+		{
+			const MeshFileStream& fileStream = file.GetStream(stream);
+			matches = fileStream.layout == desc.pStreams[stream].layout && fileStream.stride == desc.pStreams[stream].stride &&
+				fileStream.offset % MeshFileAlignment == 0 &&
+				memcmp(file.GetStreamData(stream), desc.pStreams[stream].pData, static_cast<size_t>(desc.vertexCount) * fileStream.stride) == 0;
+		}
+		for (uint32_t mesh = 0; matches && mesh < desc.meshCount; mesh++)
+		{
+			matches = memcmp(&file.GetMesh(mesh), &set.meshes[mesh], sizeof(MeshFileMesh)) == 0;
+		}
+		for (uint32_t lod = 0; matches && lod < desc.lodCount; lod++)
+		{
+			matches = memcmp(&file.GetLod(lod), &set.lods[lod], sizeof(MeshFileLod)) == 0;
+		}
+		return matches && memcmp(file.GetMeshlets(), set.meshlets.data(), set.meshlets.size() * sizeof(Meshlet)) == 0;
+	}
+}
+
+// What is written reads back byte for byte through the mapping, with both index
+// sizes, every section aligned and the file's size in its header.
+TEST(MeshFileRoundTrips)
+{
+	TemporaryFile temporary;
+	for (uint32_t indexSize : { 2u, 4u })
+	{
+		const MeshSet set(1000, indexSize, 300, indexSize);
+		CHECK(WriteMeshFile(Widen(TestPath), set.desc));
+
+		MeshFile file;
+		CHECK(file.Open(Widen(TestPath)));
+		CHECK(file.IsOpen() && MatchesMeshSet(file, set));
+		CHECK(file.GetFileSize() == ReadBytes(TestPath).size());
+		CHECK((static_cast<const uint8_t*>(file.GetIndexData()) - static_cast<const uint8_t*>(file.GetStreamData(0))) % MeshFileAlignment == 0);
+		CHECK(file.FindStream(EMeshVertexLayout::Packed, 20) == 1);
+		CHECK(file.FindStream(EMeshVertexLayout::PositionTexCoordNormalColor, 48) == 0);
+		CHECK(file.FindStream(EMeshVertexLayout::Packed, 48) == UINT32_MAX);
+		file.Close();
+		CHECK(!file.IsOpen());
+	}
+
+	// An empty set is still a valid file.
+	MeshSet set(4, 2, 3, 9);
+	set.desc.meshCount = 0;
+	set.desc.lodCount = 0;
+	set.desc.meshletCount = 0;
+	set.desc.indexCount = 0;
+	set.desc.vertexCount = 0;
+	CHECK(WriteMeshFile(Widen(TestPath), set.desc));
+	MeshFile file;
+	CHECK(file.Open(Widen(TestPath)) && file.GetMeshCount() == 0 && file.GetIndexCount() == 0);
+}
+
+// Inconsistent descriptions are refused instead of written.
+TEST(MeshFileWriteRejectsInconsistentDescs)
+{
+	TemporaryFile temporary;
+	const MeshSet set(1000, 2, 300, 1);
+	CHECK(WriteMeshFile(Widen(TestPath), set.desc));
+
+	std::vector<MeshFileDesc> descs;
+	MeshFileDesc desc = set.desc;
+	desc.indexSize = 3;
+	descs.push_back(desc);
+
+	std::vector<MeshFileMesh> meshes = set.meshes;
+	meshes[2].lodCount = 0;
+	std::vector<MeshFileMesh> meshesPastLods = set.meshes;
+	meshesPastLods[2].firstLod = set.desc.lodCount - 1;
+	std::vector<MeshFileLod> lodsPastIndices = set.lods;
+	lodsPastIndices.back().indexCount += 3;
+	std::vector<MeshFileLod> negativeBase = set.lods;
+	negativeBase[1].baseVertex = -1;
+	std::vector<MeshFileLod> basePastVertices = set.lods;
+	basePastVertices[1].baseVertex = 1001;
+	std::vector<MeshFileLod> lodsPastMeshlets = set.lods;
+	lodsPastMeshlets.back().meshletCount++;
+	std::vector<Meshlet> emptyMeshlet = set.meshlets;
+	emptyMeshlet[0].triangleCount = 0;
+	std::vector<Meshlet> meshletPastLod = set.meshlets;
+	meshletPastLod[0].startIndex = set.lods[0].indexCount - 3 * meshletPastLod[0].triangleCount + 3;
+
+	for (const std::vector<MeshFileMesh>* pMeshes : { &meshes, &meshesPastLods })
+	{
+		desc = set.desc;
+		desc.pMeshes = pMeshes->data();
+		descs.push_back(desc);
+	}
+	for (const std::vector<MeshFileLod>* pLods : { &lodsPastIndices, &negativeBase, &basePastVertices, &lodsPastMeshlets })
+	{
+		desc = set.desc;
+		desc.pLods = pLods->data();
+		descs.push_back(desc);
+	}
+	for (const std::vector<Meshlet>* pMeshlets : { &emptyMeshlet, &meshletPastLod })
+	{
+		desc = set.desc;
+		desc.pMeshlets = pMeshlets->data();
+		descs.push_back(desc);
+	}
+
+	for (const MeshFileDesc& invalid : descs)
+	{
+		CHECK(!WriteMeshFile(Widen(TestPath), invalid));
+	}
+}
+
+// Missing, truncated, padded and corrupted files fail to open, and a file with
+// random bytes flipped in its tables either fails or keeps every range in bounds.
+TEST(MeshFileOpenRejectsMalformedFiles)
+{
+	TemporaryFile temporary;
+	MeshFile file;
+	CHECK(!file.Open(L"MeshFileTestMissing.mesh"));
+
+	const MeshSet set(500, 4, 200, 2);
+	CHECK(WriteMeshFile(Widen(TestPath), set.desc));
+	const std::vector<uint8_t> valid = ReadBytes(TestPath);
+	CHECK(file.Open(Widen(TestPath)));
+	file.Close();
+
+	const auto OpensWith = [&file](const std::vector<uint8_t>& bytes)
+	{
+		WriteBytes(TestPath, bytes);
+		const bool opened = file.Open(Widen(TestPath));
+		file.Close();
+		return opened;
+	};
+
+	for (size_t size : { size_t(0), sizeof(MeshFileHeader) - 1, sizeof(MeshFileHeader), valid.size() / 2, valid.size() - 1 })
+	{
+		CHECK(!OpensWith(std::vector<uint8_t>(valid.begin(), valid.begin() + size)));
+	}
+	std::vector<uint8_t> bytes = valid;
+	bytes.push_back(0);
+	CHECK(!OpensWith(bytes));
+
+	// Header fields, then the first stream's offset and the first LOD's range.
+	const size_t streamsOffset = sizeof(MeshFileHeader);
+	const size_t lodsOffset = streamsOffset + 2 * sizeof(MeshFileStream) + 3 * sizeof(MeshFileMesh);
+	const struct
+	{
+		size_t offset;
+		uint64_t value;
+		uint32_t size;
+	} corruptions[] =
+	{
+		{ offsetof(MeshFileHeader, magic), 0x4853454E, 4 },
+		{ offsetof(MeshFileHeader, version), MeshFileVersion + 1, 4 },
+		{ offsetof(MeshFileHeader, streamCount), 100000, 4 },
+		{ offsetof(MeshFileHeader, lodCount), 0xffffffff, 4 },
+		{ offsetof(MeshFileHeader, vertexCount), 0x10000000, 4 },
+		{ offsetof(MeshFileHeader, indexCount), 0x40000000, 4 },
+		{ offsetof(MeshFileHeader, indexSize), 1, 4 },
+		{ offsetof(MeshFileHeader, indexOffset), 8, 8 },
+		{ offsetof(MeshFileHeader, meshletCount), 0x10000000, 4 },
+		{ streamsOffset + offsetof(MeshFileStream, stride), 0, 4 },
+		{ streamsOffset + offsetof(MeshFileStream, offset), 16, 8 },
+		{ streamsOffset + offsetof(MeshFileStream, offset), valid.size() / MeshFileAlignment * MeshFileAlignment, 8 },
+		{ lodsOffset + offsetof(MeshFileLod, startIndex), 0xfffffff0, 4 },
+		{ lodsOffset + offsetof(MeshFileLod, meshletCount), 1000, 4 },
+	};
+	for (const auto& corruption : corruptions)
+	{
+		bytes = valid;
+		memcpy(&bytes[corruption.offset], &corruption.value, corruption.size);
+		CHECK(!OpensWith(bytes));
+	}
+
+	std::mt19937 random(5);
+	const size_t tablesSize = lodsOffset + set.lods.size() * sizeof(MeshFileLod) + set.meshlets.size() * sizeof(Meshlet);
+	for (uint32_t trial = 0; trial < 300; trial++)
+	{
+		bytes = valid;
+		for (uint32_t flip = 0; flip < 1 + trial % 4; flip++)
+		{
+			bytes[random() % tablesSize] ^= static_cast<uint8_t>(1u << (random() % 8));
+		}
+		WriteBytes(TestPath, bytes);
+		if (!file.Open(Widen(TestPath)))
+		{
+			continue;
+		}
+
+		const uint64_t size = bytes.size();
+		const uint8_t* pBegin = static_cast<const uint8_t*>(file.GetStreamData(0)) - file.GetStream(0).offset;
+		bool inBounds = static_cast<const uint8_t*>(file.GetIndexData()) - pBegin + static_cast<uint64_t>(file.GetIndexCount()) * file.GetIndexSize() <= size;
+		for (uint32_t stream = 0; stream < file.GetStreamCount(); stream++)
+		{
+			inBounds = inBounds && file.GetStream(stream).offset + static_cast<uint64_t>(file.GetVertexCount()) * file.GetStream(stream).stride <= size;
+		}
+		for (uint32_t mesh = 0; mesh < file.GetMeshCount(); mesh++)
+		{
+			const MeshFileMesh& meshDesc = file.GetMesh(mesh);
+			for (uint32_t lod = meshDesc.firstLod; lod < meshDesc.firstLod + meshDesc.lodCount; lod++)
+			{
+				const MeshFileLod& lodDesc = file.GetLod(lod);
+				inBounds = inBounds && static_cast<uint64_t>(lodDesc.startIndex) + lodDesc.indexCount <= file.GetIndexCount() &&
+					static_cast<uint64_t>(lodDesc.firstMeshlet) + lodDesc.meshletCount <= file.GetMeshletCount();
+				for (uint32_t m = lodDesc.firstMeshlet; inBounds && m < lodDesc.firstMeshlet + lodDesc.meshletCount; m++)
+				{
+					inBounds = static_cast<uint64_t>(file.GetMeshlets()[m].startIndex) + 3 * file.GetMeshlets()[m].triangleCount <= lodDesc.indexCount;
+				}
+			}
+		}
+		CHECK(inBounds);
+		file.Close();
+	}
+}
+
+// Loading a 70 MB mesh file and reading all of its vertex and index data once:
+// mapped and used in place, against read into memory and parsed into separate
+// vertex and index arrays. Both run from the page cache.
+BENCHMARK(MeshFileMappedVsReadLoad)
+{
+	TemporaryFile temporary;
+	const MeshSet set(800000, 4, 1 << 18, 3);
+	CHECK(WriteMeshFile(Widen(TestPath), set.desc));
+	const uint64_t fileSize = ReadBytes(TestPath).size();
+
+	const auto Checksum = [](const void* pData, uint64_t size)
+	{
+		uint64_t sum = 0;
+		const uint64_t* pWords = static_cast<const uint64_t*>(pData);
+		for (uint64_t i = 0; i < size / 8; i++)
+		{
+			sum += pWords[i];
+		}
+		return sum;
+	};
+
+	const uint32_t Repeats = 10;
+	double mappedMs = 0.0;
+	double readMs = 0.0;
+	uint64_t mappedSum = 0;
+	uint64_t readSum = 0;
+	for (uint32_t r = 0; r < Repeats; r++)
+	{
+		Stopwatch stopwatch;
+		MeshFile file;
+		file.Open(Widen(TestPath));
+		for (uint32_t stream = 0; stream < file.GetStreamCount(); stream++)
+		{
+			mappedSum += Checksum(file.GetStreamData(stream), static_cast<uint64_t>(file.GetVertexCount()) * file.GetStream(stream).stride);
+		}
+		mappedSum += Checksum(file.GetIndexData(), static_cast<uint64_t>(file.GetIndexCount()) * file.GetIndexSize());
+		file.Close();
+		mappedMs += stopwatch.GetMilliseconds();
+
+		stopwatch.Restart();
+		FILE* pFile = fopen(TestPath, "rb");
+		std::vector<uint8_t> bytes(static_cast<size_t>(fileSize));
+		const size_t readSize = fread(bytes.data(), 1, bytes.size(), pFile);
+		fclose(pFile);
+		MeshFileHeader header;
+		memcpy(&header, bytes.data(), sizeof(header));
+		std::vector<std::vector<uint8_t>> streams(header.streamCount);
+		for (uint32_t stream = 0; stream < header.streamCount && readSize == fileSize; stream++)
+		{
+			MeshFileStream streamDesc;
+			memcpy(&streamDesc, &bytes[sizeof(header) + stream * sizeof(MeshFileStream)], sizeof(streamDesc));
+			const uint8_t* pData = &bytes[static_cast<size_t>(streamDesc.offset)];
+			streams[stream].assign(pData, pData + static_cast<size_t>(header.vertexCount) * streamDesc.stride);
+			readSum += Checksum(streams[stream].data(), streams[stream].size());
+		}
+		const uint8_t* pIndices = &bytes[static_cast<size_t>(header.indexOffset)];
+		const std::vector<uint8_t> indices(pIndices, pIndices + static_cast<size_t>(header.indexCount) * header.indexSize);
+		readSum += Checksum(indices.data(), indices.size());
+		readMs += stopwatch.GetMilliseconds();
+	}
+	CHECK(mappedSum == readSum);
+	DoNotOptimize(mappedSum + readSum);
+
+	const double megabytes = fileSize / (1024.0 * 1024.0);
+	printf("  %.1f MB: mapped %.2f ms (%.0f MB/s), read and parsed %.2f ms (%.0f MB/s)\n", megabytes,
+		mappedMs / Repeats, megabytes * 1000.0 * Repeats / mappedMs, readMs / Repeats, megabytes * 1000.0 * Repeats / readMs);
+}
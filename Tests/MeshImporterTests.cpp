@@ -0,0 +1,464 @@
+#include "TestFramework.h"
+#include "MeshImporter.h"
+#include "MeshFile.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	const char* const ObjPath = "MeshImporterTest.obj";
+	const char* const GltfPath = "MeshImporterTest.gltf";
+	const char* const EmbeddedGltfPath = "MeshImporterTestEmbedded.gltf";
+	const char* const BinPath = "MeshImporterTest.bin";
+	const char* const GlbPath = "MeshImporterTest.glb";
+	const char* const CachePath = "MeshImporterTest.mesh";
+
+	std::wstring Widen(const std::string& path)
+	{
+		return std::wstring(path.begin(), path.end());
+	}
+
+	// Removes the test's files when the test ends.
+	struct TemporaryFiles
+	{
+		~TemporaryFiles()
+		{
+			const char* const paths[] = { ObjPath, GltfPath, EmbeddedGltfPath, BinPath, GlbPath, CachePath };
+			for (const char* path : paths)
+			{
+				std::remove(path);
+			}
+		}
+	};
+
+	void WriteText(const char* path, const std::string& text)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(text.data(), text.size());
+	}
+
+	std::string EncodeBase64(const std::vector<uint8_t>& data)
+	{
+		const char* const digits = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+		std::string text;
+		for (size_t i = 0; i < data.size(); i += 3)
+		{
+			const uint32_t bits = (data[i] << 16) | (i + 1 < data.size() ? data[i + 1] << 8 : 0) | (i + 2 < data.size() ? data[i + 2] : 0);
+			text += digits[bits >> 18];
+			text += digits[(bits >> 12) & 63];
+			text += i + 1 < data.size() ? digits[(bits >> 6) & 63] : '=';
+			text += i + 2 < data.size() ? digits[bits & 63] : '=';
+		}
+		return text;
+	}
+
+	// A height field of size x size quads, two triangles each, sharing its
+	// vertices. Every value is a short binary fraction, so that the OBJ text
+	// parses back to exactly the floats the glTF buffers hold.
+	struct Terrain
+	{
+		uint32_t size;
+		std::vector<float> positions;
+		std::vector<float> normals;
+		std::vector<float> texCoords;
+		std::vector<uint32_t> indices;
+
+		explicit Terrain(uint32_t size) :
+			size(size)
+		{
+			for (uint32_t z = 0; z <= size; z++)
+			{
+				for (uint32_t x = 0; x <= size; x++)
+				{
+					const float height = static_cast<float>((x * 7 + z * 3) % 11);
+					const float position[3] = { x / 16.0f, height / 16.0f, z / 16.0f };
+					const float normal[3] = { height / 32.0f, 1.0f, -0.25f };
+					const float texCoord[2] = { x / 1024.0f, z / 1024.0f };
+					positions.insert(positions.end(), position, position + 3);
+					normals.insert(normals.end(), normal, normal + 3);
+					texCoords.insert(texCoords.end(), texCoord, texCoord + 2);
+				}
+			}
+			for (uint32_t z = 0; z < size; z++)
+			{
+				for (uint32_t x = 0; x < size; x++)
+				{
+					const uint32_t corner = z * (size + 1) + x;
+					const uint32_t quad[6] = { corner, corner + size + 1, corner + 1, corner + 1, corner + size + 1, corner + size + 2 };
+					indices.insert(indices.end(), quad, quad + 6);
+				}
+			}
+		}
+
+		uint32_t GetVertexCount() const { return (size + 1) * (size + 1); }
+
+		void WriteObj(const char* path) const
+		{
+			FILE* pFile = fopen(path, "wb");
+			fprintf(pFile, "# terrain\no terrain\n");
+			for (uint32_t i = 0; i < GetVertexCount(); i++)
+			{
+				fprintf(pFile, "v %.9g %.9g %.9g\n", positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2]);
+			}
+			for (uint32_t i = 0; i < GetVertexCount(); i++)
+			{
+				fprintf(pFile, "vt %.9g %.9g\n", texCoords[i * 2], 1.0f - texCoords[i * 2 + 1]);
+			}
+			for (uint32_t i = 0; i < GetVertexCount(); i++)
+			{
+				fprintf(pFile, "vn %.9g %.9g %.9g\n", normals[i * 3], normals[i * 3 + 1], normals[i * 3 + 2]);
+			}
+			fprintf(pFile, "g terrain\ns off\n");
+			for (size_t i = 0; i < indices.size(); i += 3)
+			{
+				const uint32_t a = indices[i] + 1;
+				const uint32_t b = indices[i + 1] + 1;
+				const uint32_t c = indices[i + 2] + 1;
+				fprintf(pFile, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c);
+			}
+			fclose(pFile);
+		}
+
+		// Positions, normals, texture coordinates and then indices.
+		std::vector<uint8_t> GetBuffer() const
+		{
+			std::vector<uint8_t> buffer;
+			const uint8_t* const pArrays[] = { reinterpret_cast<const uint8_t*>(positions.data()), reinterpret_cast<const uint8_t*>(normals.data()),
+				reinterpret_cast<const uint8_t*>(texCoords.data()), reinterpret_cast<const uint8_t*>(indices.data()) };
+			const size_t sizes[] = { positions.size() * 4, normals.size() * 4, texCoords.size() * 4, indices.size() * 4 };
+			for (uint32_t i = 0; i < 4; i++)
+			{
+				buffer.insert(buffer.end(), pArrays[i], pArrays[i] + sizes[i]);
+			}
+			return buffer;
+		}
+
+		// The glTF document, with uri as the buffer's "uri" or, if empty, none for a GLB.
+		std::string GetGltfJson(const std::string& uri) const
+		{
+			const size_t vertexCount = GetVertexCount();
+			const size_t indexOffset = vertexCount * 32;
+			const size_t byteLength = indexOffset + indices.size() * 4;
+			std::string json = "{\"asset\":{\"version\":\"2.0\"},\"buffers\":[{\"byteLength\":" + std::to_string(byteLength);
+			json += uri.empty() ? "}]," : ",\"uri\":\"" + uri + "\"}],";
+			json += "\"bufferViews\":[";
+			json += "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":" + std::to_string(vertexCount * 12) + "},";
+			json += "{\"buffer\":0,\"byteOffset\":" + std::to_string(vertexCount * 12) + ",\"byteLength\":" + std::to_string(vertexCount * 12) + "},";
+			json += "{\"buffer\":0,\"byteOffset\":" + std::to_string(vertexCount * 24) + ",\"byteLength\":" + std::to_string(vertexCount * 8) + "},";
+			json += "{\"buffer\":0,\"byteOffset\":" + std::to_string(indexOffset) + ",\"byteLength\":" + std::to_string(indices.size() * 4) + "}],";
+			json += "\"accessors\":[";
+			json += "{\"bufferView\":0,\"componentType\":5126,\"count\":" + std::to_string(vertexCount) + ",\"type\":\"VEC3\"},";
+			json += "{\"bufferView\":1,\"componentType\":5126,\"count\":" + std::to_string(vertexCount) + ",\"type\":\"VEC3\"},";
+			json += "{\"bufferView\":2,\"componentType\":5126,\"count\":" + std::to_string(vertexCount) + ",\"type\":\"VEC2\"},";
+			json += "{\"bufferView\":3,\"componentType\":5125,\"count\":" + std::to_string(indices.size()) + ",\"type\":\"SCALAR\"}],";
+			json += "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2},\"indices\":3}]}]}";
+			return json;
+		}
+
+		void WriteGltf(const char* path, const char* binPath) const
+		{
+			WriteText(path, GetGltfJson(binPath));
+			const std::vector<uint8_t> buffer = GetBuffer();
+			WriteText(binPath, std::string(buffer.begin(), buffer.end()));
+		}
+
+		void WriteEmbeddedGltf(const char* path) const
+		{
+			WriteText(path, GetGltfJson("data:application/octet-stream;base64," + EncodeBase64(GetBuffer())));
+		}
+
+		void WriteGlb(const char* path) const
+		{
+			std::string json = GetGltfJson("");
+			json.resize((json.size() + 3) & ~size_t(3), ' ');
+			std::vector<uint8_t> buffer = GetBuffer();
+			buffer.resize((buffer.size() + 3) & ~size_t(3), 0);
+
+			const uint32_t header[5] = { 0x46546c67, 2, static_cast<uint32_t>(20 + json.size() + 8 + buffer.size()), static_cast<uint32_t>(json.size()), 0x4e4f534a };
+			const uint32_t binaryHeader[2] = { static_cast<uint32_t>(buffer.size()), 0x004e4942 };
+			std::string glb(reinterpret_cast<const char*>(header), sizeof(header));
+			glb += json;
+			glb.append(reinterpret_cast<const char*>(binaryHeader), sizeof(binaryHeader));
+			glb.append(buffer.begin(), buffer.end());
+			WriteText(path, glb);
+		}
+	};
+
+	bool Matches(const ImportedMesh& a, const ImportedMesh& b)
+	{
+		return a.vertices.size() == b.vertices.size() && a.indices == b.indices &&
+			memcmp(a.vertices.data(), b.vertices.data(), a.vertices.size() * sizeof(MeshImportVertex)) == 0 &&
+			memcmp(a.boundsCenter, b.boundsCenter, sizeof(a.boundsCenter)) == 0 && memcmp(a.boundsExtents, b.boundsExtents, sizeof(a.boundsExtents)) == 0;
+	}
+
+	void Subtract(const float* a, const float* b, float* result)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			result[i] = a[i] - b[i];
+		}
+	}
+
+	float Dot(const float* a, const float* b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+}
+
+// A cube of quads with negative indices and no normals, centered on z = 2, is
+// mirrored to z = -2 with its winding reversed: every triangle still faces
+// outwards, and gets its face's normal, splitting the corners into 24 vertices.
+TEST(MeshImporterConvertsObjToEngineSpace)
+{
+	TemporaryFiles files;
+	WriteText(ObjPath,
+		"v -1 -1 1\nv 1 -1 1\nv 1 1 1\nv -1 1 1\nv -1 -1 3\nv 1 -1 3\nv 1 1 3\nv -1 1 3\n"
+		"f -5 -6 -7 -8\nf 6 7 8 5\nf 2 6 5 1\nf 3 7 6 2\nf 4 8 7 3\nf 8 4 1 5\n");
+	MeshImporter importer;
+	ImportedMesh mesh;
+	CHECK(importer.Import(Widen(ObjPath), mesh));
+	CHECK(mesh.indices.size() == 36);
+	CHECK(mesh.vertices.size() == 24);
+	CHECK(mesh.boundsCenter[0] == 0.0f && mesh.boundsCenter[1] == 0.0f && mesh.boundsCenter[2] == -2.0f);
+	CHECK(mesh.boundsExtents[0] == 1.0f && mesh.boundsExtents[1] == 1.0f && mesh.boundsExtents[2] == 1.0f);
+
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		const MeshImportVertex& v0 = mesh.vertices[mesh.indices[i]];
+		const MeshImportVertex& v1 = mesh.vertices[mesh.indices[i + 1]];
+		const MeshImportVertex& v2 = mesh.vertices[mesh.indices[i + 2]];
+		float edge1[3], edge2[3], outwards[3];
+		Subtract(v1.position, v0.position, edge1);
+		Subtract(v2.position, v0.position, edge2);
+		Subtract(v0.position, mesh.boundsCenter, outwards);
+		const float cross[3] = { edge1[1] * edge2[2] - edge1[2] * edge2[1], edge1[2] * edge2[0] - edge1[0] * edge2[2], edge1[0] * edge2[1] - edge1[1] * edge2[0] };
+		CHECK(Dot(cross, outwards) > 0.0f);
+		CHECK(Dot(v0.normal, outwards) == 1.0f && Dot(v0.normal, v0.normal) == 1.0f);
+		CHECK(v0.color[0] == 1.0f && v0.color[1] == 1.0f && v0.color[2] == 1.0f && v0.color[3] == 1.0f);
+	}
+}
+
+// The same terrain as OBJ, as glTF with an external and with an embedded
+// buffer, and as GLB imports to the same welded mesh.
+TEST(MeshImporterMatchesAcrossFormats)
+{
+	TemporaryFiles files;
+	const Terrain terrain(24);
+	terrain.WriteObj(ObjPath);
+	terrain.WriteGltf(GltfPath, BinPath);
+	terrain.WriteEmbeddedGltf(EmbeddedGltfPath);
+	terrain.WriteGlb(GlbPath);
+
+	MeshImporter importer;
+	ImportedMesh obj;
+	CHECK(importer.Import(Widen(ObjPath), obj));
+	CHECK(obj.vertices.size() == terrain.GetVertexCount());
+	CHECK(obj.indices.size() == terrain.indices.size());
+	CHECK(obj.vertices[0].position[2] == -terrain.positions[2]);
+
+	const char* const paths[] = { GltfPath, EmbeddedGltfPath, GlbPath };
+	for (const char* path : paths)
+	{
+		ImportedMesh gltf;
+		CHECK(importer.Import(Widen(path), gltf));
+		CHECK(Matches(gltf, obj));
+	}
+}
+
+// An OBJ spanning many parse chunks, and a GLB, import identically with no job
+// system and across one and four workers.
+TEST(MeshImporterIsIndependentOfThreadCount)
+{
+	TemporaryFiles files;
+	const Terrain terrain(200);
+	terrain.WriteObj(ObjPath);
+	terrain.WriteGlb(GlbPath);
+
+	MeshImporter serialImporter;
+	ImportedMesh obj;
+	ImportedMesh glb;
+	CHECK(serialImporter.Import(Widen(ObjPath), obj));
+	CHECK(serialImporter.Import(Widen(GlbPath), glb));
+	CHECK(obj.vertices.size() == terrain.GetVertexCount());
+
+	const uint32_t workerCounts[] = { 1, 4 };
+	for (uint32_t workerCount : workerCounts)
+	{
+		JobSystem jobSystem(workerCount);
+		MeshImporter importer(&jobSystem);
+		ImportedMesh mesh;
+		CHECK(importer.Import(Widen(ObjPath), mesh));
+		CHECK(Matches(mesh, obj));
+		CHECK(importer.Import(Widen(GlbPath), mesh));
+		CHECK(Matches(mesh, glb));
+	}
+}
+
+// Cooking writes one mesh per source, and cooking again reuses the file until a
+// source, or a buffer a glTF file references, changes.
+TEST(MeshImporterReusesTheCookedCache)
+{
+	TemporaryFiles files;
+	const Terrain terrain(16);
+	terrain.WriteObj(ObjPath);
+	terrain.WriteGltf(GltfPath, BinPath);
+	const std::vector<std::wstring> sources = { Widen(ObjPath), Widen(GltfPath) };
+
+	JobSystem jobSystem(2);
+	MeshImporter importer(&jobSystem);
+	CHECK(importer.Cook(sources, Widen(CachePath)));
+	CHECK(!importer.GetStats().cacheHit);
+	CHECK(importer.GetStats().meshCount == 2);
+	CHECK(importer.GetStats().triangleCount == terrain.indices.size() * 2 / 3);
+	CHECK(importer.GetStats().meshletCount > 0);
+	{
+		MeshFile file;
+		CHECK(file.Open(Widen(CachePath)));
+		CHECK(file.GetMeshCount() == 2);
+		CHECK(file.GetVertexCount() == terrain.GetVertexCount() * 2);
+		CHECK(file.GetIndexSize() == 2);
+		CHECK(file.GetSourceKey() == MeshImporter::ComputeSourceKey(sources));
+	}
+
+	CHECK(importer.Cook(sources, Widen(CachePath)));
+	CHECK(importer.GetStats().cacheHit);
+	CHECK(importer.GetStats().meshCount == 2);
+
+	// Padding the buffer file changes its size, and so the key.
+	std::vector<uint8_t> buffer = terrain.GetBuffer();
+	buffer.resize(buffer.size() + 4, 0);
+	WriteText(BinPath, std::string(buffer.begin(), buffer.end()));
+	CHECK(importer.Cook(sources, Widen(CachePath)));
+	CHECK(!importer.GetStats().cacheHit);
+	CHECK(importer.Cook(sources, Widen(CachePath)));
+	CHECK(importer.GetStats().cacheHit);
+}
+
+// Malformed sources fail with a message naming the file, and so does a cook of them.
+TEST(MeshImporterRejectsMalformedSources)
+{
+	TemporaryFiles files;
+	MeshImporter importer;
+	ImportedMesh mesh;
+	const char* const objs[] =
+	{
+		"v 1 2 3\nv 1 2 3\nv 1 2 3\nf 1 2 4\n",     // Index out of range.
+		"v 1 2 3\nv 1 2 3\nv 1 2 3\nf 1 2 x\n",     // Malformed face.
+		"v 1 2 3\nv 1 2 3\nv 1 2 3\n",               // No faces.
+	};
+	for (const char* obj : objs)
+	{
+		WriteText(ObjPath, obj);
+		CHECK(!importer.Import(Widen(ObjPath), mesh));
+		CHECK(importer.GetError().find(ObjPath) != std::string::npos);
+	}
+
+	// An accessor reaching past its buffer view, a missing buffer file and a truncated GLB.
+	WriteText(GltfPath, "{\"asset\":{},\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0}}]}],"
+		"\"accessors\":[{\"bufferView\":0,\"componentType\":5126,\"count\":30,\"type\":\"VEC3\"}],\"bufferViews\":[{\"buffer\":0,\"byteLength\":12}],"
+		"\"buffers\":[{\"byteLength\":12,\"uri\":\"data:;base64,AAAAAAAAAAAAAAAA\"}]}");
+	CHECK(!importer.Import(Widen(GltfPath), mesh));
+
+	// Indices, counts and byte sizes that are negative, fractional or beyond their type.
+	const std::string triangle = "{\"asset\":{},\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0}}]}],"
+		"\"accessors\":[{\"bufferView\":0,\"byteOffset\":0,\"componentType\":5126,\"count\":3,\"type\":\"VEC3\"}],"
+		"\"bufferViews\":[{\"buffer\":0,\"byteOffset\":0,\"byteLength\":36,\"byteStride\":12}],"
+		"\"buffers\":[{\"byteLength\":36,\"uri\":\"data:;base64," + std::string(48, 'A') + "\"}]}";
+	WriteText(GltfPath, triangle);
+	CHECK(importer.Import(Widen(GltfPath), mesh));
+	const char* const badNumbers[][2] =
+	{
+		{ "\"count\":3", "\"count\":2.5" },
+		{ "\"count\":3", "\"count\":4294967299" },
+		{ "\"byteStride\":12", "\"byteStride\":-4294967284" },
+		{ "\"byteStride\":12", "\"byteStride\":12.5" },
+		{ "\"byteOffset\":0,\"byteLength\"", "\"byteOffset\":-0.5,\"byteLength\"" },
+		{ "\"byteOffset\":0,\"componentType\"", "\"byteOffset\":1e300,\"componentType\"" },
+		{ "\"byteLength\":36,\"byteStride\"", "\"byteLength\":-1,\"byteStride\"" },
+		{ "\"byteLength\":36,\"uri\"", "\"byteLength\":1e400,\"uri\"" },
+		{ "\"buffer\":0", "\"buffer\":0.5" },
+		{ "\"bufferView\":0", "\"bufferView\":-0.5" },
+		{ "\"componentType\":5126", "\"componentType\":4294972422" },
+	};
+	for (const auto& badNumber : badNumbers)
+	{
+		std::string json = triangle;
+		json.replace(json.find(badNumber[0]), strlen(badNumber[0]), badNumber[1]);
+		WriteText(GltfPath, json);
+		CHECK(!importer.Import(Widen(GltfPath), mesh));
+	}
+
+	const Terrain terrain(4);
+	WriteText(GltfPath, terrain.GetGltfJson("MeshImporterTestMissing.bin"));
+	CHECK(!importer.Import(Widen(GltfPath), mesh));
+	terrain.WriteGlb(GlbPath);
+	CHECK(importer.Import(Widen(GlbPath), mesh));
+	std::ifstream glbFile(GlbPath, std::ios::binary);
+	std::string glb((std::istreambuf_iterator<char>(glbFile)), std::istreambuf_iterator<char>());
+	glbFile.close();
+	WriteText(GlbPath, glb.substr(0, glb.size() / 2));
+	CHECK(!importer.Import(Widen(GlbPath), mesh));
+
+	CHECK(!importer.Import(L"MeshImporterTestMissing.obj", mesh));
+	CHECK(!importer.Import(Widen(CachePath), mesh));
+
+	terrain.WriteObj(ObjPath);
+	const std::vector<std::wstring> sources = { Widen(ObjPath), Widen(GlbPath) };
+	CHECK(!importer.Cook(sources, Widen(CachePath)));
+	CHECK(importer.GetError().find(GlbPath) != std::string::npos);
+	MeshFile file;
+	CHECK(!file.Open(Widen(CachePath)));
+}
+
+// Import and cook throughput of a million-triangle terrain as OBJ and as GLB,
+// with no job system and across worker counts.
+BENCHMARK(MeshImporterThroughput)
+{
+	TemporaryFiles files;
+	const Terrain terrain(708);
+	terrain.WriteObj(ObjPath);
+	terrain.WriteGlb(GlbPath);
+	const double triangleCount = static_cast<double>(terrain.indices.size() / 3);
+	printf("  %.0f triangles, %u hardware threads\n", triangleCount, std::thread::hardware_concurrency());
+
+	const uint32_t Repeats = 3;
+	const uint32_t workerCounts[] = { 0, 1, 2, 4, 8 };
+	for (uint32_t workerCount : workerCounts)
+	{
+		std::unique_ptr<JobSystem> jobSystem(workerCount > 0 ? new JobSystem(workerCount) : nullptr);
+		MeshImporter importer(jobSystem.get());
+		double objSeconds = 1e30;
+		double glbSeconds = 1e30;
+		double cookSeconds = 1e30;
+		for (uint32_t r = 0; r < Repeats; r++)
+		{
+			ImportedMesh mesh;
+			Stopwatch stopwatch;
+			CHECK(importer.Import(Widen(ObjPath), mesh));
+			objSeconds = std::min(objSeconds, stopwatch.GetSeconds());
+			stopwatch.Restart();
+			CHECK(importer.Import(Widen(GlbPath), mesh));
+			glbSeconds = std::min(glbSeconds, stopwatch.GetSeconds());
+			DoNotOptimize(mesh.vertices.size());
+
+			std::remove(CachePath);
+			CHECK(importer.Cook({ Widen(ObjPath) }, Widen(CachePath)));
+			cookSeconds = std::min(cookSeconds, importer.GetStats().seconds);
+		}
+
+		char name[32];
+		snprintf(name, sizeof(name), workerCount > 0 ? "%u workers" : "no job system", workerCount);
+		printf("  %-13s: import OBJ %.2f M triangles/s (%.0f ms), GLB %.2f M triangles/s (%.0f ms), cook OBJ %.2f M triangles/s (%.0f ms)\n", name,
+			triangleCount / objSeconds * 1e-6, objSeconds * 1000.0, triangleCount / glbSeconds * 1e-6, glbSeconds * 1000.0,
+			triangleCount / cookSeconds * 1e-6, cookSeconds * 1000.0);
+	}
+}
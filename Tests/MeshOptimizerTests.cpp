@@ -0,0 +1,366 @@
+#include "TestFramework.h"
+#include "TestMath.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+	struct Vertex
+	{
+		SceneFloat3 position;
+		uint32_t id;            // Tells vertices apart once they are reordered.
+	};
+
+	struct Mesh
+	{
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+
+		uint32_t GetIndexCount() const { return static_cast<uint32_t>(indices.size()); }
+		uint32_t GetVertexCount() const { return static_cast<uint32_t>(vertices.size()); }
+	};
+
+	// A UV sphere wound like the engine's, stack by stack, its triangles facing outwards.
+	void AddSphere(Mesh& mesh, uint32_t slices, const SceneFloat3& center, float radius)
+	{
+		const uint32_t stacks = slices / 2;
+		const uint32_t base = mesh.GetVertexCount();
+		for (uint32_t stack = 0; stack <= stacks; stack++)
+		{
+			for (uint32_t slice = 0; slice <= slices; slice++)
+			{
+				const float polar = 3.14159265f * stack / stacks;
+				const float azimuth = 2.0f * 3.14159265f * slice / slices;
+				const SceneFloat3 position = { center.x + radius * sinf(polar) * cosf(azimuth), center.y + radius * cosf(polar), center.z + radius * sinf(polar) * sinf(azimuth) };
+				mesh.vertices.push_back({ position, mesh.GetVertexCount() });
+			}
+		}
+		for (uint32_t stack = 0; stack < stacks; stack++)
+		{
+			for (uint32_t slice = 0; slice < slices; slice++)
+			{
+				const uint32_t top = base + stack * (slices + 1) + slice;
+				const uint32_t bottom = top + slices + 1;
+				const uint32_t quad[6] = { top, top + 1, bottom, top + 1, bottom + 1, bottom };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+	}
+
+	void ShuffleTriangles(Mesh& mesh, uint32_t seed)
+	{
+		std::vector<std::array<uint32_t, 3>> triangles(mesh.indices.size() / 3);
+		std::copy(mesh.indices.begin(), mesh.indices.end(), &triangles[0][0]);
+		std::shuffle(triangles.begin(), triangles.end(), std::mt19937(seed));
+		std::copy(&triangles[0][0], &triangles[0][0] + mesh.indices.size(), mesh.indices.begin());
+	}
+
+	// Four by four by four overlapping spheres in a random triangle order.
+	Mesh MakeSphereLattice(uint32_t slices)
+	{
+		Mesh mesh;
+		for (uint32_t i = 0; i < 64; i++)
+		{
+			AddSphere(mesh, slices, { (i % 4) * 1.5f, (i / 4 % 4) * 1.5f, (i / 16) * 1.5f }, 1.0f);
+		}
+		ShuffleTriangles(mesh, 23);
+		return mesh;
+	}
+
+	// The triangles by vertex id, each rotated to start at its smallest id so that
+	// the winding is kept, sorted.
+	std::vector<std::array<uint32_t, 3>> GetTriangles(const Mesh& mesh)
+	{
+		std::vector<std::array<uint32_t, 3>> triangles;
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			std::array<uint32_t, 3> triangle = { mesh.vertices[mesh.indices[i]].id, mesh.vertices[mesh.indices[i + 1]].id, mesh.vertices[mesh.indices[i + 2]].id };
+			std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+			triangles.push_back(triangle);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	// Runs the three passes in order, as the importer does.
+	void Optimize(Mesh& mesh, float overdrawThreshold)
+	{
+		OptimizeVertexCache(mesh.indices.data(), mesh.indices.data(), mesh.GetIndexCount(), mesh.GetVertexCount());
+		OptimizeOverdraw(mesh.indices.data(), mesh.indices.data(), mesh.GetIndexCount(), &mesh.vertices[0].position.x, sizeof(Vertex), mesh.GetVertexCount(), overdrawThreshold);
+		std::vector<Vertex> vertices(mesh.vertices.size());
+		vertices.resize(OptimizeVertexFetch(vertices.data(), mesh.indices.data(), mesh.GetIndexCount(), mesh.vertices.data(), mesh.GetVertexCount(), sizeof(Vertex)));
+		mesh.vertices.swap(vertices);
+	}
+
+	// Shaded fragments per covered pixel, with triangles facing away culled and a
+	// less-than depth test, over orthographic views from 14 directions spread over
+	// the sphere.
+	double MeasureOverdraw(const Mesh& mesh)
+	{
+		const int Resolution = 256;
+		SceneFloat3 low = mesh.vertices[0].position;
+		SceneFloat3 high = low;
+		for (const Vertex& vertex : mesh.vertices)
+		{
+			low = { std::min(low.x, vertex.position.x), std::min(low.y, vertex.position.y), std::min(low.z, vertex.position.z) };
+			high = { std::max(high.x, vertex.position.x), std::max(high.y, vertex.position.y), std::max(high.z, vertex.position.z) };
+		}
+		const SceneFloat3 center = { (low.x + high.x) * 0.5f, (low.y + high.y) * 0.5f, (low.z + high.z) * 0.5f };
+		const float scale = Resolution * 0.5f / (std::max(high.x - low.x, std::max(high.y - low.y, high.z - low.z)) * 0.9f);
+
+		double shadedCount = 0.0;
+		double coveredCount = 0.0;
+		std::vector<float> depths(Resolution * Resolution);
+		std::vector<SceneFloat3> projected(mesh.vertices.size());
+		for (int view = 0; view < 14; view++)
+		{
+			const float y = 1.0f - 2.0f * (view + 0.5f) / 14.0f;
+			const float azimuth = view * 2.39996f;
+			const SceneFloat3 direction = { sqrtf(1.0f - y * y) * cosf(azimuth), y, sqrtf(1.0f - y * y) * sinf(azimuth) };
+			const SceneFloat3 right = Normalize(Cross(fabsf(y) > 0.9f ? SceneFloat3{ 1.0f, 0.0f, 0.0f } : SceneFloat3{ 0.0f, 1.0f, 0.0f }, direction));
+			const SceneFloat3 up = Cross(direction, right);
+			for (size_t i = 0; i < mesh.vertices.size(); i++)
+			{
+				const SceneFloat3& p = mesh.vertices[i].position;
+				const SceneFloat3 offset = { p.x - center.x, p.y - center.y, p.z - center.z };
+				projected[i] = { Dot(offset, right) * scale + Resolution * 0.5f, Dot(offset, up) * scale + Resolution * 0.5f, Dot(offset, direction) };
+			}
+
+			std::fill(depths.begin(), depths.end(), FLT_MAX);
+			for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+			{
+				const SceneFloat3& p0 = mesh.vertices[mesh.indices[i]].position;
+				const SceneFloat3& p1 = mesh.vertices[mesh.indices[i + 1]].position;
+				const SceneFloat3& p2 = mesh.vertices[mesh.indices[i + 2]].position;
+				const SceneFloat3 normal = Cross({ p1.x - p0.x, p1.y - p0.y, p1.z - p0.z }, { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z });
+				const SceneFloat3& a = projected[mesh.indices[i]];
+				const SceneFloat3& b = projected[mesh.indices[i + 1]];
+				const SceneFloat3& c = projected[mesh.indices[i + 2]];
+				const float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+				if (Dot(normal, direction) >= 0.0f || area == 0.0f)
+				{
+					continue;
+				}
+				const int x0 = std::max(0, static_cast<int>(std::min(a.x, std::min(b.x, c.x))));
+				const int x1 = std::min(Resolution - 1, static_cast<int>(std::max(a.x, std::max(b.x, c.x))));
+				const int y0 = std::max(0, static_cast<int>(std::min(a.y, std::min(b.y, c.y))));
+				const int y1 = std::min(Resolution - 1, static_cast<int>(std::max(a.y, std::max(b.y, c.y))));
+				for (int py = y0; py <= y1; py++)
+				{
+					for (int px = x0; px <= x1; px++)
+					{
+						const float x = px + 0.5f;
+						const float y = py + 0.5f;
+						const float wa = ((b.x - x) * (c.y - y) - (b.y - y) * (c.x - x)) / area;
+						const float wb = ((c.x - x) * (a.y - y) - (c.y - y) * (a.x - x)) / area;
+						const float wc = 1.0f - wa - wb;
+						if (wa < 0.0f || wb < 0.0f || wc < 0.0f)
+						{
+							continue;
+						}
+						const float depth = wa * a.z + wb * b.z + wc * c.z;
+						float& stored = depths[py * Resolution + px];
+						if (depth < stored)
+						{
+							coveredCount += stored == FLT_MAX ? 1.0 : 0.0;
+							shadedCount += 1.0;
+							stored = depth;
+						}
+					}
+				}
+			}
+		}
+		return coveredCount > 0.0 ? shadedCount / coveredCount : 0.0;
+	}
+}
+
+// Hand-replayed cases: a FIFO cache does not refresh entries on a hit, unlike LRU.
+TEST(MeshOptimizerSimulatesFifoCache)
+{
+	const uint32_t one[] = { 0, 1, 2 };
+	VertexCacheStats stats = SimulateVertexCache(one, 3, 3);
+	CHECK(stats.transformCount == 3 && stats.acmr == 3.0f && stats.atvr == 1.0f);
+
+	// 0 hits without moving up, so 3 evicts it and 1 still hits: LRU would miss 1.
+	const uint32_t fifo[] = { 0, 1, 2, 0, 3, 1 };
+	stats = SimulateVertexCache(fifo, 6, 4, 3);
+	CHECK(stats.transformCount == 4 && stats.acmr == 2.0f && stats.atvr == 1.0f);
+	const uint32_t evicted[] = { 0, 1, 2, 0, 3, 0 };
+	stats = SimulateVertexCache(evicted, 6, 4, 3);
+	CHECK(stats.transformCount == 5 && stats.atvr == 1.25f);
+
+	// Unreferenced vertices do not count towards ATVR, and a partial triangle is ignored.
+	const uint32_t sparse[] = { 5, 9, 7, 7, 9, 8, 1 };
+	stats = SimulateVertexCache(sparse, 7, 16);
+	CHECK(stats.transformCount == 4 && stats.acmr == 2.0f && stats.atvr == 1.0f);
+	stats = SimulateVertexCache(sparse, 0, 16);
+	CHECK(stats.transformCount == 0 && stats.acmr == 0.0f && stats.atvr == 0.0f);
+
+	// Every triangle misses once the cache is too small to hold any reuse.
+	Mesh sphere;
+	AddSphere(sphere, 32, { 0.0f, 0.0f, 0.0f }, 1.0f);
+	stats = SimulateVertexCache(sphere.indices.data(), sphere.GetIndexCount(), sphere.GetVertexCount(), 1);
+	CHECK(stats.acmr > 2.0f);
+	CHECK(SimulateVertexCache(sphere.indices.data(), sphere.GetIndexCount(), sphere.GetVertexCount(), 128).acmr < 1.0f);
+}
+
+// Each pass, in place or not, keeps every triangle with its winding, and the
+// fetch pass keeps each corner on the same vertex.
+TEST(MeshOptimizerPreservesTriangles)
+{
+	Mesh meshes[3];
+	AddSphere(meshes[0], 48, { 0.0f, 0.0f, 0.0f }, 1.0f);
+	meshes[1] = MakeSphereLattice(16);
+	std::mt19937 random(3);
+	for (uint32_t i = 0; i < 3000; i++)
+	{
+		meshes[2].vertices.push_back({ { static_cast<float>(random() % 100), static_cast<float>(random() % 100), static_cast<float>(random() % 100) }, i });
+	}
+	for (uint32_t i = 0; i < 6000 * 3; i++)
+	{
+		meshes[2].indices.push_back(random() % 2000);     // A soup, leaving a third of the vertices unused.
+	}
+
+	for (const Mesh& source : meshes)
+	{
+		const std::vector<std::array<uint32_t, 3>> triangles = GetTriangles(source);
+		Mesh mesh = source;
+		std::vector<uint32_t> indices(mesh.indices.size());
+		OptimizeVertexCache(indices.data(), mesh.indices.data(), mesh.GetIndexCount(), mesh.GetVertexCount());
+		OptimizeVertexCache(mesh.indices.data(), mesh.indices.data(), mesh.GetIndexCount(), mesh.GetVertexCount());
+		CHECK(indices == mesh.indices);
+		CHECK(GetTriangles(mesh) == triangles);
+
+		OptimizeOverdraw(indices.data(), mesh.indices.data(), mesh.GetIndexCount(), &mesh.vertices[0].position.x, sizeof(Vertex), mesh.GetVertexCount(), 1.05f);
+		OptimizeOverdraw(mesh.indices.data(), mesh.indices.data(), mesh.GetIndexCount(), &mesh.vertices[0].position.x, sizeof(Vertex), mesh.GetVertexCount(), 1.05f);
+		CHECK(indices == mesh.indices);
+		CHECK(GetTriangles(mesh) == triangles);
+
+		Mesh fetched = mesh;
+		Optimize(fetched, 1.05f);
+		CHECK(GetTriangles(fetched) == triangles);
+	}
+}
+
+// After the fetch pass, vertices are numbered in order of first use, so that a
+// new index is at most one past every index before it, and the unused ones are gone.
+TEST(MeshOptimizerOrdersVerticesByFirstUse)
+{
+	Mesh mesh = MakeSphereLattice(12);
+	mesh.vertices.push_back({ { 0.0f, 0.0f, 0.0f }, mesh.GetVertexCount() });      // Unused.
+	std::vector<Vertex> vertices(mesh.vertices.size());
+	const uint32_t vertexCount = OptimizeVertexFetch(vertices.data(), mesh.indices.data(), mesh.GetIndexCount(), mesh.vertices.data(), mesh.GetVertexCount(), sizeof(Vertex));
+	CHECK(vertexCount == mesh.GetVertexCount() - 1);
+
+	uint32_t nextVertex = 0;
+	for (uint32_t index : mesh.indices)
+	{
+		CHECK(index <= nextVertex);
+		nextVertex = std::max(nextVertex, index + 1);
+	}
+	CHECK(nextVertex == vertexCount);
+}
+
+// On a shuffled sphere and on shuffled overlapping spheres, the cache pass brings
+// the ACMR in a 16-entry FIFO from near 3 to about 0.7, each vertex transformed
+// less than one and a half times. The overdraw pass keeps the ACMR within a little
+// of its threshold and cuts the overdraw of the overlapping spheres, which the
+// cache pass alone does not change.
+TEST(MeshOptimizerImprovesCacheAndOverdraw)
+{
+	Mesh sphere;
+	AddSphere(sphere, 64, { 0.0f, 0.0f, 0.0f }, 1.0f);
+	ShuffleTriangles(sphere, 5);
+	Mesh lattice = MakeSphereLattice(24);
+
+	for (Mesh* pMesh : { &sphere, &lattice })
+	{
+		Mesh& mesh = *pMesh;
+		const VertexCacheStats before = SimulateVertexCache(mesh.indices.data(), mesh.GetIndexCount(), mesh.GetVertexCount());
+		const double overdrawBefore = MeasureOverdraw(mesh);
+		CHECK(before.acmr > 2.5f);
+
+		OptimizeVertexCache(mesh.indices.data(), mesh.indices.data(), mesh.GetIndexCount(), mesh.GetVertexCount());
+		const VertexCacheStats cacheOptimized = SimulateVertexCache(mesh.indices.data(), mesh.GetIndexCount(), mesh.GetVertexCount());
+		const double overdrawCacheOptimized = MeasureOverdraw(mesh);
+		CHECK(cacheOptimized.acmr < 0.75f);
+		CHECK(cacheOptimized.atvr < 1.45f);
+
+		Optimize(mesh, 1.05f);
+		const VertexCacheStats after = SimulateVertexCache(mesh.indices.data(), mesh.GetIndexCount(), mesh.GetVertexCount());
+		const double overdrawAfter = MeasureOverdraw(mesh);
+		CHECK(after.acmr <= cacheOptimized.acmr * 1.1f);
+		CHECK(after.atvr < 1.5f);
+
+		if (pMesh == &lattice)
+		{
+			CHECK(overdrawBefore > 1.5 && overdrawCacheOptimized > 1.5);
+			CHECK(overdrawAfter < overdrawCacheOptimized * 0.8);
+		}
+		else
+		{
+			CHECK(overdrawAfter < 1.01);
+		}
+	}
+}
+
+// Each pass over a million-triangle grid and over shuffled overlapping spheres,
+// with the ACMR and ATVR they reach in 16- and 32-entry FIFO caches.
+BENCHMARK(MeshOptimizerPasses)
+{
+	Mesh grid;
+	const uint32_t GridSize = 708;
+	for (uint32_t z = 0; z <= GridSize; z++)
+	{
+		for (uint32_t x = 0; x <= GridSize; x++)
+		{
+			grid.vertices.push_back({ { static_cast<float>(x), 0.0f, static_cast<float>(z) }, grid.GetVertexCount() });
+		}
+	}
+	for (uint32_t z = 0; z < GridSize; z++)
+	{
+		for (uint32_t x = 0; x < GridSize; x++)
+		{
+			const uint32_t corner = z * (GridSize + 1) + x;
+			const uint32_t quad[6] = { corner, corner + GridSize + 1, corner + 1, corner + 1, corner + GridSize + 1, corner + GridSize + 2 };
+			grid.indices.insert(grid.indices.end(), quad, quad + 6);
+		}
+	}
+	Mesh shuffledGrid = grid;
+	ShuffleTriangles(shuffledGrid, 9);
+
+	const Mesh meshes[] = { grid, shuffledGrid, MakeSphereLattice(64) };
+	const char* names[] = { "grid", "shuffled grid", "64 shuffled spheres" };
+	for (uint32_t m = 0; m < 3; m++)
+	{
+		Mesh mesh = meshes[m];
+		const VertexCacheStats before16 = SimulateVertexCache(mesh.indices.data(), mesh.GetIndexCount(), mesh.GetVertexCount());
+		const VertexCacheStats before32 = SimulateVertexCache(mesh.indices.data(), mesh.GetIndexCount(), mesh.GetVertexCount(), 32);
+
+		Stopwatch stopwatch;
+		OptimizeVertexCache(mesh.indices.data(), mesh.indices.data(), mesh.GetIndexCount(), mesh.GetVertexCount());
+		const double cacheMs = stopwatch.GetMilliseconds();
+		stopwatch.Restart();
+		OptimizeOverdraw(mesh.indices.data(), mesh.indices.data(), mesh.GetIndexCount(), &mesh.vertices[0].position.x, sizeof(Vertex), mesh.GetVertexCount(), 1.05f);
+		const double overdrawMs = stopwatch.GetMilliseconds();
+		std::vector<Vertex> vertices(mesh.vertices.size());
+		stopwatch.Restart();
+		const uint32_t vertexCount = OptimizeVertexFetch(vertices.data(), mesh.indices.data(), mesh.GetIndexCount(), mesh.vertices.data(), mesh.GetVertexCount(), sizeof(Vertex));
+		const double fetchMs = stopwatch.GetMilliseconds();
+		DoNotOptimize(vertices[vertexCount / 2].id);
+
+		const VertexCacheStats after16 = SimulateVertexCache(mesh.indices.data(), mesh.GetIndexCount(), vertexCount);
+		const VertexCacheStats after32 = SimulateVertexCache(mesh.indices.data(), mesh.GetIndexCount(), vertexCount, 32);
+		const uint32_t triangleCount = mesh.GetIndexCount() / 3;
+		printf("  %-19s: %u triangles, cache %.1f ms (%.2f M triangles/s), overdraw %.1f ms, fetch %.1f ms\n", names[m], triangleCount,
+			cacheMs, triangleCount / cacheMs * 1e-3, overdrawMs, fetchMs);
+		printf("  %-19s  FIFO 16 ACMR %.3f -> %.3f, ATVR %.3f -> %.3f; FIFO 32 ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", "",
+			before16.acmr, after16.acmr, before16.atvr, after16.atvr, before32.acmr, after32.acmr, before32.atvr, after32.atvr);
+	}
+}
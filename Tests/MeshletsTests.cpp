@@ -0,0 +1,435 @@
+#include "TestFramework.h"
+#include "TestMath.h"
+#include "Meshlets.h"
+#include "FrustumCulling.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+	struct Mesh
+	{
+		std::vector<SceneFloat3> positions;
+		std::vector<uint32_t> indices;
+
+		uint32_t GetIndexCount() const { return static_cast<uint32_t>(indices.size()); }
+		uint32_t GetVertexCount() const { return static_cast<uint32_t>(positions.size()); }
+	};
+
+	// A UV sphere, its triangles facing outwards. The poles are exact, so that the
+	// triangles that meet there are exactly degenerate rather than slivers facing
+	// whichever way rounding turns them.
+	void AddSphere(Mesh& mesh, uint32_t slices, const SceneFloat3& center, float radius)
+	{
+		const uint32_t stacks = slices / 2;
+		const uint32_t base = mesh.GetVertexCount();
+		for (uint32_t stack = 0; stack <= stacks; stack++)
+		{
+			for (uint32_t slice = 0; slice <= slices; slice++)
+			{
+				const float polar = 3.14159265f * stack / stacks;
+				const float azimuth = 2.0f * 3.14159265f * slice / slices;
+				const float ring = stack == 0 || stack == stacks ? 0.0f : radius * sinf(polar);
+				mesh.positions.push_back({ center.x + ring * cosf(azimuth), center.y + radius * cosf(polar), center.z + ring * sinf(azimuth) });
+			}
+		}
+		for (uint32_t stack = 0; stack < stacks; stack++)
+		{
+			for (uint32_t slice = 0; slice < slices; slice++)
+			{
+				const uint32_t top = base + stack * (slices + 1) + slice;
+				const uint32_t bottom = top + slices + 1;
+				const uint32_t quad[6] = { top, top + 1, bottom, top + 1, bottom + 1, bottom };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+	}
+
+	// A cache optimized sphere, the shuffled triangles of overlapping spheres, and
+	// a random triangle soup.
+	std::vector<Mesh> MakeMeshes()
+	{
+		std::vector<Mesh> meshes(3);
+		AddSphere(meshes[0], 64, { 0.0f, 0.0f, 0.0f }, 1.0f);
+		OptimizeVertexCache(meshes[0].indices.data(), meshes[0].indices.data(), meshes[0].GetIndexCount(), meshes[0].GetVertexCount());
+
+		for (uint32_t i = 0; i < 27; i++)
+		{
+			AddSphere(meshes[1], 24, { (i % 3) * 1.5f, (i / 3 % 3) * 1.5f, (i / 9) * 1.5f }, 1.0f);
+		}
+		std::vector<std::array<uint32_t, 3>> triangles(meshes[1].indices.size() / 3);
+		std::copy(meshes[1].indices.begin(), meshes[1].indices.end(), &triangles[0][0]);
+		std::shuffle(triangles.begin(), triangles.end(), std::mt19937(25));
+		std::copy(&triangles[0][0], &triangles[0][0] + meshes[1].indices.size(), meshes[1].indices.begin());
+
+		std::mt19937 random(7);
+		std::uniform_real_distribution<float> position(-3.0f, 3.0f);
+		for (uint32_t i = 0; i < 2000; i++)
+		{
+			meshes[2].positions.push_back({ position(random), position(random), position(random) });
+		}
+		for (uint32_t i = 0; i < 5000 * 3; i++)
+		{
+			meshes[2].indices.push_back(random() % 2000);
+		}
+		return meshes;
+	}
+
+	// The triangles, each rotated to start at its smallest index so that the winding is kept, sorted.
+	std::vector<std::array<uint32_t, 3>> GetTriangles(const std::vector<uint32_t>& indices)
+	{
+		std::vector<std::array<uint32_t, 3>> triangles;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			std::array<uint32_t, 3> triangle = { indices[i], indices[i + 1], indices[i + 2] };
+			std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+			triangles.push_back(triangle);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	SceneFloat3 Subtract(const SceneFloat3& a, const SceneFloat3& b)
+	{
+		return { a.x - b.x, a.y - b.y, a.z - b.z };
+	}
+
+	SceneFloat3 Transform(const SceneMatrix& world, const SceneFloat3& p)
+	{
+		return { p.x * world.m[0][0] + p.y * world.m[1][0] + p.z * world.m[2][0] + world.m[3][0],
+			p.x * world.m[0][1] + p.y * world.m[1][1] + p.z * world.m[2][1] + world.m[3][1],
+			p.x * world.m[0][2] + p.y * world.m[1][2] + p.z * world.m[2][2] + world.m[3][2] };
+	}
+
+	// A random rotation, uniform scale and translation, mirrored along x if asked.
+	SceneMatrix MakeWorld(std::mt19937& random, bool mirrored)
+	{
+		std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+		float q[4];
+		float length = 0.0f;
+		for (float& component : q)
+		{
+			component = signedUnit(random);
+			length += component * component;
+		}
+		length = sqrtf(length);
+		const float x = q[0] / length, y = q[1] / length, z = q[2] / length, w = q[3] / length;
+		const float scale = 0.5f + fabsf(signedUnit(random)) * 2.0f;
+		const float rotation[3][3] =
+		{
+			{ 1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + z * w), 2.0f * (x * z - y * w) },
+			{ 2.0f * (x * y - z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * w) },
+			{ 2.0f * (x * z + y * w), 2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y) },
+		};
+		SceneMatrix world = {};
+		for (int row = 0; row < 3; row++)
+		{
+			for (int column = 0; column < 3; column++)
+			{
+				world.m[row][column] = rotation[row][column] * scale * (row == 0 && mirrored ? -1.0f : 1.0f);
+			}
+			world.m[3][row] = signedUnit(random) * 5.0f;
+		}
+		world.m[3][3] = 1.0f;
+		return world;
+	}
+
+	// Whether every vertex of the meshlet is behind one of the frustum's planes, in world space.
+	bool IsOutside(const Mesh& mesh, const Meshlet& meshlet, const SceneMatrix& world, const Frustum& frustum)
+	{
+		for (int plane = 0; plane < 6; plane++)
+		{
+			bool outside = true;
+			for (uint32_t i = meshlet.startIndex; i < meshlet.startIndex + meshlet.triangleCount * 3 && outside; i++)
+			{
+				const SceneFloat3 p = Transform(world, mesh.positions[mesh.indices[i]]);
+				outside = p.x * frustum.normalX[plane] + p.y * frustum.normalY[plane] + p.z * frustum.normalZ[plane] + frustum.distance[plane] < 1e-4f;
+			}
+			if (outside)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Triangles of the meshlet the eye sees the front of, in world space, with the
+	// winding flipped by a mirroring world.
+	uint32_t CountFrontFacing(const Mesh& mesh, const Meshlet& meshlet, const SceneMatrix& world, bool mirrored, const SceneFloat3& eye)
+	{
+		uint32_t count = 0;
+		for (uint32_t i = meshlet.startIndex; i < meshlet.startIndex + meshlet.triangleCount * 3; i += 3)
+		{
+			const SceneFloat3 p0 = Transform(world, mesh.positions[mesh.indices[i]]);
+			const SceneFloat3 p1 = Transform(world, mesh.positions[mesh.indices[i + 1]]);
+			const SceneFloat3 p2 = Transform(world, mesh.positions[mesh.indices[i + 2]]);
+			const SceneFloat3 normal = Cross(Subtract(p1, p0), Subtract(p2, p0));
+			const SceneFloat3 toEye = Subtract(eye, p0);
+			const float facing = Dot(normal, toEye) * (mirrored ? -1.0f : 1.0f);
+			count += facing > 1e-4f * sqrtf(Dot(normal, normal) * Dot(toEye, toEye)) ? 1 : 0;
+		}
+		return count;
+	}
+}
+
+// Each triangle lands in exactly one meshlet, with its winding; the meshlets tile
+// the index buffer in order, within the vertex and triangle limits, and count
+// their vertices exactly. Empty input makes no meshlets.
+TEST(MeshletsCoverEveryTriangleOnce)
+{
+	std::vector<Mesh> meshes = MakeMeshes();
+	for (size_t m = 0; m < meshes.size(); m++)
+	{
+		Mesh& mesh = meshes[m];
+		const std::vector<std::array<uint32_t, 3>> triangles = GetTriangles(mesh.indices);
+		std::vector<Meshlet> meshlets;
+		BuildMeshlets(mesh.indices.data(), mesh.GetIndexCount(), &mesh.positions[0].x, sizeof(SceneFloat3), mesh.GetVertexCount(), meshlets);
+		CHECK(GetTriangles(mesh.indices) == triangles);
+		CHECK(meshlets.size() >= mesh.GetIndexCount() / 3 / MaxMeshletTriangles);
+
+		uint32_t nextIndex = 0;
+		uint32_t fullCount = 0;
+		for (const Meshlet& meshlet : meshlets)
+		{
+			CHECK(meshlet.startIndex == nextIndex);
+			CHECK(meshlet.triangleCount >= 1 && meshlet.triangleCount <= MaxMeshletTriangles);
+			CHECK(meshlet.vertexCount >= 3 && meshlet.vertexCount <= MaxMeshletVertices);
+			nextIndex += meshlet.triangleCount * 3;
+
+			std::vector<uint32_t> vertices(mesh.indices.begin() + meshlet.startIndex, mesh.indices.begin() + meshlet.startIndex + meshlet.triangleCount * 3);
+			std::sort(vertices.begin(), vertices.end());
+			vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+			CHECK(vertices.size() == meshlet.vertexCount);
+			fullCount += meshlet.vertexCount > MaxMeshletVertices - 3 || meshlet.triangleCount == MaxMeshletTriangles ? 1 : 0;
+		}
+		CHECK(nextIndex == mesh.GetIndexCount());
+
+		// The spheres fill their meshlets, but for the last few of each sphere.
+		if (m < 2)
+		{
+			CHECK(fullCount + 2 >= meshlets.size() * 9 / 10);
+		}
+	}
+
+	std::vector<Meshlet> meshlets(3);
+	const SceneFloat3 position = { 0.0f, 0.0f, 0.0f };
+	BuildMeshlets(nullptr, 0, &position.x, sizeof(SceneFloat3), 1, meshlets);
+	CHECK(meshlets.empty());
+}
+
+// Every vertex of a meshlet is inside its bounding sphere, and every triangle's
+// normal within its cone: the axis is a unit vector and each normal is at most
+// the cone's angle from it, unless the cone is open (coneCos 0).
+TEST(MeshletsBoundTheirTriangles)
+{
+	std::vector<Meshlet> meshlets;
+	std::vector<Mesh> meshes = MakeMeshes();
+	for (size_t m = 0; m < meshes.size(); m++)
+	{
+		Mesh& mesh = meshes[m];
+		BuildMeshlets(mesh.indices.data(), mesh.GetIndexCount(), &mesh.positions[0].x, sizeof(SceneFloat3), mesh.GetVertexCount(), meshlets);
+		uint32_t coneCount = 0;
+		for (const Meshlet& meshlet : meshlets)
+		{
+			const SceneFloat3 center = { meshlet.center[0], meshlet.center[1], meshlet.center[2] };
+			const SceneFloat3 axis = { meshlet.coneAxis[0], meshlet.coneAxis[1], meshlet.coneAxis[2] };
+			CHECK(meshlet.coneCos >= 0.0f && meshlet.coneCos <= 1.0f);
+			CHECK(fabsf(meshlet.coneSin * meshlet.coneSin + meshlet.coneCos * meshlet.coneCos - 1.0f) < 1e-4f);
+			for (uint32_t i = meshlet.startIndex; i < meshlet.startIndex + meshlet.triangleCount * 3; i += 3)
+			{
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					const SceneFloat3 offset = Subtract(mesh.positions[mesh.indices[i + corner]], center);
+					CHECK(sqrtf(Dot(offset, offset)) <= meshlet.radius * (1.0f + 1e-5f) + 1e-6f);
+				}
+
+				const SceneFloat3& p0 = mesh.positions[mesh.indices[i]];
+				const SceneFloat3 normal = Cross(Subtract(mesh.positions[mesh.indices[i + 1]], p0), Subtract(mesh.positions[mesh.indices[i + 2]], p0));
+				if (meshlet.coneCos > 0.0f && Dot(normal, normal) > 1e-12f)
+				{
+					CHECK(Dot(Normalize(normal), axis) >= meshlet.coneCos - 1e-4f);
+				}
+			}
+			if (meshlet.coneCos > 0.0f)
+			{
+				CHECK(fabsf(Dot(axis, axis) - 1.0f) < 1e-4f);
+				coneCount++;
+			}
+		}
+
+		// Most of a sphere's meshlets have a cone; the soup's normals point everywhere.
+		if (m == 0)
+		{
+			CHECK(coneCount * 2 > meshlets.size());
+		}
+	}
+}
+
+// From random eyes around randomly placed, scaled, rotated and sometimes mirrored
+// objects, a meshlet is only culled when all of it is behind one frustum plane or
+// the eye sees only the back of each of its triangles.
+TEST(MeshletsNeverCullFrontFacingTriangles)
+{
+	std::mt19937 random(25);
+	std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+	uint64_t rejectedCount = 0;
+	uint64_t testedCount = 0;
+	std::vector<Mesh> meshes = MakeMeshes();
+	for (Mesh& mesh : meshes)
+	{
+		std::vector<Meshlet> meshlets;
+		BuildMeshlets(mesh.indices.data(), mesh.GetIndexCount(), &mesh.positions[0].x, sizeof(SceneFloat3), mesh.GetVertexCount(), meshlets);
+		std::vector<MeshletIndexRange> ranges(meshlets.size());
+		for (uint32_t view = 0; view < 150; view++)
+		{
+			const bool mirrored = view % 5 == 4;
+			const SceneMatrix world = MakeWorld(random, mirrored);
+			const SceneFloat3 origin = { world.m[3][0], world.m[3][1], world.m[3][2] };
+			const SceneFloat3 eye = { origin.x + signedUnit(random) * 12.0f, origin.y + signedUnit(random) * 12.0f, origin.z + signedUnit(random) * 12.0f };
+			const SceneFloat3 target = { origin.x + signedUnit(random) * 3.0f, origin.y + signedUnit(random) * 3.0f, origin.z + signedUnit(random) * 3.0f };
+			Frustum frustum;
+			ExtractFrustum(MakeViewProjection(eye, target, 0.5f + fabsf(signedUnit(random))), frustum);
+
+			MeshletCullView cullView;
+			GetMeshletCullView(frustum, world, &eye.x, cullView);
+			CHECK(cullView.cullBackFacing == !mirrored);
+			MeshletCullStats stats = {};
+			const uint32_t rangeCount = CullMeshlets(cullView, meshlets.data(), static_cast<uint32_t>(meshlets.size()), ranges.data(), stats);
+			rejectedCount += stats.outsideTriangleCount + stats.backFacingTriangleCount;
+			testedCount += stats.triangleCount;
+
+			uint32_t range = 0;
+			for (const Meshlet& meshlet : meshlets)
+			{
+				while (range < rangeCount && ranges[range].startIndex + ranges[range].indexCount <= meshlet.startIndex)
+				{
+					range++;
+				}
+				const bool kept = range < rangeCount && ranges[range].startIndex <= meshlet.startIndex;
+				if (!kept && !IsOutside(mesh, meshlet, world, frustum))
+				{
+					CHECK(CountFrontFacing(mesh, meshlet, world, mirrored, eye) == 0);
+				}
+			}
+		}
+	}
+	CHECK(rejectedCount * 10 > testedCount);
+}
+
+// The kept ranges are sorted, merged where meshlets are consecutive and cover
+// exactly the triangles not reported as rejected, and the stats add up across calls.
+TEST(MeshletsReportRejectedTriangles)
+{
+	Mesh mesh;
+	AddSphere(mesh, 128, { 0.0f, 0.0f, 0.0f }, 1.0f);
+	std::vector<Meshlet> meshlets;
+	BuildMeshlets(mesh.indices.data(), mesh.GetIndexCount(), &mesh.positions[0].x, sizeof(SceneFloat3), mesh.GetVertexCount(), meshlets);
+	const uint32_t meshletCount = static_cast<uint32_t>(meshlets.size());
+	std::vector<MeshletIndexRange> ranges(meshletCount);
+	SceneMatrix identity = {};
+	for (int i = 0; i < 4; i++)
+	{
+		identity.m[i][i] = 1.0f;
+	}
+
+	// From far away along z, with the sphere filling the view: roughly half of it is
+	// seen from behind, and the cones find a good share of that; nothing is outside.
+	const SceneFloat3 eye = { 0.0f, 0.0f, -40.0f };
+	Frustum frustum;
+	ExtractFrustum(MakeViewProjection(eye, { 0.0f, 0.0f, 0.0f }, 0.2f), frustum);
+	MeshletCullView view;
+	GetMeshletCullView(frustum, identity, &eye.x, view);
+	MeshletCullStats stats = {};
+	const uint32_t rangeCount = CullMeshlets(view, meshlets.data(), meshletCount, ranges.data(), stats);
+	CHECK(stats.triangleCount == mesh.GetIndexCount() / 3);
+	CHECK(stats.outsideTriangleCount == 0);
+	CHECK(stats.backFacingTriangleCount * 4 > stats.triangleCount);
+	CHECK(stats.backFacingTriangleCount * 2 <= stats.triangleCount);
+
+	uint64_t keptCount = 0;
+	for (uint32_t r = 0; r < rangeCount; r++)
+	{
+		CHECK(ranges[r].indexCount > 0 && ranges[r].indexCount % 3 == 0);
+		CHECK(r == 0 || ranges[r].startIndex > ranges[r - 1].startIndex + ranges[r - 1].indexCount);
+		keptCount += ranges[r].indexCount / 3;
+	}
+	CHECK(keptCount + stats.backFacingTriangleCount == stats.triangleCount);
+
+	// Looking away: everything is outside, and the stats keep adding up.
+	const MeshletCullStats first = stats;
+	ExtractFrustum(MakeViewProjection(eye, { 0.0f, 0.0f, -80.0f }, 0.2f), frustum);
+	GetMeshletCullView(frustum, identity, &eye.x, view);
+	CHECK(CullMeshlets(view, meshlets.data(), meshletCount, ranges.data(), stats) == 0);
+	CHECK(stats.triangleCount == first.triangleCount * 2);
+	CHECK(stats.outsideTriangleCount == first.triangleCount);
+	CHECK(stats.backFacingTriangleCount == first.backFacingTriangleCount);
+
+	// Mirrored, the winding flips, so nothing is culled as back facing: the first
+	// view keeps every triangle, in a single range.
+	SceneMatrix mirror = identity;
+	mirror.m[0][0] = -1.0f;
+	ExtractFrustum(MakeViewProjection(eye, { 0.0f, 0.0f, 0.0f }, 0.2f), frustum);
+	GetMeshletCullView(frustum, mirror, &eye.x, view);
+	CHECK(!view.cullBackFacing);
+	stats = {};
+	CHECK(CullMeshlets(view, meshlets.data(), meshletCount, ranges.data(), stats) == 1);
+	CHECK(ranges[0].startIndex == 0 && ranges[0].indexCount == mesh.GetIndexCount());
+	CHECK(stats.outsideTriangleCount == 0 && stats.backFacingTriangleCount == 0);
+}
+
+// Building meshlets for a large sphere and for shuffled overlapping spheres, and
+// culling them from many views.
+BENCHMARK(MeshletsBuildAndCull)
+{
+	Mesh meshes[2];
+	AddSphere(meshes[0], 256, { 0.0f, 0.0f, 0.0f }, 1.0f);
+	OptimizeVertexCache(meshes[0].indices.data(), meshes[0].indices.data(), meshes[0].GetIndexCount(), meshes[0].GetVertexCount());
+	meshes[1] = MakeMeshes()[1];
+	const char* names[] = { "256-slice sphere", "27 shuffled spheres" };
+
+	std::mt19937 random(9);
+	std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+	for (uint32_t m = 0; m < 2; m++)
+	{
+		Mesh& mesh = meshes[m];
+		const VertexCacheStats before = SimulateVertexCache(mesh.indices.data(), mesh.GetIndexCount(), mesh.GetVertexCount());
+		std::vector<Meshlet> meshlets;
+		Stopwatch stopwatch;
+		BuildMeshlets(mesh.indices.data(), mesh.GetIndexCount(), &mesh.positions[0].x, sizeof(SceneFloat3), mesh.GetVertexCount(), meshlets);
+		const double buildMs = stopwatch.GetMilliseconds();
+		const VertexCacheStats after = SimulateVertexCache(mesh.indices.data(), mesh.GetIndexCount(), mesh.GetVertexCount());
+		const uint32_t meshletCount = static_cast<uint32_t>(meshlets.size());
+
+		const uint32_t ViewCount = 1000;
+		std::vector<MeshletCullView> views(ViewCount);
+		for (MeshletCullView& view : views)
+		{
+			const SceneMatrix world = MakeWorld(random, false);
+			const SceneFloat3 eye = { signedUnit(random) * 12.0f, signedUnit(random) * 12.0f, signedUnit(random) * 12.0f };
+			Frustum frustum;
+			ExtractFrustum(MakeViewProjection(eye, { world.m[3][0], world.m[3][1], world.m[3][2] }), frustum);
+			GetMeshletCullView(frustum, world, &eye.x, view);
+		}
+		std::vector<MeshletIndexRange> ranges(meshletCount);
+		MeshletCullStats stats = {};
+		uint64_t rangeCount = 0;
+		stopwatch.Restart();
+		for (const MeshletCullView& view : views)
+		{
+			rangeCount += CullMeshlets(view, meshlets.data(), meshletCount, ranges.data(), stats);
+		}
+		const double cullMs = stopwatch.GetMilliseconds();
+		DoNotOptimize(rangeCount);
+
+		printf("  %-19s: %u triangles in %u meshlets, build %.1f ms, ACMR %.3f -> %.3f\n", names[m], mesh.GetIndexCount() / 3, meshletCount, buildMs, before.acmr, after.acmr);
+		printf("  %-19s  cull %.2f us per view (%.1f ns per meshlet), %.1f%% outside, %.1f%% back facing, %.1f draws per view\n", "", cullMs * 1000.0 / ViewCount,
+			cullMs * 1e6 / ViewCount / meshletCount, 100.0 * stats.outsideTriangleCount / stats.triangleCount, 100.0 * stats.backFacingTriangleCount / stats.triangleCount,
+			static_cast<double>(rangeCount) / ViewCount);
+	}
+}
@@ -0,0 +1,391 @@
+#include "TestFramework.h"
+#include "TestMath.h"
+#include "OcclusionCulling.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+	const SceneMatrix Identity = { { { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f } } };
+
+	std::vector<ECullingPath> GetSupportedPaths()
+	{
+		std::vector<ECullingPath> paths = { ECullingPath::Scalar };
+		if (GetBestCullingPath() != ECullingPath::Scalar)
+		{
+			paths.push_back(ECullingPath::SSE);
+		}
+		if (GetBestCullingPath() == ECullingPath::AVX2)
+		{
+			paths.push_back(ECullingPath::AVX2);
+		}
+		return paths;
+	}
+
+	const char* GetPathName(ECullingPath path)
+	{
+		return path == ECullingPath::AVX2 ? "AVX2" : path == ECullingPath::SSE ? "SSE" : "scalar";
+	}
+
+	// Random triangles of both windings in front of, across and behind the camera.
+	struct Occluders
+	{
+		std::vector<float> positions;
+		std::vector<uint16_t> indices;
+
+		Occluders(uint32_t triangleCount, uint32_t seed, float range, float size)
+		{
+			std::mt19937 random(seed);
+			std::uniform_real_distribution<float> position(-range, range);
+			std::uniform_real_distribution<float> offset(-size, size);
+			for (uint32_t t = 0; t < triangleCount; t++)
+			{
+				const float x = position(random);
+				const float y = position(random);
+				const float z = position(random);
+				for (uint32_t v = 0; v < 3; v++)
+				{
+					positions.push_back(x + offset(random));
+					positions.push_back(y + offset(random));
+					positions.push_back(z + offset(random));
+					indices.push_back(static_cast<uint16_t>(t * 3 + v));
+				}
+			}
+		}
+	};
+
+	// An axis-aligned wall across the view at z = 0, from -halfSize to halfSize in
+	// x and y, wound to face a camera on the negative z side.
+	struct Wall
+	{
+		float positions[12];
+		uint16_t indices[6];
+
+		explicit Wall(float halfSize) :
+			positions{ -halfSize, -halfSize, 0.0f, -halfSize, halfSize, 0.0f, halfSize, halfSize, 0.0f, halfSize, -halfSize, 0.0f },
+			indices{ 0, 1, 2, 0, 2, 3 }
+		{
+		}
+	};
+
+	// The screen rectangle and nearest depth IsBoxVisible computes, with the same
+	// float operations. Returns false for boxes crossing the near plane.
+	bool GetScreenRect(const OcclusionBuffer& buffer, const SceneMatrix& viewProj, const float (&center)[3], const float (&extent)[3], float (&rect)[4], float& nearestDepth)
+	{
+		const float (&m)[4][4] = viewProj.m;
+		rect[0] = rect[1] = FLT_MAX;
+		rect[2] = rect[3] = -FLT_MAX;
+		nearestDepth = FLT_MAX;
+		for (int corner = 0; corner < 8; corner++)
+		{
+			const float x = (corner & 1) ? center[0] + extent[0] : center[0] - extent[0];
+			const float y = (corner & 2) ? center[1] + extent[1] : center[1] - extent[1];
+			const float z = (corner & 4) ? center[2] + extent[2] : center[2] - extent[2];
+			const float clipX = x * m[0][0] + y * m[1][0] + z * m[2][0] + m[3][0];
+			const float clipY = x * m[0][1] + y * m[1][1] + z * m[2][1] + m[3][1];
+			const float clipZ = x * m[0][2] + y * m[1][2] + z * m[2][2] + m[3][2];
+			const float clipW = x * m[0][3] + y * m[1][3] + z * m[2][3] + m[3][3];
+			if (clipZ < 0.0f || clipW <= 0.0f)
+			{
+				return false;
+			}
+
+			const float invW = 1.0f / clipW;
+			const float screenX = (clipX * invW * 0.5f + 0.5f) * buffer.GetWidth();
+			const float screenY = (0.5f - clipY * invW * 0.5f) * buffer.GetHeight();
+			rect[0] = std::min(rect[0], screenX);
+			rect[1] = std::min(rect[1], screenY);
+			rect[2] = std::max(rect[2], screenX);
+			rect[3] = std::max(rect[3], screenY);
+			nearestDepth = std::min(nearestDepth, clipZ * invW);
+		}
+		return true;
+	}
+
+	// Brute force over the full resolution depth buffer: visible if any pixel the
+	// rectangle, grown by a pixel, touches holds nothing in front of the box's
+	// nearest point.
+	bool IsBoxVisibleReference(const OcclusionBuffer& buffer, const SceneMatrix& viewProj, const float (&center)[3], const float (&extent)[3])
+	{
+		float rect[4];
+		float nearestDepth;
+		if (!GetScreenRect(buffer, viewProj, center, extent, rect, nearestDepth))
+		{
+			return true;
+		}
+
+		const float width = static_cast<float>(buffer.GetWidth());
+		const float height = static_cast<float>(buffer.GetHeight());
+		if (rect[2] < 0.0f || rect[3] < 0.0f || rect[0] >= width || rect[1] >= height)
+		{
+			return false;
+		}
+
+		const uint32_t left = static_cast<uint32_t>(std::max(rect[0] - 1.0f, 0.0f));
+		const uint32_t top = static_cast<uint32_t>(std::max(rect[1] - 1.0f, 0.0f));
+		const uint32_t right = static_cast<uint32_t>(std::min(rect[2] + 1.0f, width - 1.0f));
+		const uint32_t bottom = static_cast<uint32_t>(std::min(rect[3] + 1.0f, height - 1.0f));
+		for (uint32_t y = top; y <= bottom; y++)
+		{
+			for (uint32_t x = left; x <= right; x++)
+			{
+				if (nearestDepth <= buffer.GetDepth()[y * buffer.GetWidth() + x])
+				{
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	// Behind one of the planes, or too close to tell.
+	bool IsOutsideFrustum(const Frustum& frustum, const float (&center)[3], const float (&extent)[3])
+	{
+		for (int p = 0; p < 6; p++)
+		{
+			const double distance = static_cast<double>(frustum.normalX[p]) * center[0] + static_cast<double>(frustum.normalY[p]) * center[1] +
+				static_cast<double>(frustum.normalZ[p]) * center[2] + frustum.distance[p];
+			const double radius = std::fabs(frustum.normalX[p]) * extent[0] + std::fabs(frustum.normalY[p]) * extent[1] + std::fabs(frustum.normalZ[p]) * extent[2];
+			if (distance + radius < 1e-3)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void MakeBox(std::mt19937& random, float range, float size, float (&center)[3], float (&extent)[3])
+	{
+		std::uniform_real_distribution<float> position(-range, range);
+		std::uniform_real_distribution<float> extentDistribution(0.0f, size);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			center[axis] = position(random);
+			extent[axis] = extentDistribution(random);
+		}
+	}
+}
+
+// Every path, serial or over a job system, writes the same depths bit for bit.
+TEST(OcclusionCullingPathsRasterizeIdentically)
+{
+	JobSystem jobSystem(4);
+	OcclusionBuffer buffer(256, 128);
+	std::mt19937 random(20);
+	std::uniform_real_distribution<float> position(-30.0f, 30.0f);
+	for (uint32_t view = 0; view < 10; view++)
+	{
+		const SceneMatrix viewProj = MakeViewProjection({ position(random), position(random), position(random) }, { 0.0f, 0.0f, 0.0f });
+		const Occluders occluders(300, view, 30.0f, 8.0f);
+
+		buffer.Begin(viewProj);
+		buffer.AddOccluder(occluders.positions.data(), 3 * sizeof(float), occluders.indices.data(), static_cast<uint32_t>(occluders.indices.size()), Identity);
+		buffer.Rasterize(nullptr, ECullingPath::Scalar);
+		const std::vector<float> expected(buffer.GetDepth(), buffer.GetDepth() + buffer.GetWidth() * buffer.GetHeight());
+		CHECK(buffer.GetTriangleCount() > 0);
+		CHECK(std::count(expected.begin(), expected.end(), 1.0f) < static_cast<std::ptrdiff_t>(expected.size()));
+
+		for (ECullingPath path : GetSupportedPaths())
+		{
+			for (JobSystem* pJobSystem : { static_cast<JobSystem*>(nullptr), &jobSystem })
+			{
+				buffer.Begin(viewProj);
+				buffer.AddOccluder(occluders.positions.data(), 3 * sizeof(float), occluders.indices.data(), static_cast<uint32_t>(occluders.indices.size()), Identity);
+				buffer.Rasterize(pJobSystem, path);
+				CHECK(memcmp(buffer.GetDepth(), expected.data(), expected.size() * sizeof(float)) == 0);
+			}
+		}
+	}
+}
+
+// The hierarchical test gives exactly the brute force answer over the full
+// resolution depth buffer, in both square and non-square buffers, and CullBoxes
+// keeps exactly the boxes IsBoxVisible accepts, in order.
+TEST(OcclusionCullingHierarchyMatchesBruteForce)
+{
+	const uint32_t sizes[][2] = { { 256, 128 }, { 64, 64 }, { 8, 32 } };
+	std::mt19937 random(2);
+	std::uniform_real_distribution<float> position(-30.0f, 30.0f);
+	for (const uint32_t (&size)[2] : sizes)
+	{
+		OcclusionBuffer buffer(size[0], size[1]);
+		for (uint32_t view = 0; view < 5; view++)
+		{
+			const SceneMatrix viewProj = MakeViewProjection({ position(random), position(random), position(random) }, { 0.0f, 0.0f, 0.0f });
+			const Occluders occluders(200, view + 100, 25.0f, 10.0f);
+			buffer.Begin(viewProj);
+			buffer.AddOccluder(occluders.positions.data(), 3 * sizeof(float), occluders.indices.data(), static_cast<uint32_t>(occluders.indices.size()), Identity);
+			buffer.Rasterize();
+
+			const uint32_t BoxCount = 3000;
+			std::vector<float> centerX(BoxCount), centerY(BoxCount), centerZ(BoxCount), extentX(BoxCount), extentY(BoxCount), extentZ(BoxCount);
+			std::vector<uint32_t> indices;
+			std::vector<uint32_t> expected;
+			uint32_t culledCount = 0;
+			for (uint32_t i = 0; i < BoxCount; i++)
+			{
+				float center[3], extent[3];
+				MakeBox(random, 40.0f, i % 2 ? 1.0f : 8.0f, center, extent);
+				centerX[i] = center[0], centerY[i] = center[1], centerZ[i] = center[2];
+				extentX[i] = extent[0], extentY[i] = extent[1], extentZ[i] = extent[2];
+
+				const bool visible = buffer.IsBoxVisible(center[0], center[1], center[2], extent[0], extent[1], extent[2]);
+				CHECK(visible == IsBoxVisibleReference(buffer, viewProj, center, extent));
+				culledCount += !visible;
+				indices.push_back(i);
+				if (visible)
+				{
+					expected.push_back(i);
+				}
+			}
+			CHECK(culledCount > 0 && culledCount < BoxCount);
+
+			const SceneBoundsView bounds = { centerX.data(), centerY.data(), centerZ.data(), extentX.data(), extentY.data(), extentZ.data(), BoxCount };
+			const uint32_t visibleCount = buffer.CullBoxes(bounds, indices.data(), BoxCount);
+			CHECK(visibleCount == expected.size() && std::equal(expected.begin(), expected.end(), indices.begin()));
+		}
+	}
+}
+
+// Against the geometry itself: with a wall in front of the camera, a box is
+// only culled if it is off screen, or entirely behind the wall with every ray
+// from the eye to it crossing the wall. Most boxes hidden well inside the wall's silhouette are
+// culled, and boxes crossing the near plane never are.
+TEST(OcclusionCullingNeverCullsVisibleBoxes)
+{
+	const float HalfSize = 10.0f;
+	const float EyeZ = -30.0f;
+	const Wall wall(HalfSize);
+	OcclusionBuffer buffer(256, 128);
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> eyeOffset(-8.0f, 8.0f);
+
+	uint32_t falseCulls = 0;
+	uint32_t deeplyHiddenCount = 0;
+	uint32_t deeplyHiddenCulled = 0;
+	for (uint32_t view = 0; view < 10; view++)
+	{
+		const SceneFloat3 eye = { eyeOffset(random), eyeOffset(random), EyeZ };
+		const SceneMatrix viewProj = MakeViewProjection(eye, { 0.0f, 0.0f, 0.0f });
+		Frustum frustum;
+		ExtractFrustum(viewProj, frustum);
+		buffer.Begin(viewProj);
+		buffer.AddOccluder(wall.positions, 3 * sizeof(float), wall.indices, 6, Identity);
+		buffer.Rasterize();
+		CHECK(buffer.GetTriangleCount() == 2);
+
+		for (uint32_t b = 0; b < 5000; b++)
+		{
+			float center[3], extent[3];
+			MakeBox(random, 25.0f, 3.0f, center, extent);
+			center[2] = std::fabs(center[2]) * 2.0f - 5.0f;
+
+			// Project each corner through the eye onto the wall's plane. The box is
+			// hidden if all of it is behind the wall and inside its silhouette,
+			// since both the box and the wall are convex.
+			bool behind = center[2] - extent[2] > 0.0f;
+			float silhouetteMargin = FLT_MAX;
+			for (int corner = 0; corner < 8 && behind; corner++)
+			{
+				const double x = (corner & 1) ? center[0] + extent[0] : center[0] - extent[0];
+				const double y = (corner & 2) ? center[1] + extent[1] : center[1] - extent[1];
+				const double z = (corner & 4) ? center[2] + extent[2] : center[2] - extent[2];
+				const double t = -eye.z / (z - eye.z);
+				const double wallX = eye.x + (x - eye.x) * t;
+				const double wallY = eye.y + (y - eye.y) * t;
+				silhouetteMargin = std::min(silhouetteMargin, static_cast<float>(HalfSize - std::max(std::fabs(wallX), std::fabs(wallY))));
+			}
+			const bool hidden = behind && silhouetteMargin > 0.0f;
+
+			const bool visible = buffer.IsBoxVisible(center[0], center[1], center[2], extent[0], extent[1], extent[2]);
+			falseCulls += !visible && !hidden && !IsOutsideFrustum(frustum, center, extent);
+
+			// Two pixels are about 0.3 units on the wall from this distance.
+			if (hidden && silhouetteMargin > 1.0f)
+			{
+				deeplyHiddenCount++;
+				deeplyHiddenCulled += !visible;
+			}
+		}
+
+		// In front of and across the near plane.
+		CHECK(buffer.IsBoxVisible(eye.x, eye.y, eye.z + 0.05f, 0.2f, 0.2f, 0.2f));
+		CHECK(buffer.IsBoxVisible(eye.x, eye.y, eye.z + 1.0f, 0.2f, 0.2f, 0.2f));
+	}
+
+	CHECK(falseCulls == 0);
+	CHECK(deeplyHiddenCount > 1000);
+	CHECK(deeplyHiddenCulled * 10 > deeplyHiddenCount * 9);
+}
+
+// Rasterization of a few hundred to a few thousand occluder triangles on each
+// path, serial and in bands over the job system, then box tests per millisecond.
+BENCHMARK(OcclusionCullingRasterizeAndCull)
+{
+	JobSystem jobSystem;
+	OcclusionBuffer buffer(256, 128);
+	const SceneMatrix viewProj = MakeViewProjection({ 0.0f, 5.0f, -60.0f }, { 0.0f, 0.0f, 0.0f });
+	printf("  %ux%u buffer, %u workers\n", buffer.GetWidth(), buffer.GetHeight(), jobSystem.GetWorkerCount());
+
+	for (uint32_t triangleCount : { 256u, 4096u })
+	{
+		const Occluders occluders(triangleCount, 1, 40.0f, 6.0f);
+		for (ECullingPath path : GetSupportedPaths())
+		{
+			const uint32_t Repeats = 50;
+			double serialMs = 0.0;
+			double parallelMs = 0.0;
+			for (uint32_t r = 0; r < 2 * Repeats; r++)
+			{
+				buffer.Begin(viewProj);
+				Stopwatch stopwatch;
+				buffer.AddOccluder(occluders.positions.data(), 3 * sizeof(float), occluders.indices.data(), static_cast<uint32_t>(occluders.indices.size()), Identity);
+				buffer.Rasterize(r < Repeats ? nullptr : &jobSystem, path);
+				(r < Repeats ? serialMs : parallelMs) += stopwatch.GetMilliseconds();
+			}
+			DoNotOptimize(static_cast<uint64_t>(buffer.GetDepth()[buffer.GetWidth() * buffer.GetHeight() / 2] * 1000.0f));
+			printf("  %5u triangles (%u set up), %-6s: %.3f ms serial, %.3f ms parallel\n", triangleCount, buffer.GetTriangleCount(), GetPathName(path),
+				serialMs / Repeats, parallelMs / Repeats);
+		}
+	}
+
+	const uint32_t BoxCount = 1 << 18;
+	std::mt19937 random(4);
+	std::vector<float> centerX(BoxCount), centerY(BoxCount), centerZ(BoxCount), extentX(BoxCount), extentY(BoxCount), extentZ(BoxCount);
+	for (uint32_t i = 0; i < BoxCount; i++)
+	{
+		float center[3], extent[3];
+		MakeBox(random, 50.0f, 2.0f, center, extent);
+		centerX[i] = center[0], centerY[i] = center[1], centerZ[i] = center[2];
+		extentX[i] = extent[0], extentY[i] = extent[1], extentZ[i] = extent[2];
+	}
+	const SceneBoundsView bounds = { centerX.data(), centerY.data(), centerZ.data(), extentX.data(), extentY.data(), extentZ.data(), BoxCount };
+
+	std::vector<uint32_t> indices(BoxCount);
+	for (JobSystem* pJobSystem : { static_cast<JobSystem*>(nullptr), &jobSystem })
+	{
+		const uint32_t Repeats = 5;
+		uint32_t visibleCount = 0;
+		double cullMs = 0.0;
+		for (uint32_t r = 0; r < Repeats; r++)
+		{
+			for (uint32_t i = 0; i < BoxCount; i++)
+			{
+				indices[i] = i;
+			}
+			Stopwatch stopwatch;
+			visibleCount = buffer.CullBoxes(bounds, indices.data(), BoxCount, pJobSystem);
+			cullMs += stopwatch.GetMilliseconds();
+		}
+		DoNotOptimize(visibleCount);
+		printf("  CullBoxes %s: %.0f boxes/ms, %u of %u visible\n", pJobSystem ? "parallel" : "serial", BoxCount / (cullMs / Repeats), visibleCount, BoxCount);
+	}
+}
@@ -0,0 +1,173 @@
+#include "TestFramework.h"
+#include "RadixSort.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	enum class EKeyPattern
+	{
+		Random,         // Every bit varies.
+		FewDistinct,    // Heavy duplication, so stability matters.
+		DrawKeys,       // Only a few byte fields vary, as in the engine's draw keys.
+		OneByte,        // A single pass, leaving the result in scratch before the copy back.
+	};
+
+	std::vector<uint64_t> MakeKeys(uint32_t count, EKeyPattern pattern, uint32_t seed)
+	{
+		std::mt19937_64 random(seed);
+		std::vector<uint64_t> keys(count);
+		for (uint64_t& key : keys)
+		{
+			const uint64_t bits = random();
+			switch (pattern)
+			{
+			case EKeyPattern::Random:
+				key = bits;
+				break;
+			case EKeyPattern::FewDistinct:
+				key = (bits % 13) * 0x0101010101010101ull;
+				break;
+			case EKeyPattern::DrawKeys:
+				key = 0x7f00000000000000ull | ((bits & 0xf) << 40) | ((bits >> 8) & 0xffff);
+				break;
+			case EKeyPattern::OneByte:
+				key = 0x1234560000000000ull | ((bits & 0xff) << 16);
+				break;
+			}
+		}
+		return keys;
+	}
+
+	// Sorts (key, index) pairs with both the radix sorter and std::stable_sort and compares the results.
+	bool MatchesStableSort(RadixSorter& sorter, const std::vector<uint64_t>& input, JobSystem* pJobSystem)
+	{
+		const uint32_t count = static_cast<uint32_t>(input.size());
+		std::vector<uint64_t> keys = input;
+		std::vector<uint32_t> values(count);
+		std::vector<uint32_t> expected(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			values[i] = i;
+			expected[i] = i;
+		}
+		sorter.Sort(keys.data(), values.data(), count, pJobSystem);
+		std::stable_sort(expected.begin(), expected.end(), [&input](uint32_t a, uint32_t b) { return input[a] < input[b]; });
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (values[i] != expected[i] || keys[i] != input[expected[i]])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+// Every key pattern and size, including empty and single key inputs and sizes
+// around the parallel block size, sorts exactly like std::stable_sort, with and
+// without a job system, reusing one sorter's scratch throughout.
+TEST(RadixSortMatchesStableSort)
+{
+	JobSystem jobSystem(4);
+	RadixSorter sorter;
+	const EKeyPattern patterns[] = { EKeyPattern::Random, EKeyPattern::FewDistinct, EKeyPattern::DrawKeys, EKeyPattern::OneByte };
+	const uint32_t counts[] = { 0, 1, 2, 3, 255, 4096, 16383, 16384, 16385, 100003, 300000 };
+
+	uint32_t seed = 0;
+	for (EKeyPattern pattern : patterns)
+	{
+		for (uint32_t count : counts)
+		{
+			const std::vector<uint64_t> keys = MakeKeys(count, pattern, seed++);
+			CHECK(MatchesStableSort(sorter, keys, nullptr));
+			CHECK(MatchesStableSort(sorter, keys, &jobSystem));
+		}
+	}
+}
+
+// Already sorted, reversed and constant inputs.
+TEST(RadixSortHandlesOrderedInputs)
+{
+	JobSystem jobSystem(2);
+	RadixSorter sorter;
+	std::vector<uint64_t> keys = MakeKeys(70000, EKeyPattern::Random, 42);
+	std::sort(keys.begin(), keys.end());
+	CHECK(MatchesStableSort(sorter, keys, &jobSystem));
+	std::reverse(keys.begin(), keys.end());
+	CHECK(MatchesStableSort(sorter, keys, &jobSystem));
+	std::fill(keys.begin(), keys.end(), 0xabcdull);
+	CHECK(MatchesStableSort(sorter, keys, &jobSystem));
+	keys.back() = ~0ull;
+	keys.front() = 0;
+	CHECK(MatchesStableSort(sorter, keys, nullptr));
+}
+
+// A million keys with values: the radix sorter on one thread and across the job
+// system against std::stable_sort and std::sort of the same pairs.
+BENCHMARK(RadixSortMillionKeys)
+{
+	const uint32_t Count = 1 << 20;
+	const uint32_t Repeats = 5;
+	JobSystem jobSystem;
+	RadixSorter sorter;
+	printf("  %u workers\n", jobSystem.GetWorkerCount());
+
+	const EKeyPattern patterns[] = { EKeyPattern::Random, EKeyPattern::FewDistinct, EKeyPattern::DrawKeys };
+	const char* patternNames[] = { "random", "few distinct", "draw keys" };
+	for (uint32_t p = 0; p < 3; p++)
+	{
+		const std::vector<uint64_t> input = MakeKeys(Count, patterns[p], p);
+		std::vector<uint64_t> keys;
+		std::vector<uint32_t> values(Count);
+		std::vector<std::pair<uint64_t, uint32_t>> pairs(Count);
+		double radixMs = 0.0;
+		double parallelMs = 0.0;
+		double stableMs = 0.0;
+		double unstableMs = 0.0;
+		uint64_t checksum = 0;
+
+		for (uint32_t r = 0; r < Repeats; r++)
+		{
+			keys = input;
+			Stopwatch stopwatch;
+			sorter.Sort(keys.data(), values.data(), Count);
+			radixMs += stopwatch.GetMilliseconds();
+			checksum += keys[Count / 2];
+
+			keys = input;
+			stopwatch.Restart();
+			sorter.Sort(keys.data(), values.data(), Count, &jobSystem);
+			parallelMs += stopwatch.GetMilliseconds();
+			checksum += keys[Count / 2];
+
+			for (uint32_t i = 0; i < Count; i++)
+			{
+				pairs[i] = std::make_pair(input[i], i);
+			}
+			stopwatch.Restart();
+			std::stable_sort(pairs.begin(), pairs.end(), [](const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b) { return a.first < b.first; });
+			stableMs += stopwatch.GetMilliseconds();
+			checksum += pairs[Count / 2].first;
+
+			for (uint32_t i = 0; i < Count; i++)
+			{
+				pairs[i] = std::make_pair(input[i], i);
+			}
+			stopwatch.Restart();
+			std::sort(pairs.begin(), pairs.end(), [](const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b) { return a.first < b.first; });
+			unstableMs += stopwatch.GetMilliseconds();
+			checksum += pairs[Count / 2].first;
+		}
+		DoNotOptimize(checksum);
+
+		printf("  %-12s: radix %.2f ms, radix parallel %.2f ms, std::stable_sort %.2f ms, std::sort %.2f ms\n", patternNames[p],
+			radixMs / Repeats, parallelMs / Repeats, stableMs / Repeats, unstableMs / Repeats);
+	}
+}
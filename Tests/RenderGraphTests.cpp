@@ -0,0 +1,380 @@
+#include "TestFramework.h"
+#include "RenderGraph.h"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+	struct DeclaredAccess
+	{
+		RenderGraphResource resource;
+		ERenderGraphState state;
+		bool write;
+	};
+
+	// Backend that applies every barrier to its own copy of the resource states.
+	// Passes check their declared accesses against it when they execute, so a
+	// missing, redundant or out-of-order transition shows up as a failed check.
+	class StateTrackingBackend : public IRenderGraphBackend
+	{
+	public:
+		void PrepareTransientResources(const RenderGraph& graph) override
+		{
+			m_states.resize(graph.GetResourceCount());
+			for (RenderGraphResource resource = 0; resource < graph.GetResourceCount(); resource++)
+			{
+				m_states[resource] = graph.GetInitialState(resource);
+			}
+			m_barrierCount = 0;
+			m_batchCount = 0;
+			m_redundantCount = 0;
+		}
+
+		void ResourceBarriers(const RenderGraphBarrier* pBarriers, uint32_t count) override
+		{
+			for (uint32_t i = 0; i < count; i++)
+			{
+				const RenderGraphBarrier& barrier = pBarriers[i];
+				CHECK(barrier.before == m_states[barrier.resource]);
+				if (barrier.type == ERenderGraphBarrierType::Transition)
+				{
+					m_redundantCount += barrier.before == barrier.after;
+					m_states[barrier.resource] = barrier.after;
+				}
+			}
+			m_barrierCount += count;
+			m_batchCount++;
+		}
+
+		bool IsReady(const DeclaredAccess& access) const
+		{
+			const ERenderGraphState current = m_states[access.resource];
+			if (access.write)
+			{
+				return current == access.state;
+			}
+			return !IsWriteState(current) && (current & access.state) == access.state;
+		}
+
+		ERenderGraphState GetState(RenderGraphResource resource) const { return m_states[resource]; }
+		uint32_t GetBarrierCount() const { return m_barrierCount; }
+		uint32_t GetBatchCount() const { return m_batchCount; }
+		uint32_t GetRedundantCount() const { return m_redundantCount; }
+
+	private:
+		std::vector<ERenderGraphState> m_states;
+		uint32_t m_barrierCount = 0;
+		uint32_t m_batchCount = 0;
+		uint32_t m_redundantCount = 0;
+	};
+
+	// Declares passes on a graph and remembers what each declared and whether it ran.
+	struct GraphRecorder
+	{
+		RenderGraph graph;
+		StateTrackingBackend backend;
+		std::vector<std::vector<DeclaredAccess>> passAccesses;
+		std::vector<uint32_t> executed;
+		bool checkStates = true;
+
+		uint32_t AddPass(const char* name, const std::vector<DeclaredAccess>& accesses, bool sideEffects = false)
+		{
+			const uint32_t passIndex = static_cast<uint32_t>(passAccesses.size());
+			passAccesses.push_back(accesses);
+			graph.AddPass(name, [accesses, sideEffects](RenderGraphBuilder& builder)
+			{
+				for (const DeclaredAccess& access : accesses)
+				{
+					if (access.write)
+					{
+						builder.Write(access.resource, access.state);
+					}
+					else
+					{
+						builder.Read(access.resource, access.state);
+					}
+				}
+				if (sideEffects)
+				{
+					builder.SetSideEffects();
+				}
+			}, [this, passIndex]
+			{
+				for (const DeclaredAccess& access : passAccesses[passIndex])
+				{
+					CHECK(!checkStates || backend.IsReady(access));
+				}
+				executed.push_back(passIndex);
+			});
+			return passIndex;
+		}
+
+		void Execute()
+		{
+			executed.clear();
+			graph.Compile();
+			graph.Execute(backend);
+
+			// Imported resources end in their final state, transients back where they started.
+			for (RenderGraphResource resource = 0; resource < graph.GetResourceCount(); resource++)
+			{
+				if (!graph.IsTransient(resource) || graph.IsTransientAllocated(resource))
+				{
+					CHECK(backend.GetState(resource) == (graph.IsTransient(resource) ? graph.GetInitialState(resource) : finalStates[resource]));
+				}
+			}
+			CHECK(backend.GetRedundantCount() == 0);
+			CHECK(backend.GetBarrierCount() == graph.GetStats().barrierCount);
+			CHECK(backend.GetBatchCount() == graph.GetStats().barrierBatchCount);
+		}
+
+		RenderGraphResource Import(const char* name, ERenderGraphState initialState, ERenderGraphState finalState)
+		{
+			const RenderGraphResource resource = graph.ImportResource(name, initialState, finalState);
+			finalStates.resize(resource + 1, ERenderGraphState::Common);
+			finalStates[resource] = finalState;
+			return resource;
+		}
+
+		RenderGraphResource CreateTransient(const char* name, uint64_t size)
+		{
+			const RenderGraphResource resource = graph.CreateTransientResource(name, size, 65536);
+			finalStates.resize(resource + 1, ERenderGraphState::Common);
+			return resource;
+		}
+
+		std::vector<ERenderGraphState> finalStates;
+	};
+
+	DeclaredAccess Read(RenderGraphResource resource, ERenderGraphState state) { return { resource, state, false }; }
+	DeclaredAccess Write(RenderGraphResource resource, ERenderGraphState state) { return { resource, state, true }; }
+}
+
+// A shadowed deferred frame: the unused debug pass is culled, the G-buffer moves
+// straight into the union of its two read states, transients are restored.
+TEST(RenderGraphCompilesADeferredFrame)
+{
+	GraphRecorder recorder;
+	const RenderGraphResource backBuffer = recorder.Import("BackBuffer", ERenderGraphState::Present, ERenderGraphState::Present);
+	const RenderGraphResource shadowMap = recorder.CreateTransient("ShadowMap", 4 << 20);
+	const RenderGraphResource gBuffer = recorder.CreateTransient("GBuffer", 16 << 20);
+	const RenderGraphResource depth = recorder.CreateTransient("Depth", 8 << 20);
+	const RenderGraphResource debug = recorder.CreateTransient("Debug", 8 << 20);
+
+	const uint32_t shadow = recorder.AddPass("Shadow", { Write(shadowMap, ERenderGraphState::DepthWrite) });
+	const uint32_t geometry = recorder.AddPass("GBuffer", { Write(gBuffer, ERenderGraphState::RenderTarget), Write(depth, ERenderGraphState::DepthWrite) });
+	const uint32_t lighting = recorder.AddPass("Lighting", { Read(shadowMap, ERenderGraphState::ShaderResource), Read(gBuffer, ERenderGraphState::ShaderResource),
+		Read(depth, ERenderGraphState::DepthRead), Write(backBuffer, ERenderGraphState::RenderTarget) });
+	recorder.AddPass("Debug", { Read(depth, ERenderGraphState::ShaderResource), Write(debug, ERenderGraphState::RenderTarget) });
+	const uint32_t readback = recorder.AddPass("Readback", { Read(gBuffer, ERenderGraphState::CopySource) }, true);
+	recorder.Execute();
+
+	CHECK(recorder.executed == std::vector<uint32_t>({ shadow, geometry, lighting, readback }));
+	CHECK(recorder.graph.GetExecutionOrder() == recorder.executed);
+
+	// Lighting: 3 transients to read states and the back buffer to RT. Readback:
+	// shadow map and depth restored, G-buffer already covered. End: G-buffer
+	// restored, back buffer presented.
+	const RenderGraph::Stats& stats = recorder.graph.GetStats();
+	CHECK(stats.passCount == 4 && stats.culledPassCount == 1);
+	CHECK(stats.barrierCount == 8 && stats.barrierBatchCount == 3);
+	CHECK(stats.transientResourceCount == 3 && !recorder.graph.IsTransientAllocated(debug));
+
+	// The null backend sees the same barriers.
+	NullRenderGraphBackend nullBackend;
+	recorder.checkStates = false;
+	recorder.graph.Execute(nullBackend);
+	CHECK(nullBackend.GetBarrierCount() == stats.barrierCount && nullBackend.GetBatchCount() == stats.barrierBatchCount);
+}
+
+// Back-to-back UAV writes need a UAV barrier; two reads in different states need one transition.
+TEST(RenderGraphBarriersUnorderedAccessAndReads)
+{
+	GraphRecorder recorder;
+	const RenderGraphResource arguments = recorder.Import("Arguments", ERenderGraphState::Common, ERenderGraphState::Common);
+	recorder.AddPass("Clear", { Write(arguments, ERenderGraphState::UnorderedAccess) });
+	recorder.AddPass("Cull", { Write(arguments, ERenderGraphState::UnorderedAccess) });
+	recorder.AddPass("Draw", { Read(arguments, ERenderGraphState::IndirectArgument) }, true);
+	recorder.AddPass("Stats", { Read(arguments, ERenderGraphState::ShaderResource) }, true);
+	recorder.Execute();
+
+	CHECK(recorder.executed.size() == 4);
+	CHECK(recorder.graph.GetStats().barrierCount == 4);
+}
+
+// Only passes that feed an imported write or have side effects survive, with
+// everything they depend on. Checked against a brute-force reachability pass on
+// random graphs, which also exercise the state tracking above.
+TEST(RenderGraphCullsAndOrdersRandomGraphs)
+{
+	const ERenderGraphState writeStates[] = { ERenderGraphState::RenderTarget, ERenderGraphState::DepthWrite, ERenderGraphState::UnorderedAccess, ERenderGraphState::CopyDest };
+	const ERenderGraphState readStates[] = { ERenderGraphState::ShaderResource, ERenderGraphState::CopySource, ERenderGraphState::IndirectArgument,
+		ERenderGraphState::DepthRead, ERenderGraphState::VertexBuffer };
+	std::mt19937 random(5);
+
+	for (uint32_t graphIndex = 0; graphIndex < 200; graphIndex++)
+	{
+		GraphRecorder recorder;
+		const uint32_t importedCount = 1 + random() % 3;
+		const uint32_t transientCount = 2 + random() % 20;
+		const uint32_t passCount = 1 + random() % 40;
+		for (uint32_t i = 0; i < importedCount; i++)
+		{
+			recorder.Import("Imported", ERenderGraphState::Common, i == 0 ? ERenderGraphState::Present : readStates[random() % 5]);
+		}
+		for (uint32_t i = 0; i < transientCount; i++)
+		{
+			recorder.CreateTransient("Transient", (1 + random() % 16) << 16);
+		}
+
+		std::vector<bool> written(importedCount + transientCount, false);
+		std::vector<std::vector<uint32_t>> writers(passCount);
+		std::vector<bool> roots(passCount, false);
+		std::vector<std::vector<uint32_t>> dependencies(passCount);
+		std::vector<uint32_t> lastWriter(importedCount + transientCount, UINT32_MAX);
+
+		for (uint32_t passIndex = 0; passIndex < passCount; passIndex++)
+		{
+			std::vector<DeclaredAccess> accesses;
+			std::vector<bool> used(importedCount + transientCount, false);
+			const uint32_t readCount = random() % 4;
+			for (uint32_t r = 0; r < readCount; r++)
+			{
+				const RenderGraphResource resource = random() % (importedCount + transientCount);
+				if (used[resource] || (resource >= importedCount && !written[resource]))
+				{
+					continue;
+				}
+				used[resource] = true;
+				accesses.push_back(Read(resource, readStates[random() % 5]));
+			}
+			const uint32_t writeCount = 1 + random() % 2;
+			for (uint32_t w = 0; w < writeCount; w++)
+			{
+				// Imported resources are written rarely, so that culling has something to do.
+				const RenderGraphResource resource = random() % 8 == 0 ? random() % importedCount : importedCount + random() % transientCount;
+				if (used[resource])
+				{
+					continue;
+				}
+				used[resource] = true;
+				accesses.push_back(Write(resource, writeStates[random() % 4]));
+			}
+
+			// Reference dependencies: every access depends on the resource's last writer.
+			for (const DeclaredAccess& access : accesses)
+			{
+				if (lastWriter[access.resource] != UINT32_MAX)
+				{
+					dependencies[passIndex].push_back(lastWriter[access.resource]);
+				}
+				roots[passIndex] = roots[passIndex] || (access.write && access.resource < importedCount);
+			}
+			for (const DeclaredAccess& access : accesses)
+			{
+				if (access.write)
+				{
+					lastWriter[access.resource] = passIndex;
+					written[access.resource] = true;
+				}
+			}
+
+			const bool sideEffects = random() % 10 == 0;
+			roots[passIndex] = roots[passIndex] || sideEffects;
+			recorder.AddPass("Pass", accesses, sideEffects);
+		}
+
+		// Dependencies always point to earlier passes, so one backwards sweep finds everything live.
+		std::vector<bool> live = roots;
+		for (uint32_t passIndex = passCount; passIndex-- > 0;)
+		{
+			if (live[passIndex])
+			{
+				for (uint32_t dependency : dependencies[passIndex])
+				{
+					live[dependency] = true;
+				}
+			}
+		}
+		std::vector<uint32_t> expectedOrder;
+		for (uint32_t passIndex = 0; passIndex < passCount; passIndex++)
+		{
+			if (live[passIndex])
+			{
+				expectedOrder.push_back(passIndex);
+			}
+		}
+
+		recorder.Execute();
+		CHECK(recorder.executed == expectedOrder);
+		CHECK(recorder.graph.GetStats().culledPassCount == passCount - expectedOrder.size());
+	}
+}
+
+namespace
+{
+	// A post-processing heavy frame: a chain of passes, each reading the previous
+	// pass's target plus a few older ones and writing a new transient, with every
+	// fourth chain ending in an unused debug output that gets culled.
+	void BuildSyntheticFrame(RenderGraph& graph, uint32_t passCount)
+	{
+		graph.Reset();
+		const RenderGraphResource backBuffer = graph.ImportResource("BackBuffer", ERenderGraphState::Present, ERenderGraphState::Present);
+		std::vector<RenderGraphResource> targets;
+		for (uint32_t passIndex = 0; passIndex < passCount; passIndex++)
+		{
+			const RenderGraphResource target = graph.CreateTransientResource("Target", (1 + passIndex % 4) << 20, 65536);
+			const bool debug = passIndex % 4 == 3;
+			const uint32_t targetCount = static_cast<uint32_t>(targets.size());
+			graph.AddPass("Pass", [&, target, targetCount](RenderGraphBuilder& builder)
+			{
+				for (uint32_t back = 1; back <= 3 && back <= targetCount; back++)
+				{
+					builder.Read(targets[targetCount - back], back == 1 ? ERenderGraphState::ShaderResource : ERenderGraphState::CopySource);
+				}
+				builder.Write(target, ERenderGraphState::RenderTarget);
+			}, nullptr);
+			if (!debug)
+			{
+				targets.push_back(target);
+			}
+		}
+		graph.AddPass("Present", [&](RenderGraphBuilder& builder)
+		{
+			builder.Read(targets.back(), ERenderGraphState::ShaderResource);
+			builder.Write(backBuffer, ERenderGraphState::RenderTarget);
+		}, nullptr);
+	}
+}
+
+// Building and compiling the graph from scratch, as the engine does every frame.
+BENCHMARK(RenderGraphCompileTime)
+{
+	const uint32_t passCounts[] = { 16, 64, 256, 1024 };
+	RenderGraph graph;
+	for (uint32_t passCount : passCounts)
+	{
+		const uint32_t iterations = 4096 / passCount;
+		double buildMs = 0.0;
+		double compileMs = 0.0;
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			Stopwatch stopwatch;
+			BuildSyntheticFrame(graph, passCount);
+			buildMs += stopwatch.GetMilliseconds();
+			stopwatch.Restart();
+			graph.Compile();
+			compileMs += stopwatch.GetMilliseconds();
+		}
+
+		NullRenderGraphBackend backend;
+		graph.Execute(backend);
+		const RenderGraph::Stats& stats = graph.GetStats();
+		printf("  %4u passes: build %.3f ms, compile %.3f ms; %u culled, %llu barriers in %llu batches, transients %.1f of %.1f MB\n",
+			passCount + 1, buildMs / iterations, compileMs / iterations, stats.culledPassCount,
+			static_cast<unsigned long long>(backend.GetBarrierCount()), static_cast<unsigned long long>(backend.GetBatchCount()),
+			stats.transientMemory / 1048576.0, stats.naiveTransientMemory / 1048576.0);
+	}
+}
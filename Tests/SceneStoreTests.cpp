@@ -0,0 +1,554 @@
+#include "TestFramework.h"
+#include "TestMath.h"
+#include "SceneStore.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// What the test believes about each object it created, independent of the store's dense order.
+	struct Node
+	{
+		SceneObjectHandle handle;
+		uint32_t parent;            // Index into the model, UINT32_MAX for roots.
+		SceneObjectDesc desc;
+		uint32_t childCount;
+		bool alive;
+	};
+
+	struct SceneModel
+	{
+		std::vector<Node> nodes;
+		std::mt19937 random;
+
+		explicit SceneModel(uint32_t seed) : random(seed) {}
+
+		SceneFloat4 MakeRotation()
+		{
+			std::uniform_real_distribution<float> component(-1.0f, 1.0f);
+			const float x = component(random);
+			const float y = component(random);
+			const float z = component(random);
+			const float w = component(random);
+			const float length = std::sqrt(x * x + y * y + z * z + w * w);
+			return { x / length, y / length, z / length, w / length };
+		}
+
+		SceneObjectDesc MakeDesc()
+		{
+			std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+			std::uniform_real_distribution<float> scale(0.5f, 1.5f);
+			std::uniform_real_distribution<float> extent(0.0f, 3.0f);
+			SceneObjectDesc desc;
+			desc.position = { position(random), position(random), position(random) };
+			desc.rotation = MakeRotation();
+			desc.scale = { scale(random), scale(random), scale(random) };
+			desc.boundsCenter = { position(random) * 0.1f, position(random) * 0.1f, position(random) * 0.1f };
+			desc.boundsExtents = { extent(random), extent(random), extent(random) };
+			desc.mesh = random() % 100;
+			desc.material = random() % 100;
+			return desc;
+		}
+
+		uint32_t GetDepth(uint32_t node) const
+		{
+			uint32_t depth = 0;
+			for (uint32_t parent = nodes[node].parent; parent != UINT32_MAX; parent = nodes[parent].parent)
+			{
+				depth++;
+			}
+			return depth;
+		}
+
+		// A root, or a child of a random live object no deeper than maxDepth.
+		void Create(SceneStore& store, uint32_t maxDepth)
+		{
+			uint32_t parent = UINT32_MAX;
+			if (!nodes.empty() && random() % 4 != 0)
+			{
+				const uint32_t candidate = random() % nodes.size();
+				if (nodes[candidate].alive && GetDepth(candidate) < maxDepth)
+				{
+					parent = candidate;
+				}
+			}
+
+			Node node;
+			node.desc = MakeDesc();
+			node.parent = parent;
+			node.childCount = 0;
+			node.alive = true;
+			node.handle = store.Create(node.desc, parent != UINT32_MAX ? nodes[parent].handle : NullSceneObjectHandle);
+			if (parent != UINT32_MAX)
+			{
+				nodes[parent].childCount++;
+			}
+			nodes.push_back(node);
+		}
+
+		// Destroys a random live leaf, if the pick is one.
+		void DestroyLeaf(SceneStore& store)
+		{
+			const uint32_t candidate = random() % nodes.size();
+			Node& node = nodes[candidate];
+			if (!node.alive || node.childCount != 0)
+			{
+				return;
+			}
+
+			store.Destroy(node.handle);
+			node.alive = false;
+			if (node.parent != UINT32_MAX)
+			{
+				nodes[node.parent].childCount--;
+			}
+		}
+
+		// Changes one transform component of a random live object and returns it, or UINT32_MAX.
+		uint32_t Modify(SceneStore& store)
+		{
+			const uint32_t candidate = random() % nodes.size();
+			Node& node = nodes[candidate];
+			if (!node.alive)
+			{
+				return UINT32_MAX;
+			}
+
+			const SceneObjectDesc desc = MakeDesc();
+			switch (random() % 3)
+			{
+			case 0:
+				node.desc.position = desc.position;
+				store.SetPosition(node.handle, desc.position);
+				break;
+			case 1:
+				node.desc.rotation = desc.rotation;
+				store.SetRotation(node.handle, desc.rotation);
+				break;
+			default:
+				node.desc.scale = desc.scale;
+				store.SetScale(node.handle, desc.scale);
+				break;
+			}
+			return candidate;
+		}
+
+		// Scale, then rotation (XMMatrixRotationQuaternion), then translation, then the parent's world.
+		SceneMatrix GetWorld(uint32_t node) const
+		{
+			const SceneObjectDesc& desc = nodes[node].desc;
+			const float x = desc.rotation.x;
+			const float y = desc.rotation.y;
+			const float z = desc.rotation.z;
+			const float w = desc.rotation.w;
+			const SceneMatrix scale = { { { desc.scale.x, 0.0f, 0.0f, 0.0f }, { 0.0f, desc.scale.y, 0.0f, 0.0f }, { 0.0f, 0.0f, desc.scale.z, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f } } };
+			const SceneMatrix rotation =
+			{ {
+				{ 1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + z * w), 2.0f * (x * z - y * w), 0.0f },
+				{ 2.0f * (x * y - z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * w), 0.0f },
+				{ 2.0f * (x * z + y * w), 2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y), 0.0f },
+				{ 0.0f, 0.0f, 0.0f, 1.0f },
+			} };
+			SceneMatrix world = MultiplyMatrices(scale, rotation);
+			world.m[3][0] = desc.position.x;
+			world.m[3][1] = desc.position.y;
+			world.m[3][2] = desc.position.z;
+			if (nodes[node].parent != UINT32_MAX)
+			{
+				world = MultiplyMatrices(world, GetWorld(nodes[node].parent));
+			}
+			return world;
+		}
+
+		bool IsDescendantOf(uint32_t node, uint32_t ancestor) const
+		{
+			for (; node != UINT32_MAX; node = nodes[node].parent)
+			{
+				if (node == ancestor)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+	};
+
+	// Every live object's world matrix and world box against the model, and every dead handle invalid.
+	uint32_t CountWorldMismatches(const SceneStore& store, const SceneModel& model)
+	{
+		uint32_t mismatches = 0;
+		uint32_t liveCount = 0;
+		const SceneBoundsView bounds = store.GetWorldBounds();
+		for (uint32_t n = 0; n < model.nodes.size(); n++)
+		{
+			const Node& node = model.nodes[n];
+			if (!node.alive)
+			{
+				mismatches += store.IsValid(node.handle);
+				continue;
+			}
+
+			liveCount++;
+			if (!store.IsValid(node.handle))
+			{
+				mismatches++;
+				continue;
+			}
+
+			const uint32_t i = store.GetDenseIndex(node.handle);
+			mismatches += store.GetHandle(i).index != node.handle.index || store.GetMeshes()[i] != node.desc.mesh || store.GetMaterials()[i] != node.desc.material;
+
+			const SceneMatrix expected = model.GetWorld(n);
+			const SceneMatrix& world = store.GetWorldMatrices()[i];
+			for (int row = 0; row < 4; row++)
+			{
+				for (int column = 0; column < 4; column++)
+				{
+					mismatches += std::fabs(world.m[row][column] - expected.m[row][column]) > 1e-3f * (1.0f + std::fabs(expected.m[row][column]));
+				}
+			}
+
+			// The world box must hold all eight corners of the transformed local box.
+			const SceneFloat3& c = node.desc.boundsCenter;
+			const SceneFloat3& e = node.desc.boundsExtents;
+			for (uint32_t corner = 0; corner < 8; corner++)
+			{
+				const float x = c.x + (corner & 1 ? e.x : -e.x);
+				const float y = c.y + (corner & 2 ? e.y : -e.y);
+				const float z = c.z + (corner & 4 ? e.z : -e.z);
+				const float wx = x * expected.m[0][0] + y * expected.m[1][0] + z * expected.m[2][0] + expected.m[3][0];
+				const float wy = x * expected.m[0][1] + y * expected.m[1][1] + z * expected.m[2][1] + expected.m[3][1];
+				const float wz = x * expected.m[0][2] + y * expected.m[1][2] + z * expected.m[2][2] + expected.m[3][2];
+				const float tolerance = 1e-3f * (1.0f + std::fabs(wx) + std::fabs(wy) + std::fabs(wz));
+				mismatches += std::fabs(wx - bounds.centerX[i]) > bounds.extentX[i] + tolerance;
+				mismatches += std::fabs(wy - bounds.centerY[i]) > bounds.extentY[i] + tolerance;
+				mismatches += std::fabs(wz - bounds.centerZ[i]) > bounds.extentZ[i] + tolerance;
+			}
+		}
+		mismatches += liveCount != store.GetObjectCount() || bounds.count != liveCount;
+		return mismatches;
+	}
+
+	// A forest of roots with children down to the given depth, each level branchingFactor times wider.
+	void BuildForest(SceneStore& store, SceneModel& model, uint32_t rootCount, uint32_t branchingFactor, uint32_t depth)
+	{
+		uint32_t levelBegin = 0;
+		for (uint32_t r = 0; r < rootCount; r++)
+		{
+			const SceneObjectDesc desc = model.MakeDesc();
+			const Node node = { store.Create(desc), UINT32_MAX, desc, 0, true };
+			model.nodes.push_back(node);
+		}
+		for (uint32_t level = 1; level <= depth; level++)
+		{
+			const uint32_t levelEnd = static_cast<uint32_t>(model.nodes.size());
+			for (uint32_t parent = levelBegin; parent < levelEnd; parent++)
+			{
+				for (uint32_t c = 0; c < branchingFactor; c++)
+				{
+					const SceneObjectDesc desc = model.MakeDesc();
+					const Node node = { store.Create(desc, model.nodes[parent].handle), parent, desc, 0, true };
+					model.nodes.push_back(node);
+					model.nodes[parent].childCount++;
+				}
+			}
+			levelBegin = levelEnd;
+		}
+	}
+}
+
+// Through rounds of creations (which may put children before their parents'
+// level), leaf destructions (which move the last object into the hole) and
+// transform changes, every object's world matrix and box match a recursive
+// reference and handles stay valid exactly as long as their objects live.
+TEST(SceneStoreWorldMatchesReference)
+{
+	SceneStore store;
+	SceneModel model(18);
+	for (uint32_t i = 0; i < 300; i++)
+	{
+		model.Create(store, 5);
+	}
+	store.UpdateWorld();
+	CHECK(CountWorldMismatches(store, model) == 0);
+
+	for (uint32_t round = 0; round < 30; round++)
+	{
+		for (uint32_t i = 0; i < 40; i++)
+		{
+			model.DestroyLeaf(store);
+		}
+		for (uint32_t i = 0; i < 40; i++)
+		{
+			model.Create(store, 5);
+		}
+		for (uint32_t i = 0; i < 60; i++)
+		{
+			model.Modify(store);
+		}
+		store.UpdateWorld();
+		CHECK(CountWorldMismatches(store, model) == 0);
+	}
+
+	// Reused slots get a new generation, so old handles stay invalid.
+	for (const Node& node : model.nodes)
+	{
+		for (const Node& other : model.nodes)
+		{
+			if (&node != &other && node.handle.index == other.handle.index)
+			{
+				CHECK(node.handle.generation != other.handle.generation);
+			}
+		}
+	}
+}
+
+// A sparse update recomputes exactly the changed objects and their descendants
+// and leaves every other world matrix untouched.
+TEST(SceneStoreSparseUpdateTouchesOnlyDirtySubtrees)
+{
+	SceneStore store;
+	SceneModel model(7);
+	BuildForest(store, model, 20, 3, 3);
+	store.UpdateWorld();
+	CHECK(CountWorldMismatches(store, model) == 0);
+
+	// Nothing changed: nothing is recomputed.
+	store.UpdateWorld();
+	for (uint32_t i = 0; i < store.GetObjectCount(); i++)
+	{
+		CHECK(store.GetWorldChanged()[i] == 0);
+	}
+
+	for (uint32_t round = 0; round < 10; round++)
+	{
+		std::vector<SceneMatrix> before(store.GetWorldMatrices(), store.GetWorldMatrices() + store.GetObjectCount());
+		std::vector<uint32_t> modified;
+		for (uint32_t i = 0; i < 5; i++)
+		{
+			modified.push_back(model.Modify(store));
+		}
+		store.UpdateWorld();
+		CHECK(CountWorldMismatches(store, model) == 0);
+
+		for (uint32_t n = 0; n < model.nodes.size(); n++)
+		{
+			bool expectChanged = false;
+			for (uint32_t m : modified)
+			{
+				expectChanged = expectChanged || model.IsDescendantOf(n, m);
+			}
+			const uint32_t i = store.GetDenseIndex(model.nodes[n].handle);
+			CHECK((store.GetWorldChanged()[i] != 0) == expectChanged);
+			if (!expectChanged)
+			{
+				CHECK(memcmp(&before[i], &store.GetWorldMatrices()[i], sizeof(SceneMatrix)) == 0);
+			}
+		}
+	}
+}
+
+// Updating levels across a job system gives bit for bit the serial result.
+TEST(SceneStoreParallelUpdateMatchesSerial)
+{
+	JobSystem jobSystem(4);
+	SceneStore serialStore;
+	SceneStore parallelStore;
+	SceneModel serialModel(31);
+	SceneModel parallelModel(31);
+	BuildForest(serialStore, serialModel, 50, 4, 3);
+	BuildForest(parallelStore, parallelModel, 50, 4, 3);
+
+	for (uint32_t round = 0; round < 5; round++)
+	{
+		for (uint32_t i = 0; i < 500; i++)
+		{
+			serialModel.Modify(serialStore);
+			parallelModel.Modify(parallelStore);
+		}
+		serialStore.UpdateWorld();
+		parallelStore.UpdateWorld(&jobSystem, 64);
+
+		CHECK(serialStore.GetObjectCount() == parallelStore.GetObjectCount());
+		for (uint32_t n = 0; n < serialModel.nodes.size(); n++)
+		{
+			const uint32_t serialIndex = serialStore.GetDenseIndex(serialModel.nodes[n].handle);
+			const uint32_t parallelIndex = parallelStore.GetDenseIndex(parallelModel.nodes[n].handle);
+			CHECK(memcmp(&serialStore.GetWorldMatrices()[serialIndex], &parallelStore.GetWorldMatrices()[parallelIndex], sizeof(SceneMatrix)) == 0);
+			CHECK(serialStore.GetWorldChanged()[serialIndex] == parallelStore.GetWorldChanged()[parallelIndex]);
+		}
+	}
+}
+
+// UpdateWorld over about 100k objects when every object moved, when 1% did, and
+// when none did, on one thread and across the job system. Hierarchies come in
+// three shapes: deep chains, where each level holds few objects; wide fans,
+// with two levels; and the balanced forest in between.
+BENCHMARK(SceneStoreHierarchyUpdate)
+{
+	struct Shape
+	{
+		const char* name;
+		uint32_t rootCount;
+		uint32_t branchingFactor;
+		uint32_t depth;
+	};
+	const Shape shapes[] =
+	{
+		{ "deep", 1000, 1, 100 },
+		{ "wide", 10, 10000, 1 },
+		{ "balanced", 1600, 4, 3 },
+	};
+
+	JobSystem jobSystem;
+	printf("  %u workers\n", jobSystem.GetWorkerCount());
+	for (const Shape& shape : shapes)
+	{
+		SceneStore store;
+		SceneModel model(1);
+		BuildForest(store, model, shape.rootCount, shape.branchingFactor, shape.depth);
+		store.UpdateWorld();
+		const uint32_t objectCount = store.GetObjectCount();
+
+		const float fractions[] = { 1.0f, 0.01f, 0.0f };
+		for (float fraction : fractions)
+		{
+			const uint32_t Frames = 10;
+			double serialMs = 0.0;
+			double parallelMs = 0.0;
+			uint64_t changedCount = 0;
+			for (uint32_t frame = 0; frame < 2 * Frames; frame++)
+			{
+				const uint32_t stride = fraction > 0.0f ? static_cast<uint32_t>(1.0f / fraction) : UINT32_MAX;
+				for (uint32_t n = frame % 7; n < model.nodes.size() && stride != UINT32_MAX; n += stride)
+				{
+					store.SetPosition(model.nodes[n].handle, model.MakeDesc().position);
+				}
+
+				Stopwatch stopwatch;
+				if (frame < Frames)
+				{
+					store.UpdateWorld();
+					serialMs += stopwatch.GetMilliseconds();
+				}
+				else
+				{
+					store.UpdateWorld(&jobSystem);
+					parallelMs += stopwatch.GetMilliseconds();
+				}
+
+				for (uint32_t i = 0; i < objectCount; i++)
+				{
+					changedCount += store.GetWorldChanged()[i];
+				}
+			}
+			DoNotOptimize(changedCount);
+
+			printf("  %-8s %3u levels, %u objects, %5.1f%% dirty: %.3f ms serial, %.3f ms parallel, %llu world matrices recomputed per frame\n",
+				shape.name, shape.depth + 1, objectCount, fraction * 100.0f, serialMs / Frames, parallelMs / Frames,
+				static_cast<unsigned long long>(changedCount / (2 * Frames)));
+		}
+	}
+}
+
+// A million root objects, as the benchmark scene would hold at scale: creating
+// them, churning 10% through Destroy and Create, setting every transform through
+// its handle in random order, UpdateWorld on one thread and across the job
+// system, and the linear pass over bounds and mesh ids that culling makes.
+BENCHMARK(SceneStoreMillionObjects)
+{
+	const uint32_t ObjectCount = 1000000;
+	const uint32_t ChurnCount = ObjectCount / 10;
+	JobSystem jobSystem;
+	SceneStore store;
+	SceneModel model(2);
+	std::vector<SceneObjectDesc> descs(ObjectCount);
+	for (SceneObjectDesc& desc : descs)
+	{
+		desc = model.MakeDesc();
+	}
+
+	Stopwatch stopwatch;
+	std::vector<SceneObjectHandle> handles(ObjectCount);
+	for (uint32_t i = 0; i < ObjectCount; i++)
+	{
+		handles[i] = store.Create(descs[i]);
+	}
+	const double createMs = stopwatch.GetMilliseconds();
+	store.UpdateWorld(&jobSystem);
+
+	std::shuffle(handles.begin(), handles.end(), model.random);
+	stopwatch.Restart();
+	for (uint32_t i = 0; i < ChurnCount; i++)
+	{
+		store.Destroy(handles[i]);
+	}
+	for (uint32_t i = 0; i < ChurnCount; i++)
+	{
+		handles[i] = store.Create(descs[i]);
+	}
+	const double churnMs = stopwatch.GetMilliseconds();
+	stopwatch.Restart();
+	store.UpdateWorld(&jobSystem);
+	const double churnUpdateMs = stopwatch.GetMilliseconds();
+
+	const uint32_t Frames = 5;
+	double setMs = 0.0;
+	double serialMs = 0.0;
+	double parallelMs = 0.0;
+	double readMs = 0.0;
+	uint64_t checksum = 0;
+	std::shuffle(handles.begin(), handles.end(), model.random);
+	for (uint32_t frame = 0; frame < 2 * Frames; frame++)
+	{
+		stopwatch.Restart();
+		for (uint32_t i = 0; i < ObjectCount; i++)
+		{
+			const SceneFloat3& position = descs[(i + frame) % ObjectCount].position;
+			store.SetPosition(handles[i], position);
+		}
+		setMs += stopwatch.GetMilliseconds();
+
+		stopwatch.Restart();
+		if (frame < Frames)
+		{
+			store.UpdateWorld();
+			serialMs += stopwatch.GetMilliseconds();
+		}
+		else
+		{
+			store.UpdateWorld(&jobSystem);
+			parallelMs += stopwatch.GetMilliseconds();
+		}
+
+		stopwatch.Restart();
+		const SceneBoundsView bounds = store.GetWorldBounds();
+		const uint32_t* pMeshes = store.GetMeshes();
+		float extentSum = 0.0f;
+		uint64_t meshSum = 0;
+		for (uint32_t i = 0; i < bounds.count; i++)
+		{
+			extentSum += bounds.centerX[i] + bounds.centerY[i] + bounds.centerZ[i] + bounds.extentX[i] + bounds.extentY[i] + bounds.extentZ[i];
+			meshSum += pMeshes[i];
+		}
+		readMs += stopwatch.GetMilliseconds();
+		checksum += meshSum + static_cast<uint64_t>(extentSum);
+	}
+	DoNotOptimize(checksum);
+	CHECK(store.GetObjectCount() == ObjectCount);
+
+	const double nsPerObject = 1e6 / ObjectCount;
+	printf("  %u objects, %u workers\n", ObjectCount, jobSystem.GetWorkerCount());
+	printf("  create:                %8.2f ms, %5.1f ns per object\n", createMs, createMs * nsPerObject);
+	printf("  churn 10%%:             %8.2f ms, %5.1f ns per destroy and create, then %.2f ms to update\n", churnMs, churnMs * 1e6 / ChurnCount, churnUpdateMs);
+	printf("  set positions:         %8.2f ms, %5.1f ns per object\n", setMs / (2 * Frames), setMs / (2 * Frames) * nsPerObject);
+	printf("  UpdateWorld serial:    %8.2f ms, %5.1f ns per object\n", serialMs / Frames, serialMs / Frames * nsPerObject);
+	printf("  UpdateWorld parallel:  %8.2f ms, %5.1f ns per object\n", parallelMs / Frames, parallelMs / Frames * nsPerObject);
+	printf("  read bounds and meshes:%8.2f ms, %5.1f ns per object\n", readMs / (2 * Frames), readMs / (2 * Frames) * nsPerObject);
+}
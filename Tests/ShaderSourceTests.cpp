@@ -0,0 +1,121 @@
+#include "TestFramework.h"
+#include "ShaderSource.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// Shader files written to the working directory for the length of a test.
+	class TemporaryFiles
+	{
+	public:
+		~TemporaryFiles()
+		{
+			for (const std::string& name : m_names)
+			{
+				std::remove(name.c_str());
+			}
+		}
+
+		void Write(const std::string& name, const std::string& content)
+		{
+			std::ofstream file(name, std::ios::binary);
+			file << content;
+			m_names.push_back(name);
+		}
+
+	private:
+		std::vector<std::string> m_names;
+	};
+
+	std::wstring Widen(const std::string& path)
+	{
+		return std::wstring(path.begin(), path.end());
+	}
+}
+
+// Includes are followed depth first, relative to the including file, and every
+// file is listed once even when included again or through a cycle.
+TEST(ShaderSourceFollowsIncludesDepthFirstOnce)
+{
+	TemporaryFiles files;
+	files.Write("ShaderSourceTest_Main.hlsl", "#include \"ShaderSourceTest_A.hlsl\"\n#include \"ShaderSourceTest_B.hlsl\"\nfloat4 main() : SV_Target { return 0; }\n");
+	files.Write("ShaderSourceTest_A.hlsl", "#include \"ShaderSourceTest_Common.hlsl\"\n#include \"ShaderSourceTest_B.hlsl\"\n");
+	files.Write("ShaderSourceTest_B.hlsl", "#include \"ShaderSourceTest_Common.hlsl\"\n#include \"ShaderSourceTest_Main.hlsl\"\n");
+	files.Write("ShaderSourceTest_Common.hlsl", "static const float Pi = 3.14159265f;\n");
+
+	std::vector<ShaderSourceFile> sources;
+	ReadShaderSources(Widen("./ShaderSourceTest_Main.hlsl"), sources);
+
+	const char* expected[] = { "./ShaderSourceTest_Main.hlsl", "./ShaderSourceTest_A.hlsl", "./ShaderSourceTest_Common.hlsl", "./ShaderSourceTest_B.hlsl" };
+	CHECK(sources.size() == sizeof(expected) / sizeof(expected[0]));
+	for (size_t i = 0; i < sources.size() && i < sizeof(expected) / sizeof(expected[0]); i++)
+	{
+		CHECK(sources[i].path == Widen(expected[i]));
+	}
+	CHECK(sources.size() > 2 && sources[2].content == "static const float Pi = 3.14159265f;\n");
+}
+
+// Only #include "file" directives count, with any spacing; other forms and
+// commented-out lines are not followed. Carriage returns are stripped.
+TEST(ShaderSourceParsesIncludeDirectives)
+{
+	TemporaryFiles files;
+	files.Write("ShaderSourceTest_Directives.hlsl",
+		"  #  include\t\"ShaderSourceTest_Spaced.hlsl\"\r\n"
+		"// #include \"ShaderSourceTest_Commented.hlsl\"\r\n"
+		"#include <ShaderSourceTest_System.hlsl>\r\n"
+		"#define ShaderSourceTest_Include \"ShaderSourceTest_Macro.hlsl\"\r\n"
+		"#include \"\"\r\n"
+		"#include \"ShaderSourceTest_Missing.hlsl\"\r\n");
+	files.Write("ShaderSourceTest_Spaced.hlsl", "float x;\r\n");
+	files.Write("ShaderSourceTest_Commented.hlsl", "");
+
+	std::vector<ShaderSourceFile> sources;
+	ReadShaderSources(Widen("./ShaderSourceTest_Directives.hlsl"), sources);
+
+	CHECK(sources.size() == 3);
+	if (sources.size() == 3)
+	{
+		CHECK(sources[0].content.find('\r') == std::string::npos);
+		CHECK(sources[1].path == Widen("./ShaderSourceTest_Spaced.hlsl") && sources[1].content == "float x;\n");
+
+		// Missing files are listed with empty content, so their appearance changes the key.
+		CHECK(sources[2].path == Widen("./ShaderSourceTest_Missing.hlsl") && sources[2].content.empty());
+	}
+
+	// A missing root is a single empty file.
+	ReadShaderSources(Widen("./ShaderSourceTest_DoesNotExist.hlsl"), sources);
+	CHECK(sources.size() == 1 && sources[0].content.empty());
+}
+
+// The runtime key agrees with shader_key in Tools/build_shader_bundle.py, which
+// produced the constants from the same files: CRLF and LF lines, includes nested
+// and repeated, with and without defines.
+TEST(ShaderSourceKeyMatchesTheBundleScript)
+{
+	TemporaryFiles files;
+	files.Write("ShaderKeyTest_Main.hlsl",
+		"#include \"ShaderKeyTest_Common.hlsl\"\r\n"
+		"#include \"ShaderKeyTest_Lighting.hlsl\"\r\n"
+		"float4 PSMain(float4 position : SV_Position) : SV_Target\r\n"
+		"{\r\n"
+		"    return Shade(position);\r\n"
+		"}\r\n");
+	files.Write("ShaderKeyTest_Lighting.hlsl",
+		"#include \"ShaderKeyTest_Common.hlsl\"\r\n"
+		"  #  include \"ShaderKeyTest_Brdf.hlsl\"\n"
+		"float4 Shade(float4 p) { return Brdf(p) * Scale * LIGHT_COUNT; }\r\n");
+	files.Write("ShaderKeyTest_Brdf.hlsl",
+		"#include \"ShaderKeyTest_Common.hlsl\"\n"
+		"float4 Brdf(float4 p) { return p; }\n");
+	files.Write("ShaderKeyTest_Common.hlsl", "static const float Scale = 2.0f;\r\n");
+
+	const ShaderDefine defines[] = { { "USE_SHADOWS", nullptr }, { "LIGHT_COUNT", "4" } };
+	CHECK(ComputeShaderKey(Widen("./ShaderKeyTest_Main.hlsl"), defines, 2, "PSMain", "ps_5_1") == 0x1000ed5345a0920full);
+	CHECK(ComputeShaderKey(Widen("./ShaderKeyTest_Main.hlsl"), nullptr, 0, "PSMain", "ps_5_1") == 0x6531d242eb0921b5ull);
+	CHECK(ComputeShaderKey(Widen("./ShaderKeyTest_Lighting.hlsl"), defines + 1, 1, "VSMain", "vs_5_1") == 0xaea56ce4f3e87829ull);
+}
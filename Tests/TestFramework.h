@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// A minimal runner for the portable modules. TEST bodies run by default and
+// BENCHMARK bodies only with --bench; either can be narrowed to the names that
+// start with a prefix given on the command line. CHECK reports a failure and
+// carries on, so one run lists every broken expectation.
+typedef void (*TestFunction)();
+
+bool RegisterTest(const char* name, TestFunction function, bool benchmark);
+void ReportFailure(const char* file, int line, const char* expression);
+
+#define TEST(name) \
+    static void name(); \
+    static const bool name##Registered = RegisterTest(#name, name, false); \
+    static void name()
+
+#define BENCHMARK(name) \
+    static void name(); \
+    static const bool name##Registered = RegisterTest(#name, name, true); \
+    static void name()
+
+#define CHECK(expression) ((expression) ? static_cast<void>(0) : ReportFailure(__FILE__, __LINE__, #expression))
+
+class Stopwatch
+{
+public:
+    Stopwatch() : m_start(std::chrono::steady_clock::now()) {}
+
+    void Restart() { m_start = std::chrono::steady_clock::now(); }
+    double GetSeconds() const { return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count(); }
+    double GetMilliseconds() const { return GetSeconds() * 1000.0; }
+
+private:
+    std::chrono::steady_clock::time_point m_start;
+};
+
+// Keeps the optimizer from dropping work whose result is otherwise unused. Not
+// thread safe: call it from the benchmark thread only.
+void DoNotOptimize(uint64_t value);
@@ -0,0 +1,92 @@
+#include "TestFramework.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	struct RegisteredTest
+	{
+		const char* name;
+		TestFunction function;
+		bool benchmark;
+	};
+
+	// Function-local so that registration from other files' static initializers finds it constructed.
+	std::vector<RegisteredTest>& GetTests()
+	{
+		static std::vector<RegisteredTest> tests;
+		return tests;
+	}
+
+	const uint32_t MaxReportedFailures = 16;
+	uint32_t g_failureCount = 0;
+	volatile uint64_t g_sink = 0;
+}
+
+bool RegisterTest(const char* name, TestFunction function, bool benchmark)
+{
+	GetTests().push_back({ name, function, benchmark });
+	return true;
+}
+
+void ReportFailure(const char* file, int line, const char* expression)
+{
+	if (g_failureCount++ < MaxReportedFailures)
+	{
+		printf("  %s(%d): CHECK(%s) failed\n", file, line, expression);
+	}
+}
+
+void DoNotOptimize(uint64_t value)
+{
+	g_sink = g_sink + value;
+}
+
+// Usage: Tests [--bench] [name prefix]
+int main(int argc, char** argv)
+{
+	bool benchmarks = false;
+	const char* pPrefix = "";
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--bench") == 0)
+		{
+			benchmarks = true;
+		}
+		else
+		{
+			pPrefix = argv[i];
+		}
+	}
+
+	uint32_t runCount = 0;
+	uint32_t failedCount = 0;
+	for (const RegisteredTest& test : GetTests())
+	{
+		if (test.benchmark != benchmarks || strncmp(test.name, pPrefix, strlen(pPrefix)) != 0)
+		{
+			continue;
+		}
+
+		printf("%s\n", test.name);
+		fflush(stdout);
+		g_failureCount = 0;
+		const Stopwatch stopwatch;
+		test.function();
+		if (g_failureCount > 0)
+		{
+			printf("  FAILED with %u failed checks\n", g_failureCount);
+			failedCount++;
+		}
+		else if (!benchmarks)
+		{
+			printf("  passed in %.1f ms\n", stopwatch.GetMilliseconds());
+		}
+		runCount++;
+	}
+
+	printf("%u of %u %s passed\n", runCount - failedCount, runCount, benchmarks ? "benchmarks" : "tests");
+	return failedCount == 0 && runCount > 0 ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cmath>
+
+#include "SceneStore.h"
+
+// View and projection matrices with the DirectXMath conventions the engine uses
+// (row vectors, left handed, clip space depth in [0, 1]), for tests that cannot
+// include DirectXMath.
+
+inline SceneMatrix MultiplyMatrices(const SceneMatrix& a, const SceneMatrix& b)
+{
+    SceneMatrix result = {};
+    for (int row = 0; row < 4; row++)
+    {
+        for (int column = 0; column < 4; column++)
+        {
+            for (int k = 0; k < 4; k++)
+            {
+                result.m[row][column] += a.m[row][k] * b.m[k][column];
+            }
+        }
+    }
+    return result;
+}
+
+inline SceneFloat3 Normalize(const SceneFloat3& v)
+{
+    const float length = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+    return { v.x / length, v.y / length, v.z / length };
+}
+
+inline SceneFloat3 Cross(const SceneFloat3& a, const SceneFloat3& b)
+{
+    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+inline float Dot(const SceneFloat3& a, const SceneFloat3& b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+// XMMatrixLookAtLH.
+inline SceneMatrix MakeLookAt(const SceneFloat3& eye, const SceneFloat3& target, const SceneFloat3& up)
+{
+    const SceneFloat3 z = Normalize({ target.x - eye.x, target.y - eye.y, target.z - eye.z });
+    const SceneFloat3 x = Normalize(Cross(up, z));
+    const SceneFloat3 y = Cross(z, x);
+    const SceneMatrix view =
+    { {
+        { x.x, y.x, z.x, 0.0f },
+        { x.y, y.y, z.y, 0.0f },
+        { x.z, y.z, z.z, 0.0f },
+        { -Dot(x, eye), -Dot(y, eye), -Dot(z, eye), 1.0f },
+    } };
+    return view;
+}
+
+// XMMatrixPerspectiveFovLH.
+inline SceneMatrix MakePerspective(float fovY, float aspectRatio, float nearZ, float farZ)
+{
+    const float h = 1.0f / std::tan(fovY * 0.5f);
+    const float q = farZ / (farZ - nearZ);
+    const SceneMatrix projection =
+    { {
+        { h / aspectRatio, 0.0f, 0.0f, 0.0f },
+        { 0.0f, h, 0.0f, 0.0f },
+        { 0.0f, 0.0f, q, 1.0f },
+        { 0.0f, 0.0f, -q * nearZ, 0.0f },
+    } };
+    return projection;
+}
+
+inline SceneMatrix MakeViewProjection(const SceneFloat3& eye, const SceneFloat3& target, float fovY = 1.0f, float aspectRatio = 16.0f / 9.0f,
+    float nearZ = 0.1f, float farZ = 1000.0f)
+{
+    return MultiplyMatrices(MakeLookAt(eye, target, { 0.0f, 1.0f, 0.0f }), MakePerspective(fovY, aspectRatio, nearZ, farZ));
+}
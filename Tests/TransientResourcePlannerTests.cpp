@@ -0,0 +1,166 @@
+#include "TestFramework.h"
+#include "TransientResourcePlanner.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+	typedef TransientResourcePlanner::Request Request;
+	typedef TransientResourcePlanner::Placement Placement;
+
+	std::vector<Request> MakeRequests(std::mt19937& random, uint32_t count, uint32_t passCount, uint32_t heapGroupCount)
+	{
+		const uint64_t alignments[] = { 256, 4096, 65536, 4 << 20 };
+		std::vector<Request> requests(count);
+		for (Request& request : requests)
+		{
+			request.alignment = alignments[random() % 4];
+			request.size = (1 + random() % 64) * 32768 + random() % 4096;
+			request.firstPass = random() % passCount;
+			request.lastPass = std::min<uint32_t>(request.firstPass + random() % 8, passCount - 1);
+			request.heapGroup = random() % heapGroupCount;
+		}
+		return requests;
+	}
+
+	bool Overlap(uint64_t beginA, uint64_t endA, uint64_t beginB, uint64_t endB)
+	{
+		return beginA < endB && beginB < endA;
+	}
+
+	// No placement can beat the largest total size alive at any one pass.
+	uint64_t GetLowerBound(const std::vector<Request>& requests, uint32_t passCount)
+	{
+		uint64_t bound = 0;
+		for (uint32_t heapGroup = 0; heapGroup < 4; heapGroup++)
+		{
+			uint64_t groupBound = 0;
+			for (uint32_t pass = 0; pass < passCount; pass++)
+			{
+				uint64_t live = 0;
+				for (const Request& request : requests)
+				{
+					live += request.heapGroup == heapGroup && request.firstPass <= pass && pass <= request.lastPass ? request.size : 0;
+				}
+				groupBound = std::max(groupBound, live);
+			}
+			bound += groupBound;
+		}
+		return bound;
+	}
+}
+
+// Resources alive at the same time never share memory, placements are aligned
+// and inside their heap, and exactly the resources that share memory with
+// another are flagged for an aliasing barrier.
+TEST(TransientResourcePlannerNeverOverlapsLiveResources)
+{
+	std::mt19937 random(6);
+	TransientResourcePlanner planner;
+	std::vector<Placement> placements;
+	for (uint32_t round = 0; round < 300; round++)
+	{
+		const uint32_t passCount = 1 + random() % 30;
+		const std::vector<Request> requests = MakeRequests(random, random() % 60, passCount, 1 + random() % 3);
+		const uint64_t plannedSize = planner.Plan(requests, placements);
+		CHECK(placements.size() == requests.size());
+
+		uint64_t naiveSize = 0;
+		for (size_t i = 0; i < requests.size(); i++)
+		{
+			const Request& a = requests[i];
+			const Placement& placementA = placements[i];
+			naiveSize += (a.size + a.alignment - 1) / a.alignment * a.alignment;
+			CHECK(placementA.heapGroup == a.heapGroup);
+			CHECK(placementA.offset % a.alignment == 0);
+			CHECK(placementA.offset + a.size <= planner.GetHeapSize(a.heapGroup));
+
+			bool aliases = false;
+			for (size_t j = 0; j < requests.size(); j++)
+			{
+				const Request& b = requests[j];
+				if (i == j || a.heapGroup != b.heapGroup)
+				{
+					continue;
+				}
+				const bool sharesMemory = Overlap(placementA.offset, placementA.offset + a.size, placements[j].offset, placements[j].offset + b.size);
+				const bool livesTogether = a.firstPass <= b.lastPass && b.firstPass <= a.lastPass;
+				CHECK(!(sharesMemory && livesTogether));
+				aliases = aliases || sharesMemory;
+			}
+			CHECK(placementA.aliased == aliases);
+		}
+
+		CHECK(plannedSize == planner.GetPlannedSize());
+		CHECK(naiveSize == planner.GetNaiveSize());
+		CHECK(plannedSize <= naiveSize);
+		CHECK(plannedSize >= GetLowerBound(requests, passCount));
+	}
+}
+
+// Resources that never live at the same time share one allocation.
+TEST(TransientResourcePlannerAliasesDisjointLifetimes)
+{
+	TransientResourcePlanner planner;
+	std::vector<Placement> placements;
+	const std::vector<Request> requests =
+	{
+		{ 8 << 20, 65536, 0, 1, 0 },
+		{ 8 << 20, 65536, 2, 3, 0 },
+		{ 4 << 20, 65536, 4, 4, 0 },
+		{ 4 << 20, 65536, 4, 5, 0 },
+	};
+	CHECK(planner.Plan(requests, placements) == 8 << 20);
+	CHECK(planner.GetNaiveSize() == 24 << 20);
+	CHECK(placements[0].aliased && placements[1].aliased && placements[2].aliased && placements[3].aliased);
+	CHECK(planner.GetHeapGroupCount() == 1);
+}
+
+// The placed resources are reused next frame, where the first resource takes its
+// memory back from the last one, so both of an aliasing pair need a barrier.
+// Resources of other heap groups never alias.
+TEST(TransientResourcePlannerFlagsBothResourcesOfAnAlias)
+{
+	TransientResourcePlanner planner;
+	std::vector<Placement> placements;
+	const std::vector<Request> requests =
+	{
+		{ 4 << 20, 65536, 0, 1, 0 },
+		{ 2 << 20, 65536, 2, 3, 0 },
+		{ 2 << 20, 65536, 2, 3, 1 },
+	};
+	CHECK(planner.Plan(requests, placements) == 6 << 20);
+	CHECK(placements[0].offset == 0 && placements[1].offset == 0);
+	CHECK(placements[0].aliased && placements[1].aliased);
+	CHECK(!placements[2].aliased);
+}
+
+// Peak versus naive memory, and the lower bound, on synthetic frames; plus how long planning takes.
+BENCHMARK(TransientResourcePlannerPeakMemory)
+{
+	const uint32_t resourceCounts[] = { 16, 64, 256, 1024 };
+	std::mt19937 random(7);
+	TransientResourcePlanner planner;
+	std::vector<Placement> placements;
+	for (uint32_t resourceCount : resourceCounts)
+	{
+		const uint32_t passCount = resourceCount / 2;
+		const std::vector<Request> requests = MakeRequests(random, resourceCount, passCount, 2);
+
+		const uint32_t iterations = std::max(4096 / resourceCount, 4u);
+		const Stopwatch stopwatch;
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			planner.Plan(requests, placements);
+		}
+		const double ms = stopwatch.GetMilliseconds() / iterations;
+
+		const uint64_t lowerBound = GetLowerBound(requests, passCount);
+		printf("  %4u resources over %3u passes: planned %7.1f MB, naive %7.1f MB (%.1f%%), lower bound %7.1f MB; %.3f ms to plan\n",
+			resourceCount, passCount, planner.GetPlannedSize() / 1048576.0, planner.GetNaiveSize() / 1048576.0,
+			100.0 * planner.GetPlannedSize() / planner.GetNaiveSize(), lowerBound / 1048576.0, ms);
+	}
+}
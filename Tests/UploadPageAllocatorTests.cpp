@@ -0,0 +1,253 @@
+#include "TestFramework.h"
+#include "UploadPageAllocator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <vector>
+
+namespace
+{
+	const uint64_t PageSize = 64 * 1024;
+	const uint64_t ConstantAlignment = 256;
+
+	struct Range
+	{
+		uint64_t begin;
+		uint64_t end;
+	};
+
+	// Mirrors the page memory the caller would own, checking that the allocator
+	// creates and frees each index exactly once per lifetime.
+	struct PageTracker
+	{
+		std::vector<bool> live;
+
+		void OnAllocate(const UploadPageAllocator& allocator, UploadPageAllocator::Allocation allocation, bool createPage)
+		{
+			if (createPage)
+			{
+				if (allocation.page >= live.size())
+				{
+					live.resize(allocation.page + 1, false);
+				}
+				CHECK(!live[allocation.page]);
+				live[allocation.page] = true;
+			}
+			CHECK(allocation.page < live.size() && live[allocation.page]);
+			CHECK(allocator.GetPageSize(allocation.page) > 0);
+		}
+
+		void OnFree(const std::vector<uint32_t>& freedPages)
+		{
+			for (uint32_t page : freedPages)
+			{
+				CHECK(page < live.size() && live[page]);
+				live[page] = false;
+			}
+		}
+	};
+}
+
+// Allocations are aligned, fit their page and never overlap within a frame.
+TEST(UploadPageAllocatorPlacesAlignedDisjointAllocations)
+{
+	std::mt19937 random(1);
+	UploadPageAllocator allocator(PageSize);
+	PageTracker tracker;
+	std::vector<std::vector<Range>> pageRanges;
+	for (uint32_t i = 0; i < 20000; i++)
+	{
+		const uint64_t size = 1 + random() % (i % 100 == 99 ? 3 * PageSize : 2000);
+		const uint64_t alignment = random() % 2 ? ConstantAlignment : 16;
+		bool createPage;
+		const UploadPageAllocator::Allocation allocation = allocator.Allocate(size, alignment, createPage);
+		tracker.OnAllocate(allocator, allocation, createPage);
+
+		CHECK(allocation.offset % alignment == 0);
+		CHECK(allocation.offset + size <= allocator.GetPageSize(allocation.page));
+		CHECK(size <= PageSize || allocator.GetPageSize(allocation.page) >= size);
+		if (allocation.page >= pageRanges.size())
+		{
+			pageRanges.resize(allocation.page + 1);
+		}
+		pageRanges[allocation.page].push_back({ allocation.offset, allocation.offset + size });
+	}
+
+	for (std::vector<Range>& ranges : pageRanges)
+	{
+		std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) { return a.begin < b.begin; });
+		for (size_t r = 1; r < ranges.size(); r++)
+		{
+			CHECK(ranges[r - 1].end <= ranges[r].begin);
+		}
+	}
+}
+
+// Frames of random size against a GPU that lags a random number of frames:
+// no page is written again before the fence of the last frame that wrote it
+// has completed, and the pool stops growing once it covers the frames in flight.
+TEST(UploadPageAllocatorReusesPagesOnlyAfterTheirFenceRetires)
+{
+	const uint32_t MaxFramesInFlight = 3;
+	std::mt19937 random(2);
+	UploadPageAllocator allocator(PageSize);
+	PageTracker tracker;
+	std::vector<uint64_t> lastWrittenFence;
+	std::deque<uint64_t> inFlight;
+	std::vector<uint32_t> freedPages;
+	uint64_t completedFenceValue = 0;
+	uint32_t maxPageCount = 0;
+	uint32_t pageCountAtFrame1000 = 0;
+	uint64_t bytes = 0;
+	for (uint64_t fenceValue = 1; fenceValue <= 3000; fenceValue++)
+	{
+		// Between one and several pages' worth of constants, and now and then one oversized buffer.
+		const uint32_t allocationCount = 1 + random() % 600;
+		for (uint32_t a = 0; a < allocationCount; a++)
+		{
+			const uint64_t size = a == 0 && fenceValue % 7 == 0 ? 2 * PageSize + 1 : 256 + (random() % 2) * 256;
+			bool createPage;
+			const UploadPageAllocator::Allocation allocation = allocator.Allocate(size, ConstantAlignment, createPage);
+			tracker.OnAllocate(allocator, allocation, createPage);
+			bytes += size;
+
+			if (allocation.page >= lastWrittenFence.size())
+			{
+				lastWrittenFence.resize(allocation.page + 1, 0);
+			}
+			if (createPage)
+			{
+				lastWrittenFence[allocation.page] = 0;
+			}
+			CHECK(lastWrittenFence[allocation.page] == fenceValue || lastWrittenFence[allocation.page] <= completedFenceValue);
+			lastWrittenFence[allocation.page] = fenceValue;
+		}
+		allocator.FinishFrame(fenceValue);
+		inFlight.push_back(fenceValue);
+
+		// The GPU completes up to two frames, and the CPU waits when it is too far ahead, as the frame ring makes it.
+		for (uint32_t completed = random() % 3; completed > 0 && !inFlight.empty(); completed--)
+		{
+			completedFenceValue = inFlight.front();
+			inFlight.pop_front();
+		}
+		while (inFlight.size() >= MaxFramesInFlight)
+		{
+			completedFenceValue = inFlight.front();
+			inFlight.pop_front();
+		}
+
+		freedPages.clear();
+		allocator.RetirePages(completedFenceValue, freedPages);
+		tracker.OnFree(freedPages);
+		for (uint32_t page : freedPages)
+		{
+			CHECK(lastWrittenFence[page] <= completedFenceValue);
+		}
+
+		maxPageCount = std::max(maxPageCount, allocator.GetPageCount());
+		if (fenceValue == 1000)
+		{
+			pageCountAtFrame1000 = maxPageCount;
+		}
+	}
+
+	// A frame fills at most 5 pooled pages and one dedicated one.
+	CHECK(maxPageCount <= (MaxFramesInFlight + 1) * 6);
+	CHECK(maxPageCount == pageCountAtFrame1000);
+	CHECK(allocator.GetBytesAllocated() == bytes);
+}
+
+// A finished frame's partly filled page is not appended to by the next frame.
+TEST(UploadPageAllocatorStartsEachFrameOnAFreshPage)
+{
+	UploadPageAllocator allocator(PageSize);
+	std::vector<uint32_t> freedPages;
+	bool createPage;
+	const uint32_t firstPage = allocator.Allocate(256, ConstantAlignment, createPage).page;
+	allocator.FinishFrame(1);
+
+	const UploadPageAllocator::Allocation second = allocator.Allocate(256, ConstantAlignment, createPage);
+	CHECK(createPage && second.page != firstPage && second.offset == 0);
+	allocator.FinishFrame(2);
+
+	// Once frame 1 retires its page comes back, from the start.
+	allocator.RetirePages(1, freedPages);
+	CHECK(freedPages.empty());
+	const UploadPageAllocator::Allocation third = allocator.Allocate(256, ConstantAlignment, createPage);
+	CHECK(!createPage && third.page == firstPage && third.offset == 0);
+	CHECK(allocator.GetPageCount() == 2);
+}
+
+// Dedicated pages are freed on retirement and their index is reused.
+TEST(UploadPageAllocatorFreesOversizedPages)
+{
+	UploadPageAllocator allocator(PageSize);
+	std::vector<uint32_t> freedPages;
+	bool createPage;
+	const UploadPageAllocator::Allocation large = allocator.Allocate(PageSize * 3, ConstantAlignment, createPage);
+	CHECK(createPage && allocator.GetPageSize(large.page) == PageSize * 3);
+	allocator.FinishFrame(1);
+	allocator.RetirePages(0, freedPages);
+	CHECK(freedPages.empty() && allocator.GetPageCount() == 1);
+
+	allocator.RetirePages(1, freedPages);
+	CHECK(freedPages.size() == 1 && freedPages[0] == large.page);
+	CHECK(allocator.GetPageCount() == 0);
+
+	const UploadPageAllocator::Allocation small = allocator.Allocate(256, ConstantAlignment, createPage);
+	CHECK(createPage && small.page == large.page && allocator.GetPageSize(small.page) == PageSize);
+}
+
+// Per-draw constants as Engine::OnUpdate allocates them: 256 bytes each, three
+// frames in flight, with and without writing the data into backing memory.
+BENCHMARK(UploadPageAllocatorThroughput)
+{
+	const uint32_t FrameCount = 200;
+	const uint32_t AllocationsPerFrame = 100000;
+	const uint32_t MaxFramesInFlight = 3;
+	const uint64_t DefaultPageSize = 1024 * 1024;
+
+	for (uint32_t write = 0; write < 2; write++)
+	{
+		UploadPageAllocator allocator(DefaultPageSize);
+		std::vector<std::vector<uint8_t>> memory;
+		std::vector<uint32_t> freedPages;
+		uint8_t constants[256] = {};
+		uint64_t checksum = 0;
+
+		const Stopwatch stopwatch;
+		for (uint64_t fenceValue = 1; fenceValue <= FrameCount; fenceValue++)
+		{
+			for (uint32_t a = 0; a < AllocationsPerFrame; a++)
+			{
+				bool createPage;
+				const UploadPageAllocator::Allocation allocation = allocator.Allocate(sizeof(constants), ConstantAlignment, createPage);
+				if (createPage)
+				{
+					memory.resize(std::max<size_t>(memory.size(), allocation.page + 1));
+					memory[allocation.page].resize(static_cast<size_t>(allocator.GetPageSize(allocation.page)));
+				}
+				if (write)
+				{
+					constants[0] = static_cast<uint8_t>(a);
+					memcpy(&memory[allocation.page][static_cast<size_t>(allocation.offset)], constants, sizeof(constants));
+				}
+				checksum += allocation.offset;
+			}
+			allocator.FinishFrame(fenceValue);
+			freedPages.clear();
+			allocator.RetirePages(fenceValue >= MaxFramesInFlight ? fenceValue - MaxFramesInFlight + 1 : 0, freedPages);
+		}
+		const double seconds = stopwatch.GetSeconds();
+		DoNotOptimize(checksum);
+
+		printf("  %s: %.1f M allocations/s, %.2f GB/s, %u pages of %llu KB\n", write ? "allocate and write 256 B" : "allocate only",
+			FrameCount * static_cast<double>(AllocationsPerFrame) / seconds / 1e6,
+			write ? FrameCount * static_cast<double>(AllocationsPerFrame) * sizeof(constants) / seconds / 1e9 : 0.0,
+			allocator.GetPageCount(), static_cast<unsigned long long>(DefaultPageSize / 1024));
+	}
+}
@@ -0,0 +1,280 @@
+#include "TestFramework.h"
+#include "UploadRingAllocator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+	const uint64_t RingAlignment = 16;
+	const uint64_t TextureAlignment = 512;
+
+	// CopyUploader's use of the ring against a fake copy queue: a full ring
+	// submits whatever is pending and waits for the oldest submission, which
+	// the fake queue completes on the spot. Buffers larger than an allocation
+	// are split, as UploadBuffer does. Every allocation is checked against the
+	// data the GPU may still be reading.
+	class FakeCopyQueue
+	{
+	public:
+		explicit FakeCopyQueue(UploadRingAllocator& ring) :
+			m_ring(ring), m_nextFenceValue(1), m_completedFenceValue(0), m_pendingCopies(0), m_submitCount(0), m_stallCount(0), m_copyCount(0)
+		{
+		}
+
+		uint64_t Allocate(uint64_t size, uint64_t alignment)
+		{
+			CHECK(size <= m_ring.GetMaxAllocationSize());
+			for (;;)
+			{
+				m_ring.RetireSubmissions(m_completedFenceValue);
+				const uint64_t offset = m_ring.Allocate(size, alignment);
+				if (offset != UploadRingAllocator::NoSpace)
+				{
+					CHECK(offset % alignment == 0 && offset + size <= m_ring.GetRingSize());
+					CheckNotInFlight(offset, offset + size);
+					m_ranges.push_back({ offset, offset + size, 0 });
+					m_pendingCopies++;
+					m_copyCount++;
+					return offset;
+				}
+
+				if (m_pendingCopies > 0)
+				{
+					Submit();
+				}
+				m_stallCount++;
+				CHECK(m_ring.GetOldestFenceValue() > m_completedFenceValue);
+				m_completedFenceValue = m_ring.GetOldestFenceValue();
+			}
+		}
+
+		void UploadBuffer(uint64_t size)
+		{
+			while (size > 0)
+			{
+				const uint64_t chunkSize = std::min(size, m_ring.GetMaxAllocationSize());
+				Allocate(chunkSize, RingAlignment);
+				size -= chunkSize;
+			}
+		}
+
+		void Submit()
+		{
+			if (m_pendingCopies == 0)
+			{
+				return;
+			}
+			const uint64_t fenceValue = m_nextFenceValue++;
+			m_ring.Submit(fenceValue);
+			for (Range& range : m_ranges)
+			{
+				range.fenceValue = range.fenceValue == 0 ? fenceValue : range.fenceValue;
+			}
+			m_pendingCopies = 0;
+			m_submitCount++;
+		}
+
+		// The GPU catches up with everything submitted.
+		void CompleteAll()
+		{
+			m_completedFenceValue = m_nextFenceValue - 1;
+		}
+
+		uint64_t GetSubmitCount() const { return m_submitCount; }
+		uint64_t GetStallCount() const { return m_stallCount; }
+		uint64_t GetCopyCount() const { return m_copyCount; }
+
+	private:
+		struct Range
+		{
+			uint64_t begin;
+			uint64_t end;
+			uint64_t fenceValue;    // 0 until submitted.
+		};
+
+		void CheckNotInFlight(uint64_t begin, uint64_t end)
+		{
+			const uint64_t completedFenceValue = m_completedFenceValue;
+			m_ranges.erase(std::remove_if(m_ranges.begin(), m_ranges.end(), [completedFenceValue](const Range& range)
+			{
+				return range.fenceValue != 0 && range.fenceValue <= completedFenceValue;
+			}), m_ranges.end());
+
+			for (const Range& range : m_ranges)
+			{
+				CHECK(end <= range.begin || range.end <= begin);
+			}
+		}
+
+		UploadRingAllocator& m_ring;
+		std::vector<Range> m_ranges;
+		uint64_t m_nextFenceValue;
+		uint64_t m_completedFenceValue;
+		uint32_t m_pendingCopies;
+		uint64_t m_submitCount;
+		uint64_t m_stallCount;
+		uint64_t m_copyCount;
+	};
+}
+
+// An allocation that does not fit before the end of the ring skips to its start,
+// once the submission occupying the start has retired.
+TEST(UploadRingAllocatorWrapsToTheStart)
+{
+	UploadRingAllocator ring(1024);
+	CHECK(ring.Allocate(400, RingAlignment) == 0);
+	CHECK(ring.Allocate(400, RingAlignment) == 400);
+	ring.Submit(1);
+	CHECK(ring.GetUsedSize() == 800);
+
+	CHECK(ring.Allocate(400, RingAlignment) == UploadRingAllocator::NoSpace);
+	CHECK(ring.GetOldestFenceValue() == 1);
+	ring.RetireSubmissions(0);
+	CHECK(ring.Allocate(400, RingAlignment) == UploadRingAllocator::NoSpace);
+
+	// The skipped 224 bytes at the end count as used until this data retires.
+	ring.RetireSubmissions(1);
+	CHECK(ring.GetOldestFenceValue() == 0);
+	CHECK(ring.Allocate(400, RingAlignment) == 0);
+	CHECK(ring.GetUsedSize() == 624);
+
+	// Alignment applies to the physical offset.
+	CHECK(ring.Allocate(10, 256) == 512);
+	ring.Submit(2);
+	ring.RetireSubmissions(2);
+	CHECK(ring.GetUsedSize() == 0);
+}
+
+// A full ring with nothing in flight can only be freed by submitting, and space
+// comes back one submission at a time, in order.
+TEST(UploadRingAllocatorStallsUntilSubmissionsRetire)
+{
+	UploadRingAllocator ring(1024);
+	CHECK(ring.Allocate(512, RingAlignment) == 0);
+	CHECK(ring.Allocate(512, RingAlignment) == 512);
+	CHECK(ring.Allocate(16, RingAlignment) == UploadRingAllocator::NoSpace);
+	CHECK(ring.GetOldestFenceValue() == 0);
+
+	ring.Submit(5);
+	CHECK(ring.GetOldestFenceValue() == 5);
+	CHECK(ring.Allocate(16, RingAlignment) == UploadRingAllocator::NoSpace);
+	ring.RetireSubmissions(5);
+	CHECK(ring.Allocate(256, RingAlignment) == 0);
+	ring.Submit(6);
+	CHECK(ring.Allocate(256, RingAlignment) == 256);
+	ring.Submit(7);
+	CHECK(ring.Allocate(768, RingAlignment) == UploadRingAllocator::NoSpace);
+
+	ring.RetireSubmissions(6);
+	CHECK(ring.GetOldestFenceValue() == 7);
+	CHECK(ring.Allocate(512, RingAlignment) == 512);
+	CHECK(ring.Allocate(256, RingAlignment) == 0);
+	CHECK(ring.Allocate(16, RingAlignment) == UploadRingAllocator::NoSpace);
+	ring.RetireSubmissions(7);
+	CHECK(ring.Allocate(256, RingAlignment) == 256);
+}
+
+// Wherever the head is, an allocation of the maximum size fits the empty ring.
+TEST(UploadRingAllocatorAlwaysFitsTheMaximumOnceEmpty)
+{
+	const uint64_t RingSize = 4096;
+	for (uint64_t position = 0; position < RingSize; position += RingAlignment)
+	{
+		const uint64_t alignments[] = { RingAlignment, TextureAlignment };
+		for (uint64_t alignment : alignments)
+		{
+			UploadRingAllocator ring(RingSize);
+			if (position > 0)
+			{
+				CHECK(ring.Allocate(position, RingAlignment) == 0);
+			}
+			ring.Submit(1);
+			ring.RetireSubmissions(1);
+			CHECK(ring.Allocate(ring.GetMaxAllocationSize(), alignment) != UploadRingAllocator::NoSpace);
+		}
+	}
+}
+
+// Random buffers and textures, some larger than the ring, with submits now and
+// then and a GPU that lags: no allocation overlaps data still in flight, and
+// oversized buffers are split into as many copies as it takes.
+TEST(UploadRingAllocatorNeverOverwritesDataInFlight)
+{
+	std::mt19937 random(7);
+	const uint64_t RingSize = 64 * 1024;
+	UploadRingAllocator ring(RingSize);
+	FakeCopyQueue queue(ring);
+	uint64_t expectedCopies = 0;
+	for (uint32_t i = 0; i < 20000; i++)
+	{
+		const uint32_t kind = random() % 100;
+		if (kind < 2)
+		{
+			const uint64_t size = RingSize + random() % (3 * RingSize);
+			queue.UploadBuffer(size);
+			expectedCopies += (size + ring.GetMaxAllocationSize() - 1) / ring.GetMaxAllocationSize();
+		}
+		else if (kind < 10)
+		{
+			queue.Allocate(TextureAlignment * (1 + random() % 32), TextureAlignment);
+			expectedCopies++;
+		}
+		else
+		{
+			queue.UploadBuffer(1 + random() % 4000);
+			expectedCopies++;
+		}
+
+		if (random() % 16 == 0)
+		{
+			queue.Submit();
+		}
+		if (random() % 64 == 0)
+		{
+			queue.CompleteAll();
+		}
+	}
+	CHECK(queue.GetCopyCount() == expectedCopies);
+	CHECK(queue.GetStallCount() > 0);
+	CHECK(ring.GetUsedSize() <= RingSize);
+}
+
+// Streaming mesh-sized buffers through rings of several sizes, with the GPU
+// only catching up when the CPU waits: submits and stalls per batch, the bytes
+// each submit carries, and the cost of the bookkeeping itself.
+BENCHMARK(UploadRingAllocatorStreaming)
+{
+	const uint64_t TotalBytes = 4ull << 30;
+	const uint64_t ringSizes[] = { 4 << 20, 16 << 20, 64 << 20 };
+	for (uint64_t ringSize : ringSizes)
+	{
+		std::mt19937 random(8);
+		std::uniform_real_distribution<double> logSize(std::log(1024.0), std::log(8.0 * 1024 * 1024));
+		UploadRingAllocator ring(ringSize);
+		FakeCopyQueue queue(ring);
+		uint64_t bytes = 0;
+		uint64_t bufferCount = 0;
+
+		const Stopwatch stopwatch;
+		while (bytes < TotalBytes)
+		{
+			const uint64_t size = static_cast<uint64_t>(std::exp(logSize(random)));
+			queue.UploadBuffer(size);
+			bytes += size;
+			bufferCount++;
+		}
+		queue.Submit();
+		const double seconds = stopwatch.GetSeconds();
+
+		printf("  %3llu MB ring: %llu buffers, %llu copies, %llu submits, %llu stalls, %.2f MB per submit, %.1f M allocations/s\n",
+			static_cast<unsigned long long>(ringSize >> 20), static_cast<unsigned long long>(bufferCount),
+			static_cast<unsigned long long>(queue.GetCopyCount()), static_cast<unsigned long long>(queue.GetSubmitCount()),
+			static_cast<unsigned long long>(queue.GetStallCount()),
+			static_cast<double>(bytes) / (1024.0 * 1024.0) / static_cast<double>(queue.GetSubmitCount()),
+			static_cast<double>(queue.GetCopyCount()) / seconds / 1e6);
+	}
+}
@@ -0,0 +1,277 @@
+#include "TestFramework.h"
+#include "VertexPacking.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// Angle in degrees between a normal and the unit normal it decoded to.
+	double GetAngleError(const float* pNormal, const float* pDecoded)
+	{
+		const double length = sqrt(static_cast<double>(pNormal[0]) * pNormal[0] + static_cast<double>(pNormal[1]) * pNormal[1] + static_cast<double>(pNormal[2]) * pNormal[2]);
+		const double n[3] = { pNormal[0] / length, pNormal[1] / length, pNormal[2] / length };
+		const double cross[3] = { n[1] * pDecoded[2] - n[2] * pDecoded[1], n[2] * pDecoded[0] - n[0] * pDecoded[2], n[0] * pDecoded[1] - n[1] * pDecoded[0] };
+		const double dot = n[0] * pDecoded[0] + n[1] * pDecoded[1] + n[2] * pDecoded[2];
+		return atan2(sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]), dot) * 180.0 / 3.14159265358979;
+	}
+
+	// The float layout: position, texture coordinates, normal and color.
+	std::vector<float> MakeVertices(uint32_t count, const float* pCenter, const float* pExtents, uint32_t seed)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::normal_distribution<float> gaussian;
+		std::vector<float> vertices(count * 12);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			float* pVertex = &vertices[i * 12];
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				// The first eight are the corners of the bounds.
+				pVertex[axis] = pCenter[axis] + (i < 8 ? ((i >> axis) & 1 ? 1.0f : -1.0f) : signedUnit(random)) * pExtents[axis];
+			}
+			pVertex[3] = unit(random);
+			pVertex[4] = unit(random) * 4.0f;
+			pVertex[5] = gaussian(random);
+			pVertex[6] = gaussian(random);
+			pVertex[7] = gaussian(random);
+			for (uint32_t channel = 0; channel < 4; channel++)
+			{
+				pVertex[8 + channel] = unit(random);
+			}
+		}
+		return vertices;
+	}
+
+	// Largest position error along each axis after a pack and unpack.
+	void MeasurePositionErrors(const std::vector<float>& vertices, const float* pCenter, const float* pExtents, double* pErrors)
+	{
+		const uint32_t count = static_cast<uint32_t>(vertices.size() / 12);
+		const PositionQuantization quantization = GetPositionQuantization(pCenter, pExtents);
+		std::vector<PackedVertex> packed(count);
+		PackVertices(packed.data(), vertices.data(), 48, count, quantization);
+		pErrors[0] = pErrors[1] = pErrors[2] = 0.0;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			float unpacked[12];
+			UnpackVertex(packed[i], quantization, unpacked);
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				pErrors[axis] = std::max(pErrors[axis], static_cast<double>(fabsf(unpacked[axis] - vertices[i * 12 + axis])));
+			}
+		}
+	}
+}
+
+// Every finite half survives a round trip through float, and floats round to the
+// nearest half, ties to even, with overflow to infinity and underflow to zero.
+TEST(VertexPackingConvertsHalves)
+{
+	for (uint32_t half = 0; half < 0x10000; half++)
+	{
+		const float value = HalfToFloat(static_cast<uint16_t>(half));
+		if (((half >> 10) & 0x1f) != 0x1f)
+		{
+			CHECK(FloatToHalf(value) == half);
+		}
+	}
+
+	// Between each pair of neighbouring positive halves below the largest.
+	for (uint32_t half = 0; half < 0x7bff; half++)
+	{
+		const float low = HalfToFloat(static_cast<uint16_t>(half));
+		const float high = HalfToFloat(static_cast<uint16_t>(half + 1));
+		const float middle = (low + high) * 0.5f;
+		const uint32_t even = half % 2 == 0 ? half : half + 1;
+		CHECK(FloatToHalf(middle) == even);
+		CHECK(FloatToHalf(-middle) == (even | 0x8000));
+		CHECK(FloatToHalf(nextafterf(middle, 0.0f)) == half);
+		CHECK(FloatToHalf(nextafterf(middle, 1e9f)) == half + 1);
+	}
+
+	CHECK(FloatToHalf(65504.0f) == 0x7bff);
+	CHECK(FloatToHalf(65520.0f) == 0x7c00);
+	CHECK(FloatToHalf(-1e10f) == 0xfc00);
+	CHECK(FloatToHalf(INFINITY) == 0x7c00);
+	CHECK((FloatToHalf(NAN) & 0x7c00) == 0x7c00 && (FloatToHalf(NAN) & 0x3ff) != 0);
+	CHECK(FloatToHalf(FLT_MIN) == 0);
+	CHECK(FloatToHalf(-FLT_MIN) == 0x8000);
+	CHECK(FloatToHalf(HalfToFloat(1) * 0.5f) == 0);
+	CHECK(FloatToHalf(nextafterf(HalfToFloat(1) * 0.5f, 1.0f)) == 1);
+}
+
+// Random unit and non-unit normals, and those next to the octahedron's folds
+// and edges, decode within 0.01 degrees, a bit over the 0.0073 measured worst case.
+TEST(VertexPackingBoundsOctahedralError)
+{
+	std::mt19937 random(24);
+	std::normal_distribution<float> gaussian;
+	double maxError = 0.0;
+	for (uint32_t i = 0; i < 300000; i++)
+	{
+		float normal[3] = { gaussian(random), gaussian(random), gaussian(random) };
+		if (i % 3 == 0)
+		{
+			normal[i % 2 == 0 ? 2 : i % 7 % 3] *= 1e-4f;       // Near z = 0, where the halves fold, or near the other edges.
+		}
+		int16_t encoded[2];
+		float decoded[3];
+		EncodeOctahedral(normal, encoded);
+		DecodeOctahedral(encoded, decoded);
+		maxError = std::max(maxError, GetAngleError(normal, decoded));
+		CHECK(fabsf(decoded[0] * decoded[0] + decoded[1] * decoded[1] + decoded[2] * decoded[2] - 1.0f) < 1e-5f);
+
+		const float scaled[3] = { normal[0] * 37.0f, normal[1] * 37.0f, normal[2] * 37.0f };
+		EncodeOctahedral(scaled, encoded);
+		DecodeOctahedral(encoded, decoded);
+		maxError = std::max(maxError, GetAngleError(scaled, decoded));
+	}
+	CHECK(maxError < 0.01);
+}
+
+// The six axes decode exactly, and a zero normal encodes as +z rather than NaN.
+TEST(VertexPackingKeepsAxisAlignedNormals)
+{
+	for (uint32_t axis = 0; axis < 6; axis++)
+	{
+		float normal[3] = { 0.0f, 0.0f, 0.0f };
+		normal[axis / 2] = axis % 2 == 0 ? 1.0f : -1.0f;
+		int16_t encoded[2];
+		float decoded[3];
+		EncodeOctahedral(normal, encoded);
+		DecodeOctahedral(encoded, decoded);
+		CHECK(decoded[0] == normal[0] && decoded[1] == normal[1] && decoded[2] == normal[2]);
+	}
+
+	const float zero[3] = { 0.0f, 0.0f, 0.0f };
+	int16_t encoded[2];
+	float decoded[3];
+	EncodeOctahedral(zero, encoded);
+	DecodeOctahedral(encoded, decoded);
+	CHECK(encoded[0] == 0 && encoded[1] == 0);
+	CHECK(decoded[0] == 0.0f && decoded[1] == 0.0f && decoded[2] == 1.0f);
+
+	// SNORM16 reads -32768 as -1 too.
+	const int16_t lowest[2] = { -32768, 0 };
+	DecodeOctahedral(lowest, decoded);
+	CHECK(decoded[0] == -1.0f && decoded[1] == 0.0f && decoded[2] == 0.0f);
+}
+
+// Positions come back within extents / 65535, give or take float rounding,
+// over bounds of very different sizes and away from the origin; the bounds'
+// corners are included. Texture coordinates keep half precision and colors
+// are within half a step.
+TEST(VertexPackingBoundsQuantizationError)
+{
+	const float centers[][3] = { { 0.0f, 0.0f, 0.0f }, { 3.0f, -20.0f, 0.5f }, { 1000.0f, 0.0f, -500.0f } };
+	const float extents[][3] = { { 1.0f, 1.0f, 1.0f }, { 50.0f, 0.25f, 7.0f }, { 0.001f, 300.0f, 2.0f } };
+	for (uint32_t bounds = 0; bounds < 3; bounds++)
+	{
+		const std::vector<float> vertices = MakeVertices(100000, centers[bounds], extents[bounds], bounds);
+		double errors[3];
+		MeasurePositionErrors(vertices, centers[bounds], extents[bounds], errors);
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			const float rounding = 4.0f * FLT_EPSILON * (fabsf(centers[bounds][axis]) + extents[bounds][axis]);
+			CHECK(errors[axis] <= extents[bounds][axis] / 65535.0 + rounding);
+		}
+
+		const PositionQuantization quantization = GetPositionQuantization(centers[bounds], extents[bounds]);
+		std::vector<PackedVertex> packed(vertices.size() / 12);
+		PackVertices(packed.data(), vertices.data(), 48, static_cast<uint32_t>(packed.size()), quantization);
+		for (size_t i = 0; i < packed.size(); i++)
+		{
+			float unpacked[12];
+			UnpackVertex(packed[i], quantization, unpacked);
+			const float* pVertex = &vertices[i * 12];
+			CHECK(packed[i].position[3] == 0);
+			for (uint32_t t = 3; t < 5; t++)
+			{
+				// Half a unit in the last place: 2^-11 relative, or 2^-25 among the subnormals.
+				CHECK(fabs(static_cast<double>(unpacked[t]) - pVertex[t]) <= ldexp(std::max(fabs(pVertex[t]), ldexp(1.0, -14)), -11));
+			}
+			for (uint32_t channel = 8; channel < 12; channel++)
+			{
+				CHECK(fabsf(unpacked[channel] - pVertex[channel]) <= 0.5f / 255.0f + 1e-6f);
+			}
+		}
+	}
+}
+
+// Flat and single-point meshes have zero extents along some axes: those axes
+// decode exactly to the center instead of dividing by zero, and the others keep
+// their precision. Positions outside the bounds clamp to them, as do colors.
+TEST(VertexPackingHandlesDegenerateBounds)
+{
+	const float center[3] = { 2.0f, -3.0f, 0.25f };
+	const float flat[3] = { 4.0f, 0.0f, 1.0f };
+	const float point[3] = { 0.0f, 0.0f, 0.0f };
+	for (const float* pExtents : { flat, point })
+	{
+		const std::vector<float> vertices = MakeVertices(20000, center, pExtents, 5);
+		const PositionQuantization quantization = GetPositionQuantization(center, pExtents);
+		std::vector<PackedVertex> packed(vertices.size() / 12);
+		PackVertices(packed.data(), vertices.data(), 48, static_cast<uint32_t>(packed.size()), quantization);
+		for (size_t i = 0; i < packed.size(); i++)
+		{
+			float unpacked[12];
+			UnpackVertex(packed[i], quantization, unpacked);
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				if (pExtents[axis] == 0.0f)
+				{
+					CHECK(unpacked[axis] == center[axis]);
+				}
+				else
+				{
+					CHECK(fabsf(unpacked[axis] - vertices[i * 12 + axis]) <= pExtents[axis] / 65535.0f + 4.0f * FLT_EPSILON * (fabsf(center[axis]) + pExtents[axis]));
+				}
+			}
+			CHECK(std::isfinite(unpacked[5]) && std::isfinite(unpacked[6]) && std::isfinite(unpacked[7]));
+		}
+	}
+
+	const float outside[12] = { 100.0f, -100.0f, 0.25f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 2.0f, 0.5f, 1.0f };
+	PackedVertex packed;
+	PackVertices(&packed, outside, 48, 1, GetPositionQuantization(center, flat));
+	CHECK(packed.position[0] == 65535 && packed.position[1] == 0 && packed.position[2] == 32768);
+	CHECK(packed.color[0] == 0 && packed.color[1] == 255 && packed.color[2] == 128 && packed.color[3] == 255);
+}
+
+// Packing a million vertices, and unpacking them again as the reference does.
+BENCHMARK(VertexPackingMillionVertices)
+{
+	const uint32_t Count = 1 << 20;
+	const float center[3] = { 3.0f, -20.0f, 0.5f };
+	const float extents[3] = { 50.0f, 0.25f, 7.0f };
+	const std::vector<float> vertices = MakeVertices(Count, center, extents, 1);
+	const PositionQuantization quantization = GetPositionQuantization(center, extents);
+	std::vector<PackedVertex> packed(Count);
+
+	Stopwatch stopwatch;
+	PackVertices(packed.data(), vertices.data(), 48, Count, quantization);
+	const double packMs = stopwatch.GetMilliseconds();
+
+	float sum = 0.0f;
+	stopwatch.Restart();
+	for (const PackedVertex& vertex : packed)
+	{
+		float unpacked[12];
+		UnpackVertex(vertex, quantization, unpacked);
+		sum += unpacked[0] + unpacked[5];
+	}
+	const double unpackMs = stopwatch.GetMilliseconds();
+	DoNotOptimize(static_cast<uint64_t>(sum));
+
+	double errors[3];
+	MeasurePositionErrors(vertices, center, extents, errors);
+	printf("  %u vertices, %zu bytes each instead of 48: pack %.1f ms (%.1f M vertices/s), unpack %.1f ms\n", Count, sizeof(PackedVertex),
+		packMs, Count / packMs * 1e-3, unpackMs);
+	printf("  position error / extents %.3g %.3g %.3g, bound 1/65535 = %.3g\n", errors[0] / extents[0], errors[1] / extents[1], errors[2] / extents[2], 1.0 / 65535.0);
+}
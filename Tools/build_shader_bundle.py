@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+"""Compile every shader permutation listed in a manifest into one indexed bundle.
+
+Bundle layout (little-endian):
+    header   magic 'SHBN' (u32), version (u32), entry count (u32), reserved (u32)
+    index    entry count x { key (u64), offset (u64), size (u64) }, sorted by key
+    data     bytecode blobs, each 16-byte aligned
+
+The key is FNV-1a 64 over entry, target, defines and the source with its
+includes; ComputeShaderKey in Source/ShaderSource.cpp computes the same key at
+runtime, and Tests/ShaderSourceTests.cpp checks the two agree. Any edit
+to a source file simply misses and the engine compiles that shader itself.
+"""
+
+import argparse
+import os
+import re
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+
+BUNDLE_MAGIC = 0x4E424853  # 'SHBN'
+BUNDLE_VERSION = 1
+FNV_OFFSET = 14695981039346656037
+FNV_PRIME = 1099511628211
+INCLUDE_PATTERN = re.compile(rb'^[ \t]*#[ \t]*include[ \t]*"([^"]+)"', re.MULTILINE)
+
+
+def fnv1a(data, value=FNV_OFFSET):
+    for byte in data:
+        value = ((value ^ byte) * FNV_PRIME) & 0xFFFFFFFFFFFFFFFF
+    return value
+
+
+def collect_sources(path, visited, out):
+    """Depth-first, pre-order list of the file and everything it includes, each once."""
+    path = os.path.normpath(path)
+    key = os.path.normcase(path)
+    if key in visited:
+        return
+    visited.add(key)
+
+    with open(path, 'rb') as f:
+        # Line endings depend on the checkout; hash them the same everywhere.
+        content = f.read().replace(b'\r', b'')
+    out.append(content)
+
+    for include in INCLUDE_PATTERN.findall(content):
+        collect_sources(os.path.join(os.path.dirname(path), include.decode()), visited, out)
+
+
+def shader_key(source_path, entry, target, defines):
+    data = bytearray()
+    data += entry.encode() + b'\0'
+    data += target.encode() + b'\0'
+    for name, value in defines:
+        data += ('%s=%s' % (name, value)).encode() + b'\0'
+    data += b'\0'
+
+    sources = []
+    collect_sources(source_path, set(), sources)
+    for content in sources:
+        data += content + b'\0'
+    return fnv1a(data)
+
+
+def parse_manifest(path):
+    entries = []
+    with open(path, 'r') as f:
+        for line_number, line in enumerate(f, 1):
+            line = line.split('#', 1)[0].strip()
+            if not line:
+                continue
+            fields = line.split()
+            if len(fields) < 3:
+                sys.exit('%s(%d): expected <source> <entry> <target> [NAME=VALUE ...]' % (path, line_number))
+            defines = []
+            for define in fields[3:]:
+                name, _, value = define.partition('=')
+                defines.append((name, value or '1'))
+            entries.append((fields[0], fields[1], fields[2], defines))
+    return entries
+
+
+def compiler_command(compiler, source, entry, target, defines, output):
+    if compiler == 'dxc':
+        # DXC only emits DXIL, so shader model 5.x requests are built as 6.0.
+        major, minor = target.rsplit('_', 2)[-2:]
+        if int(major) < 6:
+            target = target.rsplit('_', 2)[0] + '_6_0'
+        # The shaders are written for HLSL 2018, which fxc also accepts; newer
+        # DXC releases default to 2021 and its stricter rules.
+        command = ['dxc', '-nologo', '-T', target, '-E', entry, '-HV', '2018', '-O3', '-Fo', output]
+    else:
+        command = ['fxc', '/nologo', '/T', target, '/E', entry, '/O3', '/Fo', output]
+    for name, value in defines:
+        command += ['-D', '%s=%s' % (name, value)]
+    return command + [source]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--manifest', required=True)
+    parser.add_argument('--out', required=True)
+    parser.add_argument('--compiler', choices=['dxc', 'fxc'], default='dxc')
+    parser.add_argument('--optional', action='store_true',
+                        help='succeed without writing a bundle if the compiler is not installed')
+    args = parser.parse_args()
+
+    if shutil.which(args.compiler) is None:
+        message = '%s not found; the engine will compile shaders at startup' % args.compiler
+        if args.optional:
+            print('warning: ' + message)
+            return 0
+        sys.exit('error: ' + message)
+
+    manifest_dir = os.path.dirname(os.path.abspath(args.manifest))
+    blobs = {}
+    with tempfile.TemporaryDirectory() as temp_dir:
+        for index, (source, entry, target, defines) in enumerate(parse_manifest(args.manifest)):
+            source_path = os.path.join(manifest_dir, source)
+            key = shader_key(source_path, entry, target, defines)
+            output = os.path.join(temp_dir, '%d.bin' % index)
+
+            result = subprocess.run(compiler_command(args.compiler, source_path, entry, target, defines, output),
+                                    stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+            if result.returncode != 0:
+                sys.stderr.write(result.stdout)
+                sys.exit('error: failed to compile %s:%s (%s)' % (source, entry, target))
+
+            with open(output, 'rb') as f:
+                blobs[key] = f.read()
+            print('%016x  %-24s %-12s %-8s %6d bytes' % (key, source, entry, target, len(blobs[key])))
+
+    keys = sorted(blobs)
+    header_size = 16
+    offset = header_size + len(keys) * 24
+    index = bytearray()
+    data = bytearray()
+    for key in keys:
+        padding = (-(offset + len(data))) % 16
+        data += b'\0' * padding
+        index += struct.pack('<QQQ', key, offset + len(data), len(blobs[key]))
+        data += blobs[key]
+
+    with open(args.out, 'wb') as f:
+        f.write(struct.pack('<IIII', BUNDLE_MAGIC, BUNDLE_VERSION, len(keys), 0))
+        f.write(index)
+        f.write(data)
+
+    print('wrote %s: %d shaders, %d bytes' % (args.out, len(keys), header_size + len(index) + len(data)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())